@@ -8,6 +8,7 @@
 #include "uint256.h"
 #include "proof.h"
 #include "transaction.h"
+#include "merkle.h"
 #include <vector>
 #include <walleve/stream/stream.h>
 #include <walleve/stream/datastream.h>
@@ -50,6 +51,7 @@ public:
         txMint.SetNull();
         vtx.clear();
         vchSig.clear();
+        hashSealed = 0;
     }
     bool IsNull() const
     {
@@ -75,11 +77,33 @@ public:
     {
         return (txMint.nType == CTransaction::TX_WORK);
     }
+    // Seal caches the block hash and the hashes of its transactions,
+    // code that changes fields directly calls Unseal
+    void Seal()
+    {
+        txMint.Seal();
+        for (CTransaction& tx : vtx)
+        {
+            tx.Seal();
+        }
+        hashSealed = CalcHash();
+    }
+    void Unseal()
+    {
+        txMint.Unseal();
+        for (CTransaction& tx : vtx)
+        {
+            tx.Unseal();
+        }
+        hashSealed = 0;
+    }
+    bool IsSealed() const
+    {
+        return (hashSealed != 0);
+    }
     uint256 GetHash() const
     {
-        walleve::CWalleveBufStream ss;
-        ss << nVersion << nType << nTimeStamp << hashPrev << hashMerkle << vchProof << txMint;
-        return multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
+        return (hashSealed != 0 ? hashSealed : CalcHash());
     }
     std::size_t GetTxSerializedOffset() const
     {
@@ -156,13 +180,108 @@ public:
     }
     uint256 CalcMerkleTreeRoot() const
     {
-        std::vector<uint256> vMerkleTree;
-        return BuildMerkleTree(vMerkleTree);
+        CMerkleBuilder builder;
+        for (const CTransaction& tx : vtx)
+        {
+            builder.Append(tx.GetHash());
+        }
+        return builder.GetRoot();
+    }
+    // Length of the block serialized at the head of pData, found by walking
+    // the field lengths instead of decoding it. Must follow WalleveSerialize
+    static bool GetRawSize(const unsigned char* pData,std::size_t nData,std::size_t& nSize)
+    {
+        // nVersion,nType,nTimeStamp,hashPrev,hashMerkle
+        std::size_t nPos = 2 + 2 + 4 + 32 + 32;
+        uint64 nTx = 0;
+        if (nPos > nData || !SkipRawBytes(pData,nData,nPos) || !SkipRawTx(pData,nData,nPos)
+            || !ReadRawVarInt(pData,nData,nPos,nTx))
+        {
+            return false;
+        }
+        for (uint64 i = 0;i < nTx;i++)
+        {
+            if (!SkipRawTx(pData,nData,nPos))
+            {
+                return false;
+            }
+        }
+        if (!SkipRawBytes(pData,nData,nPos))
+        {
+            return false;
+        }
+        nSize = nPos;
+        return true;
     }
 protected:
+    static bool ReadRawVarInt(const unsigned char* pData,std::size_t nData,std::size_t& nPos,uint64& nValue)
+    {
+        if (nPos >= nData)
+        {
+            return false;
+        }
+        nValue = pData[nPos++];
+        if (nValue >= 0xFD)
+        {
+            std::size_t nLength = (std::size_t)2 << (nValue - 0xFD);
+            if (nLength > nData - nPos)
+            {
+                return false;
+            }
+            nValue = 0;
+            memcpy(&nValue,pData + nPos,nLength);
+            nPos += nLength;
+        }
+        return true;
+    }
+    static bool SkipRawBytes(const unsigned char* pData,std::size_t nData,std::size_t& nPos)
+    {
+        uint64 nLength;
+        if (!ReadRawVarInt(pData,nData,nPos,nLength) || nLength > nData - nPos)
+        {
+            return false;
+        }
+        nPos += nLength;
+        return true;
+    }
+    static bool SkipRawTx(const unsigned char* pData,std::size_t nData,std::size_t& nPos)
+    {
+        // nVersion,nType,nTimeStamp,nLockUntil,hashAnchor | vInput of 33-byte outpoints |
+        // sendTo,nAmount,nTxFee | vchData | vchSig
+        uint64 nInput;
+        if (2 + 2 + 4 + 4 + 32 > nData - nPos)
+        {
+            return false;
+        }
+        nPos += 2 + 2 + 4 + 4 + 32;
+        if (!ReadRawVarInt(pData,nData,nPos,nInput) || nInput > (nData - nPos) / 33)
+        {
+            return false;
+        }
+        nPos += nInput * 33;
+        if (33 + 8 + 8 > nData - nPos)
+        {
+            return false;
+        }
+        nPos += 33 + 8 + 8;
+        return (SkipRawBytes(pData,nData,nPos) && SkipRawBytes(pData,nData,nPos));
+    }
+    uint256 CalcHash() const
+    {
+        walleve::CWalleveBufStream ss;
+        ss << nVersion << nType << nTimeStamp << hashPrev << hashMerkle << vchProof << txMint;
+        return multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
+    }
+    template <typename O>
+    void UnsealOnLoad(O&) {}
+    void UnsealOnLoad(walleve::LoadType&)
+    {
+        hashSealed = 0;
+    }
     template <typename O>
     void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
     {
+        UnsealOnLoad(opt);
         s.Serialize(nVersion,opt);
         s.Serialize(nType,opt);
         s.Serialize(nTimeStamp,opt);
@@ -173,6 +292,8 @@ protected:
         s.Serialize(vtx,opt);
         s.Serialize(vchSig,opt);
     }    
+protected:
+    uint256 hashSealed;
 };
 
 class CBlockEx : public CBlock
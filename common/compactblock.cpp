@@ -0,0 +1,190 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compactblock.h"
+#include "siphash.h"
+#include <unordered_map>
+
+using namespace std;
+
+///////////////////////////////
+// CCompactBlock
+
+void CCompactBlock::Build(const CBlock& block,uint64 nSaltIn)
+{
+    header = block;
+    header.vtx.clear();
+    nSalt = nSaltIn;
+    vchShortTxId.clear();
+    vPrefilled.clear();
+
+    uint64 nKey0,nKey1;
+    GetShortTxIdKey(header.GetHash(),nSalt,nKey0,nKey1);
+    vchShortTxId.reserve(block.vtx.size() * SHORTTXID_SIZE);
+    unordered_map<uint64,uint32> mapShortTxId;
+    for (uint32 i = 0;i < block.vtx.size();i++)
+    {
+        uint64 nShortTxId = CalcShortTxId(nKey0,nKey1,block.vtx[i].GetHash());
+        if (!mapShortTxId.insert(make_pair(nShortTxId,i)).second)
+        {
+            vPrefilled.push_back(CCompactPrefilledTx(i,block.vtx[i]));
+            continue;
+        }
+        for (int n = 0;n < SHORTTXID_SIZE;n++)
+        {
+            vchShortTxId.push_back((unsigned char)(nShortTxId >> (n * 8)));
+        }
+    }
+}
+
+uint64 CCompactBlock::GetShortTxId(size_t n) const
+{
+    uint64 nShortTxId = 0;
+    const unsigned char* p = &vchShortTxId[n * SHORTTXID_SIZE];
+    for (int i = 0;i < SHORTTXID_SIZE;i++)
+    {
+        nShortTxId |= ((uint64)p[i]) << (i * 8);
+    }
+    return nShortTxId;
+}
+
+void CCompactBlock::GetShortTxIdKey(const uint256& hashBlock,uint64 nSalt,uint64& nKey0,uint64& nKey1)
+{
+    // keyed by the block, so txids colliding under the key cannot be prepared in advance
+    unsigned char buf[32 + sizeof(uint64)];
+    memcpy(buf,hashBlock.begin(),32);
+    memcpy(buf + 32,&nSalt,sizeof(uint64));
+    uint256 hash = multiverse::crypto::CryptoHash(buf,sizeof(buf));
+    nKey0 = hash.Get64(0);
+    nKey1 = hash.Get64(1);
+}
+
+uint64 CCompactBlock::CalcShortTxId(uint64 nKey0,uint64 nKey1,const uint256& txid)
+{
+    return (multiverse::crypto::siphash(nKey0,nKey1,txid.begin(),32) & 0xFFFFFFFFFFFFULL);
+}
+
+///////////////////////////////
+// CPartialBlock
+
+bool CPartialBlock::Init(const CCompactBlock& compact)
+{
+    size_t nTx = compact.GetTxCount();
+    if (!compact.header.vtx.empty() || compact.vchShortTxId.size() % CCompactBlock::SHORTTXID_SIZE != 0
+        || nTx > CCompactBlock::MAX_TX_COUNT)
+    {
+        return false;
+    }
+
+    header = compact.header;
+    CCompactBlock::GetShortTxIdKey(header.GetHash(),compact.nSalt,nKey0,nKey1);
+    vtx.assign(nTx,CTransaction());
+    vShortTxId.assign(nTx,0);
+    vFilled.assign(nTx,false);
+
+    // prefilled transactions come in ascending order, the short ids fill the gaps
+    size_t nShortTxId = 0;
+    uint32 nNext = 0;
+    for (const CCompactPrefilledTx& prefilled : compact.vPrefilled)
+    {
+        if (prefilled.nIndex < nNext || prefilled.nIndex >= nTx)
+        {
+            return false;
+        }
+        for (;nNext < prefilled.nIndex;nNext++)
+        {
+            vShortTxId[nNext] = compact.GetShortTxId(nShortTxId++);
+        }
+        vtx[nNext] = prefilled.tx;
+        vFilled[nNext++] = true;
+    }
+    for (;nNext < nTx;nNext++)
+    {
+        vShortTxId[nNext] = compact.GetShortTxId(nShortTxId++);
+    }
+    nMissing = nTx - compact.vPrefilled.size();
+    return true;
+}
+
+size_t CPartialBlock::FillFromPool(const vector<uint256>& vTxPool,GetTxFunc fnGetTx)
+{
+    const uint32 nAmbiguous = (uint32)-1;
+    unordered_map<uint64,uint32> mapIndex;
+    for (uint32 i = 0;i < vtx.size();i++)
+    {
+        if (!vFilled[i] && !mapIndex.insert(make_pair(vShortTxId[i],i)).second)
+        {
+            mapIndex[vShortTxId[i]] = nAmbiguous;
+        }
+    }
+
+    unordered_map<uint32,uint256> mapMatch;
+    for (const uint256& txid : vTxPool)
+    {
+        unordered_map<uint64,uint32>::iterator it = mapIndex.find(CCompactBlock::CalcShortTxId(nKey0,nKey1,txid));
+        if (it != mapIndex.end() && (*it).second != nAmbiguous)
+        {
+            if (!mapMatch.insert(make_pair((*it).second,txid)).second)
+            {
+                mapMatch.erase((*it).second);
+                (*it).second = nAmbiguous;
+            }
+        }
+    }
+
+    size_t nFilled = 0;
+    for (unordered_map<uint32,uint256>::iterator it = mapMatch.begin();it != mapMatch.end();++it)
+    {
+        if (fnGetTx((*it).second,vtx[(*it).first]))
+        {
+            vFilled[(*it).first] = true;
+            nFilled++;
+        }
+    }
+    nMissing -= nFilled;
+    return nFilled;
+}
+
+void CPartialBlock::GetMissing(vector<uint32>& vIndex) const
+{
+    vIndex.clear();
+    vIndex.reserve(nMissing);
+    for (uint32 i = 0;i < vtx.size();i++)
+    {
+        if (!vFilled[i])
+        {
+            vIndex.push_back(i);
+        }
+    }
+}
+
+bool CPartialBlock::FillMissing(const vector<CTransaction>& vtxMissing)
+{
+    if (vtxMissing.size() != nMissing)
+    {
+        return false;
+    }
+    size_t n = 0;
+    for (uint32 i = 0;i < vtx.size();i++)
+    {
+        if (!vFilled[i])
+        {
+            vtx[i] = vtxMissing[n++];
+            vFilled[i] = true;
+        }
+    }
+    nMissing = 0;
+    return true;
+}
+
+bool CPartialBlock::GetBlock(CBlock& block) const
+{
+    if (nMissing != 0)
+    {
+        return false;
+    }
+    block = header;
+    block.vtx = vtx;
+    return (block.CalcMerkleTreeRoot() == block.hashMerkle);
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_COMPACTBLOCK_H
+#define  MULTIVERSE_COMPACTBLOCK_H
+
+#include "block.h"
+#include <boost/function.hpp>
+
+class CCompactPrefilledTx
+{
+    friend class walleve::CWalleveStream;
+public:
+    CCompactPrefilledTx() : nIndex(0) {}
+    CCompactPrefilledTx(uint32 nIndexIn,const CTransaction& txIn) : nIndex(nIndexIn),tx(txIn) {}
+public:
+    uint32 nIndex;
+    CTransaction tx;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(nIndex,opt);
+        s.Serialize(tx,opt);
+    }
+};
+
+// Block relayed as its header with the mint tx, and a 6-byte short id for each of its other
+// transactions: siphash of the txid keyed by the block hash and the sender's salt. The receiver takes them from its tx pool.
+// Transactions whose short ids collide inside the block are sent in full (prefilled).
+class CCompactBlock
+{
+    friend class walleve::CWalleveStream;
+public:
+    // a 2MB block holds fewer of the smallest transactions
+    enum { SHORTTXID_SIZE = 6,MAX_TX_COUNT = 1024 * 24 };
+    CCompactBlock() : nSalt(0) {}
+    void Build(const CBlock& block,uint64 nSaltIn);
+    uint256 GetHash() const { return header.GetHash(); }
+    std::size_t GetShortTxIdCount() const { return (vchShortTxId.size() / SHORTTXID_SIZE); }
+    std::size_t GetTxCount() const { return (GetShortTxIdCount() + vPrefilled.size()); }
+    uint64 GetShortTxId(std::size_t n) const;
+    static void GetShortTxIdKey(const uint256& hashBlock,uint64 nSalt,uint64& nKey0,uint64& nKey1);
+    static uint64 CalcShortTxId(uint64 nKey0,uint64 nKey1,const uint256& txid);
+public:
+    CBlock header;
+    uint64 nSalt;
+    std::vector<unsigned char> vchShortTxId;
+    std::vector<CCompactPrefilledTx> vPrefilled;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(header,opt);
+        s.Serialize(nSalt,opt);
+        s.Serialize(vchShortTxId,opt);
+        s.Serialize(vPrefilled,opt);
+    }
+};
+
+// Block being rebuilt from a compact block
+class CPartialBlock
+{
+public:
+    typedef boost::function<bool (const uint256&,CTransaction&)> GetTxFunc;
+    CPartialBlock() : nKey0(0),nKey1(0),nMissing(0) {}
+    bool Init(const CCompactBlock& compact);
+    uint256 GetHash() const { return header.GetHash(); }
+    // short ids matching several pool txs are left missing
+    std::size_t FillFromPool(const std::vector<uint256>& vTxPool,GetTxFunc fnGetTx);
+    bool IsComplete() const { return (nMissing == 0); }
+    void GetMissing(std::vector<uint32>& vIndex) const;
+    bool FillMissing(const std::vector<CTransaction>& vtxMissing);
+    // false if the transactions do not match the merkle root, after a short id collision with the pool
+    bool GetBlock(CBlock& block) const;
+protected:
+    CBlock header;
+    uint64 nKey0;
+    uint64 nKey1;
+    std::vector<CTransaction> vtx;
+    std::vector<uint64> vShortTxId;
+    std::vector<bool> vFilled;
+    std::size_t nMissing;
+};
+
+#endif //MULTIVERSE_COMPACTBLOCK_H
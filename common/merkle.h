@@ -0,0 +1,63 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_MERKLE_H
+#define  MULTIVERSE_MERKLE_H
+
+#include "uint256.h"
+#include "crypto.h"
+
+// Merkle root built one leaf at a time, keeping only the pending subtree root of each level.
+// Gives the same root as CBlock::BuildMerkleTree, which pairs the last node of an odd level with itself.
+class CMerkleBuilder
+{
+public:
+    enum { MAX_LEVEL = 32 };
+public:
+    CMerkleBuilder() { Clear(); }
+    void Clear() { nCount = 0; }
+    uint32 GetCount() const { return nCount; }
+    void Append(const uint256& hash)
+    {
+        uint256 h = hash;
+        int nLevel = 0;
+        for (nCount++;!(nCount & (((uint32)1) << nLevel));nLevel++)
+        {
+            h = multiverse::crypto::CryptoHash(vInner[nLevel],h);
+        }
+        vInner[nLevel] = h;
+    }
+    uint256 GetRoot() const
+    {
+        if (nCount == 0)
+        {
+            return uint64(0);
+        }
+        // walk up from the lowest pending subtree, pairing it with itself where its sibling is missing
+        int nLevel = 0;
+        while (!(nCount & (((uint32)1) << nLevel)))
+        {
+            nLevel++;
+        }
+        uint256 h = vInner[nLevel];
+        uint64 nFilled = nCount;
+        while (nFilled != (((uint64)1) << nLevel))
+        {
+            h = multiverse::crypto::CryptoHash(h,h);
+            nFilled += (((uint64)1) << nLevel);
+            nLevel++;
+            while (!(nFilled & (((uint64)1) << nLevel)))
+            {
+                h = multiverse::crypto::CryptoHash(vInner[nLevel],h);
+                nLevel++;
+            }
+        }
+        return h;
+    }
+protected:
+    uint32 nCount;
+    uint256 vInner[MAX_LEVEL];
+};
+
+#endif //MULTIVERSE_MERKLE_H
@@ -6,6 +6,7 @@
 
 #include "block.h"
 #include "template.h"
+#include "templatecache.h"
 
 using namespace std;
 
@@ -25,7 +26,7 @@ bool CTemplateMint::VerifyBlockSignature(const CTemplateId& nIdIn, const uint256
         return false;
     } 
 
-    const CTemplateMintPtr ptr = boost::dynamic_pointer_cast<CTemplateMint>(CTemplate::CreateTemplatePtr(nType, vchSig));
+    const CTemplateMintPtr ptr = boost::dynamic_pointer_cast<CTemplateMint>(CTemplateCache::GetInstance().GetTemplate(nIdIn, vchSig));
     if (!ptr)
     {
         return false;
@@ -17,6 +17,7 @@
 #include "proof.h"
 #include "rpc/auto_protocol.h"
 #include "template.h"
+#include "templatecache.h"
 #include "templateid.h"
 #include "transaction.h"
 #include "weighted.h"
@@ -159,7 +160,7 @@ string CTemplate::GetTypeName(uint16 nTypeIn)
 bool CTemplate::VerifyTxSignature(const CTemplateId& nIdIn, const uint256& hash, const uint256& hashAnchor,
                                   const CDestination& destTo, const vector<uint8>& vchSig, bool& fCompleted)
 {
-    CTemplatePtr ptr = CreateTemplatePtr(nIdIn.GetType(), vchSig);
+    CTemplatePtr ptr = CTemplateCache::GetInstance().GetTemplate(nIdIn, vchSig);
     if (!ptr)
     {
         return false;
@@ -0,0 +1,61 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "templatecache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+//////////////////////////////
+// CTemplateCache
+
+CTemplateCache& CTemplateCache::GetInstance()
+{
+    static CTemplateCache cache;
+    return cache;
+}
+
+CTemplateCache::CTemplateCache(size_t nCapacityIn)
+  : cacheTemplate(nCapacityIn), nCapacity(nCapacityIn), nHit(0), nMiss(0)
+{
+}
+
+const CTemplatePtr CTemplateCache::GetTemplate(const CTemplateId& nIdIn, const vector<uint8>& vchSig)
+{
+    CTemplatePtr ptr;
+    if (cacheTemplate.Retrieve(nIdIn, ptr))
+    {
+        // same leading data parses to the same template
+        const vector<uint8>& vchData = ptr->GetTemplateData();
+        if (vchSig.size() >= vchData.size() && equal(vchData.begin(), vchData.end(), vchSig.begin()))
+        {
+            nHit++;
+            return ptr;
+        }
+    }
+
+    nMiss++;
+    ptr = CTemplate::CreateTemplatePtr(nIdIn.GetType(), vchSig);
+    if (ptr)
+    {
+        cacheTemplate.AddNew(ptr->GetTemplateId(), ptr);
+    }
+    return ptr;
+}
+
+void CTemplateCache::Clear()
+{
+    cacheTemplate.Clear();
+    nHit = 0;
+    nMiss = 0;
+}
+
+void CTemplateCache::GetStat(CTemplateCacheStat& stat) const
+{
+    stat.nCapacity = nCapacity;
+    stat.nCount = cacheTemplate.GetCount();
+    stat.nHit = nHit;
+    stat.nMiss = nMiss;
+}
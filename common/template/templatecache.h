@@ -0,0 +1,60 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MULTIVERSE_TEMPLATECACHE_H
+#define MULTIVERSE_TEMPLATECACHE_H
+
+#include <atomic>
+
+#include "template.h"
+#include "walleve/cache.h"
+
+class CTemplateCacheStat
+{
+public:
+    CTemplateCacheStat() : nCapacity(0), nCount(0), nHit(0), nMiss(0) {}
+
+public:
+    std::size_t nCapacity;
+    std::size_t nCount;
+    uint64 nHit;
+    uint64 nMiss;
+};
+
+/**
+ * Validated templates keyed by template id, shared by the signature checks.
+ * Cached templates are never modified, so they may be used from any thread.
+ */
+class CTemplateCache
+{
+public:
+    enum
+    {
+        DEFAULT_CAPACITY = 8192
+    };
+
+public:
+    // Return the process wide cache.
+    static CTemplateCache& GetInstance();
+
+    CTemplateCache(std::size_t nCapacityIn = DEFAULT_CAPACITY);
+
+    // Return template whose data leads vchSig, vchSig is parsed on miss only.
+    // The result has the same id as CTemplate::CreateTemplatePtr(nIdIn.GetType(), vchSig) would have.
+    const CTemplatePtr GetTemplate(const CTemplateId& nIdIn, const std::vector<uint8>& vchSig);
+
+    // Remove all templates and reset statistics.
+    void Clear();
+
+    // Return statistics.
+    void GetStat(CTemplateCacheStat& stat) const;
+
+protected:
+    walleve::CWalleveCache<CTemplateId, CTemplatePtr> cacheTemplate;
+    std::size_t nCapacity;
+    std::atomic<uint64> nHit;
+    std::atomic<uint64> nMiss;
+};
+
+#endif // MULTIVERSE_TEMPLATECACHE_H
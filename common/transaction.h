@@ -106,11 +106,26 @@ public:
         nTxFee = 0;
         vchData.clear();
         vchSig.clear();
+        hashSealed = 0;
     }
     bool IsNull() const
     {
         return (vInput.empty() && sendTo.IsNull());
     }
+    // Seal caches the hash. The mutators and deserializing drop it,
+    // code that changes fields directly calls Unseal
+    void Seal()
+    {
+        hashSealed = CalcHash();
+    }
+    void Unseal()
+    {
+        hashSealed = 0;
+    }
+    bool IsSealed() const
+    {
+        return (hashSealed != 0);
+    }
     bool IsMintTx() const
     {
         return (nType == TX_GENESIS || nType == TX_STAKE || nType == TX_WORK); 
@@ -130,12 +145,7 @@ public:
     }
     uint256 GetHash() const
     {
-        walleve::CWalleveBufStream ss;
-        ss << (*this);
-        
-        uint256 hash = multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
-
-        return uint256(nTimeStamp,uint224(hash));
+        return (hashSealed != 0 ? hashSealed : CalcHash());
     }
     uint256 GetSignatureHash() const
     {
@@ -162,6 +172,7 @@ public:
             return false;
         }
         nLockUntil = (n << 31) | nHeight;
+        Unseal();
         return true;
     }
     friend bool operator==(const CTransaction& a, const CTransaction& b)
@@ -183,9 +194,25 @@ public:
         return !(a == b);
     }
 protected:
+    uint256 CalcHash() const
+    {
+        walleve::CWalleveBufStream ss;
+        ss << (*this);
+        
+        uint256 hash = multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
+
+        return uint256(nTimeStamp,uint224(hash));
+    }
+    template <typename O>
+    void UnsealOnLoad(O&) {}
+    void UnsealOnLoad(walleve::LoadType&)
+    {
+        Unseal();
+    }
     template <typename O>
     void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
     {
+        UnsealOnLoad(opt);
         s.Serialize(nVersion,opt);
         s.Serialize(nType,opt);
         s.Serialize(nTimeStamp,opt);
@@ -198,6 +225,8 @@ protected:
         s.Serialize(vchData,opt);
         s.Serialize(vchSig,opt);
     }
+protected:
+    uint256 hashSealed;
 };
 
 class CTxOutput
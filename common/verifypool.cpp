@@ -0,0 +1,175 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "verifypool.h"
+#include "walleve/util.h"
+
+using namespace std;
+using namespace multiverse;
+
+//////////////////////////////
+// CVerifyPool
+
+boost::mutex CVerifyPool::mtxInstance;
+boost::weak_ptr<CVerifyPool> CVerifyPool::wpInstance;
+
+boost::shared_ptr<CVerifyPool> CVerifyPool::GetInstance()
+{
+    boost::unique_lock<boost::mutex> lock(mtxInstance);
+
+    boost::shared_ptr<CVerifyPool> spPool = wpInstance.lock();
+    if (spPool == NULL)
+    {
+        size_t nCore = boost::thread::hardware_concurrency();
+        spPool = boost::shared_ptr<CVerifyPool>(new CVerifyPool());
+        if (!spPool->Start(nCore > 1 ? nCore - 1 : 0))
+        {
+            return boost::shared_ptr<CVerifyPool>();
+        }
+        wpInstance = spPool;
+    }
+    return spPool;
+}
+
+CVerifyPool::CVerifyPool()
+: fExit(false)
+{
+}
+
+CVerifyPool::~CVerifyPool()
+{
+    Stop();
+}
+
+bool CVerifyPool::Start(size_t nWorker)
+{
+    Stop();
+
+    fExit = false;
+    for (size_t i = 0;i < nWorker;i++)
+    {
+        boost::thread* pThread = new boost::thread([this]() { WorkerProc(); });
+        if (pThread == NULL)
+        {
+            Stop();
+            return false;
+        }
+        vWorker.push_back(pThread);
+    }
+    return true;
+}
+
+void CVerifyPool::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mtxPool);
+        fExit = true;
+    }
+    condWork.notify_all();
+
+    for (size_t i = 0;i < vWorker.size();i++)
+    {
+        vWorker[i]->join();
+        delete vWorker[i];
+    }
+    vWorker.clear();
+}
+
+bool CVerifyPool::Run(size_t nCount,VerifyFunc fnVerify)
+{
+    if (nCount == 0)
+    {
+        return true;
+    }
+
+    if (vWorker.empty() || nCount == 1)
+    {
+        bool fRet = true;
+        for (size_t i = 0;i < nCount;i++)
+        {
+            fRet = CallJob(fnVerify,i) && fRet;
+        }
+        return fRet;
+    }
+
+    // jobs lives on this stack until every job is done, the set leaves
+    // listJobSet as soon as its last job is handed out
+    CJobSet jobs(fnVerify,nCount);
+    boost::unique_lock<boost::mutex> lock(mtxPool);
+    listJobSet.push_back(&jobs);
+    condWork.notify_all();
+
+    while (jobs.nNext < jobs.nCount)
+    {
+        size_t n = jobs.nNext++;
+        if (jobs.nNext == jobs.nCount)
+        {
+            listJobSet.remove(&jobs);
+        }
+        RunJob(jobs,n,lock);
+    }
+    while (jobs.nDone < jobs.nCount)
+    {
+        condDone.wait(lock);
+    }
+    return !jobs.fFailed;
+}
+
+void CVerifyPool::WorkerProc()
+{
+    boost::unique_lock<boost::mutex> lock(mtxPool);
+    while (!fExit)
+    {
+        if (!listJobSet.empty())
+        {
+            // take one job and move the set to the back, so concurrent runs share the workers
+            CJobSet* pJobs = listJobSet.front();
+            listJobSet.pop_front();
+            size_t n = pJobs->nNext++;
+            if (pJobs->nNext < pJobs->nCount)
+            {
+                listJobSet.push_back(pJobs);
+            }
+            RunJob(*pJobs,n,lock);
+        }
+        else
+        {
+            condWork.wait(lock);
+        }
+    }
+}
+
+void CVerifyPool::RunJob(CJobSet& jobs,size_t n,boost::unique_lock<boost::mutex>& lock)
+{
+    // fnJob stays unchanged until the last job of the set is done, so it is called without the lock
+    lock.unlock();
+    bool fDone = CallJob(jobs.fnJob,n);
+    lock.lock();
+    if (!fDone)
+    {
+        jobs.fFailed = true;
+    }
+    if (++jobs.nDone == jobs.nCount)
+    {
+        condDone.notify_all();
+    }
+}
+
+bool CVerifyPool::CallJob(const VerifyFunc& fnVerify,size_t n)
+{
+    try
+    {
+        fnVerify(n);
+        return true;
+    }
+    catch (exception& e)
+    {
+        walleve::StdError(__PRETTY_FUNCTION__, e.what());
+    }
+    catch (...)
+    {
+        walleve::StdError(__PRETTY_FUNCTION__, "unknown exception");
+    }
+    return false;
+}
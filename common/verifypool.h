@@ -0,0 +1,68 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_VERIFYPOOL_H
+#define  MULTIVERSE_VERIFYPOOL_H
+
+#include <list>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace multiverse
+{
+
+// Fixed set of worker threads for order-independent jobs, like signature checks and block scans.
+// Run hands out job indexes to the workers and the calling thread, and returns when all are done.
+// Several threads may Run at the same time, the workers take jobs from their sets in turn.
+// A job that throws is counted as done, Run returns false if any of them did.
+class CVerifyPool
+{
+    class CJobSet
+    {
+    public:
+        CJobSet(const boost::function<void (std::size_t)>& fnJobIn,std::size_t nCountIn)
+        : fnJob(fnJobIn),nCount(nCountIn),nNext(0),nDone(0),fFailed(false) {}
+    public:
+        boost::function<void (std::size_t)> fnJob;
+        std::size_t nCount;
+        std::size_t nNext;
+        std::size_t nDone;
+        bool fFailed;
+    };
+public:
+    typedef boost::function<void (std::size_t)> VerifyFunc;
+public:
+    // Return the process wide pool, started with one worker less than the cores on first use.
+    // It stops when the last holder releases it.
+    static boost::shared_ptr<CVerifyPool> GetInstance();
+
+    CVerifyPool();
+    ~CVerifyPool();
+    bool Start(std::size_t nWorker);
+    void Stop();
+    std::size_t GetWorkerCount() const { return vWorker.size(); }
+    bool Run(std::size_t nCount,VerifyFunc fnVerify);
+protected:
+    void WorkerProc();
+    void RunJob(CJobSet& jobs,std::size_t n,boost::unique_lock<boost::mutex>& lock);
+    static bool CallJob(const VerifyFunc& fnVerify,std::size_t n);
+protected:
+    boost::mutex mtxPool;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    std::vector<boost::thread*> vWorker;
+    bool fExit;
+    std::list<CJobSet*> listJobSet;
+    static boost::mutex mtxInstance;
+    static boost::weak_ptr<CVerifyPool> wpInstance;
+};
+
+} // namespace multiverse
+
+#endif //MULTIVERSE_VERIFYPOOL_H
@@ -0,0 +1,128 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crc32c.h"
+#include <cstring>
+#include <stdint.h>
+
+namespace multiverse
+{
+namespace crypto
+{
+
+class CCrc32cTable
+{
+public:
+    CCrc32cTable()
+    {
+        for (uint32_t i = 0;i < 256;i++)
+        {
+            uint32_t crc = i;
+            for (int j = 0;j < 8;j++)
+            {
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0;i < 256;i++)
+        {
+            for (int k = 1;k < 8;k++)
+            {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+public:
+    uint32_t table[8][256];
+};
+
+static const CCrc32cTable crc32c_table;
+
+// slicing-by-8, little endian words
+static uint32_t crc32c_sw(uint32_t crc,const unsigned char* data,std::size_t size)
+{
+    const uint32_t (*t)[256] = crc32c_table.table;
+    while (size > 0 && ((uintptr_t)data & 7) != 0)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+        size--;
+    }
+    while (size >= 8)
+    {
+        uint32_t lo,hi;
+        std::memcpy(&lo,data,4);
+        std::memcpy(&hi,data + 4,4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size > 0)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+        size--;
+    }
+    return crc;
+}
+
+#if (defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)))
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc,const unsigned char* data,std::size_t size)
+{
+    while (size > 0 && ((uintptr_t)data & 7) != 0)
+    {
+        crc = __builtin_ia32_crc32qi(crc,*data++);
+        size--;
+    }
+    unsigned long long crc64 = crc;
+    while (size >= 8)
+    {
+        unsigned long long v;
+        std::memcpy(&v,data,8);
+        crc64 = __builtin_ia32_crc32di(crc64,v);
+        data += 8;
+        size -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (size > 0)
+    {
+        crc = __builtin_ia32_crc32qi(crc,*data++);
+        size--;
+    }
+    return crc;
+}
+
+static bool crc32c_hw_supported()
+{
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("sse4.2") != 0);
+}
+
+#else
+
+static uint32_t crc32c_hw(uint32_t crc,const unsigned char* data,std::size_t size)
+{
+    return crc32c_sw(crc,data,size);
+}
+
+static bool crc32c_hw_supported()
+{
+    return false;
+}
+
+#endif
+
+static const bool crc32c_fHardware = crc32c_hw_supported();
+
+unsigned int crc32c(unsigned int crc,const unsigned char* data,std::size_t size)
+{
+    crc = ~crc;
+    crc = (crc32c_fHardware ? crc32c_hw(crc,data,size) : crc32c_sw(crc,data,size));
+    return ~crc;
+}
+
+} // namespace crypto
+} // namespace multiverse
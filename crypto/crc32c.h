@@ -0,0 +1,26 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_CRC32C_H
+#define  MULTIVERSE_CRC32C_H
+
+#include <cstddef>
+
+namespace multiverse
+{
+namespace crypto
+{
+
+// CRC-32C (Castagnoli) cyclic redundancy checksum
+// polynomial : 0x1EDC6F41 (reflected 0x82F63B78)
+// crc is the value returned for the preceding bytes (0 to start), so a buffer can be
+// checksummed in pieces : crc32c(crc32c(0,a,na),b,nb) == crc32c(0,ab,na + nb).
+// Uses the SSE4.2 crc32 instruction when the cpu has it.
+
+unsigned int crc32c(unsigned int crc,const unsigned char* data,std::size_t size);
+
+} // namespace crypto
+} // namespace multiverse
+
+#endif //MULTIVERSE_CRC32C_H
@@ -95,13 +95,23 @@ uint256 CryptoHash(const void* msg, size_t len)
     return hash;
 }
 
+static const crypto_generichash_blake2b_state& GetPairHashInitState()
+{
+    static crypto_generichash_blake2b_state state;
+    static bool fInit = (crypto_generichash_blake2b_init(&state, NULL, 0, sizeof(uint256)) == 0);
+    (void)fInit;
+    return state;
+}
+
 uint256 CryptoHash(const uint256& h1, const uint256& h2)
 {
+    // merkle trees hash many pairs, so start from a copy of the initialized state
     uint256 hash;
-    crypto_generichash_blake2b_state state;
-    crypto_generichash_blake2b_init(&state, NULL, 0, sizeof(hash));
-    crypto_generichash_blake2b_update(&state, h1.begin(), sizeof(h1));
-    crypto_generichash_blake2b_update(&state, h2.begin(), sizeof(h2));
+    uint8 buf[sizeof(h1) + sizeof(h2)];
+    memcpy(buf, h1.begin(), sizeof(h1));
+    memcpy(buf + sizeof(h1), h2.begin(), sizeof(h2));
+    crypto_generichash_blake2b_state state = GetPairHashInitState();
+    crypto_generichash_blake2b_update(&state, buf, sizeof(buf));
     crypto_generichash_blake2b_final(&state, hash.begin(), sizeof(hash));
     return hash;
 }
@@ -166,31 +176,33 @@ static vector<uint8> MultiSignPreApk(const set<uint256>& setPubKey)
     return vecHash;
 }
 
-// H(Ai,A1,...,An)*Ai + ... + H(Aj,A1,...,An)*Aj
-// setPubKey = [A1 ... An], setPartKey = [Ai ... Aj], 1 <= i <= j <= n
-static bool MultiSignApk(const set<uint256>& setPubKey, const set<uint256>& setPartKey, uint8* md32)
+// Ai and hi = H(Ai,A1,...,An) of each key in setPubKey = [A1 ... An]
+static bool MultiSignKeys(const set<uint256>& setPubKey, vector<CEdwards25519>& vPoint, vector<CSC25519>& vHash)
 {
     vector<uint8> vecHash = MultiSignPreApk(setPubKey);
 
-    CEdwards25519 apk;
-    bool fInitial = true;
-    for (const uint256& key : setPartKey)
+    vPoint.resize(setPubKey.size());
+    vHash.clear();
+    vHash.reserve(setPubKey.size());
+    int i = 0;
+    for (const uint256& key : setPubKey)
     {
         memcpy(&vecHash[0], key.begin(), key.size());
-        CSC25519 hash = CSC25519(CryptoHash(&vecHash[0], vecHash.size()).begin());
-
-        CEdwards25519 point;
-        if (!point.Unpack(key.begin()))
+        vHash.push_back(CSC25519(CryptoHash(&vecHash[0], vecHash.size()).begin()));
+        if (!vPoint[i++].Unpack(key.begin()))
         {
             return false;
         }
-        apk += point.ScalarMult(hash);
     }
-
-    apk.Pack(md32);
     return true;
 }
 
+// apk = H(A1,A1,...,An)*A1 + ... + H(An,A1,...,An)*An
+static void MultiSignApk(const vector<CEdwards25519>& vPoint, const vector<CSC25519>& vHash, uint8* md32)
+{
+    CEdwards25519::MultiScalarMult(vPoint, vHash).Pack(md32);
+}
+
 // hash = H(X,apk,M)
 static CSC25519 MultiSignHash(const uint8* pX, const size_t lenX, const uint8* pApk, const size_t lenApk, const uint8* pM, const size_t lenM)
 {
@@ -263,11 +275,14 @@ bool CryptoMultiSign(const set<uint256>& setPubKey, const CCryptoKey& privkey, c
     uint8* pIndex = &vchSig[0];
 
     // apk
-    uint256 apk;
-    if (! MultiSignApk(setPubKey, setPubKey, apk.begin()))
+    vector<CEdwards25519> vPoint;
+    vector<CSC25519> vHash;
+    if (!MultiSignKeys(setPubKey, vPoint, vHash))
     {
         return false;
     }
+    uint256 apk;
+    MultiSignApk(vPoint, vHash, apk.begin());
     // H(X,apk,M)
     CSC25519 hash = MultiSignHash(pX, lenX, apk.begin(), apk.size(), pM, lenM);
 
@@ -284,9 +299,7 @@ bool CryptoMultiSign(const set<uint256>& setPubKey, const CCryptoKey& privkey, c
         // ri = H(H(si,pi),M)
         CSC25519 ri = MultiSignR(privkey, pM, lenM);
         // hi = H(Ai,A1,...,An)
-        vector<uint8> vecHash = MultiSignPreApk(setPubKey);
-        memcpy(&vecHash[0], itPub->begin(), itPub->size());
-        CSC25519 hi = CSC25519(CryptoHash(&vecHash[0], vecHash.size()).begin());
+        const CSC25519& hi = vHash[index];
         // si = H(privkey)
         CSC25519 si = ClampPrivKey(privkey.secret);
         // Si = ri + H(X,apk,M) * hi * si
@@ -336,17 +349,20 @@ bool CryptoMultiVerify(const set<uint256>& setPubKey, const uint8* pX, const siz
     const uint8* pIndex = &vchSig[0];
 
     // apk
-    uint256 apk;
-    if (! MultiSignApk(setPubKey, setPubKey, apk.begin()))
+    vector<CEdwards25519> vPoint;
+    vector<CSC25519> vHash;
+    if (!MultiSignKeys(setPubKey, vPoint, vHash))
     {
         return false;
     }
+    uint256 apk;
+    MultiSignApk(vPoint, vHash, apk.begin());
     // H(X,apk,M)
     CSC25519 hash = MultiSignHash(pX, lenX, apk.begin(), apk.size(), pM, lenM);
 
     // A = hi*Ai + ... + aj*Aj
-    CEdwards25519 A;
-    vector<uint8> vecHash = MultiSignPreApk(setPubKey);
+    vector<CEdwards25519> vPartPoint;
+    vector<CSC25519> vPartHash;
     setPartKey.clear();
     int i = 0;
 
@@ -354,20 +370,12 @@ bool CryptoMultiVerify(const set<uint256>& setPubKey, const uint8* pX, const siz
     {
         if (pIndex[i / 8] & (1 << (i % 8)))
         {
-            // hi = H(Ai,A1,...,An)
-            memcpy(&vecHash[0], itPub->begin(), itPub->size());
-            CSC25519 hi = CSC25519(CryptoHash(&vecHash[0], vecHash.size()).begin());
-            // hi * Ai
-            CEdwards25519 Ai;
-            if (!Ai.Unpack(itPub->begin()))
-            {
-                return false;
-            }
-            A += Ai.ScalarMult(hi);
-
+            vPartPoint.push_back(vPoint[i]);
+            vPartHash.push_back(vHash[i]);
             setPartKey.insert(*itPub);
         }
     }
+    CEdwards25519 A = CEdwards25519::MultiScalarMult(vPartPoint, vPartHash);
 
     // SB = R + H(X,apk,M) * (hi*Ai + ... + aj*Aj)
     CEdwards25519 SB;
@@ -4,6 +4,8 @@
 
 #include "ed25519.h"
 
+#include <algorithm>
+
 #include "base25519.h"
 
 namespace curve25519
@@ -163,6 +165,114 @@ const CEdwards25519 CEdwards25519::ScalarMult(const uint8_t* u8,std::size_t size
     return r;
 }
 
+const CEdwards25519 CEdwards25519::MultiScalarMult(const std::vector<CEdwards25519>& vPoint, const std::vector<CSC25519>& vScalar)
+{
+    std::size_t n = std::min(vPoint.size(), vScalar.size());
+    if (n == 1)
+    {
+        return vPoint[0].ScalarMult(vScalar[0]);
+    }
+    // bucket method wins once the shared bucket sums are cheaper than per point tables
+    return (n < 256 ? StrausMult(vPoint, vScalar, n) : PippengerMult(vPoint, vScalar, n));
+}
+
+const CEdwards25519 CEdwards25519::StrausMult(const std::vector<CEdwards25519>& vPoint, const std::vector<CSC25519>& vScalar, std::size_t n)
+{
+    // table[j * 16 + k] = k * vPoint[j]
+    std::vector<CEdwards25519> vTable(n * 16);
+    for (std::size_t j = 0; j < n; j++)
+    {
+        CEdwards25519* table = &vTable[j * 16];
+        table[1] = vPoint[j];
+        for (int k = 2; k < 16; k += 2)
+        {
+            table[k] = table[k >> 1];
+            table[k].Double();
+            table[k + 1] = table[k];
+            table[k + 1].Add(vPoint[j]);
+        }
+    }
+
+    CEdwards25519 r;
+    for (int i = 63; i >= 0; i--)
+    {
+        if (i != 63)
+        {
+            r.Double().Double().Double().Double();
+        }
+        for (std::size_t j = 0; j < n; j++)
+        {
+            int k = (((const uint8_t*)vScalar[j].Data())[i >> 1] >> ((i & 1) << 2)) & 15;
+            if (k != 0)
+            {
+                r.Add(vTable[j * 16 + k]);
+            }
+        }
+    }
+    return r;
+}
+
+const CEdwards25519 CEdwards25519::PippengerMult(const std::vector<CEdwards25519>& vPoint, const std::vector<CSC25519>& vScalar, std::size_t n)
+{
+    int c = 4;
+    while ((std::size_t(1) << (c + 4)) <= n && c < 16)
+    {
+        c++;
+    }
+
+    // scalars are reduced, so they are less than 2^253
+    int nWindow = (253 + c - 1) / c;
+    std::vector<CEdwards25519> vBucket(std::size_t(1) << c);
+    std::vector<bool> vUsed(std::size_t(1) << c);
+
+    CEdwards25519 r;
+    for (int w = nWindow - 1; w >= 0; w--)
+    {
+        for (int i = 0; i < c && w != nWindow - 1; i++)
+        {
+            r.Double();
+        }
+
+        std::fill(vUsed.begin(), vUsed.end(), false);
+        int nBit = w * c;
+        for (std::size_t j = 0; j < n; j++)
+        {
+            const uint64_t* v = vScalar[j].Data();
+            uint64_t bits = v[nBit >> 6] >> (nBit & 63);
+            if ((nBit & 63) + c > 64 && (nBit >> 6) < 3)
+            {
+                bits |= v[(nBit >> 6) + 1] << (64 - (nBit & 63));
+            }
+            std::size_t k = bits & ((std::size_t(1) << c) - 1);
+            if (k != 0)
+            {
+                if (vUsed[k])
+                {
+                    vBucket[k].Add(vPoint[j]);
+                }
+                else
+                {
+                    vBucket[k] = vPoint[j];
+                    vUsed[k] = true;
+                }
+            }
+        }
+
+        // sum(k * bucket[k]) by running sums from the top bucket
+        CEdwards25519 sum, acc;
+        for (std::size_t k = vBucket.size() - 1; k > 0; k--)
+        {
+            if (vUsed[k])
+            {
+                sum.Add(vBucket[k]);
+            }
+            acc.Add(sum);
+        }
+        r.Add(acc);
+    }
+    return r;
+}
+
 void CEdwards25519::FromP1P1(const CFP25519& x,const CFP25519& y,const CFP25519& z,const CFP25519& t)
 {
     fX = x * t;
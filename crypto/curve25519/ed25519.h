@@ -44,6 +44,8 @@ public:
     {
         return ScalarMult((const uint8_t*)s.Data(), 32);
     }
+    // return vScalar[0] * vPoint[0] + ... + vScalar[n-1] * vPoint[n-1]
+    static const CEdwards25519 MultiScalarMult(const std::vector<CEdwards25519>& vPoint, const std::vector<CSC25519>& vScalar);
     const CEdwards25519 operator-() const
     {
         return CEdwards25519(-fX, fY, fZ, -fT);
@@ -79,6 +81,8 @@ protected:
     void FromP1P1(const CFP25519& x, const CFP25519& y, const CFP25519& z, const CFP25519& t);
     void CalcPrescalar() const;
     void AddPrescalar(const CEdwards25519& q);
+    static const CEdwards25519 StrausMult(const std::vector<CEdwards25519>& vPoint, const std::vector<CSC25519>& vScalar, std::size_t n);
+    static const CEdwards25519 PippengerMult(const std::vector<CEdwards25519>& vPoint, const std::vector<CSC25519>& vScalar, std::size_t n);
 
 public:
     CFP25519 fX;
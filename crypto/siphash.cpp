@@ -0,0 +1,64 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "siphash.h"
+
+namespace multiverse
+{
+namespace crypto
+{
+
+#define ROTL64(x,b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0,v1,v2,v3)                                          \
+    do {                                                               \
+        v0 += v1; v1 = ROTL64(v1,13); v1 ^= v0; v0 = ROTL64(v0,32);    \
+        v2 += v3; v3 = ROTL64(v3,16); v3 ^= v2;                        \
+        v0 += v3; v3 = ROTL64(v3,21); v3 ^= v0;                        \
+        v2 += v1; v1 = ROTL64(v1,17); v1 ^= v2; v2 = ROTL64(v2,32);    \
+    } while (0)
+
+static inline uint64_t ReadLE64(const unsigned char* p,std::size_t n)
+{
+    uint64_t v = 0;
+    for (std::size_t i = 0;i < n;i++)
+    {
+        v |= ((uint64_t)p[i]) << (i * 8);
+    }
+    return v;
+}
+
+uint64_t siphash(uint64_t k0,uint64_t k1,const unsigned char* data,std::size_t size)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    const unsigned char* end = data + (size & ~(std::size_t)7);
+    for (;data != end;data += 8)
+    {
+        uint64_t m = ReadLE64(data,8);
+        v3 ^= m;
+        SIPROUND(v0,v1,v2,v3);
+        SIPROUND(v0,v1,v2,v3);
+        v0 ^= m;
+    }
+
+    uint64_t b = (((uint64_t)size) << 56) | ReadLE64(data,size & 7);
+    v3 ^= b;
+    SIPROUND(v0,v1,v2,v3);
+    SIPROUND(v0,v1,v2,v3);
+    v0 ^= b;
+
+    v2 ^= 0xFF;
+    SIPROUND(v0,v1,v2,v3);
+    SIPROUND(v0,v1,v2,v3);
+    SIPROUND(v0,v1,v2,v3);
+    SIPROUND(v0,v1,v2,v3);
+    return (v0 ^ v1 ^ v2 ^ v3);
+}
+
+} // namespace crypto
+} // namespace multiverse
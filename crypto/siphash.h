@@ -0,0 +1,24 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_SIPHASH_H
+#define  MULTIVERSE_SIPHASH_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace multiverse
+{
+namespace crypto
+{
+
+// SipHash-2-4 keyed hash with the 128-bit key (k0,k1), k0 holding key bytes 0-7 little endian.
+// Much cheaper than blake2b for short inputs, but only a PRF : not for commitments.
+
+uint64_t siphash(uint64_t k0,uint64_t k1,const unsigned char* data,std::size_t size);
+
+} // namespace crypto
+} // namespace multiverse
+
+#endif //MULTIVERSE_SIPHASH_H
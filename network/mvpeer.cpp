@@ -34,6 +34,14 @@ void CMvPeer::Activate()
     nTimeHello = 0;
     strSubVer.clear();
     nStartingHeight = 0;
+    nBlockRateStart = 0;
+    nBlockRateCount = 0;
+    nBlockRateBytes = 0;
+    dLastBlockRate = 0;
+    dLastByteRate = 0;
+    fFastChecksum = false;
+    nRecvChecksum = 0;
+    nRecvChecksumed = 0;
 
     Read(MESSAGE_HEADER_SIZE,boost::bind(&CMvPeer::HandshakeReadHeader,this));
     if (!fInBound)
@@ -53,7 +61,8 @@ bool CMvPeer::SendMessage(int nChannel,int nCommand,CWalleveBufStream& ssPayload
     hdrSend.nMagic = nMsgMagic;
     hdrSend.nType  = CMvPeerMessageHeader::GetMessageType(nChannel,nCommand);
     hdrSend.nPayloadSize = ssPayload.GetSize();
-    hdrSend.nPayloadChecksum = multiverse::crypto::CryptoHash(ssPayload.GetData(),ssPayload.GetSize()).Get32();
+    hdrSend.nPayloadChecksum = CMvPeerMessageHeader::GetPayloadChecksum(ssPayload.GetData(),ssPayload.GetSize(),
+                                                                        IsFastChecksum(nChannel,nCommand));
     hdrSend.nHeaderChecksum = hdrSend.GetHeaderChecksum();
 
     if (!hdrSend.Verify())
@@ -114,6 +123,47 @@ bool CMvPeer::FetchAskFor(uint256& hashFork,CInv& inv)
     return false;
 }
 
+void CMvPeer::BlockReceived(size_t nSize)
+{
+    int64 nNow = GetTime();
+    if (nBlockRateStart == 0)
+    {
+        nBlockRateStart = nNow;
+    }
+    else if (nNow - nBlockRateStart >= BLOCK_RATE_WINDOW)
+    {
+        int64 nElapse = nNow - nBlockRateStart;
+        dLastBlockRate = (double)nBlockRateCount / nElapse;
+        dLastByteRate = (double)nBlockRateBytes / nElapse;
+        nBlockRateStart = nNow;
+        nBlockRateCount = 0;
+        nBlockRateBytes = 0;
+    }
+    nBlockRateCount++;
+    nBlockRateBytes += nSize;
+}
+
+void CMvPeer::GetBlockRate(double& dBlockRate,double& dByteRate) const
+{
+    dBlockRate = dByteRate = 0;
+    if (nBlockRateStart == 0)
+    {
+        return;
+    }
+    int64 nElapse = GetTime() - nBlockRateStart;
+    if (nElapse < BLOCK_RATE_WINDOW && (dLastBlockRate != 0 || nElapse == 0))
+    {
+        // report the last full window until the current one is complete
+        dBlockRate = dLastBlockRate;
+        dByteRate = dLastByteRate;
+    }
+    else
+    {
+        dBlockRate = (double)nBlockRateCount / nElapse;
+        dByteRate = (double)nBlockRateBytes / nElapse;
+    }
+}
+
 void CMvPeer::SendHello()
 {
     CWalleveBufStream ssPayload;
@@ -127,6 +177,16 @@ void CMvPeer::SendHelloAck()
     SendMessage(MVPROTO_CHN_NETWORK,MVPROTO_CMD_HELLO_ACK);
 }
 
+bool CMvPeer::IsFastChecksum(int nChannel,int nCommand) const
+{
+    // hello and hello ack are sent before the remote services are known
+    if (nChannel == MVPROTO_CHN_NETWORK && (nCommand == MVPROTO_CMD_HELLO || nCommand == MVPROTO_CMD_HELLO_ACK))
+    {
+        return false;
+    }
+    return fFastChecksum;
+}
+
 bool CMvPeer::ParseMessageHeader()
 {
     try
@@ -163,6 +223,14 @@ int CMvPeer::HandleReadHeader()
         return CPeer::FAILED;
     }
 
+    if (hdrRecv.nPayloadSize > MESSAGE_PAYLOAD_CHUNK_SIZE && fFastChecksum)
+    {
+        // checksum large payloads chunk by chunk while the rest is still in flight
+        nRecvChecksum = 0;
+        nRecvChecksumed = 0;
+        Read(MESSAGE_PAYLOAD_CHUNK_SIZE,boost::bind(&CMvPeer::HandleReadChunk,this));
+        return CPeer::SUCCESS;
+    }
     if (hdrRecv.nPayloadSize != 0)
     {
         Read(hdrRecv.nPayloadSize,boost::bind(&CMvPeer::HandleReadCompleted,this));
@@ -174,8 +242,8 @@ int CMvPeer::HandleReadHeader()
 int CMvPeer::HandshakeReadCompleted()
 {
     CWalleveBufStream& ss = ReadStream();
-    uint256 hash = multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
-    if (hdrRecv.nPayloadChecksum == hash.Get32() && hdrRecv.GetChannel() == MVPROTO_CHN_NETWORK)
+    uint32 nChecksum = CMvPeerMessageHeader::GetPayloadChecksum(ss.GetData(),ss.GetSize(),false);
+    if (hdrRecv.nPayloadChecksum == nChecksum && hdrRecv.GetChannel() == MVPROTO_CHN_NETWORK)
     {
         int64 nTimeRecv = GetTime();
         int nCmd = hdrRecv.GetCommand();
@@ -209,6 +277,7 @@ int CMvPeer::HandshakeReadCompleted()
                 }
                 
                 nTimeDelta = nTime - nTimeRecv;
+                fFastChecksum = ((nService & (static_cast<CMvPeerNet*>(pPeerNet))->GetService() & NODE_FASTCHECKSUM) != 0);
                 if (!fInBound)
                 {
                     // Client
@@ -268,11 +337,32 @@ bool CMvPeer::HandshakeCompleted(bool& fIsBanned)
     return true;
 }
 
+int CMvPeer::HandleReadChunk()
+{
+    CWalleveBufStream& ss = ReadStream();
+    std::size_t nSize = ss.GetSize();
+    nRecvChecksum = multiverse::crypto::crc32c(nRecvChecksum,(const unsigned char*)ss.GetData() + nRecvChecksumed,
+                                               nSize - nRecvChecksumed);
+    nRecvChecksumed = nSize;
+    if (nSize < hdrRecv.nPayloadSize)
+    {
+        ReadMore(std::min((std::size_t)MESSAGE_PAYLOAD_CHUNK_SIZE,hdrRecv.nPayloadSize - nSize),
+                 boost::bind(&CMvPeer::HandleReadChunk,this));
+        return CPeer::SUCCESS;
+    }
+    return HandlePayload(nRecvChecksum);
+}
+
 int CMvPeer::HandleReadCompleted()
 {
     CWalleveBufStream& ss = ReadStream();
-    uint256 hash = multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
-    if (hdrRecv.nPayloadChecksum == hash.Get32())
+    return HandlePayload(CMvPeerMessageHeader::GetPayloadChecksum(ss.GetData(),ss.GetSize(),fFastChecksum));
+}
+
+int CMvPeer::HandlePayload(uint32 nChecksum)
+{
+    CWalleveBufStream& ss = ReadStream();
+    if (hdrRecv.nPayloadChecksum == nChecksum)
     {
         try
         {
@@ -33,15 +33,20 @@ public:
     uint32 Responded(CInv& inv);
     void AskFor(const uint256& hashFork, const std::vector<CInv>& vInv);
     bool FetchAskFor(uint256& hashFork,CInv& inv);
+    void BlockReceived(std::size_t nSize);
+    void GetBlockRate(double& dBlockRate,double& dByteRate) const;
 protected:
     void SendHello();
     void SendHelloAck();
+    bool IsFastChecksum(int nChannel,int nCommand) const;
     bool ParseMessageHeader();
     int HandshakeReadHeader();
     int HandshakeReadCompleted();
     virtual bool HandshakeCompleted(bool& fIsBanned);
     int HandleReadHeader();
+    int HandleReadChunk();
     int HandleReadCompleted();
+    int HandlePayload(uint32 nChecksum);
 public:
     uint32 nVersion;
     uint64 nService;
@@ -55,9 +60,19 @@ protected:
     uint32 nMsgMagic;
     uint32 nHsTimerId;
     CMvPeerMessageHeader hdrRecv;
+    bool fFastChecksum;
+    uint32 nRecvChecksum;
+    std::size_t nRecvChecksumed;
 
     std::map<CInv,uint32> mapRequest;
     std::queue<std::pair<uint256,CInv> > queAskFor;
+
+    enum {BLOCK_RATE_WINDOW = 30};
+    int64 nBlockRateStart;
+    uint64 nBlockRateCount;
+    uint64 nBlockRateBytes;
+    double dLastBlockRate;
+    double dLastByteRate;
 };
 
 class CMvPeerInfo : public walleve::CPeerInfo
@@ -67,6 +82,8 @@ public:
     uint64 nService;
     std::string strSubVer;
     int32 nStartingHeight;
+    double dBlockRate;
+    double dByteRate;
 };
 
 } // namespace network
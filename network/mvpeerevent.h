@@ -7,6 +7,7 @@
 
 #include "mvproto.h"
 #include "block.h"
+#include "compactblock.h"
 #include "transaction.h"
 #include "walleve/walleve.h"
 
@@ -34,6 +35,10 @@ enum
     MV_EVENT_PEER_GETDELEGATED,
     MV_EVENT_PEER_DISTRIBUTE,
     MV_EVENT_PEER_PUBLISH,
+    MV_EVENT_PEER_RAWBLOCK,
+    MV_EVENT_PEER_CMPCTBLOCK,
+    MV_EVENT_PEER_GETBLOCKTXN,
+    MV_EVENT_PEER_BLOCKTXN,
     MV_EVENT_PEER_MAX,
 };
 
@@ -184,6 +189,64 @@ public:
     std::vector<unsigned char> vchData;
 };
 
+// A block kept in its serialized form, written out as is.
+// Peers read it back as CBlock, so it has no load side
+class CMvEventPeerRawBlockData
+{
+    friend class walleve::CWalleveStream;
+public:
+    std::vector<unsigned char> vchData;
+protected:
+    void WalleveSerialize(walleve::CWalleveStream& s,walleve::SaveType&)
+    {
+        if (!vchData.empty())
+        {
+            s.Write((const char*)&vchData[0],vchData.size());
+        }
+    }
+    void WalleveSerialize(walleve::CWalleveStream& s,walleve::LoadType&)
+    {
+        (void)s;
+        throw std::runtime_error("raw block can not be loaded");
+    }
+    void WalleveSerialize(walleve::CWalleveStream& s,std::size_t& serSize)
+    {
+        (void)s;
+        serSize += vchData.size();
+    }
+};
+
+// Transactions of a compact block the receiver could not find, by index into vtx
+class CMvEventPeerBlockTxnRequest
+{
+    friend class walleve::CWalleveStream;
+public:
+    uint256 hashBlock;
+    std::vector<uint32> vIndex;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(hashBlock,opt);
+        s.Serialize(vIndex,opt);
+    }
+};
+
+class CMvEventPeerBlockTxnData
+{
+    friend class walleve::CWalleveStream;
+public:
+    uint256 hashBlock;
+    std::vector<CTransaction> vtx;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(hashBlock,opt);
+        s.Serialize(vtx,opt);
+    }
+};
+
 class CMvPeerEventListener;
 
 #define TYPE_PEEREVENT(type,body)       \
@@ -204,6 +267,10 @@ typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETDATA,std::vector<CInv>) CMvEventPeer
 typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETBLOCKS,CBlockLocator) CMvEventPeerGetBlocks;
 typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_TX,CTransaction) CMvEventPeerTx;
 typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_BLOCK,CBlock) CMvEventPeerBlock;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_RAWBLOCK,CMvEventPeerRawBlockData) CMvEventPeerRawBlock;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_CMPCTBLOCK,CCompactBlock) CMvEventPeerCmpctBlock;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETBLOCKTXN,CMvEventPeerBlockTxnRequest) CMvEventPeerGetBlockTxn;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_BLOCKTXN,CMvEventPeerBlockTxnData) CMvEventPeerBlockTxn;
 
 typedef TYPE_PEERDELEGATEDEVENT(MV_EVENT_PEER_BULLETIN,CMvEventPeerDelegatedBulletin) CMvEventPeerBulletin;
 typedef TYPE_PEERDELEGATEDEVENT(MV_EVENT_PEER_GETDELEGATED,CMvEventPeerDelegatedGetData) CMvEventPeerGetDelegated;
@@ -223,6 +290,10 @@ public:
     DECLARE_EVENTHANDLER(CMvEventPeerGetBlocks);
     DECLARE_EVENTHANDLER(CMvEventPeerTx);
     DECLARE_EVENTHANDLER(CMvEventPeerBlock);
+    DECLARE_EVENTHANDLER(CMvEventPeerRawBlock);
+    DECLARE_EVENTHANDLER(CMvEventPeerCmpctBlock);
+    DECLARE_EVENTHANDLER(CMvEventPeerGetBlockTxn);
+    DECLARE_EVENTHANDLER(CMvEventPeerBlockTxn);
     DECLARE_EVENTHANDLER(CMvEventPeerBulletin);
     DECLARE_EVENTHANDLER(CMvEventPeerGetDelegated);
     DECLARE_EVENTHANDLER(CMvEventPeerDistribute);
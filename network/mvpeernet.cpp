@@ -130,6 +130,44 @@ bool CMvPeerNet::HandleEvent(CMvEventPeerBlock& eventBlock)
     return SendDataMessage(eventBlock.nNonce,MVPROTO_CMD_BLOCK,ssPayload);
 }
 
+bool CMvPeerNet::HandleEvent(CMvEventPeerRawBlock& eventRawBlock)
+{
+    // same payload as CMvEventPeerBlock, the block bytes are copied in as they are
+    CWalleveBufStream ssPayload;
+    ssPayload << eventRawBlock.hashFork << eventRawBlock.data << eventRawBlock.nNonce << (int)MV_EVENT_PEER_BLOCK;
+    return SendDataMessage(eventRawBlock.nNonce,MVPROTO_CMD_BLOCK,ssPayload);
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerCmpctBlock& eventCmpctBlock)
+{
+    CWalleveBufStream ssPayload;
+    ssPayload << eventCmpctBlock;
+    return SendDataMessage(eventCmpctBlock.nNonce,MVPROTO_CMD_CMPCTBLOCK,ssPayload);
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerGetBlockTxn& eventGetBlockTxn)
+{
+    CWalleveBufStream ssPayload;
+    ssPayload << eventGetBlockTxn;
+    if (!SendDataMessage(eventGetBlockTxn.nNonce,MVPROTO_CMD_GETBLOCKTXN,ssPayload))
+    {
+        return false;
+    }
+
+    // the answer completes the compact block request
+    vector<CInv> vInv;
+    vInv.push_back(CInv(CInv::MSG_CMPCTBLOCK,eventGetBlockTxn.data.hashBlock));
+    SetInvTimer(eventGetBlockTxn.nNonce,vInv);
+    return true;
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerBlockTxn& eventBlockTxn)
+{
+    CWalleveBufStream ssPayload;
+    ssPayload << eventBlockTxn;
+    return SendDataMessage(eventBlockTxn.nNonce,MVPROTO_CMD_BLOCKTXN,ssPayload);
+}
+
 bool CMvPeerNet::HandleEvent(CMvEventPeerBulletin& eventBulletin)
 {
     CWalleveBufStream ssPayload;
@@ -222,6 +260,7 @@ CPeerInfo* CMvPeerNet::GetPeerInfo(CPeer* pPeer,CPeerInfo* pInfo)
         pMvInfo->nService = pMvPeer->nService;
         pMvInfo->strSubVer = pMvPeer->strSubVer;
         pMvInfo->nStartingHeight = pMvPeer->nStartingHeight;
+        pMvPeer->GetBlockRate(pMvInfo->dBlockRate,pMvInfo->dByteRate);
     }
     return pInfo;
 }
@@ -249,14 +288,14 @@ bool CMvPeerNet::SendDelegatedMessage(uint64 nNonce,int nCommand,walleve::CWalle
 void CMvPeerNet::SetInvTimer(uint64 nNonce,vector<CInv>& vInv)
 {
     const int64 nTimeout[] = { 0, RESPONSE_TX_TIMEOUT, RESPONSE_BLOCK_TIMEOUT,
-                                  RESPONSE_DISTRIBUTE_TIMEOUT, RESPONSE_PUBLISH_TIMEOUT};
+                                  RESPONSE_DISTRIBUTE_TIMEOUT, RESPONSE_PUBLISH_TIMEOUT, RESPONSE_BLOCK_TIMEOUT};
     CMvPeer *pMvPeer = static_cast<CMvPeer *>(GetPeer(nNonce));
     if (pMvPeer != NULL)
     {
         int64 nElapse = 0;
         for(CInv& inv : vInv)
         {
-            if (inv.nType >= CInv::MSG_TX && inv.nType <= CInv::MSG_PUBLISH)
+            if (inv.nType >= CInv::MSG_TX && inv.nType <= CInv::MSG_CMPCTBLOCK)
             {
                 nElapse += nTimeout[inv.nType];
                 uint32 nTimerId = SetTimer(nNonce,nElapse);
@@ -704,6 +743,14 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
                         return true;
                     }
 
+                    // fork nodes behind this root only serve full blocks
+                    for (CInv& inv : payload)
+                    {
+                        if (inv.nType == CInv::MSG_CMPCTBLOCK)
+                        {
+                            inv.nType = CInv::MSG_BLOCK;
+                        }
+                    }
                     return HandleRootPeerGetData(pMvPeer->GetNonce(), hashFork, payload);
                 }
 
@@ -807,11 +854,14 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
                 //SuperNode
                 if(SUPER_NODE_TYPE::SUPER_NODE_TYPE_ROOT == typeNode)
                 {
+                    pMvPeer->BlockReceived(ssPayload.GetSize());
                     CBlock payload;
                     ssPayload >> payload;
 
                     CInv inv(CInv::MSG_BLOCK, payload.GetHash());
                     CancelTimer(pMvPeer->Responded(inv));
+                    inv.nType = CInv::MSG_CMPCTBLOCK;
+                    CancelTimer(pMvPeer->Responded(inv));
 
                     if((IsMainFork(hashFork) || IsMyFork(hashFork)) 
                         && IsThisNodeData(hashFork, pMvPeer->GetNonce(), payload.GetHash()))
@@ -828,12 +878,72 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
                 }
 
                 //FnFn
+                pMvPeer->BlockReceived(ssPayload.GetSize());
                 CMvEventPeerBlock* pEvent = new CMvEventPeerBlock(pMvPeer->GetNonce(),hashFork);
                 if (pEvent != NULL)
                 {           
                     ssPayload >> pEvent->data;
                     CInv inv(CInv::MSG_BLOCK,pEvent->data.GetHash());
                     CancelTimer(pMvPeer->Responded(inv));
+                    // a compact block request may be answered with the full block
+                    inv.nType = CInv::MSG_CMPCTBLOCK;
+                    CancelTimer(pMvPeer->Responded(inv));
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                }
+            }
+            break;
+        case MVPROTO_CMD_CMPCTBLOCK:
+            {
+                pMvPeer->BlockReceived(ssPayload.GetSize());
+                CMvEventPeerCmpctBlock* pEvent = new CMvEventPeerCmpctBlock(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL)
+                {
+                    ssPayload >> pEvent->data;
+                    CInv inv(CInv::MSG_CMPCTBLOCK,pEvent->data.GetHash());
+                    CancelTimer(pMvPeer->Responded(inv));
+                    if (SUPER_NODE_TYPE::SUPER_NODE_TYPE_ROOT == typeNode && !IsMainFork(hashFork) && !IsMyFork(hashFork))
+                    {
+                        // announced to the fork nodes as an inv, they fetch the full block
+                        vector<CInv> vInv;
+                        vInv.push_back(CInv(CInv::MSG_BLOCK,inv.nHash));
+                        delete pEvent;
+                        return HandleRootPeerInv(pMvPeer->GetNonce(),hashFork,vInv);
+                    }
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                }
+            }
+            break;
+        case MVPROTO_CMD_GETBLOCKTXN:
+            {
+                if (SUPER_NODE_TYPE::SUPER_NODE_TYPE_ROOT == typeNode && !IsMainFork(hashFork) && !IsMyFork(hashFork))
+                {
+                    // never sent a compact block of this fork
+                    return true;
+                }
+                CMvEventPeerGetBlockTxn* pEvent = new CMvEventPeerGetBlockTxn(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL)
+                {
+                    ssPayload >> pEvent->data;
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                }
+            }
+            break;
+        case MVPROTO_CMD_BLOCKTXN:
+            {
+                CMvEventPeerBlockTxn* pEvent = new CMvEventPeerBlockTxn(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL)
+                {
+                    ssPayload >> pEvent->data;
+                    CInv inv(CInv::MSG_CMPCTBLOCK,pEvent->data.hashBlock);
+                    CancelTimer(pMvPeer->Responded(inv));
+                    if (SUPER_NODE_TYPE::SUPER_NODE_TYPE_ROOT == typeNode && !IsMainFork(hashFork) && !IsMyFork(hashFork))
+                    {
+                        delete pEvent;
+                        return true;
+                    }
                     pNetChannel->PostEvent(pEvent);
                     return true;
                 }
@@ -59,6 +59,7 @@ public:
     CMvPeerNet();
     CMvPeerNet(const std::string& walleveOwnKeyIn);
     ~CMvPeerNet();
+    uint64 GetService() const { return nService; }
     virtual void BuildHello(walleve::CPeer *pPeer,walleve::CWalleveBufStream& ssPayload);
     void HandlePeerWriten(walleve::CPeer *pPeer) override;
     virtual bool HandlePeerHandshaked(walleve::CPeer *pPeer,uint32 nTimerId,bool& fIsBanned);
@@ -90,6 +91,10 @@ protected:
     bool HandleEvent(CMvEventPeerGetBlocks& eventGetBlocks) override;
     bool HandleEvent(CMvEventPeerTx& eventTx) override;
     bool HandleEvent(CMvEventPeerBlock& eventBlock) override;
+    bool HandleEvent(CMvEventPeerRawBlock& eventRawBlock) override;
+    bool HandleEvent(CMvEventPeerCmpctBlock& eventCmpctBlock) override;
+    bool HandleEvent(CMvEventPeerGetBlockTxn& eventGetBlockTxn) override;
+    bool HandleEvent(CMvEventPeerBlockTxn& eventBlockTxn) override;
     bool HandleEvent(CMvEventPeerBulletin& eventBulletin) override;
     bool HandleEvent(CMvEventPeerGetDelegated& eventGetDelegated) override;
     bool HandleEvent(CMvEventPeerDistribute& eventDistribute) override;
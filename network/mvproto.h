@@ -7,6 +7,8 @@
 
 #include "uint256.h"
 #include "crc24q.h"
+#include "crc32c.h"
+#include "crypto.h"
 #include "walleve/walleve.h"
 
 namespace multiverse 
@@ -19,6 +21,8 @@ enum
 {
     NODE_NETWORK           = (1 << 0),
     NODE_DELEGATED         = (1 << 1),
+    NODE_FASTCHECKSUM      = (1 << 2),
+    NODE_COMPACTBLOCK      = (1 << 3),
 };
 
 enum
@@ -48,6 +52,9 @@ enum
     MVPROTO_CMD_INV          = 5,
     MVPROTO_CMD_TX           = 6,
     MVPROTO_CMD_BLOCK        = 7,
+    MVPROTO_CMD_CMPCTBLOCK   = 8,
+    MVPROTO_CMD_GETBLOCKTXN  = 9,
+    MVPROTO_CMD_BLOCKTXN     = 10,
 };
 
 enum
@@ -60,6 +67,7 @@ enum
 
 #define MESSAGE_HEADER_SIZE		16
 #define MESSAGE_PAYLOAD_MAX_SIZE        0x400000
+#define MESSAGE_PAYLOAD_CHUNK_SIZE      0x10000
 
 class CMvPeerMessageHeader
 {
@@ -90,6 +98,15 @@ public:
     {
         return ((nChannel << 6) | (nCommand & 0x3F));
     }
+    // blake2b unless both peers advertised NODE_FASTCHECKSUM, then crc32c
+    static uint32 GetPayloadChecksum(const char* pData,std::size_t nSize,bool fFast)
+    {
+        if (fFast)
+        {
+            return multiverse::crypto::crc32c(0,(const unsigned char*)pData,nSize);
+        }
+        return multiverse::crypto::CryptoHash(pData,nSize).Get32();
+    }
 protected:
     void WalleveSerialize(walleve::CWalleveStream& s,walleve::SaveType&)
     {
@@ -122,7 +139,8 @@ class CInv
 {
     friend class walleve::CWalleveStream;
 public:
-    enum {MSG_ERROR=0,MSG_TX,MSG_BLOCK,MSG_DISTRIBUTE,MSG_PUBLISH,};
+    // MSG_CMPCTBLOCK asks for a block in compact form, it is only used in getdata
+    enum {MSG_ERROR=0,MSG_TX,MSG_BLOCK,MSG_DISTRIBUTE,MSG_PUBLISH,MSG_CMPCTBLOCK,};
     enum {MAX_INV_COUNT = 1024 * 8};
     CInv() {}
     CInv(uint32 nTypeIn,const uint256& nHashIn)
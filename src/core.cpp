@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "core.h"
+#include "template/templatecache.h"
 
 using namespace std;                      
 using namespace walleve; 
@@ -214,15 +215,21 @@ MvErr CMvCoreProtocol::ValidateBlock(const CBlock& block)
         return DEBUG(MV_ERR_BLOCK_TRANSACTIONS_INVALID,"origin block vtx is not empty\n");
     }
 
-    vector<uint256> vMerkleTree;
-    if (block.hashMerkle != block.BuildMerkleTree(vMerkleTree))
+    vector<uint256> vTxid;
+    vTxid.reserve(block.vtx.size());
+    CMerkleBuilder builder;
+    for (const CTransaction& tx : block.vtx)
+    {
+        vTxid.push_back(tx.GetHash());
+        builder.Append(vTxid.back());
+    }
+    if (block.hashMerkle != builder.GetRoot())
     {
         return DEBUG(MV_ERR_BLOCK_TXHASH_MISMATCH,"tx merkeroot mismatched\n");
     }
 
-    set<uint256> setTx;
-    setTx.insert(vMerkleTree.begin(),vMerkleTree.begin() + block.vtx.size());
-    if (setTx.size() != block.vtx.size())
+    sort(vTxid.begin(),vTxid.end());
+    if (adjacent_find(vTxid.begin(),vTxid.end()) != vTxid.end())
     {
         return DEBUG(MV_ERR_BLOCK_DUPLICATED_TRANSACTION,"duplicate tx\n");
     }
@@ -361,7 +368,16 @@ MvErr CMvCoreProtocol::VerifySubsidiary(const CBlock& block,const CBlockIndex* p
 
 MvErr CMvCoreProtocol::VerifyBlockTx(const CTransaction& tx,const CTxContxt& txContxt,CBlockIndex* pIndexPrev)
 {
-    const CDestination& destIn = txContxt.destIn;
+    MvErr err = VerifyBlockTxContext(tx,txContxt,pIndexPrev);
+    if (err != MV_OK)
+    {
+        return err;
+    }
+    return VerifyBlockTxSignature(tx,txContxt);
+}
+
+MvErr CMvCoreProtocol::VerifyBlockTxContext(const CTransaction& tx,const CTxContxt& txContxt,CBlockIndex* pIndexPrev)
+{
     int64 nValueIn = 0;
     for(const CTxInContxt& inctxt : txContxt.vin)
     {
@@ -384,7 +400,13 @@ MvErr CMvCoreProtocol::VerifyBlockTx(const CTransaction& tx,const CTxContxt& txC
     {
         return DEBUG(MV_ERR_TRANSACTION_INPUT_INVALID,"valuein is not enough (%ld : %ld)\n",nValueIn,tx.nAmount + tx.nTxFee);
     }
+    return MV_OK;
+}
 
+MvErr CMvCoreProtocol::VerifyBlockTxSignature(const CTransaction& tx,const CTxContxt& txContxt)
+{
+    // depends on tx and its inputs only, so it may run on any thread
+    const CDestination& destIn = txContxt.destIn;
     vector<uint8> vchSig;
     if (CTemplate::IsDestInRecorded(tx.sendTo))
     {
@@ -456,7 +478,7 @@ MvErr CMvCoreProtocol::VerifyTransaction(const CTransaction& tx,const vector<CTx
     // locked coin template: nValueIn >= tx.nAmount + tx.nTxFee + nLockedCoin
     if (CTemplate::IsLockedCoin(destIn))
     {
-        CTemplatePtr ptr = CTemplate::CreateTemplatePtr(destIn.GetTemplateId(), vchSig);
+        CTemplatePtr ptr = CTemplateCache::GetInstance().GetTemplate(destIn.GetTemplateId(), vchSig);
         if (!ptr)
         {
             return DEBUG(MV_ERR_TRANSACTION_SIGNATURE_INVALID,"invalid locked coin template destination\n");
@@ -26,6 +26,8 @@ public:
     virtual MvErr VerifySubsidiary(const CBlock& block,const CBlockIndex* pIndexPrev,const CBlockIndex* pIndexRef,
                                                        const CDelegateAgreement& agreement, int64& nReward) override;
     virtual MvErr VerifyBlockTx(const CTransaction& tx, const CTxContxt& txContxt, CBlockIndex *pIndexPrev) override;
+    virtual MvErr VerifyBlockTxContext(const CTransaction& tx, const CTxContxt& txContxt, CBlockIndex *pIndexPrev) override;
+    virtual MvErr VerifyBlockTxSignature(const CTransaction& tx, const CTxContxt& txContxt) override;
     virtual MvErr VerifyTransaction(const CTransaction& tx, const std::vector<CTxOutput>& vPrevOutput, int32 nForkHeight) override;
     virtual bool GetProofOfWorkTarget(const CBlockIndex* pIndexPrev, int nAlgo, int& nBits, int64& nReward) override;
     virtual int GetProofOfWorkRunTimeBits(int nBits, int64 nTime, int64 nPrevTime) override;
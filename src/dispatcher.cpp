@@ -223,6 +223,66 @@ MvErr CDispatcher::AddNewTx(const CTransaction& tx,uint64 nNonce)
         return err;
     }
 
+    err = UpdateNewTx(tx,hashFork,destIn,nValueIn);
+    if (err != MV_OK)
+    {
+        return err;
+    }
+
+    if (!nNonce)
+    {
+        pNetChannel->BroadcastTxInv(hashFork);
+    }
+
+    return MV_OK;
+}
+
+void CDispatcher::AddNewTxBatch(const vector<CTransaction>& vtx,const vector<uint64>& vNonce,vector<MvErr>& vErr)
+{
+    vErr.assign(vtx.size(),MV_OK);
+
+    vector<CTransaction> vValidTx;
+    vector<size_t> vValidIndex;
+    for (size_t i = 0;i < vtx.size();i++)
+    {
+        vErr[i] = pCoreProtocol->ValidateTransaction(vtx[i]);
+        if (vErr[i] == MV_OK)
+        {
+            vValidTx.push_back(vtx[i]);
+            vValidIndex.push_back(i);
+        }
+    }
+
+    vector<MvErr> vPushErr;
+    vector<CTxPushResult> vResult;
+    pTxPool->PushBatch(vValidTx,vPushErr,vResult);
+
+    set<uint256> setBroadcastFork;
+    for (size_t n = 0;n < vValidTx.size();n++)
+    {
+        size_t i = vValidIndex[n];
+        vErr[i] = vPushErr[n];
+        if (vErr[i] != MV_OK)
+        {
+            continue;
+        }
+
+        const CTxPushResult& result = vResult[n];
+        vErr[i] = UpdateNewTx(vValidTx[n],result.hashFork,result.destIn,result.nValueIn);
+        if (vErr[i] == MV_OK && !vNonce[i])
+        {
+            setBroadcastFork.insert(result.hashFork);
+        }
+    }
+
+    for (const uint256& hashFork : setBroadcastFork)
+    {
+        pNetChannel->BroadcastTxInv(hashFork);
+    }
+}
+
+MvErr CDispatcher::UpdateNewTx(const CTransaction& tx,const uint256& hashFork,const CDestination& destIn,int64 nValueIn)
+{
     CAssembledTx assembledTx(tx,-1,destIn,nValueIn);
     if (!pWallet->AddNewTx(hashFork,assembledTx))
     {
@@ -235,14 +295,9 @@ MvErr CDispatcher::AddNewTx(const CTransaction& tx,uint64 nNonce)
     updateTransaction.nChange = assembledTx.GetChange();
     pService->NotifyTransactionUpdate(updateTransaction);
 
-    if (!nNonce)
-    {
-        pNetChannel->BroadcastTxInv(hashFork);
-    }
-
     if (hashFork == pCoreProtocol->GetGenesisBlockHash())
     {
-        pConsensus->AddNewTx(CAssembledTx(tx,-1,destIn,nValueIn));
+        pConsensus->AddNewTx(assembledTx);
     }
 
     return MV_OK;
@@ -18,6 +18,7 @@ public:
     ~CDispatcher();
     MvErr AddNewBlock(const CBlock& block, uint64 nNonce = 0) override;
     MvErr AddNewTx(const CTransaction& tx, uint64 nNonce = 0) override;
+    void AddNewTxBatch(const std::vector<CTransaction>& vtx, const std::vector<uint64>& vNonce, std::vector<MvErr>& vErr) override;
     bool  AddNewDistribute(const uint256& hashAnchor,const CDestination& dest,
                            const std::vector<unsigned char>& vchDistribute) override;
     bool  AddNewPublish(const uint256& hashAnchor,const CDestination& dest,
@@ -28,6 +29,7 @@ protected:
     void WalleveHandleDeinitialize() override;
     bool WalleveHandleInvoke() override;
     void WalleveHandleHalt() override;
+    MvErr UpdateNewTx(const CTransaction& tx,const uint256& hashFork,const CDestination& destIn,int64 nValueIn);
     void UpdatePrimaryBlock(const CBlock& block,const CWorldLineUpdate& updateWorldLine,const CTxSetChange& changeTxSet);
     void ActivateFork(const uint256& hashFork);
     bool ProcessForkTx(const uint256& txid,const CTransaction& tx);
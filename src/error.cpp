@@ -94,7 +94,10 @@ static const char * _MvErrString[] =
     //MV_ERR_WALLET_IS_UNENCRYPTED,                  // 38
     "wallet is unencrypted",
     //MV_ERR_WALLET_FAILED,                          // 39
-    "wallet operation is failed"
+    "wallet operation is failed",
+    /* transaction pool */
+    //MV_ERR_TRANSACTION_EVICTED,                    // 40
+    "transaction is evicted by the pool memory limit"
 };
 
 const char* multiverse::MvErrString(const MvErr& err)
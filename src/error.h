@@ -57,6 +57,8 @@ typedef enum
     MV_ERR_WALLET_IS_ENCRYPTED,				// 37
     MV_ERR_WALLET_IS_UNENCRYPTED,			// 38
     MV_ERR_WALLET_FAILED,				// 39
+    /* transaction pool */
+    MV_ERR_TRANSACTION_EVICTED,				// 40
     /* count */
     MV_ERR_MAX_COUNT
 }MvErr;
@@ -42,6 +42,8 @@ public:
     virtual MvErr VerifySubsidiary(const CBlock& block,const CBlockIndex* pIndexPrev,const CBlockIndex* pIndexRef,
                                                        const CDelegateAgreement& agreement, int64& nReward) = 0;
     virtual MvErr VerifyBlockTx(const CTransaction& tx, const CTxContxt& txContxt, CBlockIndex* pIndexPrev) = 0;
+    virtual MvErr VerifyBlockTxContext(const CTransaction& tx, const CTxContxt& txContxt, CBlockIndex* pIndexPrev) = 0;
+    virtual MvErr VerifyBlockTxSignature(const CTransaction& tx, const CTxContxt& txContxt) = 0;
     virtual MvErr VerifyTransaction(const CTransaction& tx, const std::vector<CTxOutput>& vPrevOutput, int32 nForkHeight) = 0;
     virtual bool GetProofOfWorkTarget(const CBlockIndex* pIndexPrev, int nAlgo, int& nBits, int64& nReward) = 0;
     virtual int GetProofOfWorkRunTimeBits(int nBits, int64 nTime, int64 nPrevTime) = 0;
@@ -66,6 +68,7 @@ public:
     virtual bool GetLastBlockTime(const uint256& hashFork,int32 nDepth,std::vector<int64>& vTime) = 0;
     virtual bool GetBlock(const uint256& hashBlock,CBlock& block) = 0;
     virtual bool GetBlockEx(const uint256& hashBlock,CBlockEx& block) = 0;
+    virtual bool GetRawBlock(const uint256& hashBlock,std::vector<unsigned char>& vchBlock) = 0;
     virtual bool GetOrigin(const uint256& hashFork,CBlock& block) = 0;
     virtual bool Exists(const uint256& hashBlock) = 0;
     virtual bool GetTransaction(const uint256& txid,CTransaction& tx) = 0;
@@ -85,6 +88,7 @@ public:
     virtual bool GetBlockInv(const uint256& hashFork,const CBlockLocator& locator,std::vector<uint256>& vBlockHash,std::size_t nMaxCount) = 0;
     virtual bool GetBlockDelegateEnrolled(const uint256& hashBlock,CDelegateEnrolled& enrolled) = 0;
     virtual bool GetBlockDelegateAgreement(const uint256& hashBlock,CDelegateAgreement& agreement) = 0;
+    virtual void GetStorageStatus(CStorageStatus& status) = 0;
     const CMvBasicConfig* WalleveConfig()
     {
         return dynamic_cast<const CMvBasicConfig*>(walleve::IWalleveBase::WalleveConfig());
@@ -102,7 +106,9 @@ public:
     virtual bool Exists(const uint256& txid) = 0;
     virtual void Clear() = 0;
     virtual std::size_t Count(const uint256& fork) const = 0;
+    virtual void GetMemoryUsage(const uint256& hashFork, std::size_t& nForkUsage, std::size_t& nTotalUsage) const = 0;
     virtual MvErr Push(const CTransaction& tx, uint256& hashFork, CDestination& destIn, int64& nValueIn) = 0;
+    virtual void PushBatch(const std::vector<CTransaction>& vtx, std::vector<MvErr>& vErr, std::vector<CTxPushResult>& vResult) = 0;
     virtual void Pop(const uint256& txid) = 0;
     virtual bool Get(const uint256& txid, CTransaction& tx) const = 0;
     virtual void ListTx(const uint256& hashFork, std::vector<std::pair<uint256, std::size_t>>& vTxPool) = 0;
@@ -217,6 +223,7 @@ public:
     IDispatcher() : IWalleveBase("dispatcher") {}
     virtual MvErr AddNewBlock(const CBlock& block, uint64 nNonce = 0) = 0;
     virtual MvErr AddNewTx(const CTransaction& tx, uint64 nNonce = 0) = 0;
+    virtual void AddNewTxBatch(const std::vector<CTransaction>& vtx, const std::vector<uint64>& vNonce, std::vector<MvErr>& vErr) = 0;
     virtual bool  AddNewDistribute(const uint256& hashAnchor,const CDestination& dest,
                                    const std::vector<unsigned char>& vchDistribute) = 0;
     virtual bool  AddNewPublish(const uint256& hashAnchor,const CDestination& dest,
@@ -252,9 +259,11 @@ public:
     virtual bool GetBlock(const uint256& hashBlock,CBlock& block,uint256& hashFork,int32& nHeight) = 0;
     virtual bool GetBlockEx(const uint256& hashBlock, CBlockEx& block, uint256& hashFork, int32& nHeight) = 0;
     virtual void GetTxPool(const uint256& hashFork,std::vector<std::pair<uint256,std::size_t> >& vTxPool) = 0;
+    virtual void GetTxPoolMemory(const uint256& hashFork,std::size_t& nForkUsage,std::size_t& nTotalUsage) = 0;
     virtual bool GetTransaction(const uint256& txid,CTransaction& tx,uint256& hashFork,int32& nHeight) = 0;
     virtual MvErr SendTransaction(CTransaction& tx) = 0;
     virtual bool RemovePendingTx(const uint256& txid) = 0;
+    virtual void GetStorageStatus(CStorageStatus& status) = 0;
     /* Wallet */
     virtual bool HaveKey(const crypto::CPubKey& pubkey) = 0;
     virtual void GetPubKeys(std::set<crypto::CPubKey>& setPubKey) = 0;
@@ -57,6 +57,56 @@ public:
     }
 };
 
+class CStorageStatus
+{
+public:
+    CStorageStatus() { SetNull(); }
+    void SetNull()
+    {
+        fTxFilterEnabled = false;
+        nTxFilterCapacity = nTxFilterCount = nTxFilterMemory = 0;
+        nTxFilterQuery = nTxFilterReject = nTxFilterFalsePositive = 0;
+        nFlushCount = 0;
+        nFlushLastTime = nFlushMaxTime = nFlushTotalTime = 0;
+        nFlushBatchSize = nFlushBatchDB = 0;
+        fConsistencyRunning = fConsistencyPassed = false;
+        nConsistencyLevel = 0;
+        nConsistencyDepth = 0;
+        nConsistencyForkCount = nConsistencyForkChecked = 0;
+        nConsistencyBlockChecked = nConsistencyErrorCount = 0;
+        vConsistencyFinding.clear();
+        nTemplateCacheCapacity = nTemplateCacheCount = 0;
+        nTemplateCacheHit = nTemplateCacheMiss = 0;
+    }
+public:
+    bool fTxFilterEnabled;
+    std::size_t nTxFilterCapacity;
+    std::size_t nTxFilterCount;
+    std::size_t nTxFilterMemory;
+    uint64 nTxFilterQuery;
+    uint64 nTxFilterReject;
+    uint64 nTxFilterFalsePositive;
+    uint64 nFlushCount;
+    int64 nFlushLastTime;
+    int64 nFlushMaxTime;
+    int64 nFlushTotalTime;
+    std::size_t nFlushBatchSize;
+    std::size_t nFlushBatchDB;
+    bool fConsistencyRunning;
+    bool fConsistencyPassed;
+    int nConsistencyLevel;
+    int32 nConsistencyDepth;
+    std::size_t nConsistencyForkCount;
+    std::size_t nConsistencyForkChecked;
+    uint64 nConsistencyBlockChecked;
+    uint64 nConsistencyErrorCount;
+    std::vector<std::string> vConsistencyFinding;
+    std::size_t nTemplateCacheCapacity;
+    std::size_t nTemplateCacheCount;
+    uint64 nTemplateCacheHit;
+    uint64 nTemplateCacheMiss;
+};
+
 // Notify
 class CWorldLineUpdate
 {
@@ -96,6 +146,16 @@ public:
     std::vector<std::pair<uint256,std::vector<CTxIn> > > vTxRemove;
 };
 
+class CTxPushResult
+{
+public:
+    CTxPushResult() : nValueIn(0) {}
+public:
+    uint256 hashFork;
+    CDestination destIn;
+    int64 nValueIn;
+};
+
 class CNetworkPeerUpdate
 {
 public:
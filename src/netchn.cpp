@@ -14,6 +14,8 @@ using namespace multiverse;
 using boost::asio::ip::tcp;
 
 #define PUSHTX_TIMEOUT		(1000)
+#define SCHED_STALL_CHECK	(5000)
+#define BLOCK_STALL_TIMEOUT	(20000)
 
 //////////////////////////////
 // CConcurrentPeerNetData
@@ -130,6 +132,13 @@ bool CConcurrentPeerNetData::IsPeerEmpty()
     return mapPeer.empty();
 }
 
+bool CConcurrentPeerNetData::IsCompactBlockPeer(uint64 nNonce, const uint256& hashFork) const
+{
+    ReadLocker rlockPeer(rwPeer);
+    map<uint64,CNetChannelPeer>::const_iterator it = mapPeer.find(nNonce);
+    return (it != mapPeer.end() && (*it).second.IsCompactBlockPeer(hashFork));
+}
+
 void CConcurrentPeerNetData::MakeTxInvByFork(const uint256& hashFork, const std::vector<uint256>& vTxPool, std::vector<std::pair<uint64,VecInv>>& InvData)
 {
     WriteLocker wlockPeer(rwPeer);
@@ -235,6 +244,8 @@ CNetChannel::CNetChannel(const uint nThreadIn, const bool fAffinityIn)
     pTxPool = NULL;
     pService = NULL;
     pDispatcher = NULL;
+    nTimerPushTx = 0;
+    nTimerStall = 0;
     nodeType = NODE_TYPE::NODE_TYPE_FNFN;
 }
 
@@ -299,6 +310,10 @@ bool CNetChannel::WalleveHandleInvoke()
         boost::unique_lock<boost::mutex> lock(mtxPushTx);
         nTimerPushTx = 0;
     }
+    {
+        boost::unique_lock<boost::mutex> lock(mtxStallTimer);
+        nTimerStall = WalleveSetTimer(SCHED_STALL_CHECK,boost::bind(&CNetChannel::StallTimerFunc,this,_1));
+    }
     return network::IMvNetChannel::WalleveHandleInvoke(); 
 }
 
@@ -313,10 +328,18 @@ void CNetChannel::WalleveHandleHalt()
         }
         setPushTxFork.clear(); 
     }
+    {
+        boost::unique_lock<boost::mutex> lock(mtxStallTimer);
+        if (nTimerStall != 0)
+        {
+            WalleveCancelTimer(nTimerStall);
+            nTimerStall = 0;
+        }
+    }
     
     network::IMvNetChannel::WalleveHandleHalt();
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
+        boost::unique_lock<boost::shared_mutex> wlock(rwSched);
         mapSched.clear();
     }
 }
@@ -340,23 +363,49 @@ bool CNetChannel::IsForkSynchronized(const uint256& hashFork) const
 
 void CNetChannel::BroadcastBlockInv(const uint256& hashFork,const uint256& hashBlock)
 {
-    set<uint64> setKnownPeer;
+    ForkSchedPtr spForkSched = GetForkSched(hashFork);
+    if (spForkSched == NULL)
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-        CSchedule& sched = GetSchedule(hashFork);
-        sched.GetKnownPeer(network::CInv(network::CInv::MSG_BLOCK,hashBlock), setKnownPeer);
+        throw runtime_error("Unknown fork for scheduling.");
     }
+    spForkSched->Post(boost::bind(&CNetChannel::SchedBroadcastBlockInv,this,hashFork,hashBlock,_1));
+}
+
+void CNetChannel::SchedBroadcastBlockInv(const uint256& hashFork,const uint256& hashBlock,CSchedule& sched)
+{
+    set<uint64> setKnownPeer;
+    sched.GetKnownPeer(network::CInv(network::CInv::MSG_BLOCK,hashBlock), setKnownPeer);
 
     network::CMvEventPeerInv eventInv(0,hashFork);
     eventInv.sender = "netchannel";
     eventInv.data.push_back(network::CInv(network::CInv::MSG_BLOCK,hashBlock));
 
+    // peers at the tip get the compact block right away, built once for all of them
+    network::CMvEventPeerCmpctBlock eventCmpctBlock(0,hashFork);
+    eventCmpctBlock.sender = "netchannel";
+    bool fCompactReady = false,fCompactBuilt = false;
+
     std::vector<std::pair<uint64,CNetChannelPeer>> vChannelPeer = conPeerNetData.KeyValues();
     for(const auto& channelPeer : vChannelPeer)
     {
         const uint64& nNonce = channelPeer.first;
         if (!setKnownPeer.count(nNonce) && channelPeer.second.IsSubscribed(hashFork))
         {
+            if (nodeType != NODE_TYPE::NODE_TYPE_FORK && !IsSuperNodeInnerNonce(nNonce)
+                && channelPeer.second.IsCompactBlockPeer(hashFork))
+            {
+                if (!fCompactBuilt)
+                {
+                    fCompactReady = BuildCompactBlock(hashBlock,eventCmpctBlock.data);
+                    fCompactBuilt = true;
+                }
+                if (fCompactReady)
+                {
+                    eventCmpctBlock.nNonce = nNonce;
+                    pPeerNet->DispatchEvent(&eventCmpctBlock);
+                    continue;
+                }
+            }
             eventInv.nNonce = nNonce;
             pPeerNet->DispatchEvent(&eventInv);
         }
@@ -388,8 +437,8 @@ void CNetChannel::BroadcastTxInv(const uint256& hashFork)
 void CNetChannel::SubscribeFork(const uint256& hashFork)
 {
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-        if (!mapSched.insert(make_pair(hashFork,CSchedule())).second)
+        boost::unique_lock<boost::shared_mutex> wlock(rwSched);
+        if (!mapSched.insert(make_pair(hashFork,ForkSchedPtr(new CForkSched()))).second)
         {
             return;
         }
@@ -410,7 +459,7 @@ void CNetChannel::SubscribeFork(const uint256& hashFork)
 void CNetChannel::UnsubscribeFork(const uint256& hashFork)
 {
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
+        boost::unique_lock<boost::shared_mutex> wlock(rwSched);
         if (!mapSched.erase(hashFork))
         {
             return;
@@ -430,7 +479,7 @@ void CNetChannel::UnsubscribeFork(const uint256& hashFork)
 
 bool CNetChannel::IsContains(const uint256& hashFork)
 {
-    boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
+    boost::shared_lock<boost::shared_mutex> rlock(rwSched);
     return mapSched.find(hashFork) != mapSched.end();
 }
 
@@ -448,8 +497,8 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerActive& eventActive)
         
         network::CMvEventPeerSubscribe eventSubscribe(nNonce,pCoreProtocol->GetGenesisBlockHash());
         {
-            boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-            for (map<uint256,CSchedule>::iterator it = mapSched.begin();it != mapSched.end();++it)
+            boost::shared_lock<boost::shared_mutex> rlock(rwSched);
+            for (map<uint256,ForkSchedPtr>::iterator it = mapSched.begin();it != mapSched.end();++it)
             {
                 if ((*it).first != pCoreProtocol->GetGenesisBlockHash())
                 {
@@ -473,19 +522,14 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerActive& eventActive)
 bool CNetChannel::HandleEvent(network::CMvEventPeerDeactive& eventDeactive)
 {
     uint64 nNonce = eventDeactive.nNonce;
+    vector<pair<uint256,ForkSchedPtr> > vForkSched;
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-        for (map<uint256,CSchedule>::iterator it = mapSched.begin();it != mapSched.end();++it)
-        {
-            CSchedule& sched = (*it).second;
-            set<uint64> setSchedPeer;
-            sched.RemovePeer(nNonce,setSchedPeer);
-
-            for(const uint64 nNonceSched : setSchedPeer)
-            {
-                SchedulePeerInv(nNonceSched,(*it).first,sched);
-            }
-        }
+        boost::shared_lock<boost::shared_mutex> rlock(rwSched);
+        vForkSched.assign(mapSched.begin(),mapSched.end());
+    }
+    for (size_t i = 0;i < vForkSched.size();i++)
+    {
+        vForkSched[i].second->Post(boost::bind(&CNetChannel::SchedRemovePeer,this,nNonce,vForkSched[i].first,_1));
     }
     
     conPeerNetData.DeactivePeer(nNonce);
@@ -505,7 +549,7 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerSubscribe& eventSubscribe)
         
         for(const uint256& hash : eventSubscribe.data)
         {
-            boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
+            boost::shared_lock<boost::shared_mutex> rlock(rwSched);
             if (mapSched.count(hash))
             {
                 DispatchGetBlocksEvent(nNonce,hash);
@@ -549,34 +593,58 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerInv& eventInv)
             throw runtime_error("Inv count overflow.");
         }
 
+        ForkSchedPtr spForkSched = GetForkSched(hashFork);
+        if (spForkSched == NULL)
         {
-            boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-            CSchedule& sched = GetSchedule(hashFork);
-            vector<uint256> vTxHash;
-            for(const network::CInv& inv : eventInv.data)
+            throw runtime_error("Unknown fork for scheduling.");
+        }
+        spForkSched->Post(boost::bind(&CNetChannel::SchedInv,this,nNonce,hashFork,eventInv.data,_1));
+    }
+    catch (...)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventInv");
+    }
+    return true;
+}
+
+void CNetChannel::SchedInv(uint64 nNonce,const uint256& hashFork,const vector<network::CInv>& vInv,CSchedule& sched)
+{
+    try
+    {
+        vector<uint256> vTxHash;
+        vector<uint256> vBlockHash;
+        for(const network::CInv& inv : vInv)
+        {
+            if (inv.nType == network::CInv::MSG_BLOCK)
             {
-                if ((inv.nType == network::CInv::MSG_TX && !pTxPool->Exists(inv.nHash)) 
-                    || (inv.nType == network::CInv::MSG_BLOCK && !pWorldLine->Exists(inv.nHash)))
-                {
-                    sched.AddNewInv(inv,nNonce);
-                    if (inv.nType == network::CInv::MSG_TX)
-                    {
-                        vTxHash.push_back(inv.nHash);
-                    }
-                }
+                vBlockHash.push_back(inv.nHash);
             }
-            if (!vTxHash.empty())
+            if ((inv.nType == network::CInv::MSG_TX && !pTxPool->Exists(inv.nHash)) 
+                || (inv.nType == network::CInv::MSG_BLOCK && !pWorldLine->Exists(inv.nHash)))
             {
-                conPeerNetData.AddKnownTx(nNonce, hashFork, vTxHash);
+                sched.AddNewInv(inv,nNonce);
+                if (inv.nType == network::CInv::MSG_TX)
+                {
+                    vTxHash.push_back(inv.nHash);
+                }
             }
-            SchedulePeerInv(nNonce,hashFork,sched);
         }
+        if (!vTxHash.empty())
+        {
+            conPeerNetData.AddKnownTx(nNonce, hashFork, vTxHash);
+        }
+        // a full getblocks answer ends with the peer's tip, fetch the next run of the chain
+        // while these blocks download
+        if (vBlockHash.size() == MAX_GETBLOCKS_COUNT)
+        {
+            sched.SetBlockInvContinue(nNonce,vBlockHash[vBlockHash.size() - 2]);
+        }
+        SchedulePeerInv(nNonce,hashFork,sched);
     }
     catch (...)
     {
         DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventInv");
     }
-    return true;
 }
 
 bool CNetChannel::HandleEvent(network::CMvEventPeerGetData& eventGetData)
@@ -616,7 +684,8 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerGetData& eventGetData)
         }
         else if (inv.nType == network::CInv::MSG_BLOCK)
         {
-            network::CMvEventPeerBlock eventBlock(nNonce,hashFork);
+            // served as stored, without decoding and encoding the block again
+            network::CMvEventPeerRawBlock eventBlock(nNonce,hashFork);
 
             if("up" == flow)
             {
@@ -629,7 +698,7 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerGetData& eventGetData)
                 eventBlock.sender = "netchannel";
             }
 
-            if (pWorldLine->GetBlock(inv.nHash,eventBlock.data))
+            if (pWorldLine->GetRawBlock(inv.nHash,eventBlock.data.vchData))
             {
                 pPeerNet->DispatchEvent(&eventBlock);
             }
@@ -638,6 +707,20 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerGetData& eventGetData)
                 // TODO: Penalize
             }
         }
+        else if (inv.nType == network::CInv::MSG_CMPCTBLOCK)
+        {
+            network::CMvEventPeerCmpctBlock eventCmpctBlock(nNonce,hashFork);
+            if (BuildCompactBlock(inv.nHash,eventCmpctBlock.data))
+            {
+                pPeerNet->DispatchEvent(&eventCmpctBlock);
+            }
+            else
+            {
+                // blocks are never dropped, a request for an unknown one is bogus
+                DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventGetData");
+                return true;
+            }
+        }
     }
     return true;
 }
@@ -679,14 +762,25 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerTx& eventTx)
     uint64 nNonce = eventTx.nNonce;
     uint256& hashFork = eventTx.hashFork;
     CTransaction& tx = eventTx.data;
+    tx.Seal();
+
+    ForkSchedPtr spForkSched = GetForkSched(hashFork);
+    if (spForkSched == NULL)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventTx");
+        return true;
+    }
+    spForkSched->Post(boost::bind(&CNetChannel::SchedTx,this,nNonce,hashFork,tx,_1));
+    return true;
+}
+
+void CNetChannel::SchedTx(uint64 nNonce,const uint256& hashFork,const CTransaction& tx,CSchedule& sched)
+{
     uint256 txid = tx.GetHash();
 
     try
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-
         set<uint64> setSchedPeer,setMisbehavePeer;
-        CSchedule& sched = GetSchedule(hashFork);
 
         if (!sched.ReceiveTx(nNonce,txid,tx,setSchedPeer))
         {
@@ -729,26 +823,47 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerTx& eventTx)
     {
         DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventTx");
     }
-    return true;
-    
 }
 
 bool CNetChannel::HandleEvent(network::CMvEventPeerBlock& eventBlock)
 {
     uint64 nNonce = eventBlock.nNonce;
     uint256& hashFork = eventBlock.hashFork; 
-    CBlock& block = eventBlock.data;
+    eventBlock.data.Seal();
+
+    ForkSchedPtr spForkSched = GetForkSched(hashFork);
+    if (spForkSched == NULL)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventBlock");
+        return true;
+    }
+    boost::shared_ptr<CBlock> spBlock(new CBlock(std::move(eventBlock.data)));
+    spForkSched->Post(boost::bind(&CNetChannel::SchedBlock,this,nNonce,hashFork,spBlock,_1));
+    return true;
+}
+
+void CNetChannel::SchedBlock(uint64 nNonce,const uint256& hashFork,boost::shared_ptr<CBlock> spBlock,CSchedule& sched)
+{
+    const CBlock& block = *spBlock;
     uint256 hash = block.GetHash();
 
     try
     {
-        boost::recursive_mutex::scoped_lock scoped_lock(mtxSched);
-
         set<uint64> setSchedPeer,setMisbehavePeer;
-        CSchedule& sched = GetSchedule(hashFork);
-        
+
         if (!sched.ReceiveBlock(nNonce,hash,block,setSchedPeer))
         {
+            uint64 nNonceSender = 0;
+            if (sched.ReceiveLate(nNonce,network::CInv(network::CInv::MSG_BLOCK,hash)))
+            {
+                // already re-requested from another peer after this one stalled
+                return;
+            }
+            if (sched.GetBlock(hash,nNonceSender) != NULL || pWorldLine->Exists(hash))
+            {
+                // a stalled peer's copy of a block that another peer delivered first
+                return;
+            }
             throw runtime_error("Failed to receive block");
         }
 
@@ -776,15 +891,212 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerBlock& eventBlock)
     {
         DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventBlock");
     }
-    return true; 
 }
 
-CSchedule& CNetChannel::GetSchedule(const uint256& hashFork)
+bool CNetChannel::HandleEvent(network::CMvEventPeerCmpctBlock& eventCmpctBlock)
+{
+    uint64 nNonce = eventCmpctBlock.nNonce;
+    uint256& hashFork = eventCmpctBlock.hashFork;
+
+    ForkSchedPtr spForkSched = GetForkSched(hashFork);
+    if (spForkSched == NULL)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventCmpctBlock");
+        return true;
+    }
+    boost::shared_ptr<CCompactBlock> spCompact(new CCompactBlock(std::move(eventCmpctBlock.data)));
+    spForkSched->Post(boost::bind(&CNetChannel::SchedCompactBlock,this,nNonce,hashFork,spCompact,_1));
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerGetBlockTxn& eventGetBlockTxn)
+{
+    uint64 nNonce = eventGetBlockTxn.nNonce;
+    const network::CMvEventPeerBlockTxnRequest& request = eventGetBlockTxn.data;
+
+    CBlock block;
+    if (!pWorldLine->GetBlock(request.hashBlock,block))
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventGetBlockTxn");
+        return true;
+    }
+
+    network::CMvEventPeerBlockTxn eventBlockTxn(nNonce,eventGetBlockTxn.hashFork);
+    eventBlockTxn.data.hashBlock = request.hashBlock;
+    if (request.vIndex.size() > block.vtx.size())
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventGetBlockTxn");
+        return true;
+    }
+    eventBlockTxn.data.vtx.reserve(request.vIndex.size());
+    for (const uint32 nIndex : request.vIndex)
+    {
+        if (nIndex >= block.vtx.size())
+        {
+            DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventGetBlockTxn");
+            return true;
+        }
+        eventBlockTxn.data.vtx.push_back(block.vtx[nIndex]);
+    }
+    pPeerNet->DispatchEvent(&eventBlockTxn);
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerBlockTxn& eventBlockTxn)
 {
-    map<uint256,CSchedule>::iterator it = mapSched.find(hashFork);
+    uint64 nNonce = eventBlockTxn.nNonce;
+    uint256& hashFork = eventBlockTxn.hashFork;
+
+    ForkSchedPtr spForkSched = GetForkSched(hashFork);
+    if (spForkSched == NULL)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventBlockTxn");
+        return true;
+    }
+    boost::shared_ptr<network::CMvEventPeerBlockTxnData> spBlockTxn(
+                                    new network::CMvEventPeerBlockTxnData(std::move(eventBlockTxn.data)));
+    spForkSched->Post(boost::bind(&CNetChannel::SchedBlockTxn,this,nNonce,hashFork,spBlockTxn,_1));
+    return true;
+}
+
+void CNetChannel::SchedCompactBlock(uint64 nNonce,const uint256& hashFork,boost::shared_ptr<CCompactBlock> spCompact,CSchedule& sched)
+{
+    try
+    {
+        spCompact->header.Seal();
+        uint256 hash = spCompact->GetHash();
+        // only peers at the tip may push compact blocks, others answer our requests
+        if (pWorldLine->Exists(hash) || !sched.AssignCompactBlock(nNonce,hash,IsCompactBlockPeer(nNonce,hashFork)))
+        {
+            return;
+        }
+
+        CPartialBlock partial;
+        if (!partial.Init(*spCompact))
+        {
+            throw runtime_error("Invalid compact block");
+        }
+
+        vector<uint256> vTxPool;
+        pTxPool->ListTx(hashFork,vTxPool);
+        partial.FillFromPool(vTxPool,boost::bind(&ITxPool::Get,pTxPool,_1,_2));
+        if (partial.IsComplete())
+        {
+            CompleteCompactBlock(nNonce,hashFork,partial,false,sched);
+            return;
+        }
+
+        network::CMvEventPeerGetBlockTxn eventGetBlockTxn(nNonce,hashFork);
+        eventGetBlockTxn.data.hashBlock = hash;
+        partial.GetMissing(eventGetBlockTxn.data.vIndex);
+        if (!sched.AddPartialBlock(nNonce,partial))
+        {
+            // too many blocks under reconstruction already
+            DispatchGetFullBlockEvent(nNonce,hashFork,hash);
+            return;
+        }
+        pPeerNet->DispatchEvent(&eventGetBlockTxn);
+    }
+    catch (...)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventCmpctBlock");
+    }
+}
+
+void CNetChannel::SchedBlockTxn(uint64 nNonce,const uint256& hashFork,
+                                boost::shared_ptr<network::CMvEventPeerBlockTxnData> spBlockTxn,CSchedule& sched)
+{
+    try
+    {
+        CPartialBlock* pPartial = sched.GetPartialBlock(nNonce,spBlockTxn->hashBlock);
+        if (pPartial == NULL)
+        {
+            // the block came in full from elsewhere meanwhile
+            return;
+        }
+        if (!pPartial->FillMissing(spBlockTxn->vtx))
+        {
+            sched.RemovePartialBlock(spBlockTxn->hashBlock);
+            throw runtime_error("Invalid block txn");
+        }
+        CompleteCompactBlock(nNonce,hashFork,*pPartial,true,sched);
+    }
+    catch (...)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK,"eventBlockTxn");
+    }
+}
+
+void CNetChannel::CompleteCompactBlock(uint64 nNonce,const uint256& hashFork,const CPartialBlock& partial,
+                                       bool fBlockTxn,CSchedule& sched)
+{
+    uint256 hash = partial.GetHash();
+    boost::shared_ptr<CBlock> spBlock(new CBlock);
+    bool fMatched = partial.GetBlock(*spBlock);
+    sched.RemovePartialBlock(hash);
+    if (!fMatched && fBlockTxn)
+    {
+        // the peer filled the gaps with txs that do not hash to the root,
+        // dropping it hands the block to the other peers that announced it
+        throw runtime_error("Block txn does not match the merkle root");
+    }
+    if (!fMatched)
+    {
+        // a short id picked the wrong pool tx, the peer stays assigned for the full block
+        DispatchGetFullBlockEvent(nNonce,hashFork,hash);
+        return;
+    }
+    spBlock->Seal();
+    SchedBlock(nNonce,hashFork,spBlock,sched);
+}
+
+bool CNetChannel::IsCompactBlockPeer(uint64 nNonce,const uint256& hashFork) const
+{
+    // blocks between super nodes go over dbp and are always sent in full
+    return (nodeType != NODE_TYPE::NODE_TYPE_FORK && !IsSuperNodeInnerNonce(nNonce)
+            && conPeerNetData.IsCompactBlockPeer(nNonce,hashFork));
+}
+
+bool CNetChannel::BuildCompactBlock(const uint256& hashBlock,CCompactBlock& compact)
+{
+    CBlock block;
+    if (!pWorldLine->GetBlock(hashBlock,block))
+    {
+        return false;
+    }
+    compact.Build(block,crypto::CryptoGetRand64());
+    return true;
+}
+
+void CNetChannel::SchedStalledBlock(const uint256& hashFork,int64 nNow,CSchedule& sched)
+{
+    set<uint64> setSchedPeer;
+    sched.ReassignStalledBlock(nNow,BLOCK_STALL_TIMEOUT,setSchedPeer);
+
+    for(const uint64 nNonceSched : setSchedPeer)
+    {
+        SchedulePeerInv(nNonceSched,hashFork,sched);
+    }
+}
+
+void CNetChannel::SchedRemovePeer(uint64 nNonce,const uint256& hashFork,CSchedule& sched)
+{
+    set<uint64> setSchedPeer;
+    sched.RemovePeer(nNonce,setSchedPeer);
+
+    for(const uint64 nNonceSched : setSchedPeer)
+    {
+        SchedulePeerInv(nNonceSched,hashFork,sched);
+    }
+}
+
+CNetChannel::ForkSchedPtr CNetChannel::GetForkSched(const uint256& hashFork) const
+{
+    boost::shared_lock<boost::shared_mutex> rlock(rwSched);
+    map<uint256,ForkSchedPtr>::const_iterator it = mapSched.find(hashFork);
     if (it == mapSched.end())
     {
-        throw runtime_error("Unknown fork for scheduling.");
+        return ForkSchedPtr();
     }
     return ((*it).second);
 }
@@ -807,6 +1119,24 @@ void CNetChannel::DispatchGetBlocksEvent(uint64 nNonce,const uint256& hashFork)
     }
 }
 
+void CNetChannel::DispatchGetBlocksEvent(uint64 nNonce,const uint256& hashFork,const uint256& hashContinue)
+{
+    network::CMvEventPeerGetBlocks eventGetBlocks(nNonce,hashFork);
+    if (pWorldLine->GetBlockLocator(hashFork,eventGetBlocks.data))
+    {
+        vector<uint256>& vBlockHash = eventGetBlocks.data.vBlockHash;
+        vBlockHash.insert(vBlockHash.begin(),hashContinue);
+        pPeerNet->DispatchEvent(&eventGetBlocks);
+    }
+}
+
+void CNetChannel::DispatchGetFullBlockEvent(uint64 nNonce,const uint256& hashFork,const uint256& hashBlock)
+{
+    network::CMvEventPeerGetData eventGetData(nNonce,hashFork);
+    eventGetData.data.push_back(network::CInv(network::CInv::MSG_BLOCK,hashBlock));
+    pPeerNet->DispatchEvent(&eventGetData);
+}
+
 void CNetChannel::DispatchAwardEvent(uint64 nNonce,CEndpointManager::Bonus bonus)
 {
     CWalleveEventPeerNetReward eventReward(nNonce);
@@ -831,8 +1161,20 @@ void CNetChannel::SchedulePeerInv(uint64 nNonce,const uint256& hashFork,CSchedul
     network::CMvEventPeerGetData eventGetData(nNonce,hashFork);
     bool fMissingPrev = false;
     bool fEmpty = true;
+    // a peer that was at the tip likely relays blocks whose txs are already in our pool
+    bool fCompact = IsCompactBlockPeer(nNonce,hashFork);
     if (sched.ScheduleBlockInv(nNonce,eventGetData.data,MAX_PEER_SCHED_COUNT,fMissingPrev,fEmpty))
     {
+        if (fCompact)
+        {
+            for (network::CInv& inv : eventGetData.data)
+            {
+                if (inv.nType == network::CInv::MSG_BLOCK)
+                {
+                    inv.nType = network::CInv::MSG_CMPCTBLOCK;
+                }
+            }
+        }
         if (fMissingPrev)
         {
             DispatchGetBlocksEvent(nNonce,hashFork);
@@ -861,9 +1203,15 @@ void CNetChannel::SchedulePeerInv(uint64 nNonce,const uint256& hashFork,CSchedul
     {
         pPeerNet->DispatchEvent(&eventGetData);
     }
+
+    uint256 hashContinue;
+    if (sched.GetBlockInvContinue(nNonce,MAX_GETBLOCKS_COUNT,hashContinue))
+    {
+        DispatchGetBlocksEvent(nNonce,hashFork,hashContinue);
+    }
 }
 
-bool CNetChannel::GetMissingPrevTx(CTransaction& tx,set<uint256>& setMissingPrevTx)
+bool CNetChannel::GetMissingPrevTx(const CTransaction& tx,set<uint256>& setMissingPrevTx)
 {
     setMissingPrevTx.clear();
     for(const CTxIn& txin : tx.vInput)
@@ -930,37 +1278,57 @@ void CNetChannel::AddNewBlock(const uint256& hashFork,const uint256& hash,CSched
 void CNetChannel::AddNewTx(const uint256& hashFork,const uint256& txid,CSchedule& sched,
                            set<uint64>& setSchedPeer,set<uint64>& setMisbehavePeer)
 {
+    if (pWorldLine->ExistsTx(txid))
+    {
+        return;
+    }
+
     set<uint256> setTx;
     vector<uint256> vtx;
 
     vtx.push_back(txid);
     int nAddNewTx = 0;
-    for (size_t i = 0;i < vtx.size();i++)
+    // each round hands the txs released by the previous one to the dispatcher as one batch
+    for (size_t nRound = 0;nRound < vtx.size();)
     {
-        uint256 hashTx = vtx[i];
-        uint64 nNonceSender = 0;
-        CTransaction *pTx = sched.GetTransaction(hashTx,nNonceSender);
-        if (pTx != NULL)
+        vector<uint256> vHashTx;
+        vector<CTransaction> vBatchTx;
+        vector<uint64> vNonceSender;
+        for (;nRound < vtx.size();nRound++)
         {
-            if (pWorldLine->ExistsTx(txid))
+            uint64 nNonceSender = 0;
+            CTransaction *pTx = sched.GetTransaction(vtx[nRound],nNonceSender);
+            if (pTx != NULL)
             {
-                return;
+                vHashTx.push_back(vtx[nRound]);
+                vBatchTx.push_back(*pTx);
+                vNonceSender.push_back(nNonceSender);
             }
+        }
 
-            MvErr err = pDispatcher->AddNewTx(*pTx,nNonceSender);
-            if (err == MV_OK)
+        vector<MvErr> vErr;
+        pDispatcher->AddNewTxBatch(vBatchTx,vNonceSender,vErr);
+        for (size_t i = 0;i < vHashTx.size();i++)
+        {
+            const uint256& hashTx = vHashTx[i];
+            if (vErr[i] == MV_OK)
             {
                 sched.GetNextTx(hashTx,vtx,setTx);
                 sched.RemoveInv(network::CInv(network::CInv::MSG_TX,hashTx),setSchedPeer);
                 
-                if(!IsSuperNodeInnerNonce(nNonceSender))
+                if(!IsSuperNodeInnerNonce(vNonceSender[i]))
                 {
-                    DispatchAwardEvent(nNonceSender,CEndpointManager::MAJOR_DATA);
+                    DispatchAwardEvent(vNonceSender[i],CEndpointManager::MAJOR_DATA);
                 }
 
                 nAddNewTx++;
             }
-            else if (err != MV_ERR_MISSING_PREV)
+            else if (vErr[i] == MV_ERR_TRANSACTION_EVICTED)
+            {
+                // valid but outbid while the pool is full, the announcing peers did nothing wrong
+                sched.RemoveInv(network::CInv(network::CInv::MSG_TX,hashTx),setSchedPeer);
+            }
+            else if (vErr[i] != MV_ERR_MISSING_PREV)
             {
                 sched.InvalidateTx(hashTx,setMisbehavePeer);
             }
@@ -1016,6 +1384,30 @@ void CNetChannel::SetPeerSyncStatus(uint64 nNonce,const uint256& hashFork,bool f
     }
 }
 
+void CNetChannel::StallTimerFunc(uint32 nTimerId)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mtxStallTimer);
+        if (nTimerStall != nTimerId)
+        {
+            return;
+        }
+        nTimerStall = WalleveSetTimer(SCHED_STALL_CHECK,boost::bind(&CNetChannel::StallTimerFunc,this,_1));
+    }
+
+    // Post may run the check inline, so it is called without the timer lock
+    vector<pair<uint256,ForkSchedPtr> > vForkSched;
+    {
+        boost::shared_lock<boost::shared_mutex> rlock(rwSched);
+        vForkSched.assign(mapSched.begin(),mapSched.end());
+    }
+    int64 nNow = GetTimeMillis();
+    for (size_t i = 0;i < vForkSched.size();i++)
+    {
+        vForkSched[i].second->Post(boost::bind(&CNetChannel::SchedStalledBlock,this,vForkSched[i].first,nNow,_1));
+    }
+}
+
 void CNetChannel::PushTxTimerFunc(uint32 nTimerId)
 {
     boost::unique_lock<boost::mutex> lock(mtxPushTx);
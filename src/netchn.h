@@ -10,6 +10,8 @@
 #include "virtualpeernetevent.h"
 #include "mvbase.h"
 #include "schedule.h"
+#include "scheddomain.h"
+#include <boost/shared_ptr.hpp>
 
 namespace multiverse
 {
@@ -48,6 +50,11 @@ public:
         mapSubscribedFork.erase(hashFork);
     }
     bool IsSubscribed(const uint256& hashFork) const { return (!!mapSubscribedFork.count(hashFork)); }
+    // the peer takes compact blocks and is at the tip of the fork
+    bool IsCompactBlockPeer(const uint256& hashFork) const
+    {
+        return ((nService & network::NODE_COMPACTBLOCK) && IsSynchronized(hashFork));
+    }
     void MakeTxInv(const uint256& hashFork,const std::vector<uint256>& vTxPool,
                                            std::vector<network::CInv>& vInv,std::size_t nMaxCount);
 public:
@@ -76,6 +83,7 @@ public:
     void DeletePeerUnSyncByFork(uint64 nNonce, const uint256& hashFork);
     void InsertPeerUnSyncByFork(uint64 nNonce, const uint256& hashFork);
     bool IsPeerEmpty();
+    bool IsCompactBlockPeer(uint64 nNonce, const uint256& hashFork) const;
     void MakeTxInvByFork(const uint256& hashFork, const std::vector<uint256>& vTxPool, std::vector<std::pair<uint64,VecInv>>& InvData);
 private:
     mutable boost::shared_mutex rwPeer;
@@ -87,6 +95,9 @@ private:
 class CNetChannel : public network::IMvNetChannel
 {
 public:
+    typedef CSchedDomain<CSchedule> CForkSched;
+    typedef boost::shared_ptr<CForkSched> ForkSchedPtr;
+
     enum class NODE_TYPE : int
     {
         NODE_TYPE_UNKN,
@@ -124,14 +135,32 @@ protected:
     bool HandleEvent(network::CMvEventPeerGetBlocks& eventGetBlocks) override;
     bool HandleEvent(network::CMvEventPeerTx& eventTx) override;
     bool HandleEvent(network::CMvEventPeerBlock& eventBlock) override;
-
-    CSchedule& GetSchedule(const uint256& hashFork);
+    bool HandleEvent(network::CMvEventPeerCmpctBlock& eventCmpctBlock) override;
+    bool HandleEvent(network::CMvEventPeerGetBlockTxn& eventGetBlockTxn) override;
+    bool HandleEvent(network::CMvEventPeerBlockTxn& eventBlockTxn) override;
+
+    ForkSchedPtr GetForkSched(const uint256& hashFork) const;
+    void SchedInv(uint64 nNonce,const uint256& hashFork,const std::vector<network::CInv>& vInv,CSchedule& sched);
+    void SchedTx(uint64 nNonce,const uint256& hashFork,const CTransaction& tx,CSchedule& sched);
+    void SchedBlock(uint64 nNonce,const uint256& hashFork,boost::shared_ptr<CBlock> spBlock,CSchedule& sched);
+    void SchedCompactBlock(uint64 nNonce,const uint256& hashFork,boost::shared_ptr<CCompactBlock> spCompact,CSchedule& sched);
+    void SchedBlockTxn(uint64 nNonce,const uint256& hashFork,
+                       boost::shared_ptr<network::CMvEventPeerBlockTxnData> spBlockTxn,CSchedule& sched);
+    void CompleteCompactBlock(uint64 nNonce,const uint256& hashFork,const CPartialBlock& partial,
+                              bool fBlockTxn,CSchedule& sched);
+    bool IsCompactBlockPeer(uint64 nNonce,const uint256& hashFork) const;
+    bool BuildCompactBlock(const uint256& hashBlock,CCompactBlock& compact);
+    void SchedRemovePeer(uint64 nNonce,const uint256& hashFork,CSchedule& sched);
+    void SchedStalledBlock(const uint256& hashFork,int64 nNow,CSchedule& sched);
+    void SchedBroadcastBlockInv(const uint256& hashFork,const uint256& hashBlock,CSchedule& sched);
     void NotifyPeerUpdate(uint64 nNonce,bool fActive,const network::CAddress& addrPeer);
     void DispatchGetBlocksEvent(uint64 nNonce,const uint256& hashFork);
+    void DispatchGetBlocksEvent(uint64 nNonce,const uint256& hashFork,const uint256& hashContinue);
+    void DispatchGetFullBlockEvent(uint64 nNonce,const uint256& hashFork,const uint256& hashBlock);
     void DispatchAwardEvent(uint64 nNonce,walleve::CEndpointManager::Bonus bonus);
     void DispatchMisbehaveEvent(uint64 nNonce,walleve::CEndpointManager::CloseReason reason,const std::string& strCaller = "");
     void SchedulePeerInv(uint64 nNonce,const uint256& hashFork,CSchedule& sched);
-    bool GetMissingPrevTx(CTransaction& tx,std::set<uint256>& setMissingPrevTx);
+    bool GetMissingPrevTx(const CTransaction& tx,std::set<uint256>& setMissingPrevTx);
     void AddNewBlock(const uint256& hashFork,const uint256& hash,CSchedule& sched,
                      std::set<uint64>& setSchedPeer,std::set<uint64>& setMisbehavePeer);
     void AddNewTx(const uint256& hashFork,const uint256& txid,CSchedule& sched,
@@ -141,6 +170,7 @@ protected:
     void SetPeerSyncStatus(uint64 nNonce,const uint256& hashFork,bool fSync);
 
     void PushTxTimerFunc(uint32 nTimerId);
+    void StallTimerFunc(uint32 nTimerId);
     bool PushTxInv(const uint256& hashFork);
 protected:
     network::CMvPeerNet* pPeerNet;
@@ -150,8 +180,9 @@ protected:
     IDispatcher* pDispatcher;
     IService *pService;
     
-    mutable boost::recursive_mutex mtxSched; 
-    std::map<uint256,CSchedule> mapSched; 
+    // guards the fork map only, each fork's CSchedule is touched through its own domain
+    mutable boost::shared_mutex rwSched;
+    std::map<uint256,ForkSchedPtr> mapSched;
 
     CConcurrentPeerNetData conPeerNetData;
 
@@ -159,6 +190,9 @@ protected:
     uint32 nTimerPushTx;
     std::set<uint256> setPushTxFork;
 
+    mutable boost::mutex mtxStallTimer;
+    uint32 nTimerStall;
+
     NODE_TYPE nodeType;
 };
 
@@ -25,7 +25,9 @@ CNetwork::~CNetwork()
 
 bool CNetwork::WalleveHandleInitialize()
 {
-    Configure(NetworkConfig()->nMagicNum,PROTO_VERSION,network::NODE_NETWORK | network::NODE_DELEGATED,
+    Configure(NetworkConfig()->nMagicNum,PROTO_VERSION,
+              network::NODE_NETWORK | network::NODE_DELEGATED | network::NODE_FASTCHECKSUM
+                  | network::NODE_COMPACTBLOCK,
               FormatSubVersion(),NetworkConfig()->pathRoot.generic_string(),
               !NetworkConfig()->vConnectTo.empty(), NetworkConfig()->nodeKey);
 
@@ -378,6 +378,7 @@ CRPCModWorker::CRPCModWorker(const uint nThreadIn, const bool fAffinity)
         {"gettransaction",        &CRPCModWorker::RPCGetTransaction},
         {"sendtransaction",       &CRPCModWorker::RPCSendTransaction},
         {"getforkheight",         &CRPCModWorker::RPCGetForkHeight},
+        {"getstoragestat",        &CRPCModWorker::RPCGetStorageStat},
         /* Wallet */
         {"listkey",               &CRPCModWorker::RPCListKey},
         {"getnewkey",             &CRPCModWorker::RPCGetNewKey},
@@ -618,6 +619,8 @@ CRPCResultPtr CRPCModWorker::RPCListPeer(CRPCParamPtr param)
         peer.fInbound = info.fInBound;
         peer.nHeight = info.nStartingHeight;
         peer.nBanscore = info.nScore;
+        peer.fBlockrate = info.dBlockRate;
+        peer.fBlockmbrate = info.dByteRate / (1024 * 1024);
         spResult->vecPeer.push_back(peer);
     }
 
@@ -826,6 +829,11 @@ CRPCResultPtr CRPCModWorker::RPCGetTxPool(CRPCParamPtr param)
         }
         spResult->nCount = vTxPool.size();
         spResult->nSize = nTotalSize;
+
+        size_t nForkUsage,nTotalUsage;
+        pService->GetTxPoolMemory(hashFork,nForkUsage,nTotalUsage);
+        spResult->nMemory = nForkUsage;
+        spResult->nTotalmemory = nTotalUsage;
     }
     else
     {
@@ -912,6 +920,52 @@ CRPCResultPtr CRPCModWorker::RPCGetForkHeight(CRPCParamPtr param)
     return MakeCGetForkHeightResultPtr(pService->GetForkHeight(hashFork));
 }
 
+CRPCResultPtr CRPCModWorker::RPCGetStorageStat(CRPCParamPtr param)
+{
+    auto spParam = CastParamPtr<CGetStorageStatParam>(param);
+
+    //getstoragestat
+    CStorageStatus status;
+    pService->GetStorageStatus(status);
+
+    auto spResult = MakeCGetStorageStatResultPtr();
+    spResult->txfilter.fEnabled = status.fTxFilterEnabled;
+    spResult->txfilter.nCapacity = status.nTxFilterCapacity;
+    spResult->txfilter.nCount = status.nTxFilterCount;
+    spResult->txfilter.nMemory = status.nTxFilterMemory;
+    spResult->txfilter.nQuery = status.nTxFilterQuery;
+    spResult->txfilter.nReject = status.nTxFilterReject;
+    spResult->txfilter.nFalsepositive = status.nTxFilterFalsePositive;
+    uint64 nNegative = status.nTxFilterFalsePositive + status.nTxFilterReject;
+    spResult->txfilter.fFprate = (nNegative != 0 ? (double)status.nTxFilterFalsePositive / nNegative : 0.0);
+
+    spResult->flush.nCount = status.nFlushCount;
+    spResult->flush.nLasttime = status.nFlushLastTime;
+    spResult->flush.nMaxtime = status.nFlushMaxTime;
+    spResult->flush.nTotaltime = status.nFlushTotalTime;
+    spResult->flush.nBatchsize = status.nFlushBatchSize;
+    spResult->flush.nBatchdb = status.nFlushBatchDB;
+
+    spResult->consistency.fRunning = status.fConsistencyRunning;
+    spResult->consistency.fPassed = status.fConsistencyPassed;
+    spResult->consistency.nLevel = status.nConsistencyLevel;
+    spResult->consistency.nDepth = status.nConsistencyDepth;
+    spResult->consistency.nForks = status.nConsistencyForkCount;
+    spResult->consistency.nForkschecked = status.nConsistencyForkChecked;
+    spResult->consistency.nBlocks = status.nConsistencyBlockChecked;
+    spResult->consistency.nErrors = status.nConsistencyErrorCount;
+    for (const string& strFinding : status.vConsistencyFinding)
+    {
+        spResult->consistency.vecFindings.push_back(strFinding);
+    }
+
+    spResult->templatecache.nCapacity = status.nTemplateCacheCapacity;
+    spResult->templatecache.nCount = status.nTemplateCacheCount;
+    spResult->templatecache.nHit = status.nTemplateCacheHit;
+    spResult->templatecache.nMiss = status.nTemplateCacheMiss;
+    return spResult;
+}
+
 /* Wallet */
 CRPCResultPtr CRPCModWorker::RPCListKey(CRPCParamPtr param)
 {
@@ -153,6 +153,7 @@ private:
     rpc::CRPCResultPtr RPCGetTransaction(rpc::CRPCParamPtr param);
     rpc::CRPCResultPtr RPCSendTransaction(rpc::CRPCParamPtr param);
     rpc::CRPCResultPtr RPCGetForkHeight(rpc::CRPCParamPtr param);
+    rpc::CRPCResultPtr RPCGetStorageStat(rpc::CRPCParamPtr param);
     /* Wallet */
     rpc::CRPCResultPtr RPCListKey(rpc::CRPCParamPtr param);
     rpc::CRPCResultPtr RPCGetNewKey(rpc::CRPCParamPtr param);
@@ -0,0 +1,80 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_SCHEDDOMAIN_H
+#define  MULTIVERSE_SCHEDDOMAIN_H
+
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace multiverse
+{
+
+// Serialized work queue around one fork's scheduling state.
+// The thread posting into an idle domain runs the queued work until it is empty,
+// threads posting into a busy domain only enqueue and return, so a slow fork never
+// blocks event threads that have work for other forks.
+template <typename T>
+class CSchedDomain
+{
+public:
+    typedef boost::function<void (T&)> Work;
+public:
+    CSchedDomain() : fRunning(false) {}
+    T& GetState() { return state; }
+    std::size_t GetPending() const
+    {
+        boost::unique_lock<boost::mutex> lock(mtxWork);
+        return queWork.size();
+    }
+    void Post(const Work& work)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mtxWork);
+            queWork.push_back(work);
+            if (fRunning)
+            {
+                return;
+            }
+            fRunning = true;
+        }
+        Run();
+    }
+protected:
+    void Run()
+    {
+        for (;;)
+        {
+            Work work;
+            {
+                boost::unique_lock<boost::mutex> lock(mtxWork);
+                if (queWork.empty())
+                {
+                    fRunning = false;
+                    return;
+                }
+                work.swap(queWork.front());
+                queWork.pop_front();
+            }
+            try
+            {
+                work(state);
+            }
+            catch (...)
+            {
+                // work items report their own errors, keep the domain draining
+            }
+        }
+    }
+protected:
+    mutable boost::mutex mtxWork;
+    std::deque<Work> queWork;
+    bool fRunning;
+    T state;
+};
+
+} // namespace multiverse
+
+#endif //MULTIVERSE_SCHEDDOMAIN_H
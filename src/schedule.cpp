@@ -18,21 +18,16 @@ size_t COrphan::GetSize()
 void COrphan::AddNew(const uint256& prev,const uint256& hash)
 {
     mapOrphanByPrev.insert(make_pair(prev,hash));
+    mapPrevByOrphan.insert(make_pair(hash,prev));
 }
 
 void COrphan::Remove(const uint256& hash)
 {
-    multimap<uint256,uint256>::iterator it = mapOrphanByPrev.begin();
-    while(it != mapOrphanByPrev.end())
+    multimap<uint256,uint256>::iterator it = mapPrevByOrphan.lower_bound(hash);
+    while (it != mapPrevByOrphan.end() && (*it).first == hash)
     {
-        if ((*it).second == hash)
-        {
-            mapOrphanByPrev.erase(it++);
-        }
-        else
-        {
-            ++it;
-        }
+        RemoveByPrev((*it).second,hash);
+        mapPrevByOrphan.erase(it++);
     }
 }
 
@@ -59,7 +54,24 @@ void COrphan::GetNext(const uint256& prev,vector<uint256>& vNext,set<uint256>& s
 
 void COrphan::RemoveNext(const uint256& prev)
 {
-    mapOrphanByPrev.erase(prev);
+    multimap<uint256,uint256>::iterator it = mapOrphanByPrev.lower_bound(prev);
+    while (it != mapOrphanByPrev.end() && (*it).first == prev)
+    {
+        const uint256& hash = (*it).second;
+        multimap<uint256,uint256>::iterator mi = mapPrevByOrphan.lower_bound(hash);
+        while (mi != mapPrevByOrphan.end() && (*mi).first == hash)
+        {
+            if ((*mi).second == prev)
+            {
+                mapPrevByOrphan.erase(mi++);
+            }
+            else
+            {
+                ++mi;
+            }
+        }
+        mapOrphanByPrev.erase(it++);
+    }
 }
 
 void COrphan::RemoveBranch(const uint256& root,std::vector<uint256>& vBranch)
@@ -67,13 +79,29 @@ void COrphan::RemoveBranch(const uint256& root,std::vector<uint256>& vBranch)
     set<uint256>setBranch;
     vBranch.reserve(mapOrphanByPrev.size());
     GetNext(root,vBranch,setBranch);
-    mapOrphanByPrev.erase(root);
+    RemoveNext(root);
 
     for (size_t i = 0;i < vBranch.size();i++)
     {
         uint256 hash = vBranch[i];
         GetNext(hash,vBranch,setBranch);
-        mapOrphanByPrev.erase(hash);
+        RemoveNext(hash);
+    }
+}
+
+void COrphan::RemoveByPrev(const uint256& prev,const uint256& hash)
+{
+    multimap<uint256,uint256>::iterator it = mapOrphanByPrev.lower_bound(prev);
+    while (it != mapOrphanByPrev.end() && (*it).first == prev)
+    {
+        if ((*it).second == hash)
+        {
+            mapOrphanByPrev.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
     }
 }
 
@@ -119,6 +147,19 @@ void CSchedule::RemovePeer(uint64 nPeerNonce,set<uint64>& setSchedPeer)
         }
         mapPeer.erase(it);
     }
+
+    map<uint256,pair<uint64,CPartialBlock> >::iterator mi = mapPartialBlock.begin();
+    while (mi != mapPartialBlock.end())
+    {
+        if ((*mi).second.first == nPeerNonce)
+        {
+            mapPartialBlock.erase(mi++);
+        }
+        else
+        {
+            ++mi;
+        }
+    }
 }
 
 void CSchedule::AddNewInv(const network::CInv& inv,uint64 nPeerNonce)
@@ -148,6 +189,10 @@ void CSchedule::RemoveInv(const network::CInv& inv,set<uint64>& setKnownPeer)
         setKnownPeer.insert((*it).second.setKnownPeer.begin(),(*it).second.setKnownPeer.end());
         mapState.erase(it);
     }
+    if (inv.nType == network::CInv::MSG_BLOCK)
+    {
+        mapPartialBlock.erase(inv.nHash);
+    }
 }
 
 bool CSchedule::ReceiveBlock(uint64 nPeerNonce,const uint256& hash,const CBlock& block,set<uint64>& setSchedPeer)
@@ -159,18 +204,42 @@ bool CSchedule::ReceiveBlock(uint64 nPeerNonce,const uint256& hash,const CBlock&
 
         if(!walleve::IsSuperNodeInnerNonce(nPeerNonce))
         {
-            if (state.nAssigned == nPeerNonce && !state.IsReceived())
+            map<uint64,CInvPeer>::iterator mi = mapPeer.find(nPeerNonce);
+            if (mi == mapPeer.end() || state.IsReceived())
             {
-                state.objReceived = block;
-                setSchedPeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
-                mapPeer[nPeerNonce].Completed((*it).first);
-                return true;
+                return false;
             }
+            CInvPeer& peer = (*mi).second;
+            if (state.nAssigned == nPeerNonce)
+            {
+                peer.Completed((*it).first);
+                peer.IncreaseWindow();
+            }
+            else if (peer.IsLate(hash))
+            {
+                // the stalled peer came through first, take its copy and drop the re-request
+                if (state.nAssigned != 0)
+                {
+                    mapPeer[state.nAssigned].Completed((*it).first);
+                }
+                state.nAssigned = nPeerNonce;
+            }
+            else
+            {
+                return false;
+            }
+            peer.nLastBlockTime = walleve::GetTimeMillis();
+            ClearLate((*it).first,state);
+            state.objReceived = block;
+            setSchedPeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
+            mapPartialBlock.erase(hash);
+            return true;
         }
         else
         {
             if(!state.IsReceived())
             {
+                ClearLate((*it).first,state);
                 state.objReceived = block;
                 setSchedPeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
                 mapPeer[state.nAssigned].Completed((*it).first);
@@ -212,6 +281,12 @@ bool CSchedule::ReceiveTx(uint64 nPeerNonce,const uint256& txid,const CTransacti
     return false;
 }
 
+bool CSchedule::ReceiveLate(uint64 nPeerNonce,const network::CInv& inv)
+{
+    map<uint64,CInvPeer>::iterator it = mapPeer.find(nPeerNonce);
+    return (it != mapPeer.end() && (*it).second.setLate.erase(inv.nHash) != 0);
+}
+
 CBlock* CSchedule::GetBlock(const uint256& hash,uint64& nNonceSender)
 {
     map<network::CInv,CInvState>::iterator it = mapState.find(network::CInv(network::CInv::MSG_BLOCK,hash));
@@ -316,11 +391,14 @@ bool CSchedule::ScheduleBlockInv(uint64 nPeerNonce,vector<network::CInv>& vInv,s
     {
         CInvPeer& peer = (*it).second;
         fEmpty = peer.Empty(network::CInv::MSG_BLOCK); 
-        if (!peer.IsAssigned())
+        // keep up to the peer's window of blocks in flight instead of waiting for each batch
+        size_t nInFlight = peer.GetAssigned(network::CInv::MSG_BLOCK).size();
+        if (nInFlight < peer.nBlockWindow)
         {
             bool fReceivedAll;
+            size_t nCount = min(nMaxCount,peer.nBlockWindow - nInFlight);
         
-            if (!ScheduleKnownInv(nPeerNonce,peer,network::CInv::MSG_BLOCK,vInv,nMaxCount,fReceivedAll))
+            if (!ScheduleKnownInv(nPeerNonce,peer,network::CInv::MSG_BLOCK,vInv,nCount,fReceivedAll))
             {
                 fMissingPrev = fReceivedAll;
                 return (!fReceivedAll || peer.GetCount(network::CInv::MSG_BLOCK) < MAX_PEER_BLOCK_INV_COUNT);
@@ -347,6 +425,138 @@ bool CSchedule::ScheduleTxInv(uint64 nPeerNonce,vector<network::CInv>& vInv,size
     return true;
 }
 
+void CSchedule::ReassignStalledBlock(int64 nNow,int64 nTimeout,set<uint64>& setSchedPeer)
+{
+    for (map<uint64,CInvPeer>::iterator it = mapPeer.begin();it != mapPeer.end();++it)
+    {
+        CInvPeer& peer = (*it).second;
+        set<uint256>& setAssigned = peer.GetAssigned(network::CInv::MSG_BLOCK);
+        if (setAssigned.empty() || nNow - peer.nLastBlockTime < nTimeout)
+        {
+            continue;
+        }
+
+        vector<network::CInv> vStalled;
+        for (const uint256& hash : setAssigned)
+        {
+            network::CInv inv(network::CInv::MSG_BLOCK,hash);
+            map<network::CInv,CInvState>::iterator mi = mapState.find(inv);
+            if (mi != mapState.end() && !(*mi).second.IsReceived()
+                && nNow - (*mi).second.nAssignTime >= nTimeout && (*mi).second.setKnownPeer.size() > 1)
+            {
+                vStalled.push_back(inv);
+            }
+        }
+
+        for (const network::CInv& inv : vStalled)
+        {
+            CInvState& state = mapState[inv];
+            state.nAssigned = 0;
+            peer.Relieve(inv);
+            for (const uint64 nNonce : state.setKnownPeer)
+            {
+                if (nNonce != (*it).first)
+                {
+                    setSchedPeer.insert(nNonce);
+                }
+            }
+        }
+        if (!vStalled.empty())
+        {
+            peer.DecreaseWindow();
+        }
+    }
+}
+
+void CSchedule::SetBlockInvContinue(uint64 nPeerNonce,const uint256& hash)
+{
+    map<uint64,CInvPeer>::iterator it = mapPeer.find(nPeerNonce);
+    if (it != mapPeer.end())
+    {
+        (*it).second.hashInvContinue = hash;
+    }
+}
+
+bool CSchedule::GetBlockInvContinue(uint64 nPeerNonce,size_t nBatchCount,uint256& hash)
+{
+    map<uint64,CInvPeer>::iterator it = mapPeer.find(nPeerNonce);
+    if (it != mapPeer.end())
+    {
+        CInvPeer& peer = (*it).second;
+        if (peer.hashInvContinue != uint64(0)
+            && peer.GetCount(network::CInv::MSG_BLOCK) + nBatchCount <= MAX_PEER_BLOCK_INV_COUNT)
+        {
+            hash = peer.hashInvContinue;
+            peer.hashInvContinue = uint64(0);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CSchedule::AssignCompactBlock(uint64 nPeerNonce,const uint256& hash,bool fUnsolicited)
+{
+    // a requested compact block answers our getdata. A pushed one stands for the inv and the
+    // getdata of its block, unless the block is already requested from another peer
+    network::CInv inv(network::CInv::MSG_BLOCK,hash);
+    map<network::CInv,CInvState>::iterator it = mapState.find(inv);
+    if (it != mapState.end() && (*it).second.nAssigned == nPeerNonce && !(*it).second.IsReceived())
+    {
+        return true;
+    }
+    if (!fUnsolicited)
+    {
+        return false;
+    }
+    AddNewInv(inv,nPeerNonce);
+    it = mapState.find(inv);
+    if (it == mapState.end() || !(*it).second.setKnownPeer.count(nPeerNonce) || (*it).second.IsReceived()
+        || (*it).second.nAssigned != 0)
+    {
+        return false;
+    }
+    CInvState& state = (*it).second;
+    state.nAssigned = nPeerNonce;
+    state.nAssignTime = walleve::GetTimeMillis();
+    mapPeer[nPeerNonce].Assign(inv);
+    return true;
+}
+
+bool CSchedule::AddPartialBlock(uint64 nPeerNonce,const CPartialBlock& partial)
+{
+    uint256 hash = partial.GetHash();
+    if (mapPartialBlock.size() >= MAX_PARTIAL_BLOCK_COUNT && !mapPartialBlock.count(hash))
+    {
+        return false;
+    }
+    // one slow peer must not hold the slots of the others
+    size_t nPeerCount = 0;
+    for (map<uint256,pair<uint64,CPartialBlock> >::iterator it = mapPartialBlock.begin();it != mapPartialBlock.end();++it)
+    {
+        if ((*it).second.first == nPeerNonce && (*it).first != hash && ++nPeerCount >= MAX_PEER_PARTIAL_BLOCK_COUNT)
+        {
+            return false;
+        }
+    }
+    mapPartialBlock[hash] = make_pair(nPeerNonce,partial);
+    return true;
+}
+
+CPartialBlock* CSchedule::GetPartialBlock(uint64 nPeerNonce,const uint256& hash)
+{
+    map<uint256,pair<uint64,CPartialBlock> >::iterator it = mapPartialBlock.find(hash);
+    if (it != mapPartialBlock.end() && (*it).second.first == nPeerNonce)
+    {
+        return &(*it).second.second;
+    }
+    return NULL;
+}
+
+void CSchedule::RemovePartialBlock(const uint256& hash)
+{
+    mapPartialBlock.erase(hash);
+}
+
 void CSchedule::RemoveOrphan(const network::CInv& inv)
 {
     if (inv.nType == network::CInv::MSG_TX)
@@ -359,6 +569,31 @@ void CSchedule::RemoveOrphan(const network::CInv& inv)
     }
 }
 
+void CSchedule::ClearLate(const network::CInv& inv,const CInvState& state)
+{
+    for (const uint64 nNonce : state.setKnownPeer)
+    {
+        map<uint64,CInvPeer>::iterator it = mapPeer.find(nNonce);
+        if (it != mapPeer.end())
+        {
+            (*it).second.setLate.erase(inv.nHash);
+        }
+    }
+}
+
+bool CSchedule::IsLateOnly(const uint256& hash,const CInvState& state)
+{
+    for (const uint64 nNonce : state.setKnownPeer)
+    {
+        map<uint64,CInvPeer>::iterator it = mapPeer.find(nNonce);
+        if (it != mapPeer.end() && !(*it).second.IsLate(hash))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool CSchedule::ScheduleKnownInv(uint64 nPeerNonce,CInvPeer& peer,uint32 type,
                                  vector<network::CInv>& vInv,size_t nMaxCount,bool& fReceivedAll)
 {
@@ -369,9 +604,12 @@ bool CSchedule::ScheduleKnownInv(uint64 nPeerNonce,CInvPeer& peer,uint32 type,
     {
         network::CInv inv(type,hash);
         CInvState& state = mapState[inv];
-        if (state.nAssigned == 0)
+        if (state.nAssigned == 0 && (!peer.IsLate(hash) || IsLateOnly(hash,state)))
         {
+            // the stalled peers are asked again once no other peer is left to ask
+            peer.setLate.erase(hash);
             state.nAssigned = nPeerNonce;
+            state.nAssignTime = walleve::GetTimeMillis();
             vInv.push_back(inv);
             peer.Assign(inv);
             if (vInv.size() >= nMaxCount)
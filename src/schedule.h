@@ -9,6 +9,7 @@
 #include "mvproto.h"
 #include "mvtype.h"
 #include "block.h"
+#include "compactblock.h"
 #include "transaction.h"
 
 #include <boost/variant.hpp>
@@ -25,6 +26,8 @@ class CInvPeer
         std::set<uint256> setAssigned;
     };
 public:
+    enum {MIN_BLOCK_WINDOW = 2,INIT_BLOCK_WINDOW = 8,MAX_BLOCK_WINDOW = 32};
+    CInvPeer() : nBlockWindow(INIT_BLOCK_WINDOW),nLastBlockTime(0) {}
     bool Empty(uint32 type)
     {
         return GetKnownList(type).empty(); 
@@ -65,6 +68,7 @@ public:
         CUInt256ByValue& idxByValue = listKnown.get<1>();
         idxByValue.erase(inv.nHash);
         GetAssigned(inv.nType).erase(inv.nHash);
+        setLate.erase(inv.nHash);
     }
     void Assign(const network::CInv& inv)
     {
@@ -78,8 +82,31 @@ public:
     {
         return (!invKnown[0].setAssigned.empty() || !invKnown[1].setAssigned.empty());
     }
+    // taken back after a stall, a late delivery is dropped without penalty.
+    // The mark only lives while the inv is known and not received from anyone
+    void Relieve(const network::CInv& inv)
+    {
+        GetAssigned(inv.nType).erase(inv.nHash);
+        setLate.insert(inv.nHash);
+    }
+    bool IsLate(const uint256& hash) const
+    {
+        return (!!setLate.count(hash));
+    }
+    void IncreaseWindow()
+    {
+        nBlockWindow = std::min(nBlockWindow + 1,(std::size_t)MAX_BLOCK_WINDOW);
+    }
+    void DecreaseWindow()
+    {
+        nBlockWindow = std::max(nBlockWindow / 2,(std::size_t)MIN_BLOCK_WINDOW);
+    }
 public:
     CInvPeerState invKnown[2];
+    std::size_t nBlockWindow;
+    int64 nLastBlockTime;
+    uint256 hashInvContinue;
+    std::set<uint256> setLate;
 };
 
 class COrphan
@@ -92,8 +119,11 @@ public:
     void GetNext(const uint256& prev,std::vector<uint256>& vNext,std::set<uint256>& setHash);
     void RemoveNext(const uint256& prev);
     void RemoveBranch(const uint256& root,std::vector<uint256>& vBranch);
+protected:
+    void RemoveByPrev(const uint256& prev,const uint256& hash);
 protected:
     std::multimap<uint256,uint256> mapOrphanByPrev;
+    std::multimap<uint256,uint256> mapPrevByOrphan;
 };
 
 class CSchedule
@@ -102,10 +132,11 @@ class CSchedule
     class CInvState
     {
     public:
-        CInvState() : nAssigned(0),objReceived(CNil()) {}
+        CInvState() : nAssigned(0),nAssignTime(0),objReceived(CNil()) {}
         bool IsReceived() {return (objReceived.type() != typeid(CNil));}
     public:
         uint64 nAssigned;
+        int64 nAssignTime;
         CInvObject objReceived;
         std::set<uint64> setKnownPeer;
     };
@@ -117,6 +148,7 @@ public:
     void RemoveInv(const network::CInv& inv,std::set<uint64>& setKnownPeer);
     bool ReceiveBlock(uint64 nPeerNonce,const uint256& hash,const CBlock& block,std::set<uint64>& setSchedPeer);
     bool ReceiveTx(uint64 nPeerNonce,const uint256& txid,const CTransaction& tx,std::set<uint64>& setSchedPeer);
+    bool ReceiveLate(uint64 nPeerNonce,const network::CInv& inv);
     CBlock* GetBlock(const uint256& hash,uint64& nNonceSender);
     CTransaction* GetTransaction(const uint256& txid,uint64& nNonceSender);
     void AddOrphanBlockPrev(const uint256& hash,const uint256& prev);
@@ -127,8 +159,20 @@ public:
     void InvalidateTx(const uint256& txid,std::set<uint64>& setMisbehavePeer);
     bool ScheduleBlockInv(uint64 nPeerNonce,std::vector<network::CInv>& vInv,std::size_t nMaxCount,bool& fMissingPrev,bool& fEmpty);
     bool ScheduleTxInv(uint64 nPeerNonce,std::vector<network::CInv>& vInv,std::size_t nMaxCount);
+    void ReassignStalledBlock(int64 nNow,int64 nTimeout,std::set<uint64>& setSchedPeer);
+    void SetBlockInvContinue(uint64 nPeerNonce,const uint256& hash);
+    bool GetBlockInvContinue(uint64 nPeerNonce,std::size_t nBatchCount,uint256& hash);
+    std::size_t GetOrphanBlockCount() { return orphanBlock.GetSize(); }
+    enum {MAX_PARTIAL_BLOCK_COUNT = 64,MAX_PEER_PARTIAL_BLOCK_COUNT = 4};
+    // fUnsolicited lets the peer announce the block by pushing its compact form
+    bool AssignCompactBlock(uint64 nPeerNonce,const uint256& hash,bool fUnsolicited);
+    bool AddPartialBlock(uint64 nPeerNonce,const CPartialBlock& partial);
+    CPartialBlock* GetPartialBlock(uint64 nPeerNonce,const uint256& hash);
+    void RemovePartialBlock(const uint256& hash);
 protected:
     void RemoveOrphan(const network::CInv& inv);
+    void ClearLate(const network::CInv& inv,const CInvState& state);
+    bool IsLateOnly(const uint256& hash,const CInvState& state);
     bool ScheduleKnownInv(uint64 nPeerNonce,CInvPeer& peer,uint32 type,
                                             std::vector<network::CInv>& vInv,std::size_t nMaxCount,bool& fReceivedAll);
 protected:
@@ -137,6 +181,8 @@ protected:
     COrphan orphanTx;
     std::map<uint64,CInvPeer> mapPeer;
     std::map<network::CInv,CInvState> mapState;
+    // compact blocks waiting for their missing transactions, with the peer asked for them
+    std::map<uint256,std::pair<uint64,CPartialBlock> > mapPartialBlock;
 };
 
 } // namespace multiverse
@@ -4,6 +4,7 @@
 
 #include "service.h"
 #include "event.h"
+#include "template/templatecache.h"
 
 using namespace std;
 using namespace walleve;
@@ -328,6 +329,11 @@ void CService::GetTxPool(const uint256& hashFork,vector<pair<uint256,size_t> >&
     pTxPool->ListTx(hashFork,vTxPool);
 }
 
+void CService::GetTxPoolMemory(const uint256& hashFork,size_t& nForkUsage,size_t& nTotalUsage)
+{
+    pTxPool->GetMemoryUsage(hashFork,nForkUsage,nTotalUsage);
+}
+
 bool CService::GetTransaction(const uint256& txid,CTransaction& tx,uint256& hashFork,int32& nHeight)
 {
     if (pTxPool->Get(txid,tx))
@@ -362,6 +368,19 @@ bool CService::RemovePendingTx(const uint256& txid)
     return true;
 }
 
+void CService::GetStorageStatus(CStorageStatus& status)
+{
+    status.SetNull();
+    pWorldLine->GetStorageStatus(status);
+
+    CTemplateCacheStat statTemplate;
+    CTemplateCache::GetInstance().GetStat(statTemplate);
+    status.nTemplateCacheCapacity = statTemplate.nCapacity;
+    status.nTemplateCacheCount = statTemplate.nCount;
+    status.nTemplateCacheHit = statTemplate.nHit;
+    status.nTemplateCacheMiss = statTemplate.nMiss;
+}
+
 bool CService::HaveKey(const crypto::CPubKey& pubkey)
 {
     return pWallet->Have(pubkey);
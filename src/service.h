@@ -43,9 +43,11 @@ public:
     bool GetBlock(const uint256& hashBlock,CBlock& block,uint256& hashFork,int32& nHeight) override;
     bool GetBlockEx(const uint256& hashBlock, CBlockEx& block, uint256& hashFork, int32& nHeight) override;
     void GetTxPool(const uint256& hashFork,std::vector<std::pair<uint256,std::size_t> >& vTxPool) override;
+    void GetTxPoolMemory(const uint256& hashFork,std::size_t& nForkUsage,std::size_t& nTotalUsage) override;
     bool GetTransaction(const uint256& txid,CTransaction& tx,uint256& hashFork,int32& nHeight) override;
     MvErr SendTransaction(CTransaction& tx) override;
     bool RemovePendingTx(const uint256& txid) override;
+    void GetStorageStatus(CStorageStatus& status) override;
     /* Wallet */
     bool HaveKey(const crypto::CPubKey& pubkey) override;
     void GetPubKeys(std::set<crypto::CPubKey>& setPubKey) override;
@@ -4,221 +4,72 @@
 
 #include "txpool.h"
 #include <boost/range/adaptor/reversed.hpp>
+#include <algorithm>
+#include <limits>
 using namespace std;
 using namespace walleve;
 using namespace multiverse;
 
 //////////////////////////////
-// CTxPoolCandidate
-class CTxPoolCandidate
+// Batch helpers
+
+static MvErr GetBatchPrevOutput(const CTxPoolView& txView,const map<CTxOutPoint,CTxOutput>& mapBatchOutput,
+                                const set<CTxOutPoint>& setBatchSpent,const map<CTxOutPoint,CTxOutput>& mapStored,
+                                bool fStored,const CTransaction& tx,vector<CTxOutput>& vPrevOutput)
 {
-public:
-    CTxPoolCandidate() : nTxSeq(-1),nTotalTxFee(0),nTotalSize(0) {}
-    CTxPoolCandidate(const pair<uint256,CPooledTx*>& ptx) 
-    : nTxSeq(ptx.second->nSequenceNumber),nTotalTxFee(0),nTotalSize(0)
-    {
-        AddNewTx(ptx);
-    }
-    void AddNewTx(const pair<uint256,CPooledTx*>& ptx)
+    // same checks and errors as CTxPool::AddNew, with the storage lookup done up front
+    vPrevOutput.assign(tx.vInput.size(),CTxOutput());
+    for (size_t i = 0;i < tx.vInput.size();i++)
     {
-        if (mapPoolTx.insert(ptx).second)
+        const CTxOutPoint& prevout = tx.vInput[i].prevout;
+        if (txView.IsSpent(prevout) || setBatchSpent.count(prevout))
         {
-            nTotalTxFee += ptx.second->nTxFee;
-            nTotalSize += ptx.second->nSerializeSize;
+            return MV_ERR_TRANSACTION_CONFLICTING_INPUT;
         }
-    }
-    bool Have(const uint256& txid) const
-    {
-        return (!!mapPoolTx.count(txid));
-    } 
-    int64 GetTxFeePerKB() const
-    {
-        return (nTotalSize != 0 ? (nTotalTxFee << 10) / nTotalSize : 0);
-    }
-public:
-    size_t nTxSeq;
-    int64 nTotalTxFee;
-    size_t nTotalSize;
-    map<uint256,CPooledTx*> mapPoolTx;
-};
-
-//////////////////////////////
-// CTxPoolView
-void CTxPoolView::InvalidateSpent(const CTxOutPoint& out,vector<uint256>& vInvolvedTx)
-{
-    vector<CTxOutPoint> vOutPoint;
-    vOutPoint.push_back(out);
-    for (std::size_t i = 0;i < vOutPoint.size();i++)
-    {
-        uint256 txidNextTx;
-        if (GetSpent(vOutPoint[i],txidNextTx))
+        if (!txView.GetUnspent(prevout,vPrevOutput[i]))
         {
-            CPooledTx* pNextTx = NULL;
-            if ((pNextTx = Get(txidNextTx)) != NULL)
+            map<CTxOutPoint,CTxOutput>::const_iterator it = mapBatchOutput.find(prevout);
+            if (it != mapBatchOutput.end())
             {
-                for(const CTxIn& txin : pNextTx->vInput)
-                {
-                    SetUnspent(txin.prevout);
-                }
-                CTxOutPoint out0(txidNextTx,0);
-                if (IsSpent(out0))
-                {
-                    vOutPoint.push_back(out0);
-                }
-                else
-                {
-                    mapSpent.erase(out0);
-                }
-                CTxOutPoint out1(txidNextTx,1);
-                if (IsSpent(out1))
-                {
-                    vOutPoint.push_back(out1);
-                }
-                else
-                {
-                    mapSpent.erase(out1);
-                }
-                mapTx.erase(txidNextTx);
-                vInvolvedTx.push_back(txidNextTx);
+                vPrevOutput[i] = (*it).second;
+            }
+            else if ((it = mapStored.find(prevout)) != mapStored.end())
+            {
+                vPrevOutput[i] = (*it).second;
             }
         }
     }
-}
- 
-void CTxPoolView::GetSortedTx(map<size_t,pair<uint256,CPooledTx*> >& mapSortedTx)
-{
-    for (map<uint256,CPooledTx*>::iterator mi = mapTx.begin();mi != mapTx.end(); ++mi)
+    if (!fStored)
     {
-        CPooledTx* pPooledTx = (*mi).second;
-        {
-            mapSortedTx.insert(make_pair(pPooledTx->nSequenceNumber,(*mi)));
-        }
+        return MV_ERR_SYS_STORAGE_ERROR;
     }
-}
-
-void CTxPoolView::GetInvolvedTx(map<size_t,pair<uint256,CPooledTx*> >& mapInvolvedTx,
-                                set<CDestination>& setDest)
-{
-    for (map<uint256,CPooledTx*>::iterator mi = mapTx.begin();mi != mapTx.end(); ++mi)
+    for (size_t i = 0;i < vPrevOutput.size();i++)
     {
-        CPooledTx* pPooledTx = (*mi).second;
-        if (setDest.count(pPooledTx->sendTo) || setDest.count(pPooledTx->destIn))
+        if (vPrevOutput[i].IsNull())
         {
-            mapInvolvedTx.insert(make_pair(pPooledTx->nSequenceNumber,(*mi)));
+            return MV_ERR_TRANSACTION_CONFLICTING_INPUT;
         }
     }
+    return MV_OK;
 }
 
-void CTxPoolView::ArrangeBlockTx(vector<CTransaction>& vtx,int64& nTotalTxFee,int64 nBlockTime,size_t nMaxSize)
+static bool IsSamePrevOutput(const vector<CTxOutput>& vA,const vector<CTxOutput>& vB)
 {
-    nTotalTxFee = 0;
-
-    map<size_t,pair<uint256,CPooledTx*> > mapCandidate;
-    for (map<uint256,CPooledTx*>::iterator it = mapTx.begin();it != mapTx.end();++it)
+    if (vA.size() != vB.size())
     {
-        if ((*it).second->GetTxTime() <= nBlockTime)
-        {
-            mapCandidate.insert(make_pair((*it).second->nSequenceNumber,(*it)));
-        }
+        return false;
     }
-    
-    size_t nTotalSize = 0;
-    for (map<size_t,pair<uint256,CPooledTx*> >::iterator it = mapCandidate.begin();
-         it != mapCandidate.end(); ++it)
+    for (size_t i = 0;i < vA.size();i++)
     {
-        if (nTotalSize + (*it).second.second->nSerializeSize > nMaxSize)
+        if (vA[i].destTo != vB[i].destTo || vA[i].nAmount != vB[i].nAmount
+            || vA[i].nTxTime != vB[i].nTxTime || vA[i].nLockUntil != vB[i].nLockUntil)
         {
-            break;
+            return false;
         }
-        vtx.push_back(*static_cast<CTransaction*>((*it).second.second));
-        nTotalSize += (*it).second.second->nSerializeSize;
-        nTotalTxFee += (*it).second.second->nTxFee; 
     }
+    return true;
 }
 
-void CTxPoolView::ArrangeBlockTx(map<size_t,pair<uint256,CPooledTx*> >& mapArrangedTx,size_t nMaxSize)
-{
-    size_t nTotalSize = 0;
-    mapArrangedTx.clear();
-
-    multimap<int64,CTxPoolCandidate> mapCandidate;
-    for (map<uint256,CPooledTx*>::iterator it = mapTx.begin();it != mapTx.end();++it)
-    {
-        nTotalSize += (*it).second->nSerializeSize;
-
-        CTxPoolCandidate candidateTx(*it);
-        mapCandidate.insert(make_pair(-candidateTx.GetTxFeePerKB(),candidateTx));
-    }
-
-    if (nTotalSize > nMaxSize)
-    {
-        nTotalSize = 0;
-
-        multimap<int64,CTxPoolCandidate>::iterator it;
-        while ((it = mapCandidate.begin()) != mapCandidate.end())
-        {
-            CTxPoolCandidate candidate = (*it).second;
-            mapCandidate.erase(it);
-            if (mapArrangedTx.count(candidate.nTxSeq))
-            {
-                continue;
-            }
-            
-            if (candidate.mapPoolTx.size() == 1)
-            {
-                vector<pair<uint256,CPooledTx*> > vTxTree;
-                vTxTree.push_back(*candidate.mapPoolTx.begin());
-                for (std::size_t i = 0;i < vTxTree.size();i++)
-                {
-                    CPooledTx* pPooledTx = vTxTree[i].second;
-                    for(const CTxIn& txin : pPooledTx->vInput)
-                    {
-                        const uint256& txidPrev = txin.prevout.hash;
-                        if (!candidate.Have(txidPrev))
-                        {
-                            map<uint256,CPooledTx*>::iterator mi = mapTx.find(txidPrev);
-                            if (mi != mapTx.end() && !mapArrangedTx.count((*mi).second->nSequenceNumber))
-                            {
-                                candidate.AddNewTx(*mi);
-                                vTxTree.push_back(*mi);
-                            }
-                        }
-                    }
-                }
-                int64 nTxFeePerKB = candidate.GetTxFeePerKB();
-                it = mapCandidate.begin();
-                if (it != mapCandidate.end() && -(*it).first > nTxFeePerKB)
-                {
-                    mapCandidate.insert(make_pair(-nTxFeePerKB,candidate));
-                    continue;
-                }
-            }
-            if (nTotalSize + candidate.nTotalSize <= nMaxSize)
-            {
-                for (map<uint256,CPooledTx*>::iterator mi = candidate.mapPoolTx.begin();
-                     mi != candidate.mapPoolTx.end();++mi)
-                {
-                    if (mapArrangedTx.insert(make_pair((*mi).second->nSequenceNumber,*mi)).second)
-                    {
-                        nTotalSize += (*mi).second->nSerializeSize;
-                    }
-                }    
-                if (nTotalSize + MIN_TOKEN_TX_SIZE > nMaxSize)
-                {
-                    break;
-                }
-            }
-        }
-    }
-    else
-    {
-        for (map<uint256,CPooledTx*>::iterator it = mapTx.begin();it != mapTx.end();++it)
-        {
-            mapArrangedTx.insert(make_pair((*it).second->nSequenceNumber,*it));
-        }
-    }
-}
- 
 //////////////////////////////
 // CTxPool 
 
@@ -226,6 +77,8 @@ CTxPool::CTxPool()
 {
     pCoreProtocol = NULL;
     pWorldLine = NULL;
+    nMaxMemoryUsage = 0;
+    nMaxForkMemoryUsage = 0;
 }
 
 CTxPool::~CTxPool()
@@ -263,9 +116,20 @@ bool CTxPool::WalleveHandleInvoke()
         return false;
     }
 
+    nMaxMemoryUsage = (size_t)StorageConfig()->nTxPoolMaxMemory << 20;
+    nMaxForkMemoryUsage = (size_t)StorageConfig()->nTxPoolMaxForkMemory << 20;
+
+    spVerifyPool = CVerifyPool::GetInstance();
+    if (spVerifyPool == NULL)
+    {
+        WalleveError("Failed to start verify pool\n");
+        return false;
+    }
+
     if (!LoadData())
     {
         WalleveError("Failed to load txpool data\n");
+        spVerifyPool.reset();
         return false;
     }
 
@@ -274,43 +138,40 @@ bool CTxPool::WalleveHandleInvoke()
 
 void CTxPool::WalleveHandleHalt()
 {
-    if (!SaveData())
-    {
-        WalleveError("Failed to save txpool data\n");
-    }
+    spVerifyPool.reset();
+    datTxPool.Deinitialize();
     Clear();
 }
 
 bool CTxPool::Exists(const uint256& txid)
 {    
-    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    return (!!mapTx.count(txid));
+    return dirTx.Exists(txid);
 }
 
 void CTxPool::Clear()
 {
     boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
-    mapPoolView.clear();
-    mapTx.clear();
+    mapForkPool.clear();
+    dirTx.Clear();
 }
 
 size_t CTxPool::Count(const uint256& fork) const
 {
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    map<uint256,CTxPoolView>::const_iterator it = mapPoolView.find(fork);
-    if (it != mapPoolView.end())
+    map<uint256,CForkTxPool>::const_iterator it = mapForkPool.find(fork);
+    if (it != mapForkPool.end())
     {
-        return ((*it).second.Count());
+        boost::shared_lock<boost::shared_mutex> rlockFork((*it).second.rwAccess);
+        return ((*it).second.txView.Count());
     }
     return 0;
 }
 
 MvErr CTxPool::Push(const CTransaction& tx,uint256& hashFork,CDestination& destIn,int64& nValueIn)
 {
-    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
     uint256 txid = tx.GetHash();
  
-    if (mapTx.count(txid))
+    if (dirTx.Exists(txid))
     {
         return MV_ERR_ALREADY_HAVE;
     }
@@ -326,71 +187,247 @@ MvErr CTxPool::Push(const CTransaction& tx,uint256& hashFork,CDestination& destI
         return MV_ERR_TRANSACTION_INVALID;
     }
     
-    CTxPoolView& txView = mapPoolView[hashFork];    
-    MvErr err = AddNew(txView,txid,tx,hashFork,nHeight);
-    if (err == MV_OK)
+    AddForkPool(hashFork);
+
+    MvErr err = MV_ERR_NOT_FOUND;
     {
-        CPooledTx* pPooledTx = txView.Get(txid);
-        if (pPooledTx == NULL)
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        CForkTxPool* pForkPool = GetForkPool(hashFork);
+        if (pForkPool != NULL)
         {
-            return MV_ERR_NOT_FOUND;
+            boost::unique_lock<boost::shared_mutex> wlockFork(pForkPool->rwAccess);
+            err = (pForkPool->mapTx.count(txid) ? MV_ERR_ALREADY_HAVE : AddNew(*pForkPool,txid,tx,hashFork,nHeight));
+            if (err == MV_OK)
+            {
+                vector<uint256> vEvictedTx;
+                if (nMaxForkMemoryUsage != 0)
+                {
+                    EvictForkPool(*pForkPool,hashFork,nMaxForkMemoryUsage,numeric_limits<int64>::max(),vEvictedTx);
+                }
+                CPooledTx* pPooledTx = pForkPool->txView.Get(txid);
+                if (pPooledTx != NULL)
+                {
+                    destIn = pPooledTx->destIn;
+                    nValueIn = pPooledTx->nValueIn;
+                }
+                else if (find(vEvictedTx.begin(),vEvictedTx.end(),txid) != vEvictedTx.end())
+                {
+                    // evicted right away, the pool is full of better paying txs
+                    err = MV_ERR_TRANSACTION_EVICTED;
+                }
+            }
         }
-        destIn = pPooledTx->destIn;
-        nValueIn = pPooledTx->nValueIn;
     }
 
+    CommitData();
+
     return err;
 }   
 
+void CTxPool::PushBatch(const vector<CTransaction>& vtx,vector<MvErr>& vErr,vector<CTxPushResult>& vResult)
+{
+    vErr.assign(vtx.size(),MV_OK);
+    vResult.assign(vtx.size(),CTxPushResult());
+
+    vector<CTxPoolBatchTx> vBatchTx;
+    vector<size_t> vBatchIndex(vtx.size(),vtx.size());
+    vBatchTx.reserve(vtx.size());
+
+    map<uint256,size_t> mapFirst;
+    map<uint256,pair<uint256,int32> > mapAnchor;
+    set<uint256> setInvalidAnchor;
+    for (size_t i = 0;i < vtx.size();i++)
+    {
+        const CTransaction& tx = vtx[i];
+        uint256 txid = tx.GetHash();
+        if (!mapFirst.insert(make_pair(txid,i)).second)
+        {
+            continue;
+        }
+
+        if (dirTx.Exists(txid))
+        {
+            vErr[i] = MV_ERR_ALREADY_HAVE;
+            continue;
+        }
+
+        if (tx.IsMintTx())
+        {
+            vErr[i] = MV_ERR_TRANSACTION_INVALID;
+            continue;
+        }
+
+        // txs of a batch mostly share a few anchors
+        map<uint256,pair<uint256,int32> >::iterator it = mapAnchor.find(tx.hashAnchor);
+        if (it == mapAnchor.end())
+        {
+            uint256 hashFork;
+            int32 nHeight;
+            if (setInvalidAnchor.count(tx.hashAnchor)
+                || !pWorldLine->GetBlockLocation(tx.hashAnchor,hashFork,nHeight))
+            {
+                setInvalidAnchor.insert(tx.hashAnchor);
+                vErr[i] = MV_ERR_TRANSACTION_INVALID;
+                continue;
+            }
+            it = mapAnchor.insert(make_pair(tx.hashAnchor,make_pair(hashFork,nHeight))).first;
+        }
+
+        vBatchIndex[i] = vBatchTx.size();
+        vBatchTx.push_back(CTxPoolBatchTx(tx,txid,(*it).second.second));
+        vBatchTx.back().result.hashFork = (*it).second.first;
+    }
+
+    map<uint256,vector<CTxPoolBatchTx*> > mapForkBatch;
+    for (size_t n = 0;n < vBatchTx.size();n++)
+    {
+        mapForkBatch[vBatchTx[n].result.hashFork].push_back(&vBatchTx[n]);
+    }
+
+    for (map<uint256,vector<CTxPoolBatchTx*> >::iterator it = mapForkBatch.begin();it != mapForkBatch.end();++it)
+    {
+        const uint256& hashFork = (*it).first;
+        AddForkPool(hashFork);
+
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        CForkTxPool* pForkPool = GetForkPool(hashFork);
+        if (pForkPool == NULL)
+        {
+            for (CTxPoolBatchTx* pBatchTx : (*it).second)
+            {
+                pBatchTx->err = MV_ERR_NOT_FOUND;
+            }
+            continue;
+        }
+
+        boost::unique_lock<boost::shared_mutex> wlockFork(pForkPool->rwAccess);
+        AddNewBatch(*pForkPool,hashFork,(*it).second);
+        if (nMaxForkMemoryUsage != 0)
+        {
+            vector<uint256> vEvictedTx;
+            EvictForkPool(*pForkPool,hashFork,nMaxForkMemoryUsage,numeric_limits<int64>::max(),vEvictedTx);
+            if (!vEvictedTx.empty())
+            {
+                set<uint256> setEvictedTx(vEvictedTx.begin(),vEvictedTx.end());
+                for (CTxPoolBatchTx* pBatchTx : (*it).second)
+                {
+                    if (pBatchTx->err == MV_OK && setEvictedTx.count(pBatchTx->txid))
+                    {
+                        pBatchTx->err = MV_ERR_TRANSACTION_EVICTED;
+                    }
+                }
+            }
+        }
+    }
+
+    CommitData();
+
+    for (size_t i = 0;i < vtx.size();i++)
+    {
+        size_t nFirst = mapFirst[vtx[i].GetHash()];
+        if (nFirst != i)
+        {
+            // a repeated tx gets what a second Push would have returned
+            vErr[i] = (vErr[nFirst] == MV_OK ? MV_ERR_ALREADY_HAVE : vErr[nFirst]);
+        }
+        else if (vBatchIndex[i] < vBatchTx.size())
+        {
+            vErr[i] = vBatchTx[vBatchIndex[i]].err;
+            vResult[i] = vBatchTx[vBatchIndex[i]].result;
+        }
+    }
+}
+
 void CTxPool::Pop(const uint256& txid)
 {
-    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
-    map<uint256,CPooledTx>::iterator it = mapTx.find(txid);
-    if (it == mapTx.end())
+    uint256 hashFork;
+    if (!dirTx.Find(txid,hashFork))
     {
         return;
-    }   
-    CPooledTx& tx = (*it).second;
-    uint256 hashFork;
-    int32 nHeight;
-    if (!pWorldLine->GetBlockLocation(tx.hashAnchor,hashFork,nHeight))
+    }
+
+    CDataCommit commit(this);
+    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    CForkTxPool* pForkPool = GetForkPool(hashFork);
+    if (pForkPool == NULL)
     {
         return;
     }
+
+    boost::unique_lock<boost::shared_mutex> wlockFork(pForkPool->rwAccess);
+    if (!pForkPool->mapTx.count(txid))
+    {
+        return;
+    }   
     vector<uint256> vInvalidTx;
-    CTxPoolView& txView = mapPoolView[hashFork];    
+    CTxPoolView& txView = pForkPool->txView;
     txView.Remove(txid);
     txView.InvalidateSpent(CTxOutPoint(txid,0),vInvalidTx);
     txView.InvalidateSpent(CTxOutPoint(txid,1),vInvalidTx);
+    pForkPool->mapTx.erase(txid);
+    dirTx.Erase(txid);
+    datTxPool.Remove(hashFork,txid);
     for(const uint256& txidInvalid : vInvalidTx)
     {
-        mapTx.erase(txidInvalid);
+        pForkPool->mapTx.erase(txidInvalid);
+        dirTx.Erase(txidInvalid);
+        datTxPool.Remove(hashFork,txidInvalid);
     }
 }
 
 bool CTxPool::Get(const uint256& txid,CTransaction& tx) const
 {
+    uint256 hashFork;
+    if (!dirTx.Find(txid,hashFork))
+    {
+        return false;
+    }
+
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    map<uint256,CPooledTx>::const_iterator it = mapTx.find(txid);
-    if (it != mapTx.end())
+    map<uint256,CForkTxPool>::const_iterator it = mapForkPool.find(hashFork);
+    if (it == mapForkPool.end())
+    {
+        return false;
+    }
+
+    const CForkTxPool& forkPool = (*it).second;
+    boost::shared_lock<boost::shared_mutex> rlockFork(forkPool.rwAccess);
+    map<uint256,CPooledTx>::const_iterator mi = forkPool.mapTx.find(txid);
+    if (mi != forkPool.mapTx.end())
     {
-        tx = (*it).second;
+        tx = (*mi).second;
         return true;
     }    
     return false;
 }
 
+void CTxPool::GetMemoryUsage(const uint256& hashFork,size_t& nForkUsage,size_t& nTotalUsage) const
+{
+    nForkUsage = 0;
+    nTotalUsage = 0;
+    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    for (map<uint256,CForkTxPool>::const_iterator it = mapForkPool.begin();it != mapForkPool.end();++it)
+    {
+        boost::shared_lock<boost::shared_mutex> rlockFork((*it).second.rwAccess);
+        size_t nUsage = (*it).second.txView.GetMemoryUsage();
+        if ((*it).first == hashFork)
+        {
+            nForkUsage = nUsage;
+        }
+        nTotalUsage += nUsage;
+    }
+}
+
 void CTxPool::ListTx(const uint256& hashFork,vector<pair<uint256,size_t> >& vTxPool)
 {
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    map<uint256,CTxPoolView>::iterator it = mapPoolView.find(hashFork);
-    if (it != mapPoolView.end())
+    CForkTxPool* pForkPool = GetForkPool(hashFork);
+    if (pForkPool != NULL)
     {
-        CTxPoolView& txView = (*it).second;
-        map<size_t,pair<uint256,CPooledTx*> > mapFilteredTx;
-        txView.GetSortedTx(mapFilteredTx);
-        for (map<size_t,pair<uint256,CPooledTx*> >::iterator mi = mapFilteredTx.begin();
-             mi != mapFilteredTx.end();++mi)
+        boost::shared_lock<boost::shared_mutex> rlockFork(pForkPool->rwAccess);
+        CTxPoolView& txView = pForkPool->txView;
+        for (map<size_t,pair<uint256,CPooledTx*> >::iterator mi = txView.mapTxSeq.begin();
+             mi != txView.mapTxSeq.end();++mi)
         {
             vTxPool.push_back(make_pair((*mi).second.first,(*mi).second.second->nSerializeSize));
         }
@@ -400,14 +437,13 @@ void CTxPool::ListTx(const uint256& hashFork,vector<pair<uint256,size_t> >& vTxP
 void CTxPool::ListTx(const uint256& hashFork,vector<uint256>& vTxPool)
 {
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    map<uint256,CTxPoolView>::iterator it = mapPoolView.find(hashFork);
-    if (it != mapPoolView.end())
+    CForkTxPool* pForkPool = GetForkPool(hashFork);
+    if (pForkPool != NULL)
     {
-        CTxPoolView& txView = (*it).second;
-        map<size_t,pair<uint256,CPooledTx*> > mapFilteredTx;
-        txView.GetSortedTx(mapFilteredTx);
-        for (map<size_t,pair<uint256,CPooledTx*> >::iterator mi = mapFilteredTx.begin();
-             mi != mapFilteredTx.end();++mi)
+        boost::shared_lock<boost::shared_mutex> rlockFork(pForkPool->rwAccess);
+        CTxPoolView& txView = pForkPool->txView;
+        for (map<size_t,pair<uint256,CPooledTx*> >::iterator mi = txView.mapTxSeq.begin();
+             mi != txView.mapTxSeq.end();++mi)
         {
             vTxPool.push_back((*mi).second.first);
         }
@@ -418,13 +454,14 @@ bool CTxPool::FilterTx(const uint256& hashFork,CTxFilter& filter)
 {
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
 
-    map<uint256,CTxPoolView>::iterator it = mapPoolView.find(hashFork);
-    if (it == mapPoolView.end())
+    CForkTxPool* pForkPool = GetForkPool(hashFork);
+    if (pForkPool == NULL)
     {
         return true;
     }
     
-    CTxPoolView& txView = (*it).second;
+    boost::shared_lock<boost::shared_mutex> rlockFork(pForkPool->rwAccess);
+    CTxPoolView& txView = pForkPool->txView;
     map<size_t,pair<uint256,CPooledTx*> > mapFilteredTx;
     txView.GetInvolvedTx(mapFilteredTx,filter.setDest);
 
@@ -442,25 +479,36 @@ bool CTxPool::FilterTx(const uint256& hashFork,CTxFilter& filter)
 void CTxPool::ArrangeBlockTx(const uint256& hashFork,int64 nBlockTime,size_t nMaxSize,
                              vector<CTransaction>& vtx,int64& nTotalTxFee)
 {
+    nTotalTxFee = 0;
+
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    CTxPoolView& txView = mapPoolView[hashFork];
-    txView.ArrangeBlockTx(vtx,nTotalTxFee,nBlockTime,nMaxSize);
+    CForkTxPool* pForkPool = GetForkPool(hashFork);
+    if (pForkPool != NULL)
+    {
+        boost::shared_lock<boost::shared_mutex> rlockFork(pForkPool->rwAccess);
+        pForkPool->txView.ArrangeBlockTx(vtx,nTotalTxFee,nBlockTime,nMaxSize);
+    }
 }
 
 bool CTxPool::FetchInputs(const uint256& hashFork,const CTransaction& tx,vector<CTxOutput>& vUnspent)
 {
-    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    CTxPoolView& txView = mapPoolView[hashFork];
-
     vUnspent.resize(tx.vInput.size());
 
-    for (std::size_t i = 0;i < tx.vInput.size();i++)
+    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    CForkTxPool* pForkPool = GetForkPool(hashFork);
+    boost::shared_lock<boost::shared_mutex> rlockFork;
+    if (pForkPool != NULL)
     {
-        if (txView.IsSpent(tx.vInput[i].prevout))
+        rlockFork = boost::shared_lock<boost::shared_mutex>(pForkPool->rwAccess);
+        CTxPoolView& txView = pForkPool->txView;
+        for (std::size_t i = 0;i < tx.vInput.size();i++)
         {
-            return false;
+            if (txView.IsSpent(tx.vInput[i].prevout))
+            {
+                return false;
+            }
+            txView.GetUnspent(tx.vInput[i].prevout,vUnspent[i]);
         }
-        txView.GetUnspent(tx.vInput[i].prevout,vUnspent[i]);
     }
 
     if (!pWorldLine->GetTxUnspent(hashFork,tx.vInput,vUnspent))
@@ -493,10 +541,21 @@ bool CTxPool::SynchronizeWorldLine(const CWorldLineUpdate& update,CTxSetChange&
 {
     change.hashFork = update.hashFork;
 
-    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
+    AddForkPool(update.hashFork);
+
+    CDataCommit commit(this);
+    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    CForkTxPool* pForkPool = GetForkPool(update.hashFork);
+    if (pForkPool == NULL)
+    {
+        return false;
+    }
+
+    boost::unique_lock<boost::shared_mutex> wlockFork(pForkPool->rwAccess);
     
     vector<uint256> vInvalidTx;
-    CTxPoolView& txView = mapPoolView[update.hashFork];
+    CTxPoolView& txView = pForkPool->txView;
+    map<uint256,CPooledTx>& mapTx = pForkPool->mapTx;
 
     int32 nHeight = update.nLastBlockHeight - update.vBlockAddNew.size() + 1;
     for(const CBlockEx& block : boost::adaptors::reverse(update.vBlockAddNew))
@@ -516,6 +575,8 @@ bool CTxPool::SynchronizeWorldLine(const CWorldLineUpdate& update,CTxSetChange&
                 {
                     txView.Remove(txid);
                     mapTx.erase(txid);
+                    dirTx.Erase(txid);
+                    datTxPool.Remove(update.hashFork,txid);
                     change.mapTxUpdate.insert(make_pair(txid,nHeight));
                 }
                 else
@@ -544,15 +605,8 @@ bool CTxPool::SynchronizeWorldLine(const CWorldLineUpdate& update,CTxSetChange&
             uint256 txid = tx.GetHash();
             if (!update.setTxUpdate.count(txid))
             {
-                uint256 spent0,spent1;
-                
-                txView.GetSpent(CTxOutPoint(txid,0),spent0);
-                txView.GetSpent(CTxOutPoint(txid,1),spent1);
-                if (AddNew(txView,txid,tx,update.hashFork,update.nLastBlockHeight) == MV_OK)
+                if (AddNew(*pForkPool,txid,tx,update.hashFork,update.nLastBlockHeight) == MV_OK)
                 {
-                    if (spent0 != 0) txView.SetSpent(CTxOutPoint(txid,0),spent0);
-                    if (spent1 != 0) txView.SetSpent(CTxOutPoint(txid,1),spent0);
-
                     change.mapTxUpdate.insert(make_pair(txid,-1));
                 }
                 else
@@ -581,6 +635,8 @@ bool CTxPool::SynchronizeWorldLine(const CWorldLineUpdate& update,CTxSetChange&
         {
             change.vTxRemove.push_back(make_pair(txid,(*it).second.vInput));
             mapTx.erase(it);
+            dirTx.Erase(txid);
+            datTxPool.Remove(update.hashFork,txid);
         } 
     }
     change.vTxRemove.insert(change.vTxRemove.end(),vTxRemove.begin(),vTxRemove.end());
@@ -590,54 +646,165 @@ bool CTxPool::SynchronizeWorldLine(const CWorldLineUpdate& update,CTxSetChange&
 
 bool CTxPool::LoadData()
 {
-    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
-
     vector<pair<uint256,pair<uint256,CAssembledTx> > > vTx;
     if (!datTxPool.Load(vTx))
     {
         return false;
     }
 
+    // recovered txs are admitted again in one batch, against the current worldline
+    vector<CTransaction> vtx;
+    vtx.reserve(vTx.size());
     for (int i = 0;i < vTx.size();i++)
     {
-        const uint256& hashFork = vTx[i].first;
-        const uint256& txid     = vTx[i].second.first;
-        const CAssembledTx& tx  = vTx[i].second.second;
-
-        map<uint256,CPooledTx>::iterator mi = mapTx.insert(make_pair(txid,CPooledTx(tx,GetSequenceNumber()))).first;
-        mapPoolView[hashFork].AddNew(txid,(*mi).second);
+        vtx.push_back(vTx[i].second.second);
     }
-    return true;
+    vector<pair<uint256,pair<uint256,CAssembledTx> > >().swap(vTx);
+
+    vector<MvErr> vErr;
+    vector<CTxPushResult> vResult;
+    PushBatch(vtx,vErr,vResult);
+    size_t nDropped = count_if(vErr.begin(),vErr.end(),[](MvErr err) { return err != MV_OK; });
+    WalleveLog("Txpool recovered %lu txs, %lu dropped\n",vtx.size() - nDropped,nDropped);
+
+    return SaveData();
 }
 
 bool CTxPool::SaveData()
 {
-    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    boost::unique_lock<boost::mutex> lockCompact(mtxCompact,boost::try_to_lock);
+    if (!lockCompact.owns_lock())
+    {
+        return true;
+    }
 
-    map<size_t,pair<uint256,pair<uint256,CAssembledTx> > > mapSortTx;
-    for (map<uint256,CTxPoolView>::iterator it = mapPoolView.begin();it != mapPoolView.end();++it)
+    // every mutating call journals under a shared rwAccess, so the unique lock
+    // pins the point where the pool content matches the journal rotation
+    vector<pair<uint256,pair<uint256,CAssembledTx> > > vTx;
+    uint32 nGeneration;
     {
-        map<uint256,CPooledTx*>& mapForkTx = (*it).second.mapTx;
-        for (map<uint256,CPooledTx*>::iterator mi = mapForkTx.begin();mi != mapForkTx.end();++mi)
+        boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
+        for (map<uint256,CForkTxPool>::iterator it = mapForkPool.begin();it != mapForkPool.end();++it)
+        {
+            map<size_t,pair<uint256,CPooledTx*> >& mapTxSeq = (*it).second.txView.mapTxSeq;
+            for (map<size_t,pair<uint256,CPooledTx*> >::iterator mi = mapTxSeq.begin();mi != mapTxSeq.end();++mi)
+            {
+                vTx.push_back(make_pair((*it).first,make_pair((*mi).second.first,static_cast<CAssembledTx&>(*(*mi).second.second))));
+            }
+        }
+        if (!datTxPool.Rotate(nGeneration))
         {
-            size_t n = (*mi).second->nSequenceNumber;
-            mapSortTx[n] = make_pair((*it).first,make_pair((*mi).first,static_cast<CAssembledTx&>(*(*mi).second)));
+            return false;
         }
     }
-    
-    vector<pair<uint256,pair<uint256,CAssembledTx> > > vTx;
-    vTx.reserve(mapSortTx.size());
-    for (map<size_t,pair<uint256,pair<uint256,CAssembledTx> > >::iterator it = mapSortTx.begin();
-         it != mapSortTx.end(); ++it)
+
+    return datTxPool.SaveSnapshot(nGeneration,vTx);
+}
+
+void CTxPool::CommitData()
+{
+    TrimMemory();
+    datTxPool.Flush();
+    if (datTxPool.IsCompactNeeded() && !SaveData())
+    {
+        WalleveError("Failed to compact txpool data\n");
+    }
+}
+
+void CTxPool::TrimMemory()
+{
+    if (nMaxMemoryUsage == 0)
     {
-        vTx.push_back((*it).second);
+        return;
     }
 
-    return datTxPool.Save(vTx);
+    // evict from the fork holding the lowest package, until it is no longer the lowest
+    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    for (;;)
+    {
+        size_t nTotalUsage = 0;
+        map<uint256,CForkTxPool>::iterator itWorst = mapForkPool.end();
+        int64 nWorstFeePerKB = 0;
+        int64 nNextFeePerKB = numeric_limits<int64>::max();
+        for (map<uint256,CForkTxPool>::iterator it = mapForkPool.begin();it != mapForkPool.end();++it)
+        {
+            boost::shared_lock<boost::shared_mutex> rlockFork((*it).second.rwAccess);
+            const CTxPoolView& txView = (*it).second.txView;
+            nTotalUsage += txView.GetMemoryUsage();
+            CTxPoolScore score(0,0);
+            if (!txView.GetLowestScore(score))
+            {
+                continue;
+            }
+            if (itWorst == mapForkPool.end() || score.nFeePerKB < nWorstFeePerKB)
+            {
+                if (itWorst != mapForkPool.end())
+                {
+                    nNextFeePerKB = min(nNextFeePerKB,nWorstFeePerKB);
+                }
+                itWorst = it;
+                nWorstFeePerKB = score.nFeePerKB;
+            }
+            else
+            {
+                nNextFeePerKB = min(nNextFeePerKB,score.nFeePerKB);
+            }
+        }
+        if (nTotalUsage <= nMaxMemoryUsage || itWorst == mapForkPool.end())
+        {
+            return;
+        }
+
+        CForkTxPool& forkPool = (*itWorst).second;
+        boost::unique_lock<boost::shared_mutex> wlockFork(forkPool.rwAccess);
+        size_t nUsage = forkPool.txView.GetMemoryUsage();
+        size_t nExcess = nTotalUsage - nMaxMemoryUsage;
+        vector<uint256> vEvictedTx;
+        EvictForkPool(forkPool,(*itWorst).first,(nUsage > nExcess ? nUsage - nExcess : 0),nNextFeePerKB,vEvictedTx);
+    }
+}
+
+void CTxPool::EvictForkPool(CForkTxPool& forkPool,const uint256& hashFork,size_t nTargetUsage,int64 nMaxFeePerKB,
+                            vector<uint256>& vEvictedTx)
+{
+    CTxPoolView& txView = forkPool.txView;
+    vEvictedTx.clear();
+    CTxPoolScore score(0,0);
+    while (txView.GetMemoryUsage() > nTargetUsage && txView.GetLowestScore(score)
+           && (vEvictedTx.empty() || score.nFeePerKB <= nMaxFeePerKB))
+    {
+        txView.Evict(vEvictedTx);
+    }
+    for (const uint256& txid : vEvictedTx)
+    {
+        forkPool.mapTx.erase(txid);
+        dirTx.Erase(txid);
+        datTxPool.Remove(hashFork,txid);
+    }
+}
+
+void CTxPool::AddForkPool(const uint256& hashFork)
+{
+    {
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        if (mapForkPool.count(hashFork))
+        {
+            return;
+        }
+    }
+    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
+    mapForkPool[hashFork];
 }
 
-MvErr CTxPool::AddNew(CTxPoolView& txView,const uint256& txid,const CTransaction& tx,const uint256& hashFork,const int32 nForkHeight)
+CForkTxPool* CTxPool::GetForkPool(const uint256& hashFork)
 {
+    map<uint256,CForkTxPool>::iterator it = mapForkPool.find(hashFork);
+    return (it != mapForkPool.end() ? &(*it).second : NULL);
+}
+
+MvErr CTxPool::AddNew(CForkTxPool& forkPool,const uint256& txid,const CTransaction& tx,const uint256& hashFork,const int32 nForkHeight)
+{
+    CTxPoolView& txView = forkPool.txView;
     vector<CTxOutput> vPrevOutput;
     vPrevOutput.resize(tx.vInput.size());
     for (int i = 0;i < tx.vInput.size();i++)
@@ -670,10 +837,134 @@ MvErr CTxPool::AddNew(CTxPoolView& txView,const uint256& txid,const CTransaction
         return err;
     }
     
-    CDestination destIn = vPrevOutput[0].destTo;
-    map<uint256,CPooledTx>::iterator mi;
-    mi = mapTx.insert(make_pair(txid,CPooledTx(tx,-1,GetSequenceNumber(),destIn,nValueIn))).first;
-    txView.AddNew(txid,(*mi).second);
+    AddVerified(forkPool,txid,tx,hashFork,vPrevOutput[0].destTo,nValueIn);
 
     return MV_OK;
 }
+
+void CTxPool::AddNewBatch(CForkTxPool& forkPool,const uint256& hashFork,vector<CTxPoolBatchTx*>& vBatchTx)
+{
+    CTxPoolView& txView = forkPool.txView;
+
+    vector<CTxPoolBatchTx*> vPending;
+    for (CTxPoolBatchTx* pBatchTx : vBatchTx)
+    {
+        if (forkPool.mapTx.count(pBatchTx->txid))
+        {
+            pBatchTx->err = MV_ERR_ALREADY_HAVE;
+        }
+        else
+        {
+            vPending.push_back(pBatchTx);
+        }
+    }
+    if (vPending.empty())
+    {
+        return;
+    }
+
+    // one storage pass for every input the pool cannot answer
+    vector<CTxIn> vInput;
+    for (CTxPoolBatchTx* pBatchTx : vPending)
+    {
+        for (const CTxIn& txin : pBatchTx->tx.vInput)
+        {
+            CTxOutput output;
+            if (!txView.IsSpent(txin.prevout) && !txView.GetUnspent(txin.prevout,output))
+            {
+                vInput.push_back(txin);
+            }
+        }
+    }
+    vector<CTxOutput> vOutput;
+    bool fStored = pWorldLine->GetTxUnspent(hashFork,vInput,vOutput);
+    map<CTxOutPoint,CTxOutput> mapStored;
+    for (size_t i = 0;fStored && i < vInput.size();i++)
+    {
+        mapStored[vInput[i].prevout] = vOutput[i];
+    }
+
+    // resolve inputs as if every tx before was accepted, then verify those in parallel
+    map<CTxOutPoint,CTxOutput> mapBatchOutput;
+    set<CTxOutPoint> setBatchSpent;
+    vector<CTxPoolBatchTx*> vPrepared;
+    for (CTxPoolBatchTx* pBatchTx : vPending)
+    {
+        const CTransaction& tx = pBatchTx->tx;
+        if (GetBatchPrevOutput(txView,mapBatchOutput,setBatchSpent,mapStored,fStored,tx,pBatchTx->vPrevOutput) != MV_OK)
+        {
+            continue;
+        }
+        pBatchTx->fPrepared = true;
+        pBatchTx->errVerify = MV_FAILED;
+        vPrepared.push_back(pBatchTx);
+
+        int64 nValueIn = 0;
+        for (const CTxOutput& output : pBatchTx->vPrevOutput)
+        {
+            nValueIn += output.nAmount;
+        }
+        CAssembledTx txAssembled(tx,-1,pBatchTx->vPrevOutput[0].destTo,nValueIn);
+        for (const CTxIn& txin : tx.vInput)
+        {
+            setBatchSpent.insert(txin.prevout);
+        }
+        mapBatchOutput[CTxOutPoint(pBatchTx->txid,0)] = txAssembled.GetOutput(0);
+        mapBatchOutput[CTxOutPoint(pBatchTx->txid,1)] = txAssembled.GetOutput(1);
+    }
+
+    // a job that throws leaves errVerify failed, its tx is rejected below
+    if (!spVerifyPool->Run(vPrepared.size(),[&](size_t n) {
+            CTxPoolBatchTx* pBatchTx = vPrepared[n];
+            pBatchTx->errVerify = pCoreProtocol->VerifyTransaction(pBatchTx->tx,pBatchTx->vPrevOutput,pBatchTx->nHeight);
+        }))
+    {
+        WalleveLog("PushBatch : transaction verification aborted\n");
+    }
+
+    // accept in batch order, a tx whose inputs changed because an earlier one failed is verified again
+    const map<CTxOutPoint,CTxOutput> mapNone;
+    const set<CTxOutPoint> setNone;
+    for (CTxPoolBatchTx* pBatchTx : vPending)
+    {
+        const CTransaction& tx = pBatchTx->tx;
+        vector<CTxOutput> vPrevOutput;
+        pBatchTx->err = GetBatchPrevOutput(txView,mapNone,setNone,mapStored,fStored,tx,vPrevOutput);
+        if (pBatchTx->err != MV_OK)
+        {
+            continue;
+        }
+
+        if (pBatchTx->fPrepared && IsSamePrevOutput(vPrevOutput,pBatchTx->vPrevOutput))
+        {
+            pBatchTx->err = pBatchTx->errVerify;
+        }
+        else
+        {
+            pBatchTx->err = pCoreProtocol->VerifyTransaction(tx,vPrevOutput,pBatchTx->nHeight);
+        }
+        if (pBatchTx->err != MV_OK)
+        {
+            continue;
+        }
+
+        int64 nValueIn = 0;
+        for (const CTxOutput& output : vPrevOutput)
+        {
+            nValueIn += output.nAmount;
+        }
+        pBatchTx->result.destIn = vPrevOutput[0].destTo;
+        pBatchTx->result.nValueIn = nValueIn;
+        AddVerified(forkPool,pBatchTx->txid,tx,hashFork,pBatchTx->result.destIn,nValueIn);
+    }
+}
+
+void CTxPool::AddVerified(CForkTxPool& forkPool,const uint256& txid,const CTransaction& tx,const uint256& hashFork,
+                          const CDestination& destIn,int64 nValueIn)
+{
+    map<uint256,CPooledTx>::iterator mi;
+    mi = forkPool.mapTx.insert(make_pair(txid,CPooledTx(tx,-1,forkPool.GetSequenceNumber(),destIn,nValueIn))).first;
+    forkPool.txView.AddNew(txid,(*mi).second);
+    dirTx.Insert(txid,hashFork);
+    datTxPool.AddNew(hashFork,txid,(*mi).second);
+}
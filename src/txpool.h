@@ -7,151 +7,103 @@
 
 #include "mvbase.h"
 #include "txpooldata.h"
+#include "txpoolview.h"
+#include "verifypool.h"
 
 namespace multiverse
 {
 
-class CPooledTx : public CAssembledTx
+// One fork's share of the pool, with its own lock
+class CForkTxPool
 {
 public:
-    std::size_t nSequenceNumber;
-    std::size_t nSerializeSize;
-public:
-    CPooledTx() { SetNull(); }
-    CPooledTx(const CAssembledTx& tx,std::size_t nSequenceNumberIn)
-    : CAssembledTx(tx),nSequenceNumber(nSequenceNumberIn)
-    {
-        nSerializeSize = walleve::GetSerializeSize(static_cast<const CTransaction&>(tx));
-    }
-    CPooledTx(const CTransaction& tx,const int32 nBlockHeightIn,std::size_t nSequenceNumberIn,const CDestination& destInIn=CDestination(),int64 nValueInIn=0)
-    : CAssembledTx(tx,nBlockHeightIn,destInIn,nValueInIn),nSequenceNumber(nSequenceNumberIn)
-    {
-        nSerializeSize = walleve::GetSerializeSize(tx);
-    }
-    void SetNull() override
+    CForkTxPool() : nLastSequenceNumber(0) {}
+    std::size_t GetSequenceNumber()
     {
-        CAssembledTx::SetNull();
-        nSequenceNumber = 0;
-        nSerializeSize = 0;
+        if (mapTx.empty())
+        {
+            nLastSequenceNumber = 0;
+        }
+        return ++nLastSequenceNumber;
     }
+public:
+    mutable boost::shared_mutex rwAccess;
+    CTxPoolView txView;
+    std::map<uint256,CPooledTx> mapTx;
+    std::size_t nLastSequenceNumber;
 };
 
-class CTxPoolView
+// txid -> fork, striped so lookups on different txids rarely contend
+class CTxPoolDirectory
 {
 public:
-    class CSpent : public CTxOutput
-    {
-    public:
-        CSpent() : txidNextTx(uint64(0)) {}
-        CSpent(const CTxOutput& output) : CTxOutput(output),txidNextTx(uint64(0)) {}
-        CSpent(const uint256& txidNextTxIn) : txidNextTx(txidNextTxIn) {}
-        void SetSpent(const uint256& txidNextTxIn) { *this = CSpent(txidNextTxIn); }
-        void SetUnspent(const CTxOutput& output) { *this = CSpent(output); }
-        bool IsSpent() const { return (txidNextTx != 0); };
-    public:
-        uint256 txidNextTx;
-    };
-public:
-    std::size_t Count() const { return mapTx.size(); }
+    enum { BUCKET_COUNT = 16 };
     bool Exists(const uint256& txid) const
     {
-        return (!!mapTx.count(txid));
-    }
-    CPooledTx* Get(uint256 txid) const
-    {
-        std::map<uint256,CPooledTx*>::const_iterator mi = mapTx.find(txid);
-        return (mi != mapTx.end() ? (*mi).second : NULL);
+        const CBucket& bucket = GetBucket(txid);
+        boost::shared_lock<boost::shared_mutex> rlock(bucket.rwAccess);
+        return bucket.mapFork.count(txid) != 0;
     }
-    bool IsSpent(const CTxOutPoint& out) const
+    bool Find(const uint256& txid,uint256& hashFork) const
     {
-        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
-        if (it != mapSpent.end())
+        const CBucket& bucket = GetBucket(txid);
+        boost::shared_lock<boost::shared_mutex> rlock(bucket.rwAccess);
+        std::map<uint256,uint256>::const_iterator it = bucket.mapFork.find(txid);
+        if (it == bucket.mapFork.end())
         {
-            return (*it).second.IsSpent();
+            return false;
         }
-        return false;
+        hashFork = (*it).second;
+        return true;
     }
-    bool GetUnspent(const CTxOutPoint& out,CTxOutput& unspent) const
+    void Insert(const uint256& txid,const uint256& hashFork)
     {
-        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
-        if (it != mapSpent.end() && !(*it).second.IsSpent())
-        {
-            unspent = static_cast<CTxOutput>((*it).second);
-            return (!unspent.IsNull());
-        }
-        return false;     
-    }
-    bool GetSpent(const CTxOutPoint& out,uint256& txidNextTxRet) const 
-    { 
-        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
-        if (it != mapSpent.end())
-        {
-            txidNextTxRet = (*it).second.txidNextTx;
-            return (*it).second.IsSpent();
-        }
-        return false;
-    } 
-    void SetUnspent(const CTxOutPoint& out)
-    {
-        CPooledTx* pTx = Get(out.hash);
-        if (pTx != NULL)
-        {
-            mapSpent[out].SetUnspent(pTx->GetOutput(out.n));
-        }
-        else
-        {
-            mapSpent.erase(out);
-        }
+        CBucket& bucket = GetBucket(txid);
+        boost::unique_lock<boost::shared_mutex> wlock(bucket.rwAccess);
+        bucket.mapFork[txid] = hashFork;
     }
-    void SetSpent(const CTxOutPoint& out,const uint256& txidNextTxIn)
+    void Erase(const uint256& txid)
     {
-        mapSpent[out].SetSpent(txidNextTxIn);
+        CBucket& bucket = GetBucket(txid);
+        boost::unique_lock<boost::shared_mutex> wlock(bucket.rwAccess);
+        bucket.mapFork.erase(txid);
     }
-    void AddNew(const uint256& txid,CPooledTx& tx)
+    void Clear()
     {
-        mapTx[txid] = &tx;
-        for (std::size_t i = 0;i < tx.vInput.size();i++)
-        {
-            mapSpent[tx.vInput[i].prevout].SetSpent(txid);
-        }
-        CTxOutput output;
-        output = tx.GetOutput(0);
-        if (!output.IsNull())
+        for (int i = 0;i < BUCKET_COUNT;i++)
         {
-            mapSpent[CTxOutPoint(txid,0)].SetUnspent(output);
-        }
-        output = tx.GetOutput(1); 
-        if (!output.IsNull())
-        {
-            mapSpent[CTxOutPoint(txid,1)].SetUnspent(output);
+            boost::unique_lock<boost::shared_mutex> wlock(vBucket[i].rwAccess);
+            vBucket[i].mapFork.clear();
         }
     }
-    void Remove(const uint256& txid)
-    {
-        CPooledTx *pTx = Get(txid);
-        if (pTx != NULL)
-        {
-            for (std::size_t i = 0;i < pTx->vInput.size();i++)
-            {
-                SetUnspent(pTx->vInput[i].prevout);
-            }
-            mapTx.erase(txid);
-        } 
-    }
-    void Clear() 
+protected:
+    class CBucket
     {
-        mapTx.clear();
-        mapSpent.clear();
-    }
-    void InvalidateSpent(const CTxOutPoint& out,std::vector<uint256>& vInvolvedTx);
-    void GetSortedTx(std::map<std::size_t,std::pair<uint256,CPooledTx*> >& mapSorted);
-    void GetInvolvedTx(std::map<std::size_t,std::pair<uint256,CPooledTx*> >& mapInvolvedTx,
-                       std::set<CDestination>& setDest);
-    void ArrangeBlockTx(std::map<std::size_t,std::pair<uint256,CPooledTx*> >& mapArrangedTx,std::size_t nMaxSize);
-    void ArrangeBlockTx(std::vector<CTransaction>& vtx,int64& nTotalTxFee,int64 nBlockTime,std::size_t nMaxSize);
+    public:
+        mutable boost::shared_mutex rwAccess;
+        std::map<uint256,uint256> mapFork;
+    };
+    CBucket& GetBucket(const uint256& txid) { return vBucket[txid.Get64(0) & (BUCKET_COUNT - 1)]; }
+    const CBucket& GetBucket(const uint256& txid) const { return vBucket[txid.Get64(0) & (BUCKET_COUNT - 1)]; }
+protected:
+    CBucket vBucket[BUCKET_COUNT];
+};
+
+// Working state of one tx in CTxPool::PushBatch
+class CTxPoolBatchTx
+{
 public:
-    std::map<uint256,CPooledTx*> mapTx;
-    std::map<CTxOutPoint,CSpent> mapSpent;
+    CTxPoolBatchTx(const CTransaction& txIn,const uint256& txidIn,int32 nHeightIn)
+    : tx(txIn),txid(txidIn),nHeight(nHeightIn),fPrepared(false),errVerify(MV_OK),err(MV_OK) {}
+public:
+    const CTransaction& tx;
+    uint256 txid;
+    int32 nHeight;
+    bool fPrepared;
+    std::vector<CTxOutput> vPrevOutput;
+    MvErr errVerify;
+    MvErr err;
+    CTxPushResult result;
 };
 
 class CTxPool : public ITxPool
@@ -162,7 +114,9 @@ public:
     bool Exists(const uint256& txid) override;
     void Clear() override;
     std::size_t Count(const uint256& fork) const override;
+    void GetMemoryUsage(const uint256& hashFork,std::size_t& nForkUsage,std::size_t& nTotalUsage) const override;
     MvErr Push(const CTransaction& tx,uint256& hashFork,CDestination& destIn,int64& nValueIn) override;
+    void PushBatch(const std::vector<CTransaction>& vtx,std::vector<MvErr>& vErr,std::vector<CTxPushResult>& vResult) override;
     void Pop(const uint256& txid) override;
     bool Get(const uint256& txid,CTransaction& tx) const override;
     void ListTx(const uint256& hashFork,std::vector<std::pair<uint256,std::size_t> >& vTxPool) override;
@@ -179,23 +133,37 @@ protected:
     void WalleveHandleHalt() override;
     bool LoadData();
     bool SaveData();
-    MvErr AddNew(CTxPoolView& txView,const uint256& txid,const CTransaction& tx,const uint256& hashFork,const int32 nForkHeight);
-    std::size_t GetSequenceNumber()
+    void CommitData();
+    void TrimMemory();
+    void EvictForkPool(CForkTxPool& forkPool,const uint256& hashFork,std::size_t nTargetUsage,int64 nMaxFeePerKB,
+                       std::vector<uint256>& vEvictedTx);
+    void AddForkPool(const uint256& hashFork);
+    CForkTxPool* GetForkPool(const uint256& hashFork);
+    MvErr AddNew(CForkTxPool& forkPool,const uint256& txid,const CTransaction& tx,const uint256& hashFork,const int32 nForkHeight);
+    void AddNewBatch(CForkTxPool& forkPool,const uint256& hashFork,std::vector<CTxPoolBatchTx*>& vBatchTx);
+    void AddVerified(CForkTxPool& forkPool,const uint256& txid,const CTransaction& tx,const uint256& hashFork,
+                     const CDestination& destIn,int64 nValueIn);
+protected:
+    // Commits the journal when leaving a mutating call, after the locks taken below it are released
+    class CDataCommit
     {
-        if (mapTx.empty())
-        {
-            nLastSequenceNumber = 0;
-        }
-        return ++nLastSequenceNumber;
-    }
+    public:
+        CDataCommit(CTxPool* pTxPoolIn) : pTxPool(pTxPoolIn) {}
+        ~CDataCommit() { pTxPool->CommitData(); }
+    protected:
+        CTxPool* pTxPool;
+    };
 protected:
     storage::CTxPoolData datTxPool;
+    boost::mutex mtxCompact;
     mutable boost::shared_mutex rwAccess;
     ICoreProtocol* pCoreProtocol;
     IWorldLine* pWorldLine;
-    std::map<uint256,CTxPoolView> mapPoolView;
-    std::map<uint256,CPooledTx> mapTx;
-    std::size_t nLastSequenceNumber;
+    std::map<uint256,CForkTxPool> mapForkPool;
+    CTxPoolDirectory dirTx;
+    boost::shared_ptr<CVerifyPool> spVerifyPool;
+    std::size_t nMaxMemoryUsage;
+    std::size_t nMaxForkMemoryUsage;
 };
 
 } // namespace multiverse
@@ -0,0 +1,313 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txpoolview.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+using namespace multiverse;
+
+//////////////////////////////
+// CTxPoolView
+
+void CTxPoolView::Evict(vector<uint256>& vEvictedTx)
+{
+    // the lowest package goes first, along with whatever spends it
+    if (mapTxScore.empty())
+    {
+        return;
+    }
+    uint256 txid = (*mapTxScore.rbegin()).second.first;
+    Remove(txid);
+    vEvictedTx.push_back(txid);
+    InvalidateSpent(CTxOutPoint(txid,0),vEvictedTx);
+    InvalidateSpent(CTxOutPoint(txid,1),vEvictedTx);
+}
+
+void CTxPoolView::InvalidateSpent(const CTxOutPoint& out,vector<uint256>& vInvolvedTx)
+{
+    vector<CTxOutPoint> vOutPoint;
+    vOutPoint.push_back(out);
+    for (std::size_t i = 0;i < vOutPoint.size();i++)
+    {
+        uint256 txidNextTx;
+        if (GetSpent(vOutPoint[i],txidNextTx))
+        {
+            CPooledTx* pNextTx = NULL;
+            if ((pNextTx = Get(txidNextTx)) != NULL)
+            {
+                for(const CTxIn& txin : pNextTx->vInput)
+                {
+                    SetUnspent(txin.prevout);
+                }
+                CTxOutPoint out0(txidNextTx,0);
+                if (IsSpent(out0))
+                {
+                    vOutPoint.push_back(out0);
+                }
+                else
+                {
+                    mapSpent.erase(out0);
+                }
+                CTxOutPoint out1(txidNextTx,1);
+                if (IsSpent(out1))
+                {
+                    vOutPoint.push_back(out1);
+                }
+                else
+                {
+                    mapSpent.erase(out1);
+                }
+                Erase(txidNextTx,pNextTx);
+                vInvolvedTx.push_back(txidNextTx);
+            }
+        }
+    }
+}
+ 
+void CTxPoolView::GetInvolvedTx(map<size_t,pair<uint256,CPooledTx*> >& mapInvolvedTx,
+                                set<CDestination>& setDest)
+{
+    for (map<uint256,CPooledTx*>::iterator mi = mapTx.begin();mi != mapTx.end(); ++mi)
+    {
+        CPooledTx* pPooledTx = (*mi).second;
+        if (setDest.count(pPooledTx->sendTo) || setDest.count(pPooledTx->destIn))
+        {
+            mapInvolvedTx.insert(make_pair(pPooledTx->nSequenceNumber,(*mi)));
+        }
+    }
+}
+
+void CTxPoolView::ArrangeBlockTx(vector<CTransaction>& vtx,int64& nTotalTxFee,int64 nBlockTime,size_t nMaxSize)
+{
+    nTotalTxFee = 0;
+
+    // txs whose ancestors were arranged into this block compete again with the rest of their package
+    map<CTxPoolScore,pair<uint256,CPooledTx*> > mapModified;
+    unordered_map<const CPooledTx*,CTxPoolScore> mapModifiedScore;
+    // keyed by the pooled tx, hashing a pointer is cheaper than ordering txids
+    unordered_set<const CPooledTx*> setArranged;
+    size_t nTotalSize = 0;
+    size_t nFailed = 0;
+    map<CTxPoolScore,pair<uint256,CPooledTx*> >::iterator it = mapTxScore.begin();
+    while (nTotalSize + MIN_TOKEN_TX_SIZE <= nMaxSize && nFailed < MAX_ARRANGE_FAILED)
+    {
+        while (it != mapTxScore.end() 
+               && (setArranged.count((*it).second.second) || mapModifiedScore.count((*it).second.second)))
+        {
+            ++it;
+        }
+
+        pair<uint256,CPooledTx*> candidate;
+        if (!mapModified.empty() && (it == mapTxScore.end() || (*mapModified.begin()).first < (*it).first))
+        {
+            candidate = (*mapModified.begin()).second;
+            mapModifiedScore.erase(candidate.second);
+            mapModified.erase(mapModified.begin());
+        }
+        else if (it != mapTxScore.end())
+        {
+            candidate = (*it).second;
+            ++it;
+        }
+        else
+        {
+            break;
+        }
+
+        vector<pair<uint256,CPooledTx*> > vPackage;
+        if (!GetArrangedPackage(candidate.first,candidate.second,setArranged,nBlockTime,nMaxSize - nTotalSize,vPackage))
+        {
+            nFailed++;
+            continue;
+        }
+
+        for (size_t i = 0;i < vPackage.size();i++)
+        {
+            CPooledTx* pTx = vPackage[i].second;
+            vtx.push_back(*static_cast<CTransaction*>(pTx));
+            nTotalSize += pTx->nSerializeSize;
+            nTotalTxFee += pTx->nTxFee;
+            setArranged.insert(pTx);
+        }
+
+        for (size_t i = 0;i < vPackage.size();i++)
+        {
+            for (int n = 0;n < 2;n++)
+            {
+                // most txs have no pooled children, the spent bits save the lookups
+                uint256 txidNextTx;
+                CPooledTx* pNextTx = NULL;
+                if (!(vPackage[i].second->nSpentOutput & (1U << n))
+                    || !GetSpent(CTxOutPoint(vPackage[i].first,n),txidNextTx)
+                    || (pNextTx = Get(txidNextTx)) == NULL || setArranged.count(pNextTx))
+                {
+                    continue;
+                }
+                unordered_map<const CPooledTx*,CTxPoolScore>::iterator mi = mapModifiedScore.find(pNextTx);
+                if (mi != mapModifiedScore.end())
+                {
+                    mapModified.erase((*mi).second);
+                    mapModifiedScore.erase(mi);
+                }
+                size_t nPackageTx;
+                int64 nPackageFee;
+                size_t nPackageSize;
+                if (GetPackage(pNextTx,&setArranged,nPackageTx,nPackageFee,nPackageSize))
+                {
+                    CTxPoolScore score((nPackageFee << 10) / nPackageSize,pNextTx->nSequenceNumber);
+                    mapModified.insert(make_pair(score,make_pair(txidNextTx,pNextTx)));
+                    mapModifiedScore.insert(make_pair(pNextTx,score));
+                }
+            }
+        }
+    }
+}
+
+size_t CTxPoolView::GetTxMemoryUsage(const CPooledTx& tx)
+{
+    // the tx body in CForkTxPool::mapTx, its entries in the view and the directory,
+    // and the spent/unspent records of its inputs and outputs
+    size_t nOutput = (tx.GetOutput(0).IsNull() ? 0 : 1) + (tx.GetOutput(1).IsNull() ? 0 : 1);
+    return (MapNodeUsage<uint256,CPooledTx>()
+            + MallocUsage(tx.vInput.capacity() * sizeof(CTxIn))
+            + MallocUsage(tx.vchData.capacity())
+            + MallocUsage(tx.vchSig.capacity())
+            + MapNodeUsage<uint256,CPooledTx*>()
+            + MapNodeUsage<size_t,pair<uint256,CPooledTx*> >()
+            + MapNodeUsage<CTxPoolScore,pair<uint256,CPooledTx*> >()
+            + MapNodeUsage<uint256,uint256>()
+            + (tx.vInput.size() + nOutput) * MapNodeUsage<CTxOutPoint,CSpent>());
+}
+
+bool CTxPoolView::GetPackage(const CPooledTx* pTx,const unordered_set<const CPooledTx*>* pExclude,
+                             size_t& nPackageTx,int64& nPackageFee,size_t& nPackageSize)
+{
+    nPackageTx = 1;
+    nPackageFee = pTx->nTxFee;
+    nPackageSize = pTx->nSerializeSize;
+    // at most MAX_PACKAGE_TX entries, a linear scan is cheaper than a set
+    vector<const CPooledTx*> vAncestor(1,pTx);
+    for (size_t i = 0;i < vAncestor.size();i++)
+    {
+        for(const CTxIn& txin : vAncestor[i]->vInput)
+        {
+            CPooledTx* pPrevTx = Get(txin.prevout.hash);
+            if (pPrevTx != NULL && (pExclude == NULL || !pExclude->count(pPrevTx))
+                && find(vAncestor.begin(),vAncestor.end(),pPrevTx) == vAncestor.end())
+            {
+                if (++nPackageTx > MAX_PACKAGE_TX)
+                {
+                    return false;
+                }
+                nPackageFee += pPrevTx->nTxFee;
+                nPackageSize += pPrevTx->nSerializeSize;
+                vAncestor.push_back(pPrevTx);
+            }
+        }
+    }
+    return true;
+}
+
+void CTxPoolView::UpdatePackage(const uint256& txid,CPooledTx* pTx)
+{
+    mapTxScore.erase(CTxPoolScore(*pTx));
+
+    size_t nPackageTx;
+    int64 nPackageFee;
+    size_t nPackageSize;
+    if (GetPackage(pTx,NULL,nPackageTx,nPackageFee,nPackageSize))
+    {
+        pTx->SetPackage(nPackageTx,nPackageFee,nPackageSize);
+        mapTxScore.insert(make_pair(CTxPoolScore(*pTx),make_pair(txid,pTx)));
+    }
+    else
+    {
+        // left to block assembly, which reaches it once enough ancestors are arranged
+        pTx->SetPackage(0,pTx->nTxFee,pTx->nSerializeSize);
+    }
+}
+
+void CTxPoolView::UpdateDescendantPackage(const uint256& txid,const CPooledTx* pRemovedTx)
+{
+    // descendants of a tx past the package limit are past it as well, so the walk stops there.
+    // A removed tx was counted once in every packaged descendant and is taken off directly
+    set<uint256> setVisited;
+    vector<uint256> vDescendant(1,txid);
+    for (size_t i = 0;i < vDescendant.size();i++)
+    {
+        for (int n = 0;n < 2;n++)
+        {
+            uint256 txidNextTx;
+            CPooledTx* pNextTx = NULL;
+            if (GetSpent(CTxOutPoint(vDescendant[i],n),txidNextTx) && (pNextTx = Get(txidNextTx)) != NULL
+                && setVisited.insert(txidNextTx).second)
+            {
+                bool fPackaged = (pNextTx->nPackageTx != 0);
+                if (fPackaged && pRemovedTx != NULL)
+                {
+                    mapTxScore.erase(CTxPoolScore(*pNextTx));
+                    pNextTx->SetPackage(pNextTx->nPackageTx - 1,pNextTx->nPackageFee - pRemovedTx->nTxFee,
+                                        pNextTx->nPackageSize - pRemovedTx->nSerializeSize);
+                    mapTxScore.insert(make_pair(CTxPoolScore(*pNextTx),make_pair(txidNextTx,pNextTx)));
+                }
+                else
+                {
+                    UpdatePackage(txidNextTx,pNextTx);
+                }
+                if (fPackaged || pNextTx->nPackageTx != 0)
+                {
+                    vDescendant.push_back(txidNextTx);
+                }
+            }
+        }
+    }
+}
+
+bool CTxPoolView::GetArrangedPackage(const uint256& txid,CPooledTx* pTx,const unordered_set<const CPooledTx*>& setArranged,
+                                     int64 nBlockTime,size_t nMaxSize,vector<pair<uint256,CPooledTx*> >& vPackage)
+{
+    // depth-first over pooled ancestors not yet arranged, emitting parents before children
+    size_t nSize = pTx->nSerializeSize;
+    if (pTx->GetTxTime() > nBlockTime || nSize > nMaxSize)
+    {
+        return false;
+    }
+    if (pTx->nPackageTx == 1)
+    {
+        vPackage.push_back(make_pair(txid,pTx));
+        return true;
+    }
+
+    vector<CPooledTx*> vVisited(1,pTx);
+    vector<pair<pair<uint256,CPooledTx*>,size_t> > vStack;
+    vStack.push_back(make_pair(make_pair(txid,pTx),0));
+    while (!vStack.empty())
+    {
+        CPooledTx* pCurTx = vStack.back().first.second;
+        if (vStack.back().second < pCurTx->vInput.size())
+        {
+            const uint256& txidPrev = pCurTx->vInput[vStack.back().second++].prevout.hash;
+            CPooledTx* pPrevTx = Get(txidPrev);
+            if (pPrevTx != NULL && !setArranged.count(pPrevTx)
+                && find(vVisited.begin(),vVisited.end(),pPrevTx) == vVisited.end())
+            {
+                vVisited.push_back(pPrevTx);
+                nSize += pPrevTx->nSerializeSize;
+                if (pPrevTx->GetTxTime() > nBlockTime || nSize > nMaxSize || vVisited.size() > MAX_PACKAGE_TX)
+                {
+                    return false;
+                }
+                vStack.push_back(make_pair(make_pair(txidPrev,pPrevTx),0));
+            }
+        }
+        else
+        {
+            vPackage.push_back(vStack.back().first);
+            vStack.pop_back();
+        }
+    }
+    return true;
+}
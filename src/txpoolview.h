@@ -0,0 +1,284 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_TXPOOLVIEW_H
+#define  MULTIVERSE_TXPOOLVIEW_H
+
+#include "param.h"
+#include "transaction.h"
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+namespace multiverse
+{
+
+// Heap bytes taken by an allocation of n bytes, rounded the way glibc malloc does on 64-bit
+inline std::size_t MallocUsage(std::size_t n)
+{
+    return (n != 0 ? ((n + 31) >> 4) << 4 : 0);
+}
+
+// A std::map node holds the value after the red-black tree links
+template <typename K,typename V>
+inline std::size_t MapNodeUsage()
+{
+    return MallocUsage(sizeof(std::pair<const K,V>) + 4 * sizeof(void*));
+}
+
+class CPooledTx : public CAssembledTx
+{
+public:
+    std::size_t nSequenceNumber;
+    std::size_t nSerializeSize;
+    std::size_t nMemoryUsage;
+    std::size_t nPackageTx;
+    int64 nPackageFee;
+    std::size_t nPackageSize;
+    uint32 nSpentOutput;    // bit n is set while output n is spent by a pooled tx
+public:
+    CPooledTx() { SetNull(); }
+    CPooledTx(const CAssembledTx& tx,std::size_t nSequenceNumberIn)
+    : CAssembledTx(tx),nSequenceNumber(nSequenceNumberIn)
+    {
+        if (!IsSealed())
+        {
+            Seal();
+        }
+        nSerializeSize = walleve::GetSerializeSize(static_cast<const CTransaction&>(tx));
+        nMemoryUsage = 0;
+        nSpentOutput = 0;
+        SetPackage(1,nTxFee,nSerializeSize);
+    }
+    CPooledTx(const CTransaction& tx,const int32 nBlockHeightIn,std::size_t nSequenceNumberIn,const CDestination& destInIn=CDestination(),int64 nValueInIn=0)
+    : CAssembledTx(tx,nBlockHeightIn,destInIn,nValueInIn),nSequenceNumber(nSequenceNumberIn)
+    {
+        if (!IsSealed())
+        {
+            Seal();
+        }
+        nSerializeSize = walleve::GetSerializeSize(tx);
+        nMemoryUsage = 0;
+        nSpentOutput = 0;
+        SetPackage(1,nTxFee,nSerializeSize);
+    }
+    void SetNull() override
+    {
+        CAssembledTx::SetNull();
+        nSequenceNumber = 0;
+        nSerializeSize = 0;
+        nMemoryUsage = 0;
+        nSpentOutput = 0;
+        SetPackage(0,0,0);
+    }
+    void SetPackage(std::size_t nPackageTxIn,int64 nPackageFeeIn,std::size_t nPackageSizeIn)
+    {
+        nPackageTx = nPackageTxIn;
+        nPackageFee = nPackageFeeIn;
+        nPackageSize = nPackageSizeIn;
+    }
+    int64 GetPackageFeePerKB() const
+    {
+        return (nPackageSize != 0 ? (nPackageFee << 10) / nPackageSize : 0);
+    }
+};
+
+// Orders pooled txs by package fee rate, higher first, then by arrival
+class CTxPoolScore
+{
+public:
+    CTxPoolScore(const CPooledTx& tx) : nFeePerKB(tx.GetPackageFeePerKB()),nSequenceNumber(tx.nSequenceNumber) {}
+    CTxPoolScore(int64 nFeePerKBIn,std::size_t nSequenceNumberIn) : nFeePerKB(nFeePerKBIn),nSequenceNumber(nSequenceNumberIn) {}
+    friend bool operator<(const CTxPoolScore& a,const CTxPoolScore& b)
+    {
+        return (a.nFeePerKB > b.nFeePerKB || (a.nFeePerKB == b.nFeePerKB && a.nSequenceNumber < b.nSequenceNumber));
+    }
+public:
+    int64 nFeePerKB;
+    std::size_t nSequenceNumber;
+};
+
+class CTxPoolView
+{
+public:
+    class CSpent : public CTxOutput
+    {
+    public:
+        CSpent() : txidNextTx(uint64(0)) {}
+        CSpent(const CTxOutput& output) : CTxOutput(output),txidNextTx(uint64(0)) {}
+        CSpent(const uint256& txidNextTxIn) : txidNextTx(txidNextTxIn) {}
+        void SetSpent(const uint256& txidNextTxIn) { *this = CSpent(txidNextTxIn); }
+        void SetUnspent(const CTxOutput& output) { *this = CSpent(output); }
+        bool IsSpent() const { return (txidNextTx != 0); };
+    public:
+        uint256 txidNextTx;
+    };
+    // a package is the tx with its pooled ancestors, txs with deeper chains are not indexed
+    enum { MAX_PACKAGE_TX = 25 };
+    // block assembly gives up after this many packages did not fit
+    enum { MAX_ARRANGE_FAILED = 1000 };
+public:
+    CTxPoolView() : nMemoryUsage(0) {}
+    std::size_t Count() const { return mapTx.size(); }
+    std::size_t GetMemoryUsage() const { return nMemoryUsage; }
+    bool Exists(const uint256& txid) const
+    {
+        return (!!mapTx.count(txid));
+    }
+    CPooledTx* Get(uint256 txid) const
+    {
+        std::map<uint256,CPooledTx*>::const_iterator mi = mapTx.find(txid);
+        return (mi != mapTx.end() ? (*mi).second : NULL);
+    }
+    bool IsSpent(const CTxOutPoint& out) const
+    {
+        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
+        if (it != mapSpent.end())
+        {
+            return (*it).second.IsSpent();
+        }
+        return false;
+    }
+    bool GetUnspent(const CTxOutPoint& out,CTxOutput& unspent) const
+    {
+        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
+        if (it != mapSpent.end() && !(*it).second.IsSpent())
+        {
+            unspent = static_cast<CTxOutput>((*it).second);
+            return (!unspent.IsNull());
+        }
+        return false;     
+    }
+    bool GetSpent(const CTxOutPoint& out,uint256& txidNextTxRet) const 
+    { 
+        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
+        if (it != mapSpent.end())
+        {
+            txidNextTxRet = (*it).second.txidNextTx;
+            return (*it).second.IsSpent();
+        }
+        return false;
+    } 
+    void SetUnspent(const CTxOutPoint& out)
+    {
+        CPooledTx* pTx = Get(out.hash);
+        if (pTx != NULL)
+        {
+            mapSpent[out].SetUnspent(pTx->GetOutput(out.n));
+            pTx->nSpentOutput &= ~(1U << out.n);
+        }
+        else
+        {
+            mapSpent.erase(out);
+        }
+    }
+    void SetSpent(const CTxOutPoint& out,const uint256& txidNextTxIn)
+    {
+        mapSpent[out].SetSpent(txidNextTxIn);
+        CPooledTx* pTx = Get(out.hash);
+        if (pTx != NULL)
+        {
+            pTx->nSpentOutput |= (1U << out.n);
+        }
+    }
+    void AddNew(const uint256& txid,CPooledTx& tx)
+    {
+        tx.nMemoryUsage = GetTxMemoryUsage(tx);
+        nMemoryUsage += tx.nMemoryUsage;
+        mapTx[txid] = &tx;
+        for (std::size_t i = 0;i < tx.vInput.size();i++)
+        {
+            SetSpent(tx.vInput[i].prevout,txid);
+        }
+        // outputs may already be spent by pooled txs when a tx comes back from a detached block
+        tx.nSpentOutput = 0;
+        for (uint32 n = 0;n < 2;n++)
+        {
+            CTxOutPoint out(txid,n);
+            CTxOutput output = tx.GetOutput(n);
+            if (IsSpent(out))
+            {
+                tx.nSpentOutput |= (1U << n);
+            }
+            else if (!output.IsNull())
+            {
+                mapSpent[out].SetUnspent(output);
+            }
+        }
+        mapTxSeq.insert(std::make_pair(tx.nSequenceNumber,std::make_pair(txid,&tx)));
+        UpdatePackage(txid,&tx);
+        UpdateDescendantPackage(txid);
+    }
+    void Remove(const uint256& txid)
+    {
+        CPooledTx *pTx = Get(txid);
+        if (pTx != NULL)
+        {
+            for (std::size_t i = 0;i < pTx->vInput.size();i++)
+            {
+                SetUnspent(pTx->vInput[i].prevout);
+            }
+            // outputs nobody in the pool spends are no longer needed
+            for (uint32 n = 0;n < 2;n++)
+            {
+                std::map<CTxOutPoint,CSpent>::iterator it = mapSpent.find(CTxOutPoint(txid,n));
+                if (it != mapSpent.end() && !(*it).second.IsSpent())
+                {
+                    mapSpent.erase(it);
+                }
+            }
+            Erase(txid,pTx);
+            UpdateDescendantPackage(txid,pTx);
+        } 
+    }
+    void Clear() 
+    {
+        mapTx.clear();
+        mapSpent.clear();
+        mapTxSeq.clear();
+        mapTxScore.clear();
+        nMemoryUsage = 0;
+    }
+    bool GetLowestScore(CTxPoolScore& score) const
+    {
+        if (mapTxScore.empty())
+        {
+            return false;
+        }
+        score = (*mapTxScore.rbegin()).first;
+        return true;
+    }
+    void Evict(std::vector<uint256>& vEvictedTx);
+    void InvalidateSpent(const CTxOutPoint& out,std::vector<uint256>& vInvolvedTx);
+    void GetInvolvedTx(std::map<std::size_t,std::pair<uint256,CPooledTx*> >& mapInvolvedTx,
+                       std::set<CDestination>& setDest);
+    void ArrangeBlockTx(std::vector<CTransaction>& vtx,int64& nTotalTxFee,int64 nBlockTime,std::size_t nMaxSize);
+protected:
+    void Erase(const uint256& txid,CPooledTx* pTx)
+    {
+        nMemoryUsage -= pTx->nMemoryUsage;
+        mapTxScore.erase(CTxPoolScore(*pTx));
+        mapTxSeq.erase(pTx->nSequenceNumber);
+        mapTx.erase(txid);
+    }
+    static std::size_t GetTxMemoryUsage(const CPooledTx& tx);
+    bool GetPackage(const CPooledTx* pTx,const std::unordered_set<const CPooledTx*>* pExclude,
+                    std::size_t& nPackageTx,int64& nPackageFee,std::size_t& nPackageSize);
+    void UpdatePackage(const uint256& txid,CPooledTx* pTx);
+    void UpdateDescendantPackage(const uint256& txid,const CPooledTx* pRemovedTx = NULL);
+    bool GetArrangedPackage(const uint256& txid,CPooledTx* pTx,const std::unordered_set<const CPooledTx*>& setArranged,
+                            int64 nBlockTime,std::size_t nMaxSize,std::vector<std::pair<uint256,CPooledTx*> >& vPackage);
+public:
+    std::map<uint256,CPooledTx*> mapTx;
+    std::map<CTxOutPoint,CSpent> mapSpent;
+    std::map<std::size_t,std::pair<uint256,CPooledTx*> > mapTxSeq;
+    std::map<CTxPoolScore,std::pair<uint256,CPooledTx*> > mapTxScore;
+protected:
+    std::size_t nMemoryUsage;
+};
+
+} // namespace multiverse
+
+#endif //MULTIVERSE_TXPOOLVIEW_H
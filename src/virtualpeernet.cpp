@@ -562,6 +562,32 @@ bool CVirtualPeerNet::HandleEvent(network::CMvEventPeerBlock& eventBlock)
     return true;
 }
 
+//raw blocks go straight to p2p peers, blocks routed over dbp are handed over decoded
+bool CVirtualPeerNet::HandleEvent(network::CMvEventPeerRawBlock& eventRawBlock)
+{
+    if(typeNode == SUPER_NODE_TYPE::SUPER_NODE_TYPE_FNFN
+       || (typeNode == SUPER_NODE_TYPE::SUPER_NODE_TYPE_ROOT && SENDER_NETCHN == eventRawBlock.sender
+           && !IsSuperNodeInnerNonce(eventRawBlock.nNonce)))
+    {
+        return CMvPeerNet::HandleEvent(eventRawBlock);
+    }
+
+    network::CMvEventPeerBlock eventBlock(eventRawBlock.nNonce,eventRawBlock.hashFork,
+                                          eventRawBlock.sender,eventRawBlock.flow);
+    try
+    {
+        CWalleveBufStream ss;
+        ss << eventRawBlock.data;
+        ss >> eventBlock.data;
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+    return HandleEvent(eventBlock);
+}
+
 //only available at the level of root node which delivers ACTIVE event to super node cluster
 //by hook member function in terms of template method in design pattern
 bool CVirtualPeerNet::HandlePeerHandshakedForForkNode(const network::CMvEventPeerActive& peerActive)
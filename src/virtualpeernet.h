@@ -41,6 +41,7 @@ protected:
     bool HandleEvent(network::CMvEventPeerGetBlocks& eventGetBlocks) override;
     bool HandleEvent(network::CMvEventPeerTx& eventTx) override;
     bool HandleEvent(network::CMvEventPeerBlock& eventBlock) override;
+    bool HandleEvent(network::CMvEventPeerRawBlock& eventRawBlock) override;
 
     bool HandlePeerHandshakedForForkNode(const network::CMvEventPeerActive& peerActive) override;
     bool DestroyPeerForForkNode(const network::CMvEventPeerDeactive& peerDeactive) override;
@@ -58,6 +58,13 @@ bool CWorldLine::WalleveHandleInvoke()
         return false;
     }
 
+    spVerifyPool = CVerifyPool::GetInstance();
+    if (spVerifyPool == NULL)
+    {
+        WalleveError("Failed to start verify pool\n");
+        return false;
+    }
+
     if (!CheckContainer())
     {
         cntrBlock.Clear();
@@ -80,12 +87,21 @@ bool CWorldLine::WalleveHandleInvoke()
             return false;
         }
     }    
+
+    // full checking runs in background and resumes from where it stopped last time
+    if (!cntrBlock.StartConsistencyCheck(StorageConfig()->nCheckLevel, StorageConfig()->nCheckDepth))
+    {
+        WalleveError("Failed to start consistency checking\n");
+        return false;
+    }
         
     return true;
 }
 
 void CWorldLine::WalleveHandleHalt()
 {
+    spVerifyPool.reset();
+    cntrBlock.StopConsistencyCheck();
     cntrBlock.Deinitialize();
     cacheEnrolled.Clear();
     cacheAgreement.Clear();
@@ -163,39 +179,25 @@ bool CWorldLine::GetBlockLocation(const uint256& hashBlock,uint256& hashFork,int
 bool CWorldLine::GetBlockHash(const uint256& hashFork,const int32 nHeight,uint256& hashBlock)
 {
     CBlockIndex* pIndex = NULL;
-    if (!cntrBlock.RetrieveFork(hashFork,&pIndex) || pIndex->GetBlockHeight() < nHeight)
+    if (!cntrBlock.RetrieveFork(hashFork,nHeight,&pIndex))
     {
         return false;
     }
-    while (pIndex != NULL && pIndex->GetBlockHeight() > nHeight)
-    {
-        pIndex = pIndex->pPrev;
-    }
-    while (pIndex != NULL && pIndex->GetBlockHeight() == nHeight && pIndex->IsExtended())
-    {
-        pIndex = pIndex->pPrev;
-    }
-    hashBlock = !pIndex ? uint64(0) : pIndex->GetBlockHash();
-    return (pIndex != NULL);
+    hashBlock = pIndex->GetBlockHash();
+    return true;
 }
 
 bool CWorldLine::GetBlockHash(const uint256& hashFork,const int32 nHeight,vector<uint256>& vBlockHash)
 {   
-    CBlockIndex* pIndex = NULL;
-    if (!cntrBlock.RetrieveFork(hashFork,&pIndex) || pIndex->GetBlockHeight() < nHeight)
+    vector<CBlockIndex*> vIndex;
+    if (!cntrBlock.RetrieveFork(hashFork,nHeight,vIndex))
     {       
         return false;                               
     }   
-    while (pIndex != NULL && pIndex->GetBlockHeight() > nHeight)
-    {
-        pIndex = pIndex->pPrev;
-    }
-    while (pIndex != NULL && pIndex->GetBlockHeight() == nHeight)
+    for (CBlockIndex* pIndex : vIndex)
     {
         vBlockHash.push_back(pIndex->GetBlockHash());
-        pIndex = pIndex->pPrev;
     }
-    std::reverse(vBlockHash.begin(),vBlockHash.end());
     return (!vBlockHash.empty());
 }
 
@@ -243,6 +245,11 @@ bool CWorldLine::GetBlockEx(const uint256& hashBlock,CBlockEx& block)
     return cntrBlock.Retrieve(hashBlock,block);
 }
 
+bool CWorldLine::GetRawBlock(const uint256& hashBlock,vector<unsigned char>& vchBlock)
+{
+    return cntrBlock.RetrieveRaw(hashBlock,vchBlock);
+}
+
 bool CWorldLine::GetOrigin(const uint256& hashFork,CBlock& block)
 {
     return cntrBlock.RetrieveOrigin(hashFork,block);
@@ -407,6 +414,10 @@ MvErr CWorldLine::AddNewBlock(const CBlock& block,CWorldLineUpdate& update)
 
     vTxContxt.reserve(block.vtx.size());
 
+    // contextual checks walk the view in order, signatures of txs before the first failure are verified afterwards
+    vector<size_t> vVerifyTx;
+    const char* pszFailed = NULL;
+    uint256 txidFailed;
     for(const CTransaction& tx : block.vtx)
     {
         uint256 txid = tx.GetHash();
@@ -414,17 +425,20 @@ MvErr CWorldLine::AddNewBlock(const CBlock& block,CWorldLineUpdate& update)
         err = GetTxContxt(view,tx,txContxt);
         if (err != MV_OK)
         {
-            WalleveLog("AddNewBlock Get txContxt Error(%s) : %s \n",MvErrString(err),txid.ToString().c_str());
-            return err;
+            pszFailed = "Get txContxt";
+            txidFailed = txid;
+            break;
         }
         if (!pTxPool->Exists(txid))
         {
-            err = pCoreProtocol->VerifyBlockTx(tx,txContxt,pIndexPrev);
+            err = pCoreProtocol->VerifyBlockTxContext(tx,txContxt,pIndexPrev);
             if (err != MV_OK)
             {
-                WalleveLog("AddNewBlock Verify BlockTx Error(%s) : %s \n",MvErrString(err),txid.ToString().c_str());
-                return err;
+                pszFailed = "Verify BlockTx";
+                txidFailed = txid;
+                break;
             }
+            vVerifyTx.push_back(vTxContxt.size());
         }
         vTxContxt.push_back(txContxt);
         view.AddTx(txid,tx,txContxt.destIn,txContxt.GetValueIn());
@@ -432,6 +446,29 @@ MvErr CWorldLine::AddNewBlock(const CBlock& block,CWorldLineUpdate& update)
         nTotalFee += tx.nTxFee;
     }
 
+    vector<MvErr> vVerifyErr(vVerifyTx.size(),MV_OK);
+    if (!spVerifyPool->Run(vVerifyTx.size(),[&](size_t n) {
+            vVerifyErr[n] = pCoreProtocol->VerifyBlockTxSignature(block.vtx[vVerifyTx[n]],vTxContxt[vVerifyTx[n]]);
+        }))
+    {
+        WalleveLog("AddNewBlock Verify BlockTx Error : signature verification aborted, %s \n",hash.ToString().c_str());
+        return MV_FAILED;
+    }
+    for (size_t n = 0;n < vVerifyTx.size();n++)
+    {
+        if (vVerifyErr[n] != MV_OK)
+        {
+            WalleveLog("AddNewBlock Verify BlockTx Error(%s) : %s \n",MvErrString(vVerifyErr[n]),
+                       block.vtx[vVerifyTx[n]].GetHash().ToString().c_str());
+            return vVerifyErr[n];
+        }
+    }
+    if (pszFailed != NULL)
+    {
+        WalleveLog("AddNewBlock %s Error(%s) : %s \n",pszFailed,MvErrString(err),txidFailed.ToString().c_str());
+        return err;
+    }
+
     if (block.txMint.nAmount > nTotalFee + nReward)
     {
         WalleveLog("AddNewBlock Mint tx amount invalid : (%ld > %ld + %ld \n",block.txMint.nAmount,nTotalFee,nReward);
@@ -718,6 +755,40 @@ bool CWorldLine::GetBlockDelegateAgreement(const uint256& hashBlock,CDelegateAgr
     return true;
 }
 
+void CWorldLine::GetStorageStatus(CStorageStatus& status)
+{
+    storage::CTxIndexFilterStat statFilter;
+    cntrBlock.GetTxFilterStat(statFilter);
+    status.fTxFilterEnabled = statFilter.fEnabled;
+    status.nTxFilterCapacity = statFilter.nCapacity;
+    status.nTxFilterCount = statFilter.nCount;
+    status.nTxFilterMemory = statFilter.nMemory;
+    status.nTxFilterQuery = statFilter.nQuery;
+    status.nTxFilterReject = statFilter.nReject;
+    status.nTxFilterFalsePositive = statFilter.nFalsePositive;
+
+    storage::CBlockDBFlushStat statFlush;
+    cntrBlock.GetFlushStat(statFlush);
+    status.nFlushCount = statFlush.nFlushCount;
+    status.nFlushLastTime = statFlush.nLastFlushTime;
+    status.nFlushMaxTime = statFlush.nMaxFlushTime;
+    status.nFlushTotalTime = statFlush.nTotalFlushTime;
+    status.nFlushBatchSize = statFlush.nLastBatchSize;
+    status.nFlushBatchDB = statFlush.nLastBatchDB;
+
+    storage::CConsistencyStat statConsistency;
+    cntrBlock.GetConsistencyStat(statConsistency);
+    status.fConsistencyRunning = statConsistency.fRunning;
+    status.fConsistencyPassed = statConsistency.fPassed;
+    status.nConsistencyLevel = statConsistency.nCheckLevel;
+    status.nConsistencyDepth = statConsistency.nCheckDepth;
+    status.nConsistencyForkCount = statConsistency.nForkCount;
+    status.nConsistencyForkChecked = statConsistency.nForkChecked;
+    status.nConsistencyBlockChecked = statConsistency.nBlockChecked;
+    status.nConsistencyErrorCount = statConsistency.nErrorCount;
+    status.vConsistencyFinding = statConsistency.vFinding;
+}
+
 bool CWorldLine::CheckContainer()
 {
     if (cntrBlock.IsEmpty())
@@ -728,7 +799,14 @@ bool CWorldLine::CheckContainer()
     {
         return false;
     }
-    return cntrBlock.CheckConsistency(StorageConfig()->nCheckLevel, StorageConfig()->nCheckDepth);
+    // a failed background check is repaired here, on the start after it ran
+    if (cntrBlock.IsConsistencyFailed())
+    {
+        WalleveLog("Consistency checking of last run failed\n");
+        return false;
+    }
+    // only the recent blocks are checked before start, the rest is left to background checking
+    return cntrBlock.CheckConsistency(0, 16);
 }
 
 bool CWorldLine::RebuildContainer()
@@ -777,6 +855,7 @@ bool CWorldLine::GetBlockChanges(const CBlockIndex* pIndexNew,const CBlockIndex*
             {
                 return false;
             }
+            block.Seal();
             vBlockAddNew.push_back(block);
             pIndexNew = pIndexNew->pPrev;
         }
@@ -787,6 +866,7 @@ bool CWorldLine::GetBlockChanges(const CBlockIndex* pIndexNew,const CBlockIndex*
             {
                 return false;
             }
+            block.Seal();
             vBlockRemove.push_back(block);
             pIndexFork = pIndexFork->pPrev;
         }
@@ -7,6 +7,7 @@
 
 #include "mvbase.h"
 #include "blockbase.h"
+#include "verifypool.h"
 #include <map>
 
 namespace multiverse
@@ -29,6 +30,7 @@ public:
     bool GetLastBlockTime(const uint256& hashFork,int32 nDepth,std::vector<int64>& vTime) override;
     bool GetBlock(const uint256& hashBlock,CBlock& block) override;
     bool GetBlockEx(const uint256& hashBlock,CBlockEx& block) override;
+    bool GetRawBlock(const uint256& hashBlock,std::vector<unsigned char>& vchBlock) override;
     bool GetOrigin(const uint256& hashFork,CBlock& block) override;
     bool Exists(const uint256& hashBlock) override;
     bool GetTransaction(const uint256& txid,CTransaction& tx) override;
@@ -48,6 +50,7 @@ public:
     bool GetBlockInv(const uint256& hashFork,const CBlockLocator& locator,std::vector<uint256>& vBlockHash,std::size_t nMaxCount) override;
     bool GetBlockDelegateEnrolled(const uint256& hashBlock,CDelegateEnrolled& enrolled) override;
     bool GetBlockDelegateAgreement(const uint256& hashBlock,CDelegateAgreement& agreement) override;
+    void GetStorageStatus(CStorageStatus& status) override;
 protected:
     bool WalleveHandleInitialize() override;
     void WalleveHandleDeinitialize() override;
@@ -67,6 +70,7 @@ protected:
     ICoreProtocol* pCoreProtocol;
     ITxPool* pTxPool;
     storage::CBlockBase cntrBlock;
+    boost::shared_ptr<CVerifyPool> spVerifyPool;
     walleve::CWalleveCache<uint256,CDelegateEnrolled> cacheEnrolled;
     walleve::CWalleveCache<uint256,CDelegateAgreement> cacheAgreement;;
 };
@@ -0,0 +1,184 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addresstxindexdb.h"
+#include "leveldbeng.h"
+
+#include <boost/bind.hpp>
+#include <boost/endian/conversion.hpp>
+
+using namespace std;
+using namespace walleve;
+using namespace multiverse::storage;
+
+// Keys :
+//  "addr",fork,dest,height,txid -> CAddrTxIndex, height is stored big-endian so that
+//                                  the entries of one address are ordered by height
+//  "tx",fork,txid               -> (height,destinations), to undo the entries of a tx on reorg
+//  "tip",fork                   -> last block indexed, written in the same batch as its entries
+
+typedef pair<pair<string,uint256>,pair<CDestination,pair<uint32,uint256> > > CAddrTxKey;
+typedef pair<string,pair<uint256,uint256> > CTxRefKey;
+typedef pair<int32,vector<CDestination> > CTxRef;
+
+static inline CAddrTxKey AddrTxKey(const uint256& hashFork,const CDestination& dest,int32 nHeight,const uint256& txid)
+{
+    return make_pair(make_pair(string("addr"),hashFork),
+                     make_pair(dest,make_pair(boost::endian::native_to_big((uint32)nHeight),txid)));
+}
+
+static inline CTxRefKey TxRefKey(const uint256& hashFork,const uint256& txid)
+{
+    return make_pair(string("tx"),make_pair(hashFork,txid));
+}
+
+static inline pair<string,uint256> TipKey(const uint256& hashFork)
+{
+    return make_pair(string("tip"),hashFork);
+}
+
+//////////////////////////////
+// CAddressTxIndexDB
+
+bool CAddressTxIndexDB::Initialize(const boost::filesystem::path& pathData)
+{
+    CLevelDBArguments args;
+    args.path = (pathData / "addrtxindex").string();
+    args.syncwrite = false;
+    args.files = 64;
+    args.cache = 16 << 20;
+
+    CLevelDBEngine *engine = new CLevelDBEngine(args);
+
+    if (!Open(engine))
+    {
+        delete engine;
+        return false;
+    }
+
+    return true;
+}
+
+void CAddressTxIndexDB::Deinitialize()
+{
+    Close();
+}
+
+bool CAddressTxIndexDB::Update(const uint256& hashFork,const vector<pair<CDestination,CAddrTxIndex> >& vAddrTxNew,
+                                                       const vector<uint256>& vTxDel,const uint256& hashTip)
+{
+    // block updates and the background build share one batch of the engine
+    boost::unique_lock<boost::mutex> lock(mtxUpdate);
+
+    // reads do not see the pending batch, so look up the removed entries first
+    vector<pair<uint256,CTxRef> > vRemove;
+    vRemove.reserve(vTxDel.size());
+    for (int i = 0;i < vTxDel.size();i++)
+    {
+        CTxRef ref;
+        if (Read(TxRefKey(hashFork,vTxDel[i]),ref))
+        {
+            vRemove.push_back(make_pair(vTxDel[i],ref));
+        }
+    }
+
+    map<uint256,CTxRef> mapNew;
+    for (int i = 0;i < vAddrTxNew.size();i++)
+    {
+        const CAddrTxIndex& addrTx = vAddrTxNew[i].second;
+        CTxRef& ref = mapNew[addrTx.txid];
+        ref.first = addrTx.nBlockHeight;
+        ref.second.push_back(vAddrTxNew[i].first);
+    }
+
+    if (!TxnBegin())
+    {
+        return false;
+    }
+
+    for (int i = 0;i < vRemove.size();i++)
+    {
+        const uint256& txid = vRemove[i].first;
+        const CTxRef& ref = vRemove[i].second;
+        for (int j = 0;j < ref.second.size();j++)
+        {
+            Erase(AddrTxKey(hashFork,ref.second[j],ref.first,txid));
+        }
+        Erase(TxRefKey(hashFork,txid));
+    }
+
+    for (int i = 0;i < vAddrTxNew.size();i++)
+    {
+        const CAddrTxIndex& addrTx = vAddrTxNew[i].second;
+        Write(AddrTxKey(hashFork,vAddrTxNew[i].first,addrTx.nBlockHeight,addrTx.txid),addrTx);
+    }
+
+    for (map<uint256,CTxRef>::iterator it = mapNew.begin();it != mapNew.end();++it)
+    {
+        Write(TxRefKey(hashFork,(*it).first),(*it).second);
+    }
+
+    if (hashTip != 0)
+    {
+        Write(TipKey(hashFork),hashTip);
+    }
+
+    // the tip rides in the same batch, a lost tail is caught on load
+    return TxnCommit(false);
+}
+
+bool CAddressTxIndexDB::Retrieve(const uint256& hashFork,const CDestination& dest,int32 nHeightFrom,vector<CAddrTxIndex>& vAddrTx)
+{
+    return WalkThrough(boost::bind(&CAddressTxIndexDB::RetrieveWalker,this,_1,_2,
+                                   boost::cref(hashFork),boost::cref(dest),boost::ref(vAddrTx)),
+                       AddrTxKey(hashFork,dest,nHeightFrom < 0 ? 0 : nHeightFrom,uint256()));
+}
+
+bool CAddressTxIndexDB::RetrieveTip(const uint256& hashFork,uint256& hashTip)
+{
+    return Read(TipKey(hashFork),hashTip);
+}
+
+bool CAddressTxIndexDB::IsComplete()
+{
+    int nVersion = 0;
+    return (Read(string("complete"),nVersion) && nVersion == 1);
+}
+
+bool CAddressTxIndexDB::SetComplete()
+{
+    boost::unique_lock<boost::mutex> lock(mtxUpdate);
+    return Write(string("complete"),int(1));
+}
+
+void CAddressTxIndexDB::Clear()
+{
+    RemoveAll();
+}
+
+bool CAddressTxIndexDB::RetrieveWalker(CWalleveBufStream& ssKey,CWalleveBufStream& ssValue,
+                                       const uint256& hashFork,const CDestination& dest,vector<CAddrTxIndex>& vAddrTx)
+{
+    string strPrefix;
+    uint256 hashForkKey;
+    ssKey >> strPrefix;
+    if (strPrefix != "addr")
+    {
+        return false;
+    }
+
+    CDestination destKey;
+    uint32 nHeightKey;
+    CAddrTxIndex addrTx;
+    ssKey >> hashForkKey >> destKey >> nHeightKey >> addrTx.txid;
+    if (hashForkKey != hashFork || destKey != dest)
+    {
+        return false;
+    }
+
+    ssValue >> addrTx;
+    addrTx.nBlockHeight = (int32)boost::endian::big_to_native(nHeightKey);
+    vAddrTx.push_back(addrTx);
+    return true;
+}
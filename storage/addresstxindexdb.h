@@ -0,0 +1,85 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_ADDRESSTXINDEXDB_H
+#define  MULTIVERSE_ADDRESSTXINDEXDB_H
+
+#include "uint256.h"
+#include "destination.h"
+
+#include "walleve/walleve.h"
+
+#include <vector>
+
+namespace multiverse
+{
+namespace storage
+{
+
+class CAddrTxIndex
+{
+    friend class walleve::CWalleveStream;
+public:
+    int32 nBlockHeight;
+    uint256 txid;
+    uint32 nFile;
+    uint32 nOffset;
+    CDestination destIn;
+    int64 nValueIn;
+public:
+    CAddrTxIndex() { SetNull(); }
+    CAddrTxIndex(int32 nBlockHeightIn,const uint256& txidIn,uint32 nFileIn,uint32 nOffsetIn,
+                 const CDestination& destInIn = CDestination(),int64 nValueInIn = 0)
+    : nBlockHeight(nBlockHeightIn),txid(txidIn),nFile(nFileIn),nOffset(nOffsetIn),destIn(destInIn),nValueIn(nValueInIn) {}
+    void SetNull()
+    {
+        nBlockHeight = 0;
+        txid         = 0;
+        nFile        = 0;
+        nOffset      = 0;
+        destIn.SetNull();
+        nValueIn     = 0;
+    }
+    bool IsNull() const { return (nFile == 0); }
+    bool operator<(const CAddrTxIndex& b) const
+    {
+        return (nBlockHeight < b.nBlockHeight
+                || (nBlockHeight == b.nBlockHeight && (nFile < b.nFile || (nFile == b.nFile && nOffset < b.nOffset))));
+    }
+protected:
+    // nBlockHeight and txid are part of the db key
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(nFile,opt);
+        s.Serialize(nOffset,opt);
+        s.Serialize(destIn,opt);
+        s.Serialize(nValueIn,opt);
+    }
+};
+
+class CAddressTxIndexDB : public walleve::CKVDB
+{
+public:
+    CAddressTxIndexDB() {}
+    bool Initialize(const boost::filesystem::path& pathData);
+    void Deinitialize();
+    bool Update(const uint256& hashFork,const std::vector<std::pair<CDestination,CAddrTxIndex> >& vAddrTxNew,
+                                        const std::vector<uint256>& vTxDel,const uint256& hashTip = uint256());
+    bool Retrieve(const uint256& hashFork,const CDestination& dest,int32 nHeightFrom,std::vector<CAddrTxIndex>& vAddrTx);
+    bool RetrieveTip(const uint256& hashFork,uint256& hashTip);
+    bool IsComplete();
+    bool SetComplete();
+    void Clear();
+protected:
+    bool RetrieveWalker(walleve::CWalleveBufStream& ssKey,walleve::CWalleveBufStream& ssValue,
+                        const uint256& hashFork,const CDestination& dest,std::vector<CAddrTxIndex>& vAddrTx);
+protected:
+    boost::mutex mtxUpdate;
+};
+
+} // namespace storage
+} // namespace multiverse
+
+#endif //MULTIVERSE_ADDRESSTXINDEXDB_H
@@ -14,6 +14,7 @@ using namespace multiverse::storage;
 
 #define BLOCKFILE_PREFIX	"block"
 #define LOGFILE_NAME            "storage.log"
+#define SNAPSHOT_INTERVAL       (3600)
 
 //////////////////////////////
 // CBlockBaseDBWalker
@@ -238,7 +239,8 @@ void CBlockView::GetTxRemoved(vector<uint256>& vRemove)
 // CBlockBase 
 
 CBlockBase::CBlockBase()
-: fDebugLog(false)
+: fDebugLog(false),pThreadSnapshot(NULL),fStopSnapshot(true),nSnapshotSeq(-1),
+  pThreadConsistency(NULL),fStopConsistency(true),pThreadAddressTx(NULL),fStopAddressTx(true)
 {
 }
 
@@ -257,6 +259,13 @@ bool CBlockBase::Initialize(const path& pathDataLocation,bool fDebug,bool fRenew
 
     Log("B","Initializing... (Path : %s)\n",pathDataLocation.string().c_str());
 
+    spWorkerPool = CVerifyPool::GetInstance();
+    if (spWorkerPool == NULL)
+    {
+        Error("B","Failed to start worker pool\n");
+        return false;
+    }
+
     if (!dbBlock.Initialize(pathDataLocation))
     {
         Error("B","Failed to initialize block db\n");
@@ -269,6 +278,16 @@ bool CBlockBase::Initialize(const path& pathDataLocation,bool fDebug,bool fRenew
         Error("B","Failed to initialize block tsfile\n");
         return false;
     }
+
+    pathConsistency = pathDataLocation / "consistency.dat";
+
+    if (!snapshotIndex.Initialize(pathDataLocation))
+    {
+        dbBlock.Deinitialize();
+        tsBlock.Deinitialize();
+        Error("B","Failed to initialize block index snapshot\n");
+        return false;
+    }
     
     if (fRenewDB)
     {
@@ -286,12 +305,46 @@ bool CBlockBase::Initialize(const path& pathDataLocation,bool fDebug,bool fRenew
         Error("B","Failed to load block db\n");
         return false;
     }
+
+    if (!dbBlock.IsAddressTxIndexComplete() && !StartAddressTxIndexBuild())
+    {
+        Warn("B","Failed to start address tx index thread, fall back to scanning blocks\n");
+    }
+
+    fStopSnapshot = false;
+    pThreadSnapshot = new boost::thread([this]() { SnapshotProc(); });
+    if (pThreadSnapshot == NULL)
+    {
+        fStopSnapshot = true;
+        Warn("B","Failed to start block index snapshot thread\n");
+    }
     Log("B","Initialized\n");
     return true;
 }
 
 void CBlockBase::Deinitialize()
 {
+    StopConsistencyCheck();
+    StopAddressTxIndexBuild();
+
+    if (pThreadSnapshot)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mtxSnapshot);
+            fStopSnapshot = true;
+        }
+        condSnapshot.notify_all();
+        pThreadSnapshot->join();
+        delete pThreadSnapshot;
+        pThreadSnapshot = NULL;
+
+        // clean shutdown leaves a snapshot matching the db for the next start
+        if (!SaveSnapshot())
+        {
+            Warn("B","Failed to save block index snapshot\n");
+        }
+    }
+
     dbBlock.Deinitialize();
     tsBlock.Deinitialize();
     {
@@ -299,6 +352,7 @@ void CBlockBase::Deinitialize()
 
         ClearCache();
     }
+    spWorkerPool.reset();
     Log("B","Deinitialized\n");
 }
 
@@ -306,7 +360,7 @@ bool CBlockBase::Exists(const uint256& hash) const
 {
     CWalleveReadLock rlock(rwAccess);
  
-    return (!!mapIndex.count(hash));
+    return (arenaIndex.GetHandle(hash) != CBlockIndexArena::NULL_HANDLE);
 }
 
 bool CBlockBase::ExistsTx(const uint256& txid)
@@ -320,15 +374,22 @@ bool CBlockBase::IsEmpty() const
 {
     CWalleveReadLock rlock(rwAccess);
 
-    return mapIndex.empty();
+    return arenaIndex.IsEmpty();
 }
 
 void CBlockBase::Clear()
 {
+    // the build thread takes the read lock, stop it before locking
+    StopAddressTxIndexBuild();
+
     CWalleveWriteLock wlock(rwAccess);
 
     dbBlock.RemoveAll();
     ClearCache();    
+
+    // progress and findings of the checking belong to the removed blocks
+    boost::system::error_code ec;
+    boost::filesystem::remove(pathConsistency,ec);
 }
 
 bool CBlockBase::Initiate(const uint256& hashGenesis,const CBlock& blockGenesis)
@@ -338,7 +399,7 @@ bool CBlockBase::Initiate(const uint256& hashGenesis,const CBlock& blockGenesis)
         return false;
     }
     uint32 nFile,nOffset;
-    if (!tsBlock.Write(CBlockEx(blockGenesis),nFile,nOffset))
+    if (!tsBlock.Write(CBlockEx(blockGenesis),nFile,nOffset) || !tsBlock.Flush())
     {
         return false;
     }
@@ -349,6 +410,9 @@ bool CBlockBase::Initiate(const uint256& hashGenesis,const CBlock& blockGenesis)
     vector<pair<uint256,CTxIndex> > vTxNew;
     vTxNew.push_back(make_pair(txidMintTx,CTxIndex(0,nFile,nTxOffset)));
 
+    vector<pair<CDestination,CAddrTxIndex> > vAddrTxNew;
+    vAddrTxNew.push_back(make_pair(blockGenesis.txMint.sendTo,CAddrTxIndex(0,txidMintTx,nFile,nTxOffset)));
+
     vector<CTxUnspent> vAddNew;
     vAddNew.push_back(CTxUnspent(CTxOutPoint(txidMintTx,0),CTxOutput(blockGenesis.txMint)));
 
@@ -393,7 +457,8 @@ bool CBlockBase::Initiate(const uint256& hashGenesis,const CBlock& blockGenesis)
         {
             CWalleveWriteLock wForkLock(spFork->GetRWAccess());
      
-            if (!dbBlock.UpdateFork(hashGenesis,hashGenesis,uint64(0),vTxNew,vector<uint256>(),vAddNew,vector<CTxOutPoint>()))
+            if (!dbBlock.UpdateFork(hashGenesis,hashGenesis,uint64(0),vTxNew,vector<uint256>(),
+                                    vAddrTxNew,vector<uint256>(),vAddNew,vector<CTxOutPoint>()))
             {
                 return false;
             }
@@ -421,6 +486,11 @@ bool CBlockBase::AddNew(const uint256& hash,CBlockEx& block,CBlockIndex** ppInde
     {
         return false;
     }
+    // the block must be on disk before the index refers to it
+    if (!tsBlock.Flush())
+    {
+        return false;
+    }
     { 
         CWalleveWriteLock wlock(rwAccess);
 
@@ -432,8 +502,7 @@ bool CBlockBase::AddNew(const uint256& hash,CBlockEx& block,CBlockIndex** ppInde
 
         if (!dbBlock.AddNewBlock(CBlockOutline(pIndexNew)))
         {
-            mapIndex.erase(hash);
-            delete pIndexNew;
+            arenaIndex.Remove(hash);
             return false;
         }
         
@@ -442,8 +511,7 @@ bool CBlockBase::AddNew(const uint256& hash,CBlockEx& block,CBlockIndex** ppInde
             if (!UpdateDelegate(hash,block,CDiskPos(nFile,nOffset)))
             {
                 dbBlock.RemoveBlock(hash);
-                mapIndex.erase(hash);
-                delete pIndexNew;
+                arenaIndex.Remove(hash);
                 return false;
             }
         }
@@ -517,6 +585,34 @@ bool CBlockBase::Retrieve(const uint256& hash,CBlockEx& block)
     return true;    
 }
 
+bool CBlockBase::RetrieveRaw(const uint256& hash,vector<unsigned char>& vchBlock)
+{
+    vchBlock.clear();
+
+    CDiskPos pos;
+    {
+        CWalleveReadLock rlock(rwAccess);
+
+        CBlockIndex* pIndex = GetIndex(hash);
+        if (pIndex == NULL)
+        {
+            return false;
+        }
+        pos = CDiskPos(pIndex->nFile,pIndex->nOffset);
+    }
+
+    // the record holds a CBlockEx, whose head is the plain block
+    size_t nSize;
+    if (!tsBlock.ReadRaw(pos,vchBlock) || vchBlock.empty()
+        || !CBlock::GetRawSize(&vchBlock[0],vchBlock.size(),nSize))
+    {
+        vchBlock.clear();
+        return false;
+    }
+    vchBlock.resize(nSize);
+    return true;
+}
+
 bool CBlockBase::Retrieve(const CBlockIndex* pIndex,CBlockEx& block)
 {
     block.SetNull();
@@ -553,6 +649,60 @@ bool CBlockBase::RetrieveFork(const uint256& hash,CBlockIndex** ppIndex)
     return false;
 }
 
+bool CBlockBase::RetrieveFork(const uint256& hash,int32 nHeight,CBlockIndex** ppIndex)
+{
+    CWalleveReadLock rlock(rwAccess);
+
+    boost::shared_ptr<CBlockFork> spFork = GetFork(hash);
+    if (spFork == NULL)
+    {
+        return false;
+    }
+
+    CWalleveReadLock rForkLock(spFork->GetRWAccess());
+
+    *ppIndex = GetForkIndex(spFork,nHeight);
+    return (*ppIndex != NULL);
+}
+
+bool CBlockBase::RetrieveFork(const uint256& hash,int32 nHeight,vector<CBlockIndex*>& vIndex)
+{
+    CWalleveReadLock rlock(rwAccess);
+
+    boost::shared_ptr<CBlockFork> spFork = GetFork(hash);
+    if (spFork == NULL)
+    {
+        return false;
+    }
+
+    CWalleveReadLock rForkLock(spFork->GetRWAccess());
+
+    CBlockIndex* pIndex = GetForkIndex(spFork,nHeight);
+    if (pIndex != NULL && nHeight < spFork->GetOrigin()->GetBlockHeight())
+    {
+        // pNext of parent fork blocks follows the parent's chain, collect backward instead
+        CBlockIndex* p = spFork->GetOrigin();
+        while (p != pIndex)
+        {
+            if (p->GetBlockHeight() == nHeight)
+            {
+                vIndex.push_back(p);
+            }
+            p = p->pPrev;
+        }
+        vIndex.push_back(pIndex);
+        std::reverse(vIndex.begin(),vIndex.end());
+    }
+    else
+    {
+        for (;pIndex != NULL && pIndex->GetBlockHeight() == nHeight;pIndex = pIndex->pNext)
+        {
+            vIndex.push_back(pIndex);
+        }
+    }
+    return (!vIndex.empty());
+}
+
 bool CBlockBase::RetrieveFork(const string& strName,CBlockIndex** ppIndex)
 {
     CWalleveReadLock rlock(rwAccess);
@@ -846,7 +996,8 @@ bool CBlockBase::CommitBlockView(CBlockView& view,CBlockIndex* pIndexNew)
     }
 
     vector<pair<uint256,CTxIndex> > vTxNew;
-    if (!GetTxNewIndex(view,pIndexNew,vTxNew))
+    vector<pair<CDestination,CAddrTxIndex> > vAddrTxNew;
+    if (!GetTxNewIndex(view,pIndexNew,vTxNew,vAddrTxNew))
     {
         return false;
     }
@@ -854,6 +1005,12 @@ bool CBlockBase::CommitBlockView(CBlockView& view,CBlockIndex* pIndexNew)
     vector<uint256> vTxDel;
     view.GetTxRemoved(vTxDel);
 
+    // txs moved to another height by the reorg drop their old address entries too
+    set<uint256> setTxUpdate;
+    view.GetTxUpdated(setTxUpdate);
+    vector<uint256> vAddrTxDel(vTxDel);
+    vAddrTxDel.insert(vAddrTxDel.end(),setTxUpdate.begin(),setTxUpdate.end());
+
     vector<CTxUnspent> vAddNew;
     vector<CTxOutPoint> vRemove;
     view.GetUnspentChanges(vAddNew,vRemove);
@@ -863,7 +1020,8 @@ bool CBlockBase::CommitBlockView(CBlockView& view,CBlockIndex* pIndexNew)
         spFork->UpgradeToWrite();
     }
 
-    if (!dbBlock.UpdateFork(hashFork,pIndexNew->GetBlockHash(),view.GetForkHash(),vTxNew,vTxDel,vAddNew,vRemove))
+    if (!dbBlock.UpdateFork(hashFork,pIndexNew->GetBlockHash(),view.GetForkHash(),vTxNew,vTxDel,
+                            vAddrTxNew,vAddrTxDel,vAddNew,vRemove))
     {
         return false;
     }
@@ -879,23 +1037,15 @@ bool CBlockBase::LoadIndex(CBlockOutline& outline)
     uint256 hash = outline.GetBlockHash();
     CBlockIndex* pIndexNew = NULL;
 
-    map<uint256, CBlockIndex*>::iterator mi = mapIndex.find(hash);
-    if (mi != mapIndex.end())
+    bool fNew = false;
+    pIndexNew = arenaIndex.Insert(hash,static_cast<CBlockIndex&>(outline),fNew);
+    if (!fNew)
     {
-        pIndexNew = (*mi).second;
+        const uint256* phash = pIndexNew->phashBlock;
         *pIndexNew = static_cast<CBlockIndex&>(outline);
-    }
-    else
-    {
-        pIndexNew = new CBlockIndex(static_cast<CBlockIndex&>(outline));
-        if (pIndexNew == NULL)
-        {
-            return false;
-        }
-        mi = mapIndex.insert(make_pair(hash, pIndexNew)).first;
+        pIndexNew->phashBlock = phash;
     }
 
-    pIndexNew->phashBlock = &((*mi).first);
     pIndexNew->pPrev = NULL;
     pIndexNew->pOrigin = pIndexNew;
 
@@ -940,36 +1090,17 @@ bool CBlockBase::FilterTx(const uint256& hashFork,CTxFilter& filter)
 
     CWalleveReadLock rForkLock(spFork->GetRWAccess());
 
+    if (dbBlock.IsAddressTxIndexComplete())
+    {
+        return FilterIndexedTx(hashFork,spFork->GetOrigin()->GetBlockHeight(),false,filter);
+    }
+
+    vector<CBlockIndex*> vIndex;
     for (CBlockIndex* pIndex = spFork->GetOrigin(); pIndex != NULL; pIndex = pIndex->pNext)
     {    
-        CBlockEx block;
-        if (!tsBlock.Read(block,pIndex->nFile,pIndex->nOffset))
-        {
-            return false;
-        }
-        int32 nBlockHeight = pIndex->GetBlockHeight();
-        if (filter.setDest.count(block.txMint.sendTo))
-        {
-            if (!filter.FoundTx(hashFork,CAssembledTx(block.txMint,nBlockHeight)))
-            {
-                return false;
-            }
-        }
-        for (int i = 0; i < block.vtx.size();i++)
-        {
-            CTransaction& tx = block.vtx[i];
-            CTxContxt& ctxt = block.vTxContxt[i];
-
-            if (filter.setDest.count(tx.sendTo) || filter.setDest.count(ctxt.destIn))
-            {
-                if (!filter.FoundTx(hashFork,CAssembledTx(tx,nBlockHeight,ctxt.destIn,ctxt.GetValueIn())))
-                {
-                    return false;
-                }
-            }
-        }
+        vIndex.push_back(pIndex);
     }
-    return true;
+    return ScanForkTx(hashFork,vIndex,filter);
 }
 
 bool CBlockBase::FilterTx(const uint256& hashFork, const int32 nDepth, CTxFilter& filter)
@@ -984,37 +1115,26 @@ bool CBlockBase::FilterTx(const uint256& hashFork, const int32 nDepth, CTxFilter
 
     CWalleveReadLock rForkLock(spFork->GetRWAccess());
 
-    int nCount = 0;
-    for (CBlockIndex* pIndex = spFork->GetLast(); pIndex != NULL && nCount++ < nDepth; pIndex = pIndex->pPrev)
+    if (dbBlock.IsAddressTxIndexComplete())
     {
-        CBlockEx block;
-        if (!tsBlock.Read(block,pIndex->nFile,pIndex->nOffset))
-        {
-            return false;
-        }
-        int32 nBlockHeight = pIndex->GetBlockHeight();
-        if (filter.setDest.count(block.txMint.sendTo))
+        // depth counts blocks, and extended blocks share the height of their primary block.
+        // Blocks sharing the start height are all included
+        CBlockIndex* pIndexFrom = spFork->GetLast();
+        for (int nCount = 1;nCount < nDepth && pIndexFrom->pPrev != NULL;nCount++)
         {
-            if (!filter.FoundTx(hashFork,CAssembledTx(block.txMint,nBlockHeight)))
-            {
-                return false;
-            }
+            pIndexFrom = pIndexFrom->pPrev;
         }
-        for (int i = 0; i < block.vtx.size();i++)
-        {
-            CTransaction& tx = block.vtx[i];
-            CTxContxt& ctxt = block.vTxContxt[i];
+        int32 nHeightFrom = pIndexFrom->GetBlockHeight();
+        return FilterIndexedTx(hashFork,std::max(nHeightFrom,spFork->GetOrigin()->GetBlockHeight()),true,filter);
+    }
 
-            if (filter.setDest.count(tx.sendTo) || filter.setDest.count(ctxt.destIn))
-            {
-                if (!filter.FoundTx(hashFork,CAssembledTx(tx,nBlockHeight,ctxt.destIn,ctxt.GetValueIn())))
-                {
-                    return false;
-                }
-            }
-        }
+    vector<CBlockIndex*> vIndex;
+    int nCount = 0;
+    for (CBlockIndex* pIndex = spFork->GetLast(); pIndex != NULL && nCount++ < nDepth; pIndex = pIndex->pPrev)
+    {
+        vIndex.push_back(pIndex);
     }
-    return true;
+    return ScanForkTx(hashFork,vIndex,filter);
 }
 
 bool CBlockBase::ListForkContext(std::vector<CForkContext>& vForkCtxt)
@@ -1101,28 +1221,12 @@ bool CBlockBase::GetForkBlockInv(const uint256& hashFork,const CBlockLocator& lo
 
 bool CBlockBase::CheckConsistency(int nCheckLevel, const int32 nCheckDepth)
 {
-    boost::timer::cpu_timer t_lock;
-    t_lock.start();
-
-    CWalleveReadLock rlock(rwAccess);
-
-    Log("B", "Getting lock duration ===> %s.\n", t_lock.format().c_str());
-
     boost::timer::cpu_timer t_check;
     t_check.start();
 
     Log("B", "Check consistency with parameters check-level:%d and check-depth:%d.\n", nCheckLevel, nCheckDepth);
 
-    int nLevel = nCheckLevel;
-    if(nCheckLevel < 0)
-    {
-        nLevel = 0;
-    }
-    if(nCheckLevel > 3)
-    {
-        nLevel = 3;
-    }
-    int32 nDepth = nCheckDepth;
+    int nLevel = std::max(0, std::min(nCheckLevel, 3));
 
     Log("B", "Consistency checking level is %d\n", nLevel);
 
@@ -1135,329 +1239,805 @@ bool CBlockBase::CheckConsistency(int nCheckLevel, const int32 nCheckDepth)
 
     for(const auto& fork : vFork)
     {
-        boost::timer::cpu_timer t_fork;
-        t_fork.start();
+        if(!CheckForkConsistency(fork.first, fork.second, nLevel, nCheckDepth, NULL))
+        {
+            return false;
+        }
+    }
+
+    Log("B", "Checking duration ===> %s\n", t_check.format().c_str());
+
+    Log("B", "Data consistency verified.\n");
+
+    return true;
+}
+
+bool CBlockBase::StartConsistencyCheck(int nCheckLevel,int32 nCheckDepth)
+{
+    StopConsistencyCheck();
+
+    int nLevel = std::max(0,std::min(nCheckLevel,3));
+    {
+        boost::unique_lock<boost::mutex> lock(mtxConsistency);
+        fStopConsistency = false;
+        statConsistency = CConsistencyStat();
+        statConsistency.fRunning = true;
+        statConsistency.nCheckLevel = nLevel;
+        statConsistency.nCheckDepth = nCheckDepth;
+    }
+
+    pThreadConsistency = new boost::thread([this,nLevel,nCheckDepth]() { ConsistencyProc(nLevel,nCheckDepth); });
+    if (pThreadConsistency == NULL)
+    {
+        boost::unique_lock<boost::mutex> lock(mtxConsistency);
+        statConsistency.fRunning = false;
+        return false;
+    }
+    return true;
+}
+
+void CBlockBase::StopConsistencyCheck()
+{
+    if (pThreadConsistency)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mtxConsistency);
+            fStopConsistency = true;
+        }
+        pThreadConsistency->join();
+        delete pThreadConsistency;
+        pThreadConsistency = NULL;
+    }
+}
+
+void CBlockBase::GetConsistencyStat(CConsistencyStat& stat)
+{
+    boost::unique_lock<boost::mutex> lock(mtxConsistency);
+    stat = statConsistency;
+}
+
+bool CBlockBase::IsConsistencyFailed()
+{
+    CConsistencyCheckpoint checkpoint;
+    return (LoadConsistencyCheckpoint(checkpoint) && checkpoint.fFailed);
+}
+
+bool CBlockBase::CheckForkConsistency(const uint256& hashFork,const uint256& hashRefBlock,int nLevel,int32 nDepth,
+                                      CConsistencyCheckpoint* pCheckpoint)
+{
+    boost::timer::cpu_timer t_fork;
+    t_fork.start();
+
+    CConsistencyForkCheckpoint* pForkCheckpoint = NULL;
+    if (pCheckpoint != NULL)
+    {
+        for (size_t i = 0;i < pCheckpoint->vFork.size() && pForkCheckpoint == NULL;i++)
+        {
+            if (pCheckpoint->vFork[i].hashFork == hashFork)
+            {
+                pForkCheckpoint = &pCheckpoint->vFork[i];
+            }
+        }
+        if (pForkCheckpoint == NULL)
+        {
+            pCheckpoint->vFork.push_back(CConsistencyForkCheckpoint());
+            pForkCheckpoint = &pCheckpoint->vFork.back();
+            pForkCheckpoint->hashFork = hashFork;
+        }
+    }
+
+    CBlockIndex* pIndexLast = NULL;
+    CBlockIndex* pIndexTop = NULL;
+    CBlockIndex* pIndexBottom = NULL;
+    bool fMainFork = false;
+    {
+        CWalleveReadLock rlock(rwAccess);
 
         //checking of level 0: fork/block
 
         //check field refblock of table fork must be in rows in table block
-        CBlockIndex* pBlockRefIndex = GetIndex(fork.second);
-        if(!pBlockRefIndex)
+        if (GetIndex(hashRefBlock) == NULL)
         {
-            Error("B", "Get referenced block index failed.\n");
+            AddConsistencyFinding("Get referenced block index failed, fork " + hashFork.GetHex());
             return false;
         }
 
-        boost::shared_ptr<CBlockFork> spFork = GetFork(fork.first);
-        if(NULL == spFork)
+        boost::shared_ptr<CBlockFork> spFork = GetFork(hashFork);
+        if (spFork == NULL)
         {
-            Error("B", "Get fork failed.\n");
+            AddConsistencyFinding("Get fork failed, fork " + hashFork.GetHex());
             return false;
         }
-        CBlockIndex* pLastBlock = spFork->GetLast();
-        if(NULL == pLastBlock)
+
+        CWalleveReadLock rForkLock(spFork->GetRWAccess());
+
+        pIndexLast = spFork->GetLast();
+        if (pIndexLast == NULL)
         {
-            Error("B", "Get last block index of current fork failed.\n");
+            AddConsistencyFinding("Get last block index of current fork failed, fork " + hashFork.GetHex());
             return false;
         }
+        fMainFork = spFork->GetOrigin()->IsPrimary();
 
-        bool fIsMainFork = spFork->GetOrigin()->IsPrimary();
-
-        if(0 == nDepth || pLastBlock->nHeight < nDepth)
+        // [bottom,top] is verified by an earlier run, it is skipped while top stays on the fork chain
+        if (pForkCheckpoint != NULL && pForkCheckpoint->hashTop != 0)
         {
-            nDepth = pLastBlock->nHeight;
-            Log("B", "Consistency checking depth is {%d} for fork:{%s}\n", nDepth, fork.first.ToString().c_str());
+            pIndexTop = GetIndex(pForkCheckpoint->hashTop);
+            pIndexBottom = GetIndex(pForkCheckpoint->hashBottom);
+            if (pIndexTop == NULL || pIndexBottom == NULL || pIndexTop->GetOriginHash() != hashFork
+                || (pIndexTop != pIndexLast && pIndexTop->pNext == NULL))
+            {
+                pIndexTop = pIndexBottom = NULL;
+                *pForkCheckpoint = CConsistencyForkCheckpoint();
+                pForkCheckpoint->hashFork = hashFork;
+            }
         }
+    }
 
-        CBlockIndex* pIndex = pLastBlock;
-        map<CDestination, int64> mapNextBlockDelegate;
+    int32 nHeightBottom = ((nDepth == 0 || pIndexLast->nHeight < nDepth) ? 0 : pIndexLast->nHeight - nDepth);
+    Log("B", "Consistency checking depth is {%d} for fork:{%s}\n", pIndexLast->nHeight - nHeightBottom, hashFork.ToString().c_str());
 
-        map<CTxOutPoint, CTxUnspent> mapUnspentUTXO;
-        vector<CTxOutPoint> vSpentUTXO;
+    bool fResumed = (pIndexTop != NULL);
+    if (fResumed)
+    {
+        Log("B", "Resume consistency checking of fork:{%s} verified down to height %d\n",
+                 hashFork.ToString().c_str(), pIndexBottom->nHeight);
+    }
+    vector<pair<CBlockIndex*,CBlockIndex*> > vSegment;
+    GetConsistencySegment(pIndexLast,pIndexTop,pIndexBottom,fResumed && pForkCheckpoint->fComplete,vSegment);
 
-        while(pIndex && pLastBlock->nHeight - pIndex->nHeight < nDepth)
+    // one range per pool worker and one for this thread, on the pool shared with block verification
+    size_t nWorker = std::min(spWorkerPool->GetWorkerCount() + 1,(size_t)CONSISTENCY_MAX_WORKER);
+
+    // the unspent state of the verified segment goes on with the resumed one
+    map<CTxOutPoint, CTxUnspent> mapUnspentUTXO;
+    set<CTxOutPoint> setSpentUTXO;
+    if (fResumed)
+    {
+        for (const auto& unspent : pForkCheckpoint->vUnspent)
         {
-            //be able to read from block files
-            CBlockEx block;
-            if(!tsBlock.ReadDirect(block, pIndex->nFile, pIndex->nOffset))
-            {
-                Error("B", "Retrieve block from file directly failed.\n");
-                return false;
-            }
+            mapUnspentUTXO.insert(make_pair(unspent.first, CTxUnspent(unspent.first, unspent.second)));
+        }
+        setSpentUTXO.insert(pForkCheckpoint->vSpent.begin(), pForkCheckpoint->vSpent.end());
+    }
+    auto lmdSaveUnspent = [&] () {
+        pForkCheckpoint->vUnspent.clear();
+        pForkCheckpoint->vUnspent.reserve(mapUnspentUTXO.size());
+        for (const auto& unspent : mapUnspentUTXO)
+        {
+            pForkCheckpoint->vUnspent.push_back(make_pair(unspent.first, unspent.second.output));
+        }
+        pForkCheckpoint->vSpent.assign(setSpentUTXO.begin(), setSpentUTXO.end());
+    };
+
+    for (size_t nSeg = 0;nSeg < vSegment.size();nSeg++)
+    {
+        CBlockIndex* pIndex = vSegment[nSeg].first;
+        CBlockIndex* pIndexEnd = vSegment[nSeg].second;
+        uint256 hashChild = (pIndex == pIndexLast ? uint256() : pIndexBottom->GetBlockHash());
 
-            //consistent between database and block file
-            if(!(pIndex->GetBlockHash() == block.GetHash()
-                 && pIndex->pPrev->GetBlockHash() == block.hashPrev
-                 && pIndex->nVersion == block.nVersion
-                 && pIndex->nType == block.nType
-                 && pIndex->nTimeStamp == block.nTimeStamp
-                 && ((pIndex->nMintType == 0 ) ?
-                     block.IsVacant()
-                     : (!block.IsVacant() && pIndex->txidMint == block.txMint.GetHash() && pIndex->nMintType == block.txMint.nType))
-                ))
+        while (pIndex != NULL && pIndex->nHeight > nHeightBottom)
+        {
+            if (pCheckpoint != NULL && IsConsistencyStopping())
             {
-                Error("B", "Block info are not consistent in db and file.\n");
-                return false;
+                return true;
             }
 
-            //checking of level 1: transaction
-            if(nLevel >= 1 && !pIndex->IsVacant())
+            // pPrev links never change, so ranges are collected without holding the index lock
+            vector<CConsistencyRange> vRange;
+            vRange.reserve(nWorker);
+            while (vRange.size() < nWorker && pIndex != NULL && pIndex->nHeight > nHeightBottom)
             {
-                auto lmdChkTx = [&] (const uint256& txid, const CTxIndex& pTxIndex) -> bool {
-                    CTransaction tx;
-                    if (!tsBlock.ReadDirect(tx, pTxIndex.nFile, pTxIndex.nOffset))
-                    {
-                        Error("B", "Retrieve tx from file directly failed.\n");
-                        return false;
-                    }
-
-                    //consistent between database and block file
-                    if(txid != tx.GetHash() || pTxIndex.nBlockHeight != pIndex->nHeight)
-                    {
-                        return false;
-                    }
-
-                    return true;
-                };
-
-                CTxIndex pTxIdx;
-                uint256 fk;
-                if(!dbBlock.RetrieveTxIndex(pIndex->txidMint, pTxIdx, fk))
+                vRange.push_back(CConsistencyRange());
+                CConsistencyRange& range = vRange.back();
+                range.hashChild = hashChild;
+                if (pIndexEnd != NULL)
                 {
-                    Error("B", "Retrieve mint tx index from db failed.\n");
-                    return false;
+                    range.hashCounted = pIndexEnd->GetBlockHash();
                 }
-                if(!lmdChkTx(pIndex->txidMint, pTxIdx))
+                while (range.vBlock.size() < CONSISTENCY_RANGE_SIZE && pIndex != NULL && pIndex->nHeight > nHeightBottom)
                 {
-                    Error("B", "Mint tx info are not consistent in db and file.\n");
-                    return false;
+                    range.vBlock.push_back(CBlockOutline(pIndex));
+                    hashChild = pIndex->GetBlockHash();
+                    pIndex = (pIndex == pIndexEnd ? NULL : pIndex->pPrev);
                 }
+            }
 
-                for(auto const& tx : block.vtx)
+            if (!spWorkerPool->Run(vRange.size(),[&](size_t n) { CheckRangeConsistency(vRange[n],nLevel,fMainFork); }))
+            {
+                // a range whose check throws stays failed
+                for (size_t i = 0;i < vRange.size();i++)
                 {
-                    pTxIdx.SetNull();
-                    const uint256& txid = tx.GetHash();
-                    if(!dbBlock.RetrieveTxIndex(txid, pTxIdx, fk))
+                    if (!vRange[i].fPassed && vRange[i].strError.empty())
                     {
-                        Error("B", "Retrieve token tx index from db failed.\n");
-                        return false;
-                    }
-                    if(!lmdChkTx(txid, pTxIdx))
-                    {
-                        Error("B", "Token tx info are not consistent in db and file.\n");
-                        return false;
+                        vRange[i].strError = "Range checking throws, block " + vRange[i].vBlock[0].GetBlockHash().GetHex();
                     }
                 }
-
             }
 
-            //checking of level 2: delegate/enroll
-            if(nLevel >= 2 && fIsMainFork)
+            uint64 nBlockChecked = 0;
+            for (size_t i = 0;i < vRange.size();i++)
             {
-                static bool fIsLastBlock = true;
-
-                if(fIsLastBlock)
+                CConsistencyRange& range = vRange[i];
+                if (!range.fPassed)
                 {
-                    if(!dbBlock.RetrieveDelegate(block.GetHash(), mapNextBlockDelegate))
+                    if (!IsForkChainBlock(hashFork,range.vBlock[0].GetBlockHash()))
                     {
-                        Error("B", "Retrieve the latest delegate record from db failed.\n");
-                        return false;
+                        Log("B", "Fork:{%s} is reorganized during consistency checking, skip the rest of it\n",
+                                 hashFork.ToString().c_str());
+                        return true;
                     }
-                    fIsLastBlock = false;
+                    AddConsistencyFinding(range.strError);
+                    return false;
                 }
-                else
-                {   //compare delegate in this iteration with the previous one
-                    map<CDestination, int64> mapPrevBlockDelegate;
-                    if(!dbBlock.RetrieveDelegate(block.GetHash(), mapPrevBlockDelegate))
-                    {
-                        Error("B", "Retrieve the following previous delegate record from db failed.\n");
-                        return false;
-                    }
-                    if(mapNextBlockDelegate != mapPrevBlockDelegate)
-                    {
-                        Error("B", "Delegate records followed one by one do not match.\n");
-                        return false;
-                    }
-                    mapNextBlockDelegate = mapPrevBlockDelegate;
+                nBlockChecked += range.vBlock.size();
+                if (nLevel >= 3)
+                {
+                    MergeRangeUnspent(range,mapUnspentUTXO,setSpentUTXO);
                 }
+            }
+            {
+                boost::unique_lock<boost::mutex> lock(mtxConsistency);
+                statConsistency.nBlockChecked += nBlockChecked;
+            }
 
-                if (block.txMint.nType == CTransaction::TX_STAKE)
+            if (pForkCheckpoint != NULL && pIndexEnd == NULL)
+            {
+                if (!fResumed)
                 {
-                    mapNextBlockDelegate[block.txMint.sendTo] -= block.txMint.nAmount;
+                    pForkCheckpoint->hashTop = pIndexLast->GetBlockHash();
                 }
+                pForkCheckpoint->hashBottom = vRange.back().vBlock.back().GetBlockHash();
+                lmdSaveUnspent();
+                SaveConsistencyCheckpoint(*pCheckpoint);
+            }
+        }
 
-                map<pair<uint256, CDestination>, tuple<uint256, uint32, uint32>> mapEnrollRanged;
-                for (int i = 0; i < block.vtx.size(); i++)
-                {
-                    const CTransaction& tx = block.vtx[i];
-                    {
-                        CTemplateId tid;
-                        if(tx.sendTo.GetTemplateId(tid) && tid.GetType() == TEMPLATE_DELEGATE)
-                        {
-                            mapNextBlockDelegate[tx.sendTo] -= tx.nAmount;
-                        }
-                    }
+        if (pForkCheckpoint != NULL && pIndexEnd != NULL)
+        {
+            pForkCheckpoint->hashTop = pIndexLast->GetBlockHash();
+            lmdSaveUnspent();
+            SaveConsistencyCheckpoint(*pCheckpoint);
+        }
+    }
 
-                    const CTxContxt& txContxt = block.vTxContxt[i];
-                    {
-                        CTemplateId tid;
-                        if(txContxt.destIn.GetTemplateId(tid) && tid.GetType() == TEMPLATE_DELEGATE)
-                        {
-                            mapNextBlockDelegate[txContxt.destIn] += tx.nAmount + tx.nTxFee;
-                        }
-                    }
+    Log("B", "Checking duration before comparing unspent ===> %s\n", t_fork.format().c_str());
+    if(nLevel >= 3)
+    {
+        boost::shared_ptr<CBlockFork> spFork;
+        {
+            CWalleveReadLock rlock(rwAccess);
+            spFork = GetFork(hashFork);
+        }
+        if (spFork == NULL)
+        {
+            AddConsistencyFinding("Get fork failed, fork " + hashFork.GetHex());
+            return false;
+        }
 
-                    if(tx.nType == CTransaction::TX_CERT)
-                    {
-                        const uint256& anchor = tx.hashAnchor;
-                        const CDestination& dest = tx.sendTo;
-                        const uint256& blk = block.GetHash();
-                        CTxIndex txIdx;
-                        uint256 fk;
-                        if(!dbBlock.RetrieveTxIndex(tx.GetHash(), txIdx, fk))
-                        {
-                            Error("B", "Retrieve enroll tx index from table transaction failed.\n");
-                            return false;
-                        }
-                        const uint32& nFile = txIdx.nFile;
-                        const uint32& nOffset = txIdx.nOffset;
-                        mapEnrollRanged[make_pair(anchor, dest)] = make_tuple(blk, nFile, nOffset);
-                    }
+        CWalleveReadLock rForkLock(spFork->GetRWAccess());
+        // new blocks change the unspent set, compare only while the fork stays at the checked tip
+        if (spFork->GetLast() != pIndexLast)
+        {
+            Log("B", "Fork:{%s} is updated during consistency checking, skip comparing unspent\n", hashFork.ToString().c_str());
+        }
+        else
+        {
+            //compare unspent with transaction
+            CForkUnspentCheckWalker walker(mapUnspentUTXO);
+            if(!dbBlock.WalkThroughUnspent(hashFork, walker))
+            {
+                AddConsistencyFinding(to_string(mapUnspentUTXO.size()) + " ranged unspent records failed to walk through, fork " + hashFork.GetHex());
+                return false;
+            }
+
+            if(walker.nMatch != mapUnspentUTXO.size())
+            {
+                AddConsistencyFinding(to_string(mapUnspentUTXO.size()) + " ranged unspent records do not match with full collection of unspent, fork " + hashFork.GetHex());
+                return false;
+            }
+        }
+    }
+
+    if (pForkCheckpoint != NULL)
+    {
+        pForkCheckpoint->fComplete = true;
+        SaveConsistencyCheckpoint(*pCheckpoint);
+    }
+
+    Log("B", "Checking duration of fork{%s} ===> %s\n", hashFork.ToString().c_str(), t_fork.format().c_str());
+    return true;
+}
+
+void CBlockBase::GetConsistencySegment(CBlockIndex* pIndexLast,CBlockIndex* pIndexTop,CBlockIndex* pIndexBottom,bool fComplete,
+                                       vector<pair<CBlockIndex*,CBlockIndex*> >& vSegment)
+{
+    // segments are walked down by pPrev from first to second, a NULL second runs down to the bottom height
+    vSegment.clear();
+    if (pIndexTop == NULL)
+    {
+        vSegment.push_back(make_pair(pIndexLast,(CBlockIndex*)NULL));
+        return;
+    }
+    if (pIndexTop != pIndexLast)
+    {
+        // top is checked again, so the delegate of its child is compared with it
+        vSegment.push_back(make_pair(pIndexLast,pIndexTop));
+    }
+    if (!fComplete && pIndexBottom->pPrev != NULL)
+    {
+        vSegment.push_back(make_pair(pIndexBottom->pPrev,(CBlockIndex*)NULL));
+    }
+}
+
+void CBlockBase::MergeRangeUnspent(const CConsistencyRange& range,map<CTxOutPoint,CTxUnspent>& mapUnspent,
+                                                                  set<CTxOutPoint>& setSpent)
+{
+    // ranges are merged from top to bottom, outputs spent in one range may be created in a lower one
+    for (const auto& spent : range.vSpent)
+    {
+        if (!mapUnspent.erase(spent))
+        {
+            setSpent.insert(spent);
+        }
+    }
+    for (const auto& unspent : range.mapUnspent)
+    {
+        if (!setSpent.erase(unspent.first))
+        {
+            mapUnspent.insert(unspent);
+        }
+    }
+}
+
+void CBlockBase::CheckRangeConsistency(CConsistencyRange& range,int nLevel,bool fMainFork)
+{
+    range.fPassed = false;
+
+    map<CDestination, int64> mapNextBlockDelegate;
+    bool fIsLastBlock = true;
+    if(nLevel >= 2 && fMainFork && range.hashChild != 0)
+    {
+        // the delegate of the block above the range leads to the one expected for its first block
+        CBlockEx blockChild;
+        if(!Retrieve(range.hashChild, blockChild) || !dbBlock.RetrieveDelegate(range.hashChild, mapNextBlockDelegate))
+        {
+            range.strError = "Retrieve the delegate record above range from db failed, block " + range.hashChild.GetHex();
+            return;
+        }
+        if(!ApplyBlockDelegate(blockChild, mapNextBlockDelegate, range.strError))
+        {
+            return;
+        }
+        fIsLastBlock = false;
+    }
+
+    for(const CBlockOutline& outline : range.vBlock)
+    {
+        const string strBlock = ", block " + outline.GetBlockHash().GetHex();
+
+        //be able to read from block files
+        CBlockEx block;
+        if(!tsBlock.ReadDirect(block, outline.nFile, outline.nOffset))
+        {
+            range.strError = "Retrieve block from file directly failed" + strBlock;
+            return;
+        }
+        block.Seal();
+
+        //consistent between database and block file
+        if(!(outline.GetBlockHash() == block.GetHash()
+             && outline.hashPrev == block.hashPrev
+             && outline.nVersion == block.nVersion
+             && outline.nType == block.nType
+             && outline.nTimeStamp == block.nTimeStamp
+             && ((outline.nMintType == 0 ) ?
+                 block.IsVacant()
+                 : (!block.IsVacant() && outline.txidMint == block.txMint.GetHash() && outline.nMintType == block.txMint.nType))
+            ))
+        {
+            range.strError = "Block info are not consistent in db and file" + strBlock;
+            return;
+        }
+
+        //checking of level 1: transaction
+        if(nLevel >= 1 && !outline.IsVacant())
+        {
+            auto lmdChkTx = [&] (const uint256& txid, const CTxIndex& pTxIndex) -> bool {
+                CTransaction tx;
+                if (!tsBlock.ReadDirect(tx, pTxIndex.nFile, pTxIndex.nOffset))
+                {
+                    return false;
                 }
 
-                vector<CDestination> vDestNull;
-                for(const auto& delegate : mapNextBlockDelegate)
+                //consistent between database and block file
+                if(txid != tx.GetHash() || pTxIndex.nBlockHeight != outline.nHeight)
                 {
-                    if(delegate.second < 0)
-                    {
-                        Error("B", "Amount on delegate template address must not be less than zero.\n");
-                        return false;
-                    }
-                    if(delegate.second == 0)
-                    {
-                        vDestNull.push_back(delegate.first);
-                    }
+                    return false;
                 }
-                for(const auto& dest : vDestNull)
+
+                return true;
+            };
+
+            CTxIndex pTxIdx;
+            uint256 fk;
+            if(!dbBlock.RetrieveTxIndex(outline.txidMint, pTxIdx, fk))
+            {
+                range.strError = "Retrieve mint tx index from db failed" + strBlock;
+                return;
+            }
+            if(!lmdChkTx(outline.txidMint, pTxIdx))
+            {
+                range.strError = "Mint tx info are not consistent in db and file" + strBlock;
+                return;
+            }
+
+            for(auto const& tx : block.vtx)
+            {
+                pTxIdx.SetNull();
+                const uint256& txid = tx.GetHash();
+                if(!dbBlock.RetrieveTxIndex(txid, pTxIdx, fk))
                 {
-                    mapNextBlockDelegate.erase(dest);
+                    range.strError = "Retrieve token tx index from db failed" + strBlock;
+                    return;
                 }
+                if(!lmdChkTx(txid, pTxIdx))
+                {
+                    range.strError = "Token tx info are not consistent in db and file" + strBlock;
+                    return;
+                }
+            }
+        }
 
-                //compare enroll ranged in argument of nDepth with table enroll
-                vector<uint256> vBlockRange;
-                vBlockRange.push_back(block.GetHash());
-                map<CDestination, CDiskPos> mapRes;
-                if(!dbBlock.RetrieveEnroll(block.hashPrev, vBlockRange, mapRes))
+        //checking of level 2: delegate/enroll
+        if(nLevel >= 2 && fMainFork)
+        {
+            if(fIsLastBlock)
+            {
+                if(!dbBlock.RetrieveDelegate(block.GetHash(), mapNextBlockDelegate))
                 {
-                    Error("B", "Retrieve enroll tx records from table enroll failed.\n");
-                    return false;
+                    range.strError = "Retrieve the latest delegate record from db failed" + strBlock;
+                    return;
                 }
-                map<CDestination, CDiskPos> mapResComp;
-                for(const auto& enroll : mapEnrollRanged)
+                fIsLastBlock = false;
+            }
+            else
+            {   //compare delegate in this iteration with the previous one
+                map<CDestination, int64> mapPrevBlockDelegate;
+                if(!dbBlock.RetrieveDelegate(block.GetHash(), mapPrevBlockDelegate))
                 {
-                    const CDestination& dest = enroll.first.second;
-                    const tuple<uint256, uint32, uint32>& pos = enroll.second;
-                    const uint32& file = get<1>(pos);
-                    const uint32& offset = get<2>(pos);
-                    mapResComp.insert(make_pair(dest, CDiskPos(file, offset)));
+                    range.strError = "Retrieve the following previous delegate record from db failed" + strBlock;
+                    return;
                 }
-                if(mapRes != mapResComp)
+                if(mapNextBlockDelegate != mapPrevBlockDelegate)
                 {
-                    Error("B", "Enroll transactions in tables enroll and transaction do not match.\n");
-                    return false;
+                    range.strError = "Delegate records followed one by one do not match" + strBlock;
+                    return;
                 }
+                mapNextBlockDelegate = mapPrevBlockDelegate;
+            }
+
+            if(!ApplyBlockDelegate(block, mapNextBlockDelegate, range.strError))
+            {
+                return;
             }
 
-            //checking of level 3: unspent
-            if(nLevel >= 3)
+            map<pair<uint256, CDestination>, tuple<uint256, uint32, uint32>> mapEnrollRanged;
+            for(const CTransaction& tx : block.vtx)
             {
-                CTransaction txMint;
-                if(!RetrieveTx(block.txMint.GetHash(), txMint))
+                if(tx.nType == CTransaction::TX_CERT)
                 {
-                    return false;
+                    const uint256& anchor = tx.hashAnchor;
+                    const CDestination& dest = tx.sendTo;
+                    const uint256& blk = block.GetHash();
+                    CTxIndex txIdx;
+                    uint256 fk;
+                    if(!dbBlock.RetrieveTxIndex(tx.GetHash(), txIdx, fk))
+                    {
+                        range.strError = "Retrieve enroll tx index from table transaction failed" + strBlock;
+                        return;
+                    }
+                    const uint32& nFile = txIdx.nFile;
+                    const uint32& nOffset = txIdx.nOffset;
+                    mapEnrollRanged[make_pair(anchor, dest)] = make_tuple(blk, nFile, nOffset);
                 }
-                mapUnspentUTXO.insert(make_pair(CTxOutPoint(block.txMint.GetHash(), 0), CTxUnspent(CTxOutPoint(block.txMint.GetHash(), 0)
-                                     , CTxOutput(txMint.sendTo, txMint.nAmount, txMint.nTimeStamp, txMint.nLockUntil))));
+            }
 
-                for(int i = 0; i < block.vtx.size(); ++i)
+            //compare enroll ranged in argument of nDepth with table enroll
+            vector<uint256> vBlockRange;
+            vBlockRange.push_back(block.GetHash());
+            map<CDestination, CDiskPos> mapRes;
+            if(!dbBlock.RetrieveEnroll(block.hashPrev, vBlockRange, mapRes))
+            {
+                range.strError = "Retrieve enroll tx records from table enroll failed" + strBlock;
+                return;
+            }
+            map<CDestination, CDiskPos> mapResComp;
+            for(const auto& enroll : mapEnrollRanged)
+            {
+                const CDestination& dest = enroll.first.second;
+                const tuple<uint256, uint32, uint32>& pos = enroll.second;
+                const uint32& file = get<1>(pos);
+                const uint32& offset = get<2>(pos);
+                mapResComp.insert(make_pair(dest, CDiskPos(file, offset)));
+            }
+            if(mapRes != mapResComp)
+            {
+                range.strError = "Enroll transactions in tables enroll and transaction do not match" + strBlock;
+                return;
+            }
+        }
+
+        //checking of level 3: unspent
+        if(nLevel >= 3 && outline.GetBlockHash() != range.hashCounted)
+        {
+            map<CTxOutPoint, CTxUnspent>& mapUnspentUTXO = range.mapUnspent;
+            vector<CTxOutPoint>& vSpentUTXO = range.vSpent;
+
+            CTransaction txMint;
+            if(!RetrieveTx(block.txMint.GetHash(), txMint))
+            {
+                range.strError = "Retrieve mint tx failed" + strBlock;
+                return;
+            }
+            mapUnspentUTXO.insert(make_pair(CTxOutPoint(block.txMint.GetHash(), 0), CTxUnspent(CTxOutPoint(block.txMint.GetHash(), 0)
+                                 , CTxOutput(txMint.sendTo, txMint.nAmount, txMint.nTimeStamp, txMint.nLockUntil))));
+
+            for(int i = 0; i < block.vtx.size(); ++i)
+            {
+                const CTransaction& tx = block.vtx[i];
+                const CTxContxt& txCtxt = block.vTxContxt[i];
+                int64 nChange = txCtxt.GetValueIn() - tx.nAmount - tx.nTxFee;
+                mapUnspentUTXO.insert(make_pair(
+                        CTxOutPoint(tx.GetHash(), 0),
+                        CTxUnspent(CTxOutPoint(tx.GetHash(), 0)
+                                 , CTxOutput(tx.sendTo, tx.nAmount, tx.nTimeStamp, tx.nLockUntil))));
+                if(nChange > 0)
                 {
-                    const CTransaction& tx = block.vtx[i];
-                    const CTxContxt& txCtxt = block.vTxContxt[i];
-                    int64 nChange = txCtxt.GetValueIn() - tx.nAmount - tx.nTxFee;
-                    mapUnspentUTXO.insert(make_pair(
-                            CTxOutPoint(tx.GetHash(), 0),
-                            CTxUnspent(CTxOutPoint(tx.GetHash(), 0)
-                                     , CTxOutput(tx.sendTo, tx.nAmount, tx.nTimeStamp, tx.nLockUntil))));
-                    if(nChange > 0)
+                    Log("B", "Tx(%s) with a change(%s) on height(%d): to prepare to check.\n", tx.GetHash().ToString().c_str(), to_string(nChange).c_str(), outline.nHeight);
+                    if(!CheckInputSingleAddressForTxWithChange(tx.GetHash()))
                     {
-                        Log("B", "Tx(%s) with a change(%s) on height(%d): to prepare to check.\n", tx.GetHash().ToString().c_str(), to_string(nChange).c_str(), pIndex->nHeight);
-                        if(!CheckInputSingleAddressForTxWithChange(tx.GetHash()))
-                        {
-                            Error("B", "Tx(%s) with a change(%s) on height(%d): input must be a single address.\n", tx.GetHash().ToString().c_str(), to_string(nChange).c_str(), pIndex->nHeight);
-                            return false;
-                        }
-                        else
-                        {
-                            mapUnspentUTXO.insert(make_pair(
-                                    CTxOutPoint(tx.GetHash(), 1),
-                                    CTxUnspent(CTxOutPoint(tx.GetHash(), 1)
-                                             , CTxOutput(txCtxt.destIn, nChange, tx.nTimeStamp, tx.nLockUntil))));
-                        }
+                        range.strError = "Tx " + tx.GetHash().GetHex() + " with a change on height " + to_string(outline.nHeight)
+                                         + ": input must be a single address";
+                        return;
                     }
-                    for(const auto& txin : tx.vInput)
+                    else
                     {
-                        vSpentUTXO.push_back(txin.prevout);
+                        mapUnspentUTXO.insert(make_pair(
+                                CTxOutPoint(tx.GetHash(), 1),
+                                CTxUnspent(CTxOutPoint(tx.GetHash(), 1)
+                                         , CTxOutput(txCtxt.destIn, nChange, tx.nTimeStamp, tx.nLockUntil))));
                     }
                 }
-
-                vector<CTxOutPoint> vRemovedUTXO;
-                for(const auto& spent : vSpentUTXO)
+                for(const auto& txin : tx.vInput)
                 {
-                    if(mapUnspentUTXO.find(spent) != mapUnspentUTXO.end())
-                    {
-                        mapUnspentUTXO.erase(spent);
-                        vRemovedUTXO.push_back(spent);
-                    }
+                    vSpentUTXO.push_back(txin.prevout);
                 }
+            }
 
-                for(const auto& txDel : vRemovedUTXO)
+            vector<CTxOutPoint> vRemovedUTXO;
+            for(const auto& spent : vSpentUTXO)
+            {
+                if(mapUnspentUTXO.find(spent) != mapUnspentUTXO.end())
                 {
-                    const auto& pos = find(vSpentUTXO.begin(), vSpentUTXO.end(), txDel);
-                    vSpentUTXO.erase(pos);
+                    mapUnspentUTXO.erase(spent);
+                    vRemovedUTXO.push_back(spent);
                 }
-
             }
 
-            pIndex = pIndex->pPrev;
+            for(const auto& txDel : vRemovedUTXO)
+            {
+                const auto& pos = find(vSpentUTXO.begin(), vSpentUTXO.end(), txDel);
+                vSpentUTXO.erase(pos);
+            }
         }
-        Log("B", "Checking duration before comparing unspent ===> %s\n", t_fork.format().c_str());
-        if(nLevel >= 3)
+    }
+
+    range.fPassed = true;
+}
+
+bool CBlockBase::ApplyBlockDelegate(const CBlockEx& block,map<CDestination,int64>& mapDelegate,string& strError)
+{
+    // turns the delegate record of block into the one expected for its prev block
+    if (block.txMint.nType == CTransaction::TX_STAKE)
+    {
+        mapDelegate[block.txMint.sendTo] -= block.txMint.nAmount;
+    }
+
+    for (int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction& tx = block.vtx[i];
         {
-            //compare unspent with transaction
-            CForkUnspentCheckWalker walker(mapUnspentUTXO);
-            if(!dbBlock.WalkThroughUnspent(fork.first, walker))
+            CTemplateId tid;
+            if(tx.sendTo.GetTemplateId(tid) && tid.GetType() == TEMPLATE_DELEGATE)
             {
-                Error("B", "{%d} ranged unspent records failed to walk through.\n", mapUnspentUTXO.size());
-                return false;
+                mapDelegate[tx.sendTo] -= tx.nAmount;
             }
+        }
 
-            if(walker.nMatch != mapUnspentUTXO.size())
+        const CTxContxt& txContxt = block.vTxContxt[i];
+        {
+            CTemplateId tid;
+            if(txContxt.destIn.GetTemplateId(tid) && tid.GetType() == TEMPLATE_DELEGATE)
             {
-                Error("B", "{%d} ranged unspent records do not match with full collection of unspent.\n", mapUnspentUTXO.size());
-                return false;
+                mapDelegate[txContxt.destIn] += tx.nAmount + tx.nTxFee;
             }
         }
+    }
 
-        Log("B", "Checking duration of fork{%s} ===> %s\n", fork.first.ToString().c_str(), t_fork.format().c_str());
+    vector<CDestination> vDestNull;
+    for(const auto& delegate : mapDelegate)
+    {
+        if(delegate.second < 0)
+        {
+            strError = "Amount on delegate template address must not be less than zero, block " + block.GetHash().GetHex();
+            return false;
+        }
+        if(delegate.second == 0)
+        {
+            vDestNull.push_back(delegate.first);
+        }
+    }
+    for(const auto& dest : vDestNull)
+    {
+        mapDelegate.erase(dest);
     }
+    return true;
+}
 
-    Log("B", "Checking duration ===> %s\n", t_check.format().c_str());
+bool CBlockBase::IsForkChainBlock(const uint256& hashFork,const uint256& hashBlock)
+{
+    CWalleveReadLock rlock(rwAccess);
 
-    Log("B", "Data consistency verified.\n");
+    CBlockIndex* pIndex = GetIndex(hashBlock);
+    boost::shared_ptr<CBlockFork> spFork = GetFork(hashFork);
+    if (pIndex == NULL || spFork == NULL)
+    {
+        return false;
+    }
+    if (pIndex->GetOriginHash() != hashFork)
+    {
+        // below the origin, the blocks are ancestors shared with the parent fork
+        return true;
+    }
+
+    CWalleveReadLock rForkLock(spFork->GetRWAccess());
+    return (pIndex == spFork->GetLast() || pIndex->pNext != NULL);
+}
+
+bool CBlockBase::IsConsistencyStopping()
+{
+    boost::unique_lock<boost::mutex> lock(mtxConsistency);
+    return fStopConsistency;
+}
+
+void CBlockBase::AddConsistencyFinding(const string& strFinding)
+{
+    Error("B", "%s.\n", strFinding.c_str());
+
+    boost::unique_lock<boost::mutex> lock(mtxConsistency);
+    statConsistency.nErrorCount++;
+    statConsistency.vFinding.push_back(strFinding);
+    if (statConsistency.vFinding.size() > CONSISTENCY_MAX_FINDING)
+    {
+        statConsistency.vFinding.erase(statConsistency.vFinding.begin());
+    }
+}
+
+bool CBlockBase::LoadConsistencyCheckpoint(CConsistencyCheckpoint& checkpoint)
+{
+    if (!is_regular_file(pathConsistency))
+    {
+        return false;
+    }
 
+    try
+    {
+        CWalleveFileStream fs(pathConsistency.c_str());
+        fs >> checkpoint;
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+    return true;
+}
+
+bool CBlockBase::SaveConsistencyCheckpoint(const CConsistencyCheckpoint& checkpoint)
+{
+    // a crash leaves either the old checkpoint or the new one, never a torn file
+    boost::filesystem::path pathTemp = pathConsistency.string() + ".tmp";
+    FILE * fp = fopen(pathTemp.c_str(),"w");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    fclose(fp);
+
+    try
+    {
+        {
+            CWalleveFileStream fs(pathTemp.c_str());
+            fs << checkpoint;
+        }
+        boost::filesystem::rename(pathTemp,pathConsistency);
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
     return true;
 }
 
+void CBlockBase::ConsistencyProc(int nLevel,int32 nDepth)
+{
+    boost::timer::cpu_timer t_check;
+    t_check.start();
+
+    Log("B", "Background consistency checking started, check-level:%d and check-depth:%d.\n", nLevel, nDepth);
+
+    // progress of the same check survives restarts, another level or depth starts over
+    CConsistencyCheckpoint checkpoint;
+    if (!LoadConsistencyCheckpoint(checkpoint) || checkpoint.nCheckLevel != nLevel || checkpoint.nCheckDepth != nDepth)
+    {
+        checkpoint = CConsistencyCheckpoint();
+        checkpoint.nCheckLevel = nLevel;
+        checkpoint.nCheckDepth = nDepth;
+    }
+
+    vector<pair<uint256, uint256>> vFork;
+    bool fPassed = dbBlock.ListFork(vFork);
+    if (!fPassed)
+    {
+        AddConsistencyFinding("List fork failed");
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mtxConsistency);
+        statConsistency.nForkCount = vFork.size();
+    }
+
+    for (size_t i = 0;i < vFork.size() && !IsConsistencyStopping();i++)
+    {
+        if (!CheckForkConsistency(vFork[i].first, vFork[i].second, nLevel, nDepth, &checkpoint))
+        {
+            fPassed = false;
+        }
+        boost::unique_lock<boost::mutex> lock(mtxConsistency);
+        statConsistency.nForkChecked++;
+    }
+
+    bool fStopped = IsConsistencyStopping();
+    if (!fStopped)
+    {
+        // a failed run is repaired on next start, the worldline rebuilds the container then
+        checkpoint.fFailed = !fPassed;
+        SaveConsistencyCheckpoint(checkpoint);
+    }
+
+    uint64 nErrorCount = 0;
+    {
+        boost::unique_lock<boost::mutex> lock(mtxConsistency);
+        statConsistency.fRunning = false;
+        statConsistency.fPassed = (fPassed && !fStopped);
+        nErrorCount = statConsistency.nErrorCount;
+    }
+
+    if (fStopped)
+    {
+        Log("B", "Background consistency checking is interrupted, it resumes on next start.\n");
+    }
+    else if (fPassed)
+    {
+        Log("B", "Data consistency verified in background, duration ===> %s\n", t_check.format().c_str());
+    }
+    else
+    {
+        Error("B", "Background consistency checking found %lu errors, the container is rebuilt on next start.\n", nErrorCount);
+    }
+}
+
 bool CBlockBase::CheckInputSingleAddressForTxWithChange(const uint256& txid)
 {
     CTransaction tx;
@@ -1537,18 +2117,32 @@ bool CBlockBase::CheckInputSingleAddressForTxWithChange(const uint256& txid)
 
 CBlockIndex* CBlockBase::GetIndex(const uint256& hash) const
 {
-    map<uint256,CBlockIndex*>::const_iterator mi = mapIndex.find(hash);
-    return (mi != mapIndex.end() ? (*mi).second : NULL);
+    return arenaIndex.Get(hash);
 }
 
-CBlockIndex* CBlockBase::GetOrCreateIndex(const uint256& hash)
+CBlockIndex* CBlockBase::GetForkIndex(boost::shared_ptr<CBlockFork> spFork,int32 nHeight) const
 {
-    map<uint256,CBlockIndex*>::const_iterator mi = mapIndex.find(hash);
-    if (mi == mapIndex.end())
+    CBlockIndex* pIndex = spFork->GetIndexByHeight(nHeight);
+    if (pIndex == NULL && nHeight >= 0 && nHeight < spFork->GetOrigin()->GetBlockHeight())
     {
-        mi = mapIndex.insert(make_pair(hash,new CBlockIndex())).first;
+        // heights below origin belong to the parent forks
+        pIndex = spFork->GetOrigin();
+        while (pIndex != NULL && pIndex->GetBlockHeight() > nHeight)
+        {
+            pIndex = pIndex->pPrev;
+        }
+        while (pIndex != NULL && pIndex->GetBlockHeight() == nHeight && pIndex->IsExtended())
+        {
+            pIndex = pIndex->pPrev;
+        }
     }
-    return ((*mi).second);
+    return pIndex;
+}
+
+CBlockIndex* CBlockBase::GetOrCreateIndex(const uint256& hash)
+{
+    bool fNew = false;
+    return arenaIndex.Insert(hash,CBlockIndex(),fNew);
 }
 
 CBlockIndex* CBlockBase::GetBranch(CBlockIndex* pIndexRef,CBlockIndex* pIndex,vector<CBlockIndex*>& vPath)
@@ -1591,20 +2185,17 @@ CBlockIndex* CBlockBase::GetOriginIndex(const uint256& txidMint) const
 
 CBlockIndex* CBlockBase::AddNewIndex(const uint256& hash,const CBlock& block,uint32 nFile,uint32 nOffset)
 {
-    CBlockIndex* pIndexNew = new CBlockIndex(block,nFile,nOffset);
+    bool fNew = false;
+    CBlockIndex* pIndexNew = arenaIndex.Insert(hash,CBlockIndex(block,nFile,nOffset),fNew);
     if (pIndexNew != NULL)
     {
-        map<uint256, CBlockIndex*>::iterator mi = mapIndex.insert(make_pair(hash, pIndexNew)).first;
-        pIndexNew->phashBlock = &((*mi).first);
-    
         int64 nMoneySupply = block.GetBlockMint();
         uint64 nChainTrust = block.GetBlockTrust();
         uint64 nRandBeacon = block.GetBlockBeacon();
         CBlockIndex* pIndexPrev = NULL;
-        map<uint256, CBlockIndex*>::iterator miPrev = mapIndex.find(block.hashPrev);
-        if (miPrev != mapIndex.end())
+        pIndexPrev = arenaIndex.Get(block.hashPrev);
+        if (pIndexPrev != NULL)
         {
-            pIndexPrev = (*miPrev).second;
             pIndexNew->pPrev = pIndexPrev;
             pIndexNew->nHeight = pIndexPrev->nHeight + (pIndexNew->IsExtended() ? 0 : 1);
             if (!pIndexNew->IsOrigin())
@@ -1723,7 +2314,8 @@ bool CBlockBase::GetTxUnspent(const uint256 fork,const CTxOutPoint& out,CTxOutpu
     return dbBlock.RetrieveTxUnspent(fork,out,unspent);
 }
 
-bool CBlockBase::GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,vector<pair<uint256,CTxIndex> >& vTxNew)
+bool CBlockBase::GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,vector<pair<uint256,CTxIndex> >& vTxNew,
+                                                                       vector<pair<CDestination,CAddrTxIndex> >& vAddrTxNew)
 {
     vector<CBlockIndex*> vPath;
     if (view.GetFork() != NULL && view.GetFork()->GetLast() != NULL)
@@ -1735,7 +2327,6 @@ bool CBlockBase::GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,vector<pa
         vPath.push_back(pIndexNew);
     }
 
-    CWalleveBufStream ss;
     for (int i = vPath.size() - 1;i >= 0;i--)
     {
         CBlockIndex* pIndex = vPath[i];
@@ -1744,39 +2335,150 @@ bool CBlockBase::GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,vector<pa
         {
             return false;
         }
-        int32 nHeight = pIndex->GetBlockHeight();
-        uint32 nOffset = pIndex->nOffset + block.GetTxSerializedOffset();
+        GetBlockTxIndex(pIndex,block,vTxNew,vAddrTxNew);
+    }
+    return true;
+}
 
-        if (!block.txMint.IsNull())
+void CBlockBase::GetBlockTxIndex(const CBlockIndex* pIndex,const CBlockEx& block,vector<pair<uint256,CTxIndex> >& vTxNew,
+                                                                                  vector<pair<CDestination,CAddrTxIndex> >& vAddrTxNew)
+{
+    CWalleveBufStream ss;
+    int32 nHeight = pIndex->GetBlockHeight();
+    uint32 nOffset = pIndex->nOffset + block.GetTxSerializedOffset();
+
+    if (!block.txMint.IsNull())
+    {
+        uint256 txid = block.txMint.GetHash();
+        CTxIndex txIndex(nHeight,pIndex->nFile,nOffset);
+        vTxNew.push_back(make_pair(txid,txIndex));
+        vAddrTxNew.push_back(make_pair(block.txMint.sendTo,CAddrTxIndex(nHeight,txid,pIndex->nFile,nOffset)));
+    }
+    nOffset += ss.GetSerializeSize(block.txMint);
+
+    CVarInt var(block.vtx.size());
+    nOffset += ss.GetSerializeSize(var);
+    for (int i = 0;i < block.vtx.size();i++)
+    {
+        const CTransaction& tx = block.vtx[i];
+        const CTxContxt& txCtxt = block.vTxContxt[i];
+        uint256 txid = tx.GetHash();
+        CTxIndex txIndex(nHeight,pIndex->nFile,nOffset);
+        vTxNew.push_back(make_pair(txid,txIndex));
+
+        CAddrTxIndex addrTx(nHeight,txid,pIndex->nFile,nOffset,txCtxt.destIn,txCtxt.GetValueIn());
+        vAddrTxNew.push_back(make_pair(tx.sendTo,addrTx));
+        if (!txCtxt.destIn.IsNull() && txCtxt.destIn != tx.sendTo)
         {
-            CTxIndex txIndex(nHeight,pIndex->nFile,nOffset);
-            vTxNew.push_back(make_pair(block.txMint.GetHash(),txIndex));
+            vAddrTxNew.push_back(make_pair(txCtxt.destIn,addrTx));
         }
-        nOffset += ss.GetSerializeSize(block.txMint);
+        nOffset += ss.GetSerializeSize(tx);
+    }
+}
+
+bool CBlockBase::FilterBlockTx(const CBlockIndex* pIndex,const set<CDestination>& setDest,vector<CAssembledTx>& vMatch)
+{
+    CBlockEx block;
+    if (!tsBlock.Read(block,pIndex->nFile,pIndex->nOffset,false))
+    {
+        return false;
+    }
+    int32 nBlockHeight = pIndex->GetBlockHeight();
+    if (setDest.count(block.txMint.sendTo))
+    {
+        vMatch.push_back(CAssembledTx(block.txMint,nBlockHeight));
+    }
+    for (int i = 0; i < block.vtx.size();i++)
+    {
+        CTransaction& tx = block.vtx[i];
+        CTxContxt& ctxt = block.vTxContxt[i];
 
-        CVarInt var(block.vtx.size());
-        nOffset += ss.GetSerializeSize(var);
-        for (int i = 0;i < block.vtx.size();i++)
+        if (setDest.count(tx.sendTo) || setDest.count(ctxt.destIn))
         {
-            CTransaction& tx = block.vtx[i];
-            CTxContxt& txCtxt = block.vTxContxt[i];
-            uint256 txid = tx.GetHash();
-            CTxIndex txIndex(nHeight,pIndex->nFile,nOffset);
-            vTxNew.push_back(make_pair(txid,txIndex));
-            nOffset += ss.GetSerializeSize(tx);
+            vMatch.push_back(CAssembledTx(tx,nBlockHeight,ctxt.destIn,ctxt.GetValueIn()));
         }
     }
     return true;
 }
 
-void CBlockBase::ClearCache()
+bool CBlockBase::FilterIndexedTx(const uint256& hashFork,int32 nHeightFrom,bool fReverse,CTxFilter& filter)
 {
-    map<uint256, CBlockIndex *>::iterator mi;
-    for (mi = mapIndex.begin(); mi != mapIndex.end(); ++mi)
+    vector<CAddrTxIndex> vAddrTx;
+    for (set<CDestination>::const_iterator it = filter.setDest.begin();it != filter.setDest.end();++it)
+    {
+        if (!dbBlock.RetrieveAddressTx(hashFork,*it,nHeightFrom,vAddrTx))
+        {
+            return false;
+        }
+    }
+
+    // a tx between two filtered addresses is indexed under both of them
+    std::sort(vAddrTx.begin(),vAddrTx.end());
+    vAddrTx.erase(std::unique(vAddrTx.begin(),vAddrTx.end(),
+                              [](const CAddrTxIndex& a,const CAddrTxIndex& b) { return (a.txid == b.txid); }),
+                  vAddrTx.end());
+    if (fReverse)
+    {
+        // newest block first, the txs of a block stay in block order
+        std::stable_sort(vAddrTx.begin(),vAddrTx.end(),
+                         [](const CAddrTxIndex& a,const CAddrTxIndex& b) { return (a.nBlockHeight > b.nBlockHeight); });
+    }
+
+    for (int i = 0;i < vAddrTx.size();i++)
     {
-        delete (*mi).second;
+        const CAddrTxIndex& addrTx = vAddrTx[i];
+        CTransaction tx;
+        if (!tsBlock.Read(tx,addrTx.nFile,addrTx.nOffset,false))
+        {
+            return false;
+        }
+        if (!filter.FoundTx(hashFork,CAssembledTx(tx,addrTx.nBlockHeight,addrTx.destIn,addrTx.nValueIn)))
+        {
+            return false;
+        }
     }
-    mapIndex.clear(); 
+    return true;
+}
+
+bool CBlockBase::ScanForkTx(const uint256& hashFork,const vector<CBlockIndex*>& vIndex,CTxFilter& filter)
+{
+    // Blocks are read and matched on the worker pool FILTER_WINDOW_SIZE at a time,
+    // then the matches of the window are delivered to filter in the order of vIndex.
+    size_t nWindow = std::min(vIndex.size(),(size_t)FILTER_WINDOW_SIZE);
+    vector<vector<CAssembledTx> > vMatch(nWindow);
+    vector<int> vRead(nWindow,0);
+    for (size_t nBase = 0;nBase < vIndex.size();nBase += nWindow)
+    {
+        size_t nCount = std::min(vIndex.size() - nBase,nWindow);
+        if (!spWorkerPool->Run(nCount,[&](size_t n) {
+                vMatch[n].clear();
+                vRead[n] = FilterBlockTx(vIndex[nBase + n],filter.setDest,vMatch[n]);
+            }))
+        {
+            return false;
+        }
+
+        for (size_t n = 0;n < nCount;n++)
+        {
+            if (!vRead[n])
+            {
+                return false;
+            }
+            for (int j = 0;j < vMatch[n].size();j++)
+            {
+                if (!filter.FoundTx(hashFork,vMatch[n][j]))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void CBlockBase::ClearCache()
+{
+    arenaIndex.Clear();
     mapFork.clear();
 }
 
@@ -1785,42 +2487,351 @@ bool CBlockBase::LoadDB()
     CWalleveWriteLock wlock(rwAccess);
 
     ClearCache();
-    CBlockWalker walker(this);
-    if (!dbBlock.WalkThroughBlock(walker))
+    if (LoadSnapshot())
+    {
+        nSnapshotSeq = dbBlock.GetChangeSeq();
+        Log("B","Loaded block index snapshot, %lu blocks, %lu forks\n",arenaIndex.GetSize(),mapFork.size());
+    }
+    else
     {
         ClearCache();
+        CBlockWalker walker(this);
+        if (!dbBlock.WalkThroughBlock(walker))
+        {
+            ClearCache();
+            return false;
+        }
+
+        vector<pair<uint256,uint256> > vFork;
+        if (!dbBlock.ListFork(vFork))
+        {
+            ClearCache();
+            return false;
+        }
+        for (int i = 0;i < vFork.size();i++)
+        {   
+            CBlockIndex* pIndex = GetIndex(vFork[i].second);
+            if (pIndex == NULL)
+            {
+                ClearCache();
+                return false;
+            }
+            CProfile profile;
+            if (!LoadForkProfile(pIndex->pOrigin,profile))
+            {
+                return false;
+            }
+            boost::shared_ptr<CBlockFork> spFork = AddNewFork(profile,pIndex);
+            if (spFork == NULL)
+            {
+                return false;
+            }
+        }
+    }
+
+    if (!IsAddressTxIndexMatched())
+    {
+        // built again in background after loading, FilterTx scans blocks until it is complete
+        dbBlock.ClearAddressTxIndex();
+    }
+
+    return true;
+}
+
+bool CBlockBase::LoadSnapshot()
+{
+    uint256 hashSnapshot;
+    if (!dbBlock.RetrieveSnapshot(hashSnapshot))
+    {
+        return false;
+    }
+
+    vector<CBlockIndexSnapshotFork> vSnapshotFork;
+    vector<CBlockOutline> vOutline;
+    if (!snapshotIndex.Load(hashSnapshot,vSnapshotFork,vOutline))
+    {
+        Warn("B","Block index snapshot is missing or damaged\n");
         return false;
     }
 
     vector<pair<uint256,uint256> > vFork;
-    if (!dbBlock.ListFork(vFork))
+    if (!dbBlock.ListFork(vFork) || vFork.size() != vSnapshotFork.size())
     {
-        ClearCache();
         return false;
     }
-    for (int i = 0;i < vFork.size();i++)
-    {   
-        CBlockIndex* pIndex = GetIndex(vFork[i].second);
-        if (pIndex == NULL)
+    map<uint256,uint256> mapForkLast(vFork.begin(),vFork.end());
+    for (int i = 0;i < vSnapshotFork.size();i++)
+    {
+        map<uint256,uint256>::iterator it = mapForkLast.find(vSnapshotFork[i].hashFork);
+        if (it == mapForkLast.end() || (*it).second != vSnapshotFork[i].hashLastBlock)
         {
-            ClearCache();
+            Warn("B","Block index snapshot is stale\n");
             return false;
         }
+    }
+
+    arenaIndex.Reserve(vOutline.size());
+    for (int i = 0;i < vOutline.size();i++)
+    {
+        LoadIndex(vOutline[i]);
+    }
+
+    for (int i = 0;i < vSnapshotFork.size();i++)
+    {
+        CBlockIndex* pIndex = GetIndex(vSnapshotFork[i].hashLastBlock);
         CProfile profile;
-        if (!LoadForkProfile(pIndex->pOrigin,profile))
+        if (pIndex == NULL || !profile.Load(vSnapshotFork[i].vchProfile)
+            || AddNewFork(profile,pIndex) == NULL)
         {
             return false;
         }
-        boost::shared_ptr<CBlockFork> spFork = AddNewFork(profile,pIndex);
-        if (spFork == NULL)
+    }
+    return true;
+}
+
+bool CBlockBase::SaveSnapshot()
+{
+    vector<CBlockIndexSnapshotFork> vSnapshotFork;
+    vector<CBlockOutline> vOutline;
+    uint64 nSeq = 0;
+    {
+        CWalleveReadLock rlock(rwAccess);
+
+        // hold every fork, so the captured tips agree with the captured index
+        vector<boost::shared_ptr<CBlockFork> > vspFork;
+        for (map<uint256,boost::shared_ptr<CBlockFork> >::iterator it = mapFork.begin();it != mapFork.end();++it)
         {
+            (*it).second->ReadLock();
+            vspFork.push_back((*it).second);
+        }
+
+        nSeq = dbBlock.GetChangeSeq();
+        vSnapshotFork.resize(vspFork.size());
+        for (int i = 0;i < vspFork.size();i++)
+        {
+            CBlockIndex* pIndexLast = vspFork[i]->GetLast();
+            CProfile profile = vspFork[i]->GetProfile();
+            vSnapshotFork[i].hashFork = pIndexLast->GetOriginHash();
+            vSnapshotFork[i].hashLastBlock = pIndexLast->GetBlockHash();
+            profile.Save(vSnapshotFork[i].vchProfile);
+        }
+
+        vOutline.reserve(arenaIndex.GetSize());
+        arenaIndex.WalkThrough([&vOutline](const CBlockIndex* pIndex) { vOutline.push_back(CBlockOutline(pIndex)); });
+
+        for (int i = 0;i < vspFork.size();i++)
+        {
+            vspFork[i]->ReadUnlock();
+        }
+    }
+
+    if (nSeq == nSnapshotSeq)
+    {
+        return true;
+    }
+
+    uint256 hashSnapshot;
+    if (!snapshotIndex.Save(vSnapshotFork,vOutline,hashSnapshot))
+    {
+        return false;
+    }
+
+    // a block stored meanwhile makes this snapshot stale, the next cycle retries
+    if (dbBlock.UpdateSnapshot(hashSnapshot,nSeq))
+    {
+        nSnapshotSeq = nSeq;
+        Log("B","Saved block index snapshot, %lu blocks\n",vOutline.size());
+    }
+    return true;
+}
+
+void CBlockBase::SnapshotProc()
+{
+    boost::system_time timeout = boost::get_system_time();
+
+    boost::unique_lock<boost::mutex> lock(mtxSnapshot);
+    while (!fStopSnapshot)
+    {
+        timeout += boost::posix_time::seconds(SNAPSHOT_INTERVAL);
+
+        while (!fStopSnapshot)
+        {
+            if (!condSnapshot.timed_wait(lock,timeout))
+            {
+                break;
+            }
+        }
+
+        if (!fStopSnapshot && !SaveSnapshot())
+        {
+            Warn("B","Failed to save block index snapshot\n");
+        }
+    }
+}
+
+bool CBlockBase::IsAddressTxIndexMatched()
+{
+    if (!dbBlock.IsAddressTxIndexComplete())
+    {
+        return false;
+    }
+
+    // the address index is written without sync, after a crash it may end at another block than the fork
+    for (map<uint256,boost::shared_ptr<CBlockFork> >::iterator it = mapFork.begin();it != mapFork.end();++it)
+    {
+        uint256 hashTip;
+        if (!dbBlock.RetrieveAddressTxTip((*it).first,hashTip) || hashTip != (*it).second->GetLast()->GetBlockHash())
+        {
+            Warn("B","Address tx index of fork %s does not end at its last block\n",(*it).first.GetHex().c_str());
             return false;
         }
     }
+    return true;
+}
 
+bool CBlockBase::StartAddressTxIndexBuild()
+{
+    StopAddressTxIndexBuild();
+
+    {
+        boost::unique_lock<boost::mutex> lock(mtxAddressTx);
+        fStopAddressTx = false;
+    }
+
+    pThreadAddressTx = new boost::thread([this]() { AddressTxIndexProc(); });
+    if (pThreadAddressTx == NULL)
+    {
+        boost::unique_lock<boost::mutex> lock(mtxAddressTx);
+        fStopAddressTx = true;
+        return false;
+    }
     return true;
 }
 
+void CBlockBase::StopAddressTxIndexBuild()
+{
+    if (pThreadAddressTx)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mtxAddressTx);
+            fStopAddressTx = true;
+        }
+        pThreadAddressTx->join();
+        delete pThreadAddressTx;
+        pThreadAddressTx = NULL;
+    }
+}
+
+bool CBlockBase::IsAddressTxIndexBuildStopping()
+{
+    boost::unique_lock<boost::mutex> lock(mtxAddressTx);
+    return fStopAddressTx;
+}
+
+CBlockIndex* CBlockBase::GetAddressTxIndexResume(CBlockIndex* pIndexDone,CBlockIndex* pIndexLast)
+{
+    // a reorg between batches detaches indexed blocks, the fork update that did it dropped their entries
+    while (pIndexDone != NULL && pIndexDone != pIndexLast && pIndexDone->pNext == NULL)
+    {
+        pIndexDone = pIndexDone->pPrev;
+    }
+    return pIndexDone;
+}
+
+bool CBlockBase::BuildForkAddressTxIndex(const uint256& hashFork)
+{
+    boost::shared_ptr<CBlockFork> spFork;
+    {
+        CWalleveReadLock rlock(rwAccess);
+        spFork = GetFork(hashFork);
+    }
+    if (spFork == NULL)
+    {
+        return false;
+    }
+
+    CBlockIndex* pIndexDone = NULL;
+    size_t nBlockCount = 0;
+    while (!IsAddressTxIndexBuildStopping())
+    {
+        // a batch at a time under the fork lock, new blocks wait for one batch at most and index themselves
+        CWalleveReadLock rlock(rwAccess);
+        CWalleveReadLock rForkLock(spFork->GetRWAccess());
+
+        CBlockIndex* pIndexLast = spFork->GetLast();
+        pIndexDone = GetAddressTxIndexResume(pIndexDone,pIndexLast);
+        if (pIndexDone == pIndexLast)
+        {
+            return true;
+        }
+
+        vector<pair<uint256,CTxIndex> > vTxNew;
+        vector<pair<CDestination,CAddrTxIndex> > vAddrTxNew;
+        for (CBlockIndex* pIndex = (pIndexDone != NULL ? pIndexDone->pNext : spFork->GetOrigin());
+             pIndex != NULL && vAddrTxNew.size() < ADDRTX_REBUILD_BATCH;pIndex = pIndex->pNext)
+        {
+            if (++nBlockCount % ADDRTX_REBUILD_PROGRESS == 0)
+            {
+                Log("B","Building address tx index of fork %s, at height %d/%d\n",
+                    hashFork.GetHex().c_str(),pIndex->GetBlockHeight(),pIndexLast->GetBlockHeight());
+            }
+            CBlockEx block;
+            if (!tsBlock.Read(block,pIndex->nFile,pIndex->nOffset,false))
+            {
+                return false;
+            }
+            GetBlockTxIndex(pIndex,block,vTxNew,vAddrTxNew);
+            pIndexDone = pIndex;
+        }
+
+        if (!dbBlock.AddAddressTx(hashFork,vAddrTxNew,pIndexDone == pIndexLast ? pIndexLast->GetBlockHash() : uint256()))
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+void CBlockBase::AddressTxIndexProc()
+{
+    // run after upgrading from a tree without the index, or when the index does not end at the fork tips after a crash
+    Log("B","Building address tx index in background, FilterTx scans blocks until it is built\n");
+
+    vector<uint256> vFork;
+    {
+        CWalleveReadLock rlock(rwAccess);
+        for (map<uint256,boost::shared_ptr<CBlockFork> >::iterator it = mapFork.begin();it != mapFork.end();++it)
+        {
+            vFork.push_back((*it).first);
+        }
+    }
+
+    // forks created meanwhile are indexed by their own updates from the origin on
+    for (size_t i = 0;i < vFork.size();i++)
+    {
+        Log("B","Building address tx index of fork %s\n",vFork[i].GetHex().c_str());
+        if (!BuildForkAddressTxIndex(vFork[i]))
+        {
+            if (IsAddressTxIndexBuildStopping())
+            {
+                Log("B","Address tx index building is interrupted, it starts over on next start\n");
+            }
+            else
+            {
+                Warn("B","Failed to build address tx index, fall back to scanning blocks\n");
+            }
+            return;
+        }
+    }
+
+    if (!dbBlock.SetAddressTxIndexComplete())
+    {
+        Warn("B","Failed to mark address tx index complete, fall back to scanning blocks\n");
+        return;
+    }
+    Log("B","Address tx index is built\n");
+}
+
 bool CBlockBase::SetupLog(const path& pathLocation,bool fDebug)
 {
 
@@ -8,8 +8,11 @@
 #include "timeseries.h"
 #include "blockdb.h"
 #include "block.h"
+#include "blockindexarena.h"
+#include "blockindexsnapshot.h"
 #include "forkcontext.h"
 #include "profile.h"
+#include "verifypool.h"
 #include "walleve/walleve.h"
 
 #include <map>
@@ -42,6 +45,11 @@ public:
     const CProfile& GetProfile() const { return forkProfile; }
     CBlockIndex* GetLast() const { return pIndexLast; }
     CBlockIndex* GetOrigin() const { return pIndexOrigin; }
+    CBlockIndex* GetIndexByHeight(int32 nHeight) const
+    {
+        int32 n = nHeight - pIndexOrigin->GetBlockHeight();
+        return ((n >= 0 && n < (int32)vHeightIndex.size()) ? vHeightIndex[n] : NULL);
+    }
     void UpdateLast(CBlockIndex* pIndexLastIn) { pIndexLast = pIndexLastIn; UpdateNext(); }
     void UpdateNext()
     {
@@ -64,6 +72,25 @@ public:
                 pIndex->pNext = pIndexNext;
                 pIndexNext = pIndex;
             }
+            UpdateHeightIndex(pIndexNext);
+        }
+    }
+protected:
+    void UpdateHeightIndex(CBlockIndex* pIndexFrom)
+    {
+        // rewrite the height slots above the branch point, each holding the first block of its height
+        int32 nOrigin = pIndexOrigin->GetBlockHeight();
+        if ((int32)vHeightIndex.size() <= pIndexFrom->GetBlockHeight() - nOrigin)
+        {
+            pIndexFrom = pIndexOrigin;
+        }
+        vHeightIndex.resize(pIndexLast->GetBlockHeight() - nOrigin + 1);
+        for (CBlockIndex* pIndex = pIndexFrom;pIndex != NULL;pIndex = pIndex->pNext)
+        {
+            if (!pIndex->IsExtended())
+            {
+                vHeightIndex[pIndex->GetBlockHeight() - nOrigin] = pIndex;
+            }
         }
     }
 protected:
@@ -71,6 +98,7 @@ protected:
     CProfile forkProfile;
     CBlockIndex* pIndexLast;
     CBlockIndex* pIndexOrigin;
+    std::vector<CBlockIndex*> vHeightIndex;
 };
 
 class CBlockView
@@ -144,6 +172,86 @@ protected:
     std::vector<uint256> vTxAddNew;
 };
 
+class CConsistencyStat
+{
+public:
+    CConsistencyStat()
+    : fRunning(false),fPassed(false),nCheckLevel(0),nCheckDepth(0),
+      nForkCount(0),nForkChecked(0),nBlockChecked(0),nErrorCount(0) {}
+public:
+    bool fRunning;
+    bool fPassed;
+    int nCheckLevel;
+    int32 nCheckDepth;
+    std::size_t nForkCount;
+    std::size_t nForkChecked;
+    uint64 nBlockChecked;
+    uint64 nErrorCount;
+    std::vector<std::string> vFinding;
+};
+
+// Verified segment [hashBottom,hashTop] of a fork chain, kept across restarts
+class CConsistencyForkCheckpoint
+{
+    friend class walleve::CWalleveStream;
+public:
+    CConsistencyForkCheckpoint() : fComplete(false) {}
+public:
+    uint256 hashFork;
+    uint256 hashTop;
+    uint256 hashBottom;
+    bool fComplete;
+    // level 3: outputs left unspent by the segment, and spent outputs created below it
+    std::vector<std::pair<CTxOutPoint,CTxOutput> > vUnspent;
+    std::vector<CTxOutPoint> vSpent;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(hashFork,opt);
+        s.Serialize(hashTop,opt);
+        s.Serialize(hashBottom,opt);
+        s.Serialize(fComplete,opt);
+        s.Serialize(vUnspent,opt);
+        s.Serialize(vSpent,opt);
+    }
+};
+
+class CConsistencyCheckpoint
+{
+    friend class walleve::CWalleveStream;
+public:
+    CConsistencyCheckpoint() : nCheckLevel(-1),nCheckDepth(0),fFailed(false) {}
+public:
+    int32 nCheckLevel;
+    int32 nCheckDepth;
+    bool fFailed;       // the last complete run found errors, the container is rebuilt on next start
+    std::vector<CConsistencyForkCheckpoint> vFork;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(nCheckLevel,opt);
+        s.Serialize(nCheckDepth,opt);
+        s.Serialize(fFailed,opt);
+        s.Serialize(vFork,opt);
+    }
+};
+
+class CConsistencyRange
+{
+public:
+    CConsistencyRange() : fPassed(false) {}
+public:
+    std::vector<CBlockOutline> vBlock;
+    uint256 hashChild;
+    uint256 hashCounted;    // its outputs are already in the resumed unspent state
+    bool fPassed;
+    std::string strError;
+    std::map<CTxOutPoint,CTxUnspent> mapUnspent;
+    std::vector<CTxOutPoint> vSpent;
+};
+
 class CBlockBase
 {
     friend class CBlockView;
@@ -163,8 +271,11 @@ public:
     bool Retrieve(const CBlockIndex* pIndex,CBlock& block);
     bool Retrieve(const uint256& hash,CBlockEx& block);
     bool Retrieve(const CBlockIndex* pIndex,CBlockEx& block);
+    bool RetrieveRaw(const uint256& hash,std::vector<unsigned char>& vchBlock);
     bool RetrieveIndex(const uint256& hash,CBlockIndex** ppIndex);
     bool RetrieveFork(const uint256& hash,CBlockIndex** ppIndex);
+    bool RetrieveFork(const uint256& hash,int32 nHeight,CBlockIndex** ppIndex);
+    bool RetrieveFork(const uint256& hash,int32 nHeight,std::vector<CBlockIndex*>& vIndex);
     bool RetrieveFork(const std::string& strName,CBlockIndex** ppIndex);
     bool RetrieveProfile(const uint256& hash,CProfile& profile);
     bool RetrieveForkContext(const uint256& hash,CForkContext& ctxt);
@@ -190,9 +301,16 @@ public:
     bool GetForkBlockLocator(const uint256& hashFork,CBlockLocator& locator);
     bool GetForkBlockInv(const uint256& hashFork,const CBlockLocator& locator,std::vector<uint256>& vBlockHash,size_t nMaxCount);
     bool CheckConsistency(int nCheckLevel, const int32 nCheckDepth);
+    bool StartConsistencyCheck(int nCheckLevel,int32 nCheckDepth);
+    void StopConsistencyCheck();
+    void GetConsistencyStat(CConsistencyStat& stat);
+    bool IsConsistencyFailed();
     bool CheckInputSingleAddressForTxWithChange(const uint256& txid);
+    void GetFlushStat(CBlockDBFlushStat& stat) { dbBlock.GetFlushStat(stat); }
+    void GetTxFilterStat(CTxIndexFilterStat& stat) { dbBlock.GetTxFilterStat(stat); }
 protected:
     CBlockIndex* GetIndex(const uint256& hash) const;
+    CBlockIndex* GetForkIndex(boost::shared_ptr<CBlockFork> spFork,int32 nHeight) const;
     CBlockIndex* GetOrCreateIndex(const uint256& hash);
     CBlockIndex* GetBranch(CBlockIndex* pIndexRef,CBlockIndex* pIndex,std::vector<CBlockIndex*>& vPath);
     CBlockIndex* GetOriginIndex(const uint256& txidMint) const;
@@ -203,9 +321,39 @@ protected:
     bool LoadForkProfile(const CBlockIndex* pIndexOrigin,CProfile& profile);
     bool UpdateDelegate(const uint256& hash,CBlockEx& block,const CDiskPos& posBlock);
     bool GetTxUnspent(const uint256 fork,const CTxOutPoint& out,CTxOutput& unspent);
-    bool GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,std::vector<std::pair<uint256,CTxIndex> >& vTxNew);
+    bool GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,std::vector<std::pair<uint256,CTxIndex> >& vTxNew,
+                                                               std::vector<std::pair<CDestination,CAddrTxIndex> >& vAddrTxNew);
+    void GetBlockTxIndex(const CBlockIndex* pIndex,const CBlockEx& block,std::vector<std::pair<uint256,CTxIndex> >& vTxNew,
+                                                                         std::vector<std::pair<CDestination,CAddrTxIndex> >& vAddrTxNew);
+    bool FilterIndexedTx(const uint256& hashFork,int32 nHeightFrom,bool fReverse,CTxFilter& filter);
+    bool FilterBlockTx(const CBlockIndex* pIndex,const std::set<CDestination>& setDest,std::vector<CAssembledTx>& vMatch);
+    bool ScanForkTx(const uint256& hashFork,const std::vector<CBlockIndex*>& vIndex,CTxFilter& filter);
+    bool CheckForkConsistency(const uint256& hashFork,const uint256& hashRefBlock,int nLevel,int32 nDepth,
+                              CConsistencyCheckpoint* pCheckpoint);
+    void CheckRangeConsistency(CConsistencyRange& range,int nLevel,bool fMainFork);
+    static void GetConsistencySegment(CBlockIndex* pIndexLast,CBlockIndex* pIndexTop,CBlockIndex* pIndexBottom,bool fComplete,
+                                      std::vector<std::pair<CBlockIndex*,CBlockIndex*> >& vSegment);
+    static void MergeRangeUnspent(const CConsistencyRange& range,std::map<CTxOutPoint,CTxUnspent>& mapUnspent,
+                                                                 std::set<CTxOutPoint>& setSpent);
+    bool ApplyBlockDelegate(const CBlockEx& block,std::map<CDestination,int64>& mapDelegate,std::string& strError);
+    bool IsForkChainBlock(const uint256& hashFork,const uint256& hashBlock);
+    bool IsConsistencyStopping();
+    void AddConsistencyFinding(const std::string& strFinding);
+    bool LoadConsistencyCheckpoint(CConsistencyCheckpoint& checkpoint);
+    bool SaveConsistencyCheckpoint(const CConsistencyCheckpoint& checkpoint);
+    void ConsistencyProc(int nLevel,int32 nDepth);
     void ClearCache();
     bool LoadDB();
+    bool LoadSnapshot();
+    bool SaveSnapshot();
+    void SnapshotProc();
+    bool IsAddressTxIndexMatched();
+    bool StartAddressTxIndexBuild();
+    void StopAddressTxIndexBuild();
+    bool IsAddressTxIndexBuildStopping();
+    bool BuildForkAddressTxIndex(const uint256& hashFork);
+    static CBlockIndex* GetAddressTxIndexResume(CBlockIndex* pIndexDone,CBlockIndex* pIndexLast);
+    void AddressTxIndexProc();
     bool SetupLog(const boost::filesystem::path& pathDataLocation,bool fDebug);
     void Log(const char* pszIdent,const char *pszFormat,...)
     {
@@ -239,12 +387,30 @@ protected:
         va_end(ap);
     }
 protected:
+    enum {FILTER_WINDOW_SIZE = 256};
+    enum {ADDRTX_REBUILD_BATCH = 4096,ADDRTX_REBUILD_PROGRESS = 10000};
+    enum {CONSISTENCY_MAX_WORKER = 8,CONSISTENCY_RANGE_SIZE = 256,CONSISTENCY_MAX_FINDING = 32};
     mutable walleve::CWalleveRWAccess rwAccess;
     walleve::CWalleveLog walleveLog;
     bool fDebugLog;
     CBlockDB dbBlock;
     CTimeSeriesCached tsBlock;
-    std::map<uint256,CBlockIndex*> mapIndex;
+    CBlockIndexArena arenaIndex;
+    CBlockIndexSnapshot snapshotIndex;
+    boost::shared_ptr<CVerifyPool> spWorkerPool;
+    boost::mutex mtxSnapshot;
+    boost::condition_variable condSnapshot;
+    boost::thread* pThreadSnapshot;
+    bool fStopSnapshot;
+    uint64 nSnapshotSeq;
+    boost::filesystem::path pathConsistency;
+    boost::mutex mtxConsistency;
+    boost::thread* pThreadConsistency;
+    bool fStopConsistency;
+    CConsistencyStat statConsistency;
+    boost::mutex mtxAddressTx;
+    boost::thread* pThreadAddressTx;
+    bool fStopAddressTx;
     std::map<uint256,boost::shared_ptr<CBlockFork> > mapFork;
 };
 
@@ -5,14 +5,54 @@
 #include "blockdb.h"
 #include "walleve/stream/datastream.h"
 
+#include <boost/bind.hpp>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
+using namespace walleve;
 using namespace multiverse::storage;
 
+#define UNSPENT_FLUSH_INTERVAL                  (60)
+#define TXINDEX_FLUSH_INTERVAL                  (3600)
+
+#ifdef __linux__
+#define BLOCKDB_GROUP_SYNC                      true
+#else
+#define BLOCKDB_GROUP_SYNC                      false
+#endif
+
+// Commits of every fork db are written unsynced and made durable together by one
+// syncfs on the data directory, instead of one fsync per fork. Where syncfs is
+// unavailable each commit syncs itself as before.
+static bool SyncBlockDB(const boost::filesystem::path& pathData)
+{
+#ifdef __linux__
+    int fd = open(pathData.string().c_str(),O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool fRet = (syncfs(fd) == 0);
+    close(fd);
+    return fRet;
+#else
+    return true;
+#endif
+}
+
+
 //////////////////////////////
 // CBlockDB
 
 CBlockDB::CBlockDB()
 {
+    pThreadFlush = NULL;
+    fStopFlush = true;
+    nChangeSeq = 0;
+    fSnapshotValid = false;
 }
 
 CBlockDB::~CBlockDB()
@@ -36,6 +76,11 @@ bool CBlockDB::Initialize(const boost::filesystem::path& pathData)
         return false;
     }
 
+    if (!dbAddressTxIndex.Initialize(pathData))
+    {
+        return false;
+    }
+
     if (!dbUnspent.Initialize(pathData))
     {
         return false;
@@ -46,13 +91,43 @@ bool CBlockDB::Initialize(const boost::filesystem::path& pathData)
         return false;
     }
 
-    return LoadFork();
+    if (!LoadFork())
+    {
+        return false;
+    }
+
+    uint256 hashSnapshot;
+    fSnapshotValid = dbFork.RetrieveSnapshot(hashSnapshot);
+
+    pathBlockDB = pathData;
+    fStopFlush = false;
+    pThreadFlush = new boost::thread(boost::bind(&CBlockDB::FlushProc,this));
+    if (pThreadFlush == NULL)
+    {
+        fStopFlush = true;
+        return false;
+    }
+
+    return true;
 }
 
 void CBlockDB::Deinitialize()
 {
+    if (pThreadFlush)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mtxFlush);
+            fStopFlush = true;
+        }
+        condFlush.notify_all();
+        pThreadFlush->join();
+        delete pThreadFlush;
+        pThreadFlush = NULL;
+    }
+
     dbDelegate.Deinitialize();
     dbUnspent.Deinitialize();
+    dbAddressTxIndex.Deinitialize();
     dbTxIndex.Deinitialize();
     dbBlockIndex.Deinitialize();
     dbFork.Deinitialize();
@@ -60,12 +135,18 @@ void CBlockDB::Deinitialize()
 
 bool CBlockDB::RemoveAll()
 {
+    InvalidateSnapshot();
+
     dbDelegate.Clear();
     dbUnspent.Clear();
+    dbAddressTxIndex.Clear();
     dbTxIndex.Clear();
     dbBlockIndex.Clear();
     dbFork.Clear();
 
+    // an empty chain is fully indexed
+    dbAddressTxIndex.SetComplete();
+
     return true;
 }
 
@@ -88,6 +169,8 @@ bool CBlockDB::ListForkContext(vector<CForkContext>& vForkCtxt)
 
 bool CBlockDB::AddNewFork(const uint256& hash)
 {
+    InvalidateSnapshot();
+
     if (!dbFork.UpdateFork(hash))
     {
         return false;
@@ -110,6 +193,8 @@ bool CBlockDB::AddNewFork(const uint256& hash)
 
 bool CBlockDB::RemoveFork(const uint256& hash)
 {
+    InvalidateSnapshot();
+
     if (!dbUnspent.RemoveFork(hash))
     {
         return false;
@@ -126,6 +211,7 @@ bool CBlockDB::ListFork(vector<pair<uint256,uint256> >& vFork)
 
 bool CBlockDB::UpdateFork(const uint256& hash,const uint256& hashRefBlock,const uint256& hashForkBased,
                           const vector<pair<uint256,CTxIndex> >& vTxNew,const vector<uint256>& vTxDel,
+                          const vector<pair<CDestination,CAddrTxIndex> >& vAddrTxNew,const vector<uint256>& vAddrTxDel,
                           const vector<CTxUnspent>& vAddNew,const vector<CTxOutPoint>& vRemove)
 {
     if (!dbUnspent.Exists(hash))
@@ -133,6 +219,8 @@ bool CBlockDB::UpdateFork(const uint256& hash,const uint256& hashRefBlock,const
         return false;
     }
 
+    InvalidateSnapshot();
+
     bool fIgnoreTxDel = false;
     if (hashForkBased != hash && hashForkBased != 0)
     {
@@ -153,6 +241,11 @@ bool CBlockDB::UpdateFork(const uint256& hash,const uint256& hashRefBlock,const
         return false;
     }
 
+    if (!dbAddressTxIndex.Update(hash,vAddrTxNew,fIgnoreTxDel ? vector<uint256>() : vAddrTxDel,hashRefBlock))
+    {
+        return false;
+    }
+
     if (!dbUnspent.Update(hash,vAddNew,vRemove))
     {
         return false;
@@ -163,14 +256,43 @@ bool CBlockDB::UpdateFork(const uint256& hash,const uint256& hashRefBlock,const
 
 bool CBlockDB::AddNewBlock(const CBlockOutline& outline)
 {
+    InvalidateSnapshot();
     return dbBlockIndex.AddNewBlock(outline);
 }
 
 bool CBlockDB::RemoveBlock(const uint256& hash)
 {
+    InvalidateSnapshot();
     return dbBlockIndex.RemoveBlock(hash);
 }
 
+uint64 CBlockDB::GetChangeSeq()
+{
+    boost::unique_lock<boost::mutex> lock(mtxSnapshot);
+    return nChangeSeq;
+}
+
+bool CBlockDB::RetrieveSnapshot(uint256& hashSnapshot)
+{
+    return dbFork.RetrieveSnapshot(hashSnapshot);
+}
+
+bool CBlockDB::UpdateSnapshot(const uint256& hashSnapshot,uint64 nSeq)
+{
+    boost::unique_lock<boost::mutex> lock(mtxSnapshot);
+    // the index changed while the snapshot was being written
+    if (nSeq != nChangeSeq)
+    {
+        return false;
+    }
+    if (!dbFork.UpdateSnapshot(hashSnapshot))
+    {
+        return false;
+    }
+    fSnapshotValid = true;
+    return true;
+}
+
 bool CBlockDB::UpdateDelegateContext(const uint256& hash,const CDelegateContext& ctxtDelegate)
 {
     return dbDelegate.AddNew(hash,ctxtDelegate);
@@ -193,6 +315,37 @@ bool CBlockDB::RetrieveTxIndex(const uint256& fork,const uint256& txid,CTxIndex&
     return dbTxIndex.Retrieve(fork,txid,txIndex);
 }
 
+bool CBlockDB::RetrieveAddressTx(const uint256& fork,const CDestination& dest,int32 nHeightFrom,vector<CAddrTxIndex>& vAddrTx)
+{
+    return dbAddressTxIndex.Retrieve(fork,dest,nHeightFrom,vAddrTx);
+}
+
+bool CBlockDB::IsAddressTxIndexComplete()
+{
+    return dbAddressTxIndex.IsComplete();
+}
+
+bool CBlockDB::RetrieveAddressTxTip(const uint256& fork,uint256& hashTip)
+{
+    return dbAddressTxIndex.RetrieveTip(fork,hashTip);
+}
+
+bool CBlockDB::AddAddressTx(const uint256& fork,const vector<pair<CDestination,CAddrTxIndex> >& vAddrTxNew,
+                            const uint256& hashTip)
+{
+    return dbAddressTxIndex.Update(fork,vAddrTxNew,vector<uint256>(),hashTip);
+}
+
+bool CBlockDB::SetAddressTxIndexComplete()
+{
+    return dbAddressTxIndex.SetComplete();
+}
+
+void CBlockDB::ClearAddressTxIndex()
+{
+    dbAddressTxIndex.Clear();
+}
+
 bool CBlockDB::RetrieveTxUnspent(const uint256& fork,const CTxOutPoint& out,CTxOutput& unspent)
 {
     return dbUnspent.Retrieve(fork,out,unspent);
@@ -214,6 +367,17 @@ bool CBlockDB::RetrieveEnroll(const uint256& hashAnchor,const vector<uint256>& v
     return dbDelegate.RetrieveEnrollTx(hashAnchor,vBlockRange,mapEnrollTxPos);
 }
 
+void CBlockDB::GetTxFilterStat(CTxIndexFilterStat& stat)
+{
+    dbTxIndex.GetFilterStat(stat);
+}
+
+void CBlockDB::GetFlushStat(CBlockDBFlushStat& stat)
+{
+    boost::unique_lock<boost::mutex> lock(mtxStat);
+    stat = statFlush;
+}
+
 bool CBlockDB::LoadFork()
 {
     vector<pair<uint256,uint256> > vFork;
@@ -234,6 +398,83 @@ bool CBlockDB::LoadFork()
             return false;
         }
     }
+
+    if (!dbTxIndex.BuildFilter())
+    {
+        StdError("CBlockDB","LoadFork : failed to build tx index filter, lookups go to db");
+    }
     return true;
 }
 
+bool CBlockDB::Flush(bool fFlushTxIndex)
+{
+    CTicks t;
+    size_t nCount = 0,nDB = 0;
+    bool fRet = true;
+
+    if (fFlushTxIndex && !dbTxIndex.Flush(nCount,nDB,!BLOCKDB_GROUP_SYNC))
+    {
+        fRet = false;
+    }
+
+    if (!dbUnspent.Flush(nCount,nDB,!BLOCKDB_GROUP_SYNC))
+    {
+        fRet = false;
+    }
+
+    if (BLOCKDB_GROUP_SYNC && nDB != 0 && !SyncBlockDB(pathBlockDB))
+    {
+        StdError("CBlockDB","Flush : failed to sync block db");
+        fRet = false;
+    }
+
+    int64 nElapse = t.Elapse();
+    {
+        boost::unique_lock<boost::mutex> lock(mtxStat);
+        statFlush.nFlushCount++;
+        statFlush.nLastFlushTime = nElapse;
+        statFlush.nMaxFlushTime = std::max(statFlush.nMaxFlushTime,nElapse);
+        statFlush.nTotalFlushTime += nElapse;
+        statFlush.nLastBatchSize = nCount;
+        statFlush.nLastBatchDB = nDB;
+    }
+    return fRet;
+}
+
+void CBlockDB::InvalidateSnapshot()
+{
+    boost::unique_lock<boost::mutex> lock(mtxSnapshot);
+    ++nChangeSeq;
+    if (fSnapshotValid)
+    {
+        dbFork.RemoveSnapshot();
+        fSnapshotValid = false;
+    }
+}
+
+void CBlockDB::FlushProc()
+{
+    boost::system_time timeout = boost::get_system_time();
+    int nCycle = 0;
+
+    boost::unique_lock<boost::mutex> lock(mtxFlush);
+    while (!fStopFlush)
+    {
+        timeout += boost::posix_time::seconds(UNSPENT_FLUSH_INTERVAL);
+
+        while (!fStopFlush)
+        {
+            if (!condFlush.timed_wait(lock,timeout))
+            {
+                break;
+            }
+        }
+
+        if (!fStopFlush)
+        {
+            // tx index chunks are rewritten on flush, so they keep their longer interval
+            bool fFlushTxIndex = (++nCycle % (TXINDEX_FLUSH_INTERVAL / UNSPENT_FLUSH_INTERVAL) == 0);
+            Flush(fFlushTxIndex);
+        }
+    }
+}
@@ -10,15 +10,32 @@
 #include "transaction.h"
 #include "blockindexdb.h"
 #include "txindexdb.h"
+#include "addresstxindexdb.h"
 #include "forkdb.h"
 #include "unspentdb.h"
 #include "delegatedb.h"
 
+#include <boost/thread/thread.hpp>
+
 namespace multiverse
 {
 namespace storage
 {
 
+class CBlockDBFlushStat
+{
+public:
+    CBlockDBFlushStat()
+    : nFlushCount(0),nLastFlushTime(0),nMaxFlushTime(0),nTotalFlushTime(0),nLastBatchSize(0),nLastBatchDB(0) {}
+public:
+    uint64 nFlushCount;
+    int64 nLastFlushTime;
+    int64 nMaxFlushTime;
+    int64 nTotalFlushTime;
+    std::size_t nLastBatchSize;
+    std::size_t nLastBatchDB;
+};
+
 class CBlockDB
 {
 public:
@@ -35,26 +52,54 @@ public:
     bool ListFork(std::vector<std::pair<uint256,uint256> >& vFork);
     bool UpdateFork(const uint256& hash,const uint256& hashRefBlock,const uint256& hashForkBased,
                     const std::vector<std::pair<uint256,CTxIndex> >& vTxNew,const std::vector<uint256>& vTxDel,
+                    const std::vector<std::pair<CDestination,CAddrTxIndex> >& vAddrTxNew,const std::vector<uint256>& vAddrTxDel,
                     const std::vector<CTxUnspent>& vAddNew,const std::vector<CTxOutPoint>& vRemove);
     bool AddNewBlock(const CBlockOutline& outline);
     bool RemoveBlock(const uint256& hash);
     bool UpdateDelegateContext(const uint256& hash,const CDelegateContext& ctxtDelegate);
     bool WalkThroughBlock(CBlockDBWalker& walker);
+    uint64 GetChangeSeq();
+    bool RetrieveSnapshot(uint256& hashSnapshot);
+    bool UpdateSnapshot(const uint256& hashSnapshot,uint64 nSeq);
     bool RetrieveTxIndex(const uint256& txid,CTxIndex& txIndex,uint256& fork);
     bool RetrieveTxIndex(const uint256& fork,const uint256& txid,CTxIndex& txIndex);
+    bool RetrieveAddressTx(const uint256& fork,const CDestination& dest,int32 nHeightFrom,std::vector<CAddrTxIndex>& vAddrTx);
+    bool IsAddressTxIndexComplete();
+    bool RetrieveAddressTxTip(const uint256& fork,uint256& hashTip);
+    bool AddAddressTx(const uint256& fork,const std::vector<std::pair<CDestination,CAddrTxIndex> >& vAddrTxNew,
+                      const uint256& hashTip = uint256());
+    bool SetAddressTxIndexComplete();
+    void ClearAddressTxIndex();
     bool RetrieveTxUnspent(const uint256& fork,const CTxOutPoint& out,CTxOutput& unspent);
     bool WalkThroughUnspent(const uint256& hashFork, CForkUnspentDBWalker& walker);
     bool RetrieveDelegate(const uint256& hash,std::map<CDestination,int64>& mapDelegate);
     bool RetrieveEnroll(const uint256& hashAnchor,const std::vector<uint256>& vBlockRange, 
                                                   std::map<CDestination,CDiskPos>& mapEnrollTxPos);
+    void GetTxFilterStat(CTxIndexFilterStat& stat);
+    void GetFlushStat(CBlockDBFlushStat& stat);
 protected:
     bool LoadFork();
+    bool Flush(bool fFlushTxIndex);
+    void FlushProc();
+    void InvalidateSnapshot();
 protected:
     CForkDB       dbFork;
     CBlockIndexDB dbBlockIndex;
     CTxIndexDB    dbTxIndex;
+    CAddressTxIndexDB dbAddressTxIndex;
     CUnspentDB    dbUnspent;
     CDelegateDB   dbDelegate;
+
+    boost::filesystem::path pathBlockDB;
+    boost::mutex mtxFlush;
+    boost::condition_variable condFlush;
+    boost::thread* pThreadFlush;
+    bool fStopFlush;
+    boost::mutex mtxStat;
+    CBlockDBFlushStat statFlush;
+    boost::mutex mtxSnapshot;
+    uint64 nChangeSeq;
+    bool fSnapshotValid;
 };
 
 } // namespace storage
@@ -0,0 +1,177 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexarena.h"
+
+using namespace std;
+using namespace multiverse::storage;
+
+#define ARENA_MIN_BUCKET        (1 << 16)
+
+//////////////////////////////
+// CBlockIndexArena
+
+CBlockIndexArena::CBlockIndexArena()
+: nNext(0),nSize(0)
+{
+}
+
+CBlockIndexArena::~CBlockIndexArena()
+{
+    Clear();
+}
+
+CBlockIndexArena::Handle CBlockIndexArena::GetHandle(const uint256& hash) const
+{
+    if (nSize == 0)
+    {
+        return NULL_HANDLE;
+    }
+    size_t nMask = vBucket.size() - 1;
+    for (size_t i = GetBucket(hash);vBucket[i] != NULL_HANDLE;i = (i + 1) & nMask)
+    {
+        if (GetSlot(vBucket[i]).hash == hash)
+        {
+            return vBucket[i];
+        }
+    }
+    return NULL_HANDLE;
+}
+
+CBlockIndex* CBlockIndexArena::Insert(const uint256& hash,const CBlockIndex& index,bool& fNew)
+{
+    if ((nSize + 1) * 2 > vBucket.size())
+    {
+        Rehash(max(vBucket.size() * 2,(size_t)ARENA_MIN_BUCKET));
+    }
+
+    size_t nMask = vBucket.size() - 1;
+    size_t i = GetBucket(hash);
+    for (;vBucket[i] != NULL_HANDLE;i = (i + 1) & nMask)
+    {
+        CSlot& slot = GetSlot(vBucket[i]);
+        if (slot.hash == hash)
+        {
+            fNew = false;
+            return &slot.index;
+        }
+    }
+
+    Handle handle = NewSlot();
+    CSlot& slot = GetSlot(handle);
+    slot.hash = hash;
+    slot.index = index;
+    slot.index.phashBlock = &slot.hash;
+    if (index.pOrigin == &index)
+    {
+        slot.index.pOrigin = &slot.index;
+    }
+    vBucket[i] = handle;
+    nSize++;
+
+    fNew = true;
+    return &slot.index;
+}
+
+bool CBlockIndexArena::Remove(const uint256& hash)
+{
+    if (nSize == 0)
+    {
+        return false;
+    }
+
+    size_t nMask = vBucket.size() - 1;
+    size_t i = GetBucket(hash);
+    for (;vBucket[i] != NULL_HANDLE;i = (i + 1) & nMask)
+    {
+        if (GetSlot(vBucket[i]).hash == hash)
+        {
+            break;
+        }
+    }
+    if (vBucket[i] == NULL_HANDLE)
+    {
+        return false;
+    }
+
+    CSlot& slot = GetSlot(vBucket[i]);
+    slot.hash = 0;
+    slot.index = CBlockIndex();
+    vFree.push_back(vBucket[i]);
+
+    // backward shift the rest of the probe chain, so lookups need no tombstones
+    for (size_t j = (i + 1) & nMask;vBucket[j] != NULL_HANDLE;j = (j + 1) & nMask)
+    {
+        size_t k = GetBucket(GetSlot(vBucket[j]).hash);
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+        {
+            vBucket[i] = vBucket[j];
+            i = j;
+        }
+    }
+    vBucket[i] = NULL_HANDLE;
+    nSize--;
+    return true;
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0;i < vSlab.size();i++)
+    {
+        delete [] vSlab[i];
+    }
+    vSlab.clear();
+    vFree.clear();
+    vBucket.clear();
+    nNext = 0;
+    nSize = 0;
+}
+
+void CBlockIndexArena::Reserve(size_t nCount)
+{
+    size_t nBucket = ARENA_MIN_BUCKET;
+    while (nBucket < nCount * 2)
+    {
+        nBucket <<= 1;
+    }
+    if (nBucket > vBucket.size())
+    {
+        Rehash(nBucket);
+    }
+}
+
+CBlockIndexArena::Handle CBlockIndexArena::NewSlot()
+{
+    if (!vFree.empty())
+    {
+        Handle handle = vFree.back();
+        vFree.pop_back();
+        return handle;
+    }
+    if (nNext == vSlab.size() * SLAB_SIZE)
+    {
+        vSlab.push_back(new CSlot[SLAB_SIZE]);
+    }
+    return nNext++;
+}
+
+void CBlockIndexArena::Rehash(size_t nBucket)
+{
+    vector<Handle> vOld(nBucket,(Handle)NULL_HANDLE);
+    vOld.swap(vBucket);
+
+    size_t nMask = vBucket.size() - 1;
+    for (size_t n = 0;n < vOld.size();n++)
+    {
+        if (vOld[n] != NULL_HANDLE)
+        {
+            size_t i = GetBucket(GetSlot(vOld[n]).hash);
+            while (vBucket[i] != NULL_HANDLE)
+            {
+                i = (i + 1) & nMask;
+            }
+            vBucket[i] = vOld[n];
+        }
+    }
+}
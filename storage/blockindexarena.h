@@ -0,0 +1,78 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_BLOCKINDEXARENA_H
+#define  MULTIVERSE_BLOCKINDEXARENA_H
+
+#include "block.h"
+
+namespace multiverse
+{
+namespace storage
+{
+
+// Block indexes live in fixed-size slabs, addressed by a 32-bit handle.
+// Slabs never move, so CBlockIndex pointers and phashBlock stay valid until Remove/Clear.
+class CBlockIndexArena
+{
+public:
+    typedef uint32 Handle;
+    enum { NULL_HANDLE = 0xFFFFFFFF };
+    enum { SLAB_BITS = 12, SLAB_SIZE = (1 << SLAB_BITS) };
+public:
+    CBlockIndexArena();
+    ~CBlockIndexArena();
+    std::size_t GetSize() const { return nSize; }
+    bool IsEmpty() const { return (nSize == 0); }
+    Handle GetHandle(const uint256& hash) const;
+    CBlockIndex* Get(Handle handle) const
+    {
+        return (handle != NULL_HANDLE ? &GetSlot(handle).index : NULL);
+    }
+    CBlockIndex* Get(const uint256& hash) const { return Get(GetHandle(hash)); }
+    CBlockIndex* Insert(const uint256& hash,const CBlockIndex& index,bool& fNew);
+    bool Remove(const uint256& hash);
+    void Clear();
+    void Reserve(std::size_t nCount);
+    template <typename F>
+    void WalkThrough(F fnWalker) const
+    {
+        for (Handle handle = 0;handle < nNext;handle++)
+        {
+            CBlockIndex* pIndex = &GetSlot(handle).index;
+            if (pIndex->phashBlock != NULL)
+            {
+                fnWalker(pIndex);
+            }
+        }
+    }
+protected:
+    class CSlot
+    {
+    public:
+        uint256 hash;
+        CBlockIndex index;
+    };
+    CSlot& GetSlot(Handle handle) const
+    {
+        return vSlab[handle >> SLAB_BITS][handle & (SLAB_SIZE - 1)];
+    }
+    std::size_t GetBucket(const uint256& hash) const
+    {
+        return (std::size_t)(hash.Get64(0) & (vBucket.size() - 1));
+    }
+    Handle NewSlot();
+    void Rehash(std::size_t nBucket);
+protected:
+    std::vector<CSlot*> vSlab;
+    std::vector<Handle> vFree;
+    std::vector<Handle> vBucket;
+    Handle nNext;
+    std::size_t nSize;
+};
+
+} // namespace storage
+} // namespace multiverse
+
+#endif //MULTIVERSE_BLOCKINDEXARENA_H
@@ -0,0 +1,171 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+#include "crypto.h"
+
+#include <stdio.h>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace boost::filesystem;
+using namespace walleve;
+using namespace multiverse::storage;
+
+// magic + version + payload hash + payload size
+#define SNAPSHOT_HEADER_SIZE            (4 + 4 + 32 + 8)
+
+//////////////////////////////
+// CBlockIndexSnapshot
+
+CBlockIndexSnapshot::CBlockIndexSnapshot()
+{
+}
+
+CBlockIndexSnapshot::~CBlockIndexSnapshot()
+{
+}
+
+bool CBlockIndexSnapshot::Initialize(const path& pathData)
+{
+    pathSnapshotFile = pathData / "blockindex.dat";
+
+    if (exists(pathSnapshotFile) && !is_regular_file(pathSnapshotFile))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool CBlockIndexSnapshot::Remove()
+{
+    if (is_regular_file(pathSnapshotFile))
+    {
+        return remove(pathSnapshotFile);
+    }
+    return true;
+}
+
+bool CBlockIndexSnapshot::Save(vector<CBlockIndexSnapshotFork>& vFork,vector<CBlockOutline>& vOutline,uint256& hashSnapshot)
+{
+    CWalleveBufStream ssPayload;
+    CWalleveBufStream ssHeader;
+    try
+    {
+        ssPayload << vFork << vOutline;
+        hashSnapshot = crypto::CryptoHash(ssPayload.GetData(),ssPayload.GetSize());
+        ssHeader << (uint32)SNAPSHOT_MAGIC << (uint32)SNAPSHOT_VERSION << hashSnapshot << (uint64)ssPayload.GetSize();
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+
+    // write aside and rename, so a crash never leaves a torn snapshot behind
+    path pathTemp = pathSnapshotFile;
+    pathTemp += ".tmp";
+    FILE * fp = fopen(pathTemp.c_str(),"wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    bool fRet = (fwrite(ssHeader.GetData(),1,ssHeader.GetSize(),fp) == ssHeader.GetSize()
+                 && fwrite(ssPayload.GetData(),1,ssPayload.GetSize(),fp) == ssPayload.GetSize()
+                 && fflush(fp) == 0);
+#ifdef __linux__
+    fRet = (fRet && fsync(fileno(fp)) == 0);
+#endif
+    fclose(fp);
+
+    try
+    {
+        if (fRet)
+        {
+            rename(pathTemp,pathSnapshotFile);
+        }
+        else
+        {
+            remove(pathTemp);
+        }
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+    return fRet;
+}
+
+bool CBlockIndexSnapshot::Load(const uint256& hashSnapshot,vector<CBlockIndexSnapshotFork>& vFork,vector<CBlockOutline>& vOutline)
+{
+    vFork.clear();
+    vOutline.clear();
+
+    if (!is_regular_file(pathSnapshotFile))
+    {
+        return false;
+    }
+
+    FILE * fp = fopen(pathSnapshotFile.c_str(),"rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    try
+    {
+        CWalleveBufStream ss;
+        char header[SNAPSHOT_HEADER_SIZE];
+        if (fread(header,1,SNAPSHOT_HEADER_SIZE,fp) != SNAPSHOT_HEADER_SIZE)
+        {
+            fclose(fp);
+            return false;
+        }
+        ss.Write(header,SNAPSHOT_HEADER_SIZE);
+
+        uint32 nMagic,nVersion;
+        uint256 hash;
+        uint64 nSize;
+        ss >> nMagic >> nVersion >> hash >> nSize;
+        if (nMagic != SNAPSHOT_MAGIC || nVersion != SNAPSHOT_VERSION || hash != hashSnapshot
+            || nSize != file_size(pathSnapshotFile) - SNAPSHOT_HEADER_SIZE)
+        {
+            fclose(fp);
+            return false;
+        }
+
+        // read the payload in one piece and check it before parsing
+        vector<char> vPayload(nSize);
+        if (nSize == 0 || fread(&vPayload[0],1,nSize,fp) != nSize
+            || crypto::CryptoHash(&vPayload[0],nSize) != hashSnapshot)
+        {
+            fclose(fp);
+            return false;
+        }
+        fclose(fp);
+        fp = NULL;
+
+        ss.Clear();
+        ss.Write(&vPayload[0],nSize);
+        vector<char>().swap(vPayload);
+        ss >> vFork >> vOutline;
+    }
+    catch (std::exception& e)
+    {
+        if (fp != NULL)
+        {
+            fclose(fp);
+        }
+        StdError(__PRETTY_FUNCTION__, e.what());
+        vFork.clear();
+        vOutline.clear();
+        return false;
+    }
+
+    return true;
+}
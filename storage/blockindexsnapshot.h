@@ -0,0 +1,56 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_BLOCKINDEXSNAPSHOT_H
+#define  MULTIVERSE_BLOCKINDEXSNAPSHOT_H
+
+#include "walleve/walleve.h"
+#include "block.h"
+
+#include <boost/filesystem.hpp>
+
+namespace multiverse
+{
+namespace storage
+{
+
+class CBlockIndexSnapshotFork
+{
+    friend class walleve::CWalleveStream;
+public:
+    uint256 hashFork;
+    uint256 hashLastBlock;
+    std::vector<unsigned char> vchProfile;
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(hashFork,opt);
+        s.Serialize(hashLastBlock,opt);
+        s.Serialize(vchProfile,opt);
+    }
+};
+
+// Binary image of the in-memory block index and fork state.
+// The file is identified by the hash of its payload, which CForkDB records
+// while the leveldb state still matches it.
+class CBlockIndexSnapshot
+{
+public:
+    enum { SNAPSHOT_MAGIC = 0x4D564249, SNAPSHOT_VERSION = 1 };
+public:
+    CBlockIndexSnapshot();
+    ~CBlockIndexSnapshot();
+    bool Initialize(const boost::filesystem::path& pathData);
+    bool Remove();
+    bool Save(std::vector<CBlockIndexSnapshotFork>& vFork,std::vector<CBlockOutline>& vOutline,uint256& hashSnapshot);
+    bool Load(const uint256& hashSnapshot,std::vector<CBlockIndexSnapshotFork>& vFork,std::vector<CBlockOutline>& vOutline);
+protected:
+    boost::filesystem::path pathSnapshotFile;
+};
+
+} // namespace storage
+} // namespace multiverse
+
+#endif //MULTIVERSE_BLOCKINDEXSNAPSHOT_H
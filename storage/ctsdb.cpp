@@ -43,7 +43,7 @@ void CCTSIndex::Deinitialize()
     Close();
 }
 
-bool CCTSIndex::Update(const vector<int64>& vTime,const vector<CDiskPos>& vPos,const vector<int64>& vDel)
+bool CCTSIndex::Update(const vector<int64>& vTime,const vector<CDiskPos>& vPos,const vector<int64>& vDel,bool fSync)
 {
     if (vTime.size() != vPos.size())
     {
@@ -65,7 +65,7 @@ bool CCTSIndex::Update(const vector<int64>& vTime,const vector<CDiskPos>& vPos,c
         Erase(vDel[i]);
     }
 
-    if (!TxnCommit())
+    if (!TxnCommit(fSync))
     {
         return false;
     }
@@ -77,3 +77,16 @@ bool CCTSIndex::Retrieve(const int64 nTime,CDiskPos& pos)
 {
     return Read(nTime,pos);
 }
+
+bool CCTSIndex::ListPos(vector<CDiskPos>& vPos)
+{
+    return WalkThrough(boost::bind(&CCTSIndex::PosWalker,this,_1,_2,boost::ref(vPos)));
+}
+
+bool CCTSIndex::PosWalker(CWalleveBufStream& ssKey,CWalleveBufStream& ssValue,vector<CDiskPos>& vPos)
+{
+    CDiskPos pos;
+    ssValue >> pos;
+    vPos.push_back(pos);
+    return true;
+}
@@ -25,8 +25,12 @@ public:
     bool Initialize(const boost::filesystem::path& pathCTSDB);
     void Deinitialize();
     bool Update(const std::vector<int64>& vTime,const std::vector<CDiskPos>& vPos,
-                const std::vector<int64>& vDel);
+                const std::vector<int64>& vDel,bool fSync = true);
     bool Retrieve(const int64,CDiskPos& pos);
+    bool ListPos(std::vector<CDiskPos>& vPos);
+protected:
+    bool PosWalker(walleve::CWalleveBufStream& ssKey,walleve::CWalleveBufStream& ssValue,
+                   std::vector<CDiskPos>& vPos);
 };
 
 template <typename K,typename V>
@@ -248,6 +252,11 @@ public:
     }
 
     bool Flush()
+    {
+        std::size_t nCount = 0;
+        return Flush(nCount,true);
+    }
+    bool Flush(std::size_t& nCount,bool fSync)
     {
         walleve::CWalleveUpgradeLock ulock(rwLower);
 
@@ -265,6 +274,7 @@ public:
             {
                 vTime.push_back((*it).first);
                 vChunk.push_back(C(mapValue.begin(),mapValue.end()));
+                nCount += mapValue.size();
             }
         }
 
@@ -278,7 +288,7 @@ public:
         }
         if (!vPos.empty() || !vDel.empty())
         {
-            if (!dbIndex.Update(vTime,vPos,vDel))
+            if (!dbIndex.Update(vTime,vPos,vDel,fSync))
             {
                 return false;
             }
@@ -293,6 +303,29 @@ public:
 
         return true;
     }
+    template <typename F>
+    bool WalkThroughKey(F fnWalker)
+    {
+        // stored chunks only, pending changes in the cache are not visited
+        std::vector<CDiskPos> vPos;
+        if (!dbIndex.ListPos(vPos))
+        {
+            return false;
+        }
+        for (std::size_t i = 0;i < vPos.size();i++)
+        {
+            C chunk;
+            if (!tsChunk.Read(chunk,vPos[i]))
+            {
+                return false;
+            }
+            for (typename C::iterator it = chunk.begin();it != chunk.end();++it)
+            {
+                fnWalker((*it).first);
+            }
+        }
+        return true;
+    }
 protected:
     std::map<K,V>& GetUpdateMap(const int64 nTime)
     {
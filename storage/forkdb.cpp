@@ -86,6 +86,21 @@ bool CForkDB::RetrieveFork(const uint256& hashFork,uint256& hashLastBlock)
     return Read(make_pair(string("active"),hashFork),hashLastBlock);
 }
 
+bool CForkDB::UpdateSnapshot(const uint256& hashSnapshot)
+{
+    return Write(make_pair(string("snapshot"),uint256()),hashSnapshot);
+}
+
+bool CForkDB::RemoveSnapshot()
+{
+    return Erase(make_pair(string("snapshot"),uint256()));
+}
+
+bool CForkDB::RetrieveSnapshot(uint256& hashSnapshot)
+{
+    return Read(make_pair(string("snapshot"),uint256()),hashSnapshot);
+}
+
 bool CForkDB::ListFork(vector<pair<uint256,uint256> >& vFork)
 {
     multimap<int32,uint256> mapJoint;
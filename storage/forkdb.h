@@ -29,6 +29,9 @@ public:
     bool RemoveFork(const uint256& hashFork);
     bool RetrieveFork(const uint256& hashFork,uint256& hashLastBlock);
     bool ListFork(std::vector<std::pair<uint256,uint256> >& vFork);
+    bool UpdateSnapshot(const uint256& hashSnapshot);
+    bool RemoveSnapshot();
+    bool RetrieveSnapshot(uint256& hashSnapshot);
     void Clear();
 protected:
     bool LoadCtxtWalker(walleve::CWalleveBufStream& ssKey,walleve::CWalleveBufStream& ssValue,
@@ -84,13 +84,14 @@ bool CLevelDBEngine::TxnBegin()
     return ((pbatch = new leveldb::WriteBatch()) != NULL); 
 }
 
-bool CLevelDBEngine::TxnCommit()
+bool CLevelDBEngine::TxnCommit(bool fSync)
 {
     if (pbatch != NULL)
     {
-        leveldb::WriteOptions batchoption;
-        
-        leveldb::Status status = pdb->Write(batchoptions,pbatch);
+        leveldb::WriteOptions batchoption = batchoptions;
+        batchoption.sync = (batchoptions.sync && fSync);
+
+        leveldb::Status status = pdb->Write(batchoption,pbatch);
         delete pbatch;
         pbatch = NULL;
         return status.ok();
@@ -35,7 +35,7 @@ public:
     bool Open() override;
     void Close() override;
     bool TxnBegin() override;
-    bool TxnCommit() override;
+    bool TxnCommit(bool fSync) override;
     void TxnAbort() override;
     bool Get(walleve::CWalleveBufStream& ssKey,walleve::CWalleveBufStream& ssValue) override;
     bool Put(walleve::CWalleveBufStream& ssKey,walleve::CWalleveBufStream& ssValue, bool fOverwrite) override;
@@ -9,16 +9,64 @@ using namespace boost::filesystem;
 using namespace walleve;
 using namespace multiverse::storage;
 
+//////////////////////////////
+// CTimeSeriesMappedFile
+
+CTimeSeriesMappedFile::CTimeSeriesMappedFile(const string& strPath,size_t nSizeIn,size_t nCapacityIn)
+: mapping(strPath.c_str(),boost::interprocess::read_only),
+  region(mapping,boost::interprocess::read_only,0,nCapacityIn),nSize(nSizeIn),nCapacity(nCapacityIn)
+{
+}
+
+bool CTimeSeriesMappedFile::Extend(size_t nSizeIn)
+{
+    // pages past the end of file are never touched, only bytes below nSize are read
+    if (nSizeIn > nCapacity)
+    {
+        return false;
+    }
+    if (nSizeIn > nSize)
+    {
+        nSize = nSizeIn;
+    }
+    return true;
+}
+
+bool CTimeSeriesMappedFile::ReadRaw(uint32 nOffset,uint32 nMagic,vector<unsigned char>& vchData) const
+{
+    // the record header (magic + size) sits right before the offset handed out by Write
+    size_t nLimit = nSize;
+    if (nOffset < 8 || nOffset > nLimit)
+    {
+        return false;
+    }
+    uint32 nRecordMagic,nRecordSize;
+    memcpy(&nRecordMagic,GetData() + nOffset - 8,4);
+    memcpy(&nRecordSize,GetData() + nOffset - 4,4);
+    if (nRecordMagic != nMagic || nRecordSize > nLimit - nOffset)
+    {
+        return false;
+    }
+    vchData.assign(GetData() + nOffset,GetData() + nOffset + nRecordSize);
+    return true;
+}
+
 //////////////////////////////
 // CTimeSeriesBase
 
 CTimeSeriesBase::CTimeSeriesBase()
 {
     nLastFile = 0;
+    nFileStreamTick = 0;
+    nMappedFileTick = 0;
+    nMapChunkSize = MAP_CHUNK_SIZE;
+    nMaxMappedFile = MAX_MAPPED_FILE;
 }
 
 CTimeSeriesBase::~CTimeSeriesBase()
 {
+    CloseAllMappedFile();
+    CloseAllFileStream();
 }
 
 bool CTimeSeriesBase::Initialize(const path& pathLocationIn,const string& strPrefixIn)
@@ -42,6 +90,8 @@ bool CTimeSeriesBase::Initialize(const path& pathLocationIn,const string& strPre
 
 void CTimeSeriesBase::Deinitialize()
 {
+    CloseAllMappedFile();
+    CloseAllFileStream();
 }
 
 bool CTimeSeriesBase::CheckDiskSpace()
@@ -93,18 +143,136 @@ bool CTimeSeriesBase::GetLastFilePath(uint32& nFile,std::string& strPath)
     return false;
 }
 
+CWalleveFileStream* CTimeSeriesBase::GetFileStream(uint32 nFile)
+{
+    map<uint32,CFileStreamEntry>::iterator it = mapFileStream.find(nFile);
+    if (it != mapFileStream.end())
+    {
+        (*it).second.nLastUsed = ++nFileStreamTick;
+        return (*it).second.spStream.get();
+    }
+
+    string pathFile;
+    if (!GetFilePath(nFile,pathFile))
+    {
+        return NULL;
+    }
+
+    if (mapFileStream.size() >= MAX_OPEN_FILE)
+    {
+        map<uint32,CFileStreamEntry>::iterator itLRU = mapFileStream.begin();
+        for (it = mapFileStream.begin();it != mapFileStream.end();++it)
+        {
+            if ((*it).second.nLastUsed < (*itLRU).second.nLastUsed)
+            {
+                itLRU = it;
+            }
+        }
+        mapFileStream.erase(itLRU);
+    }
+
+    CFileStreamEntry entry(new CWalleveFileStream(pathFile.c_str()),++nFileStreamTick);
+    if (!entry.spStream->IsValid())
+    {
+        return NULL;
+    }
+    mapFileStream[nFile] = entry;
+    return entry.spStream.get();
+}
+
+void CTimeSeriesBase::CloseFileStream(uint32 nFile)
+{
+    mapFileStream.erase(nFile);
+}
+
+void CTimeSeriesBase::CloseAllFileStream()
+{
+    mapFileStream.clear();
+}
+
+boost::shared_ptr<CTimeSeriesMappedFile> CTimeSeriesBase::GetMappedFile(uint32 nFile,uint32 nOffset)
+{
+    map<uint32,CMappedFileEntry>::iterator it = mapMappedFile.find(nFile);
+    if (it != mapMappedFile.end())
+    {
+        (*it).second.nLastUsed = ++nMappedFileTick;
+        if (nOffset < (*it).second.spMapped->GetSize())
+        {
+            return (*it).second.spMapped;
+        }
+    }
+
+    string pathFile;
+    if (!GetFilePath(nFile,pathFile))
+    {
+        return NULL;
+    }
+    try
+    {
+        size_t nSize = file_size(pathFile);
+        if (nOffset >= nSize)
+        {
+            return NULL;
+        }
+
+        // appends to the tip file land inside the mapped chunk most of the time
+        if (it != mapMappedFile.end() && (*it).second.spMapped->Extend(nSize))
+        {
+            return (*it).second.spMapped;
+        }
+
+        if (it == mapMappedFile.end() && mapMappedFile.size() >= nMaxMappedFile)
+        {
+            map<uint32,CMappedFileEntry>::iterator itLRU = mapMappedFile.begin();
+            for (it = mapMappedFile.begin();it != mapMappedFile.end();++it)
+            {
+                if ((*it).second.nLastUsed < (*itLRU).second.nLastUsed)
+                {
+                    itLRU = it;
+                }
+            }
+            mapMappedFile.erase(itLRU);
+        }
+
+        // map ahead to the next chunk boundary, readers holding the previous
+        // mapping keep it alive until they finish
+        size_t nCapacity = nSize;
+#ifndef WIN32
+        nCapacity = ((nSize + nMapChunkSize - 1) / nMapChunkSize) * nMapChunkSize;
+        if (nCapacity > MAX_FILE_SIZE)
+        {
+            nCapacity = max(nSize,(size_t)MAX_FILE_SIZE);
+        }
+#endif
+        CMappedFileEntry entry(new CTimeSeriesMappedFile(pathFile,nSize,nCapacity),++nMappedFileTick);
+        mapMappedFile[nFile] = entry;
+        return entry.spMapped;
+    }
+    catch (exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+    }
+    return NULL;
+}
+
+void CTimeSeriesBase::CloseAllMappedFile()
+{
+    mapMappedFile.clear();
+}
+
 //////////////////////////////
 // CTimeSeriesCached
 
 const uint32 CTimeSeriesCached::nMagicNum = 0x5E33A1EF;
 
 CTimeSeriesCached::CTimeSeriesCached()
-: cacheStream(FILE_CACHE_SIZE)
+: cacheStream(FILE_CACHE_SIZE),nAppendFile(0),nAppendBase(0)
 {
 }
 
 CTimeSeriesCached::~CTimeSeriesCached()
 {
+    FlushAppend();
 }
 
 bool CTimeSeriesCached::Initialize(const path& pathLocationIn,const string& strPrefixIn)
@@ -119,6 +287,9 @@ bool CTimeSeriesCached::Initialize(const path& pathLocationIn,const string& strP
         boost::unique_lock<boost::mutex> lock(mtxCache);
 
         ResetCache();
+        ssAppend.Clear();
+        nAppendFile = 0;
+        nAppendBase = 0;
     }
     return true;
 }
@@ -127,7 +298,145 @@ void CTimeSeriesCached::Deinitialize()
 {
     boost::unique_lock<boost::mutex> lock(mtxCache);
 
+    FlushAppend();
+    nAppendFile = 0;
     ResetCache();
+    CloseAllMappedFile();
+    CloseAllFileStream();
+}
+
+void CTimeSeriesCached::SetMappedFile(size_t nMapChunkSizeIn,size_t nMaxMappedFileIn)
+{
+    boost::unique_lock<boost::mutex> lock(mtxCache);
+
+    nMapChunkSize = nMapChunkSizeIn;
+    nMaxMappedFile = nMaxMappedFileIn;
+}
+
+bool CTimeSeriesCached::Flush()
+{
+    boost::unique_lock<boost::mutex> lock(mtxCache);
+
+    return FlushAppend();
+}
+
+bool CTimeSeriesCached::ReadRaw(const CDiskPos& pos,vector<unsigned char>& vchData)
+{
+    boost::unique_lock<boost::mutex> lock(mtxCache);
+
+    if (pos.nFile == nAppendFile && pos.nOffset >= nAppendBase && !FlushAppend())
+    {
+        return false;
+    }
+
+    boost::shared_ptr<CTimeSeriesMappedFile> spMapped = GetMappedFile(pos.nFile,pos.nOffset);
+    if (spMapped != NULL)
+    {
+        lock.unlock();
+        return spMapped->ReadRaw(pos.nOffset,nMagicNum,vchData);
+    }
+
+    if (pos.nOffset < 8)
+    {
+        return false;
+    }
+    try
+    {
+        CWalleveFileStream* pStream = GetFileStream(pos.nFile);
+        if (pStream == NULL)
+        {
+            return false;
+        }
+        uint32 nMagic,nSize;
+        pStream->Seek(pos.nOffset - 8);
+        *pStream >> nMagic >> nSize;
+        if (nMagic != nMagicNum || nSize > MAX_FILE_SIZE)
+        {
+            return false;
+        }
+        vchData.resize(nSize);
+        if (nSize != 0)
+        {
+            pStream->Read((char*)&vchData[0],nSize);
+        }
+    }
+    catch (exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        CloseFileStream(pos.nFile);
+        return false;
+    }
+    return true;
+}
+
+bool CTimeSeriesCached::PrepareAppend()
+{
+    if (nAppendFile != 0 && nAppendFile == nLastFile
+        && nAppendBase + ssAppend.GetSize() < MAX_FILE_SIZE - MAX_CHUNK_SIZE - 8)
+    {
+        return true;
+    }
+
+    if (!FlushAppend())
+    {
+        return false;
+    }
+
+    uint32 nFile;
+    string pathFile;
+    if (!GetLastFilePath(nFile,pathFile))
+    {
+        return false;
+    }
+
+    CWalleveFileStream* pStream = GetFileStream(nFile);
+    if (pStream == NULL)
+    {
+        return false;
+    }
+    pStream->SeekToEnd();
+    nAppendFile = nFile;
+    nAppendBase = pStream->GetCurPos();
+    return true;
+}
+
+bool CTimeSeriesCached::FlushAppend()
+{
+    if (ssAppend.GetSize() == 0)
+    {
+        return true;
+    }
+
+    try
+    {
+        CWalleveFileStream* pStream = GetFileStream(nAppendFile);
+        if (pStream == NULL)
+        {
+            return false;
+        }
+        pStream->SeekToEnd();
+        if (pStream->GetCurPos() != nAppendBase)
+        {
+            return false;
+        }
+        pStream->Write(ssAppend.GetData(),ssAppend.GetSize());
+        pStream->Sync();
+        if (pStream->GetCurPos() != nAppendBase + ssAppend.GetSize())
+        {
+            CloseFileStream(nAppendFile);
+            return false;
+        }
+    }
+    catch (exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        CloseFileStream(nAppendFile);
+        return false;
+    }
+
+    nAppendBase += ssAppend.GetSize();
+    ssAppend.Clear();
+    return true;
 }
 
 void CTimeSeriesCached::ResetCache()
@@ -5,8 +5,13 @@
 #ifndef  MULTIVERSE_TIMESERIES_H
 #define  MULTIVERSE_TIMESERIES_H
 
+#include <map>
+#include <atomic>
 #include <boost/thread/thread.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <walleve/walleve.h>
 #include "uint256.h"
 
@@ -37,6 +42,42 @@ protected:
 };
 
 
+class CTimeSeriesMappedFile
+{
+public:
+    CTimeSeriesMappedFile(const std::string& strPath,std::size_t nSizeIn,std::size_t nCapacityIn);
+    const char* GetData() const { return (const char*)region.get_address(); }
+    std::size_t GetSize() const { return nSize; }
+    std::size_t GetCapacity() const { return nCapacity; }
+    bool Extend(std::size_t nSizeIn);
+    template <typename T>
+    bool Read(T& t,uint32 nOffset) const
+    {
+        std::size_t nLimit = nSize;
+        if (nOffset >= nLimit)
+        {
+            return false;
+        }
+        try
+        {
+            walleve::CWalleveMemoryStream ss(GetData() + nOffset,nLimit - nOffset);
+            ss >> t;
+            return (!ss.IsFailed());
+        }
+        catch (std::exception& e)
+        {
+            walleve::StdError(__PRETTY_FUNCTION__, e.what());
+        }
+        return false;
+    }
+    bool ReadRaw(uint32 nOffset,uint32 nMagic,std::vector<unsigned char>& vchData) const;
+protected:
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    std::atomic<std::size_t> nSize;
+    std::size_t nCapacity;
+};
+
 template <typename T>
 class CTSWalker
 {
@@ -46,6 +87,26 @@ public:
 
 class CTimeSeriesBase
 {
+    class CFileStreamEntry
+    {
+    public:
+        CFileStreamEntry() : nLastUsed(0) {}
+        CFileStreamEntry(walleve::CWalleveFileStream* pStreamIn,uint64 nLastUsedIn)
+        : spStream(pStreamIn),nLastUsed(nLastUsedIn) {}
+    public:
+        boost::shared_ptr<walleve::CWalleveFileStream> spStream;
+        uint64 nLastUsed;
+    };
+    class CMappedFileEntry
+    {
+    public:
+        CMappedFileEntry() : nLastUsed(0) {}
+        CMappedFileEntry(CTimeSeriesMappedFile* pMappedIn,uint64 nLastUsedIn)
+        : spMapped(pMappedIn),nLastUsed(nLastUsedIn) {}
+    public:
+        boost::shared_ptr<CTimeSeriesMappedFile> spMapped;
+        uint64 nLastUsed;
+    };
 public:
     CTimeSeriesBase();
     ~CTimeSeriesBase();
@@ -56,11 +117,24 @@ protected:
     const std::string FileName(uint32 nFile);
     bool GetFilePath(uint32 nFile,std::string& strPath);
     bool GetLastFilePath(uint32& nFile,std::string& strPath);
+    walleve::CWalleveFileStream* GetFileStream(uint32 nFile);
+    void CloseFileStream(uint32 nFile);
+    void CloseAllFileStream();
+    boost::shared_ptr<CTimeSeriesMappedFile> GetMappedFile(uint32 nFile,uint32 nOffset);
+    void CloseAllMappedFile();
 protected:
     enum {MAX_FILE_SIZE = 0x7F000000,MAX_CHUNK_SIZE = 0x200000};
+    enum {MAX_OPEN_FILE = 64};
+    enum {MAP_CHUNK_SIZE = 0x4000000,MAX_MAPPED_FILE = 16};
     boost::filesystem::path pathLocation;
     std::string strPrefix;
     uint32 nLastFile;
+    uint64 nFileStreamTick;
+    uint64 nMappedFileTick;
+    std::size_t nMapChunkSize;
+    std::size_t nMaxMappedFile;
+    std::map<uint32,CFileStreamEntry> mapFileStream;
+    std::map<uint32,CMappedFileEntry> mapMappedFile;
 };
 
 class CTimeSeriesCached : public CTimeSeriesBase
@@ -70,37 +144,19 @@ public:
     ~CTimeSeriesCached();
     bool Initialize(const boost::filesystem::path& pathLocationIn,const std::string& strPrefixIn);
     void Deinitialize();
+    void SetMappedFile(std::size_t nMapChunkSizeIn,std::size_t nMaxMappedFileIn);
+    // appended records stay in memory until Flush, flush before committing anything that refers to them
+    bool Flush();
     template <typename T>
     bool Write(const T& t,uint32& nFile,uint32& nOffset,bool fWriteCache = true)
     {
-        boost::unique_lock<boost::mutex> lock(mtxCache);
-
-        std::string pathFile;
-        if (!GetLastFilePath(nFile,pathFile))
+        CDiskPos pos;
+        if (!Write(t,pos,fWriteCache))
         {
             return false;
         }
-        try
-        {
-            walleve::CWalleveFileStream fs(pathFile.c_str());
-            fs.SeekToEnd();
-            uint32 nSize = fs.GetSerializeSize(t);
-            fs << nMagicNum << nSize;
-            nOffset = fs.GetCurPos();
-            fs << t;
-        }
-        catch (std::exception& e)
-        {
-            walleve::StdError(__PRETTY_FUNCTION__, e.what());
-            return false;
-        }
-        if (fWriteCache)
-        {
-            if (!WriteToCache(t,CDiskPos(nFile,nOffset)))
-            {
-                ResetCache();
-            }
-        }
+        nFile = pos.nFile;
+        nOffset = pos.nOffset;
         return true;
     }
     template <typename T>
@@ -108,19 +164,17 @@ public:
     {
         boost::unique_lock<boost::mutex> lock(mtxCache);
 
-        std::string pathFile;
-        if (!GetLastFilePath(pos.nFile,pathFile))
+        if (!PrepareAppend())
         {
             return false;
         }
         try
         {
-            walleve::CWalleveFileStream fs(pathFile.c_str());
-            fs.SeekToEnd();
-            uint32 nSize = fs.GetSerializeSize(t);
-            fs << nMagicNum << nSize;
-            pos.nOffset = fs.GetCurPos();
-            fs << t;
+            uint32 nSize = ssAppend.GetSerializeSize(t);
+            ssAppend << nMagicNum << nSize;
+            pos.nFile = nAppendFile;
+            pos.nOffset = nAppendBase + ssAppend.GetSize();
+            ssAppend << t;
         }
         catch (std::exception& e)
         {
@@ -139,39 +193,7 @@ public:
     template <typename T>
     bool Read(T& t,uint32 nFile,uint32 nOffset,bool fWriteCache = true)
     {
-        boost::unique_lock<boost::mutex> lock(mtxCache);
-
-        if (ReadFromCache(t,CDiskPos(nFile,nOffset)))
-        {
-            return true;
-        }
-
-        std::string pathFile;
-        if (!GetFilePath(nFile,pathFile))
-        {
-            return false;
-        }
-        try
-        {
-            // Open history file to read
-            walleve::CWalleveFileStream fs(pathFile.c_str());
-            fs.Seek(nOffset);
-            fs >> t;
-        }
-        catch (std::exception& e)
-        {
-            walleve::StdError(__PRETTY_FUNCTION__, e.what());
-            return false;
-        }
-
-        if (fWriteCache)
-        {
-            if (!WriteToCache(t,CDiskPos(nFile,nOffset)))
-            {
-                ResetCache();
-            }
-        }
-        return true;
+        return Read(t,CDiskPos(nFile,nOffset),fWriteCache);
     }
     template <typename T>
     bool Read(T& t,const CDiskPos& pos,bool fWriteCache = true)
@@ -183,21 +205,8 @@ public:
             return true;
         }
 
-        std::string pathFile;
-        if (!GetFilePath(pos.nFile,pathFile))
-        {
-            return false;
-        }
-        try
+        if (!ReadRecord(t,pos,lock))
         {
-            // Open history file to read
-            walleve::CWalleveFileStream fs(pathFile.c_str());
-            fs.Seek(pos.nOffset);
-            fs >> t;
-        }
-        catch (std::exception& e)
-        {
-            walleve::StdError(__PRETTY_FUNCTION__, e.what());
             return false;
         }
 
@@ -213,6 +222,13 @@ public:
     template <typename T>
     bool WalkThrough(CTSWalker<T>& walker,uint32& nLastFileRet,uint32& nLastPosRet)
     {
+        boost::unique_lock<boost::mutex> lock(mtxCache);
+
+        if (!FlushAppend())
+        {
+            return false;
+        }
+
         bool fRet = true;
         uint32 nFile = 1;
         uint32 nOffset = 0;
@@ -256,25 +272,57 @@ public:
     template <typename T>
     bool ReadDirect(T& t,uint32 nFile,uint32 nOffset)
     {
-        std::string pathFile;
-        if (!GetFilePath(nFile,pathFile))
+        boost::unique_lock<boost::mutex> lock(mtxCache);
+
+        return ReadRecord(t,CDiskPos(nFile,nOffset),lock);
+    }
+    bool ReadRaw(const CDiskPos& pos,std::vector<unsigned char>& vchData);
+protected:
+    bool PrepareAppend();
+    bool FlushAppend();
+    template <typename T>
+    bool ReadRecord(T& t,const CDiskPos& pos,boost::unique_lock<boost::mutex>& lock)
+    {
+        if (pos.nFile == nAppendFile && pos.nOffset >= nAppendBase && !FlushAppend())
+        {
+            return false;
+        }
+        boost::shared_ptr<CTimeSeriesMappedFile> spMapped = GetMappedFile(pos.nFile,pos.nOffset);
+        if (spMapped == NULL)
+        {
+            return ReadFromFile(t,pos);
+        }
+        // the mapping is immutable and kept alive by spMapped, deserialize outside the lock
+        lock.unlock();
+        bool fRet = spMapped->Read(t,pos.nOffset);
+        lock.lock();
+        return fRet;
+    }
+    template <typename T>
+    bool ReadFromFile(T& t,const CDiskPos& pos)
+    {
+        if (pos.nFile == nAppendFile && pos.nOffset >= nAppendBase && !FlushAppend())
         {
             return false;
         }
         try
         {
-            walleve::CWalleveFileStream fs(pathFile.c_str());
-            fs.Seek(nOffset);
-            fs >> t;
+            walleve::CWalleveFileStream* pStream = GetFileStream(pos.nFile);
+            if (pStream == NULL)
+            {
+                return false;
+            }
+            pStream->Seek(pos.nOffset);
+            *pStream >> t;
         }
-        catch(...)
+        catch (std::exception& e)
         {
+            walleve::StdError(__PRETTY_FUNCTION__, e.what());
+            CloseFileStream(pos.nFile);
             return false;
         }
-
         return true;
     }
-protected:
     void ResetCache();
     bool VacateCache(uint32 nNeeded);
     template <typename T>
@@ -331,6 +379,9 @@ protected:
     boost::mutex mtxCache;
     walleve::CWalleveCircularStream cacheStream;
     std::map<CDiskPos,std::size_t> mapCachePos;
+    walleve::CWalleveBufStream ssAppend;
+    uint32 nAppendFile;
+    uint32 nAppendBase;
     static const uint32 nMagicNum;
 };
 
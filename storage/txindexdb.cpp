@@ -10,14 +10,145 @@ using namespace std;
 using namespace walleve;
 using namespace multiverse::storage;
 
-#define TXINDEX_FLUSH_INTERVAL			(3600)    
+#define TXFILTER_MIN_CAPACITY           (1 << 20)
+#define TXFILTER_SLOT_PER_TX            (10)
+#define TXFILTER_HASH_COUNT             (7)
+#define TXFILTER_COUNTER_MAX            (15)
+
+//////////////////////////////
+// CTxIndexFilter
+
+CTxIndexFilter::CTxIndexFilter()
+: nSlot(0),nCapacity(0),nCount(0),fEnabled(false),nQuery(0),nReject(0),nFalsePositive(0)
+{
+}
+
+void CTxIndexFilter::Reset(size_t nCapacityIn)
+{
+    CWalleveWriteLock wlock(rwAccess);
+
+    nCapacity = max(nCapacityIn,(size_t)TXFILTER_MIN_CAPACITY);
+    nSlot = nCapacity * TXFILTER_SLOT_PER_TX;
+    vector<uint8>((nSlot + 1) / 2,0).swap(vCounter);
+    nCount = 0;
+    fEnabled = true;
+}
+
+void CTxIndexFilter::Disable()
+{
+    CWalleveWriteLock wlock(rwAccess);
+
+    vector<uint8>().swap(vCounter);
+    nSlot = nCapacity = nCount = 0;
+    fEnabled = false;
+}
+
+void CTxIndexFilter::Insert(const uint224& hash)
+{
+    CWalleveWriteLock wlock(rwAccess);
+    if (!fEnabled)
+    {
+        return;
+    }
+
+    size_t vSlot[TXFILTER_HASH_COUNT];
+    GetSlot(hash,vSlot);
+    for (int i = 0;i < TXFILTER_HASH_COUNT;i++)
+    {
+        uint8& n = vCounter[vSlot[i] >> 1];
+        int nShift = (vSlot[i] & 1) << 2;
+        if (((n >> nShift) & 0x0F) < TXFILTER_COUNTER_MAX)
+        {
+            n += (1 << nShift);
+        }
+    }
+    nCount++;
+}
+
+void CTxIndexFilter::Remove(const uint224& hash)
+{
+    CWalleveWriteLock wlock(rwAccess);
+    if (!fEnabled)
+    {
+        return;
+    }
+
+    size_t vSlot[TXFILTER_HASH_COUNT];
+    GetSlot(hash,vSlot);
+    for (int i = 0;i < TXFILTER_HASH_COUNT;i++)
+    {
+        uint8& n = vCounter[vSlot[i] >> 1];
+        int nShift = (vSlot[i] & 1) << 2;
+        uint8 nCounter = ((n >> nShift) & 0x0F);
+        // a saturated counter no longer knows its count, it stays set
+        if (nCounter > 0 && nCounter < TXFILTER_COUNTER_MAX)
+        {
+            n -= (1 << nShift);
+        }
+    }
+    if (nCount > 0)
+    {
+        nCount--;
+    }
+}
+
+bool CTxIndexFilter::MayContain(const uint224& hash,bool fStat)
+{
+    CWalleveReadLock rlock(rwAccess);
+    if (!fEnabled)
+    {
+        return true;
+    }
+
+    if (fStat)
+    {
+        nQuery++;
+    }
+    size_t vSlot[TXFILTER_HASH_COUNT];
+    GetSlot(hash,vSlot);
+    for (int i = 0;i < TXFILTER_HASH_COUNT;i++)
+    {
+        if (((vCounter[vSlot[i] >> 1] >> ((vSlot[i] & 1) << 2)) & 0x0F) == 0)
+        {
+            if (fStat)
+            {
+                nReject++;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void CTxIndexFilter::GetStat(CTxIndexFilterStat& stat)
+{
+    CWalleveReadLock rlock(rwAccess);
+
+    stat.fEnabled = fEnabled;
+    stat.nCapacity = nCapacity;
+    stat.nCount = nCount;
+    stat.nMemory = vCounter.size();
+    stat.nQuery = nQuery;
+    stat.nReject = nReject;
+    stat.nFalsePositive = nFalsePositive;
+}
+
+void CTxIndexFilter::GetSlot(const uint224& hash,size_t* pSlot) const
+{
+    // tx hash is uniformly distributed, derive the probes by double hashing
+    uint64 h1 = hash.Get64(0);
+    uint64 h2 = hash.Get64(1) | 1;
+    for (int i = 0;i < TXFILTER_HASH_COUNT;i++)
+    {
+        pSlot[i] = (size_t)((h1 + i * h2) % nSlot);
+    }
+}
+
 //////////////////////////////
 // CTxIndexDB
 
 CTxIndexDB::CTxIndexDB()
 {
-    pThreadFlush = NULL;
-    fStopFlush = true;
 }
 
 bool CTxIndexDB::Initialize(const boost::filesystem::path& pathData)
@@ -34,31 +165,11 @@ bool CTxIndexDB::Initialize(const boost::filesystem::path& pathData)
         return false;
     }
 
-    fStopFlush = false;
-    pThreadFlush = new boost::thread(boost::bind(&CTxIndexDB::FlushProc,this));
-    if (pThreadFlush == NULL)
-    {
-        fStopFlush = true;
-        return false;
-    }
-
     return true;
 }
 
 void CTxIndexDB::Deinitialize()
 {
-    if (pThreadFlush)
-    {
-        {
-            boost::unique_lock<boost::mutex> lock(mtxFlush);
-            fStopFlush = true;
-        }
-        condFlush.notify_all();
-        pThreadFlush->join();
-        delete pThreadFlush;
-        pThreadFlush = NULL;
-    }
-
     {
         CWalleveWriteLock wlock(rwAccess);
     
@@ -73,6 +184,7 @@ void CTxIndexDB::Deinitialize()
         }
         mapTxDB.clear();
     }
+    filter.Disable();
 }
 
 bool CTxIndexDB::LoadFork(const uint256& hashFork)
@@ -107,9 +219,11 @@ bool CTxIndexDB::Update(const uint256& hashFork,const vector<pair<uint256,CTxInd
 
     std::shared_ptr<CForkTxDB> spTxDB = (*it).second;
 
+    // the filter learns new txs before they become visible, and forgets removed ones after
     for (int i = 0;i < vTxNew.size();i++)
     {
         CTxId txid(vTxNew[i].first);
+        filter.Insert(txid.GetTxHash());
         spTxDB->Update(txid.GetTxTime(),txid.GetTxHash(),vTxNew[i].second);
     }
 
@@ -117,6 +231,7 @@ bool CTxIndexDB::Update(const uint256& hashFork,const vector<pair<uint256,CTxInd
     {
         CTxId txid(vTxDel[i]);
         spTxDB->Erase(txid.GetTxTime(),txid.GetTxHash());
+        filter.Remove(txid.GetTxHash());
     }
     return true;
 }
@@ -133,7 +248,13 @@ bool CTxIndexDB::Retrieve(const uint256& hashFork,const uint256& txidIn,CTxIndex
 
     std::shared_ptr<CForkTxDB> spTxDB = (*it).second;
     
+    // the filter covers all forks, a miss here may be a tx of another fork,
+    // so the stats only count the lookups over all forks
     CTxId txid(txidIn);
+    if (!filter.MayContain(txid.GetTxHash(),false))
+    {
+        return false;
+    }
 
     return spTxDB->Retrieve(txid.GetTxTime(),txid.GetTxHash(),txIndex);
 }
@@ -143,6 +264,10 @@ bool CTxIndexDB::Retrieve(const uint256& txidIn,CTxIndex& txIndex,uint256& hashF
     CWalleveReadLock rlock(rwAccess);
 
     CTxId txid(txidIn);
+    if (!filter.MayContain(txid.GetTxHash()))
+    {
+        return false;
+    }
 
     for (map<uint256,std::shared_ptr<CForkTxDB> >::iterator it = mapTxDB.begin();
          it != mapTxDB.end();++it)
@@ -155,6 +280,7 @@ bool CTxIndexDB::Retrieve(const uint256& txidIn,CTxIndex& txIndex,uint256& hashF
         }
     }    
 
+    filter.AddFalsePositive();
     return false;
 }
 
@@ -170,42 +296,61 @@ void CTxIndexDB::Clear()
         spTxDB->Deinitialize();
     }
     mapTxDB.clear();
+
+    filter.Reset(0);
 }
 
-void CTxIndexDB::FlushProc()
+bool CTxIndexDB::BuildFilter()
 {
-    boost::system_time timeout = boost::get_system_time();
+    CWalleveWriteLock wlock(rwAccess);
 
-    boost::unique_lock<boost::mutex> lock(mtxFlush);
-    while (!fStopFlush)
+    vector<uint224> vHash;
+    for (map<uint256,std::shared_ptr<CForkTxDB> >::iterator it = mapTxDB.begin();
+         it != mapTxDB.end();++it)
     {
-        timeout += boost::posix_time::seconds(TXINDEX_FLUSH_INTERVAL);
-
-        while (!fStopFlush)
+        if (!(*it).second->WalkThroughKey([&vHash](const uint224& hash) { vHash.push_back(hash); }))
         {
-            if (!condFlush.timed_wait(lock,timeout))
-            {
-                break;
-            }
+            filter.Disable();
+            return false;
         }
+    }
 
-        if (!fStopFlush)
+    // leave room for the chain to double before the false-positive rate degrades
+    filter.Reset(vHash.size() * 2);
+    for (size_t i = 0;i < vHash.size();i++)
+    {
+        filter.Insert(vHash[i]);
+    }
+    return true;
+}
+
+bool CTxIndexDB::Flush(size_t& nCount,size_t& nFork,bool fSync)
+{
+    vector<std::shared_ptr<CForkTxDB> > vTxDB;
+    {
+        CWalleveReadLock rlock(rwAccess);
+
+        vTxDB.reserve(mapTxDB.size());
+        for (map<uint256,std::shared_ptr<CForkTxDB> >::iterator it = mapTxDB.begin();
+             it != mapTxDB.end();++it)
         {
-            vector<std::shared_ptr<CForkTxDB> > vTxDB;
-            vTxDB.reserve(mapTxDB.size());
-            {
-                CWalleveReadLock rlock(rwAccess);
+            vTxDB.push_back((*it).second);
+        }
+    }
 
-                for (map<uint256,std::shared_ptr<CForkTxDB> >::iterator it = mapTxDB.begin();
-                     it != mapTxDB.end();++it)
-                {
-                    vTxDB.push_back((*it).second);
-                }
-            }
-            for (int i = 0;i < vTxDB.size();i++)
-            {
-                vTxDB[i]->Flush();
-            }
+    bool fRet = true;
+    for (int i = 0;i < vTxDB.size();i++)
+    {
+        size_t n = 0;
+        if (!vTxDB[i]->Flush(n,fSync))
+        {
+            fRet = false;
+        }
+        else if (n != 0)
+        {
+            nCount += n;
+            nFork++;
         }
     }
+    return fRet;
 }
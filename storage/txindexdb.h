@@ -8,13 +8,56 @@
 #include "transaction.h"
 #include "ctsdb.h"
 #include "walleve/walleve.h"
-#include <boost/thread/thread.hpp>
+
+#include <atomic>
 
 namespace multiverse
 {
 namespace storage
 {
 
+class CTxIndexFilterStat
+{
+public:
+    CTxIndexFilterStat()
+    : fEnabled(false),nCapacity(0),nCount(0),nMemory(0),nQuery(0),nReject(0),nFalsePositive(0) {}
+public:
+    bool fEnabled;
+    std::size_t nCapacity;
+    std::size_t nCount;
+    std::size_t nMemory;
+    uint64 nQuery;
+    uint64 nReject;
+    uint64 nFalsePositive;
+};
+
+// Counting bloom filter over the tx hashes of all forks, with 4-bit saturating counters.
+// Answers definite misses, so that lookups of unknown txids never reach the fork dbs.
+class CTxIndexFilter
+{
+public:
+    CTxIndexFilter();
+    void Reset(std::size_t nCapacityIn);
+    void Disable();
+    void Insert(const uint224& hash);
+    void Remove(const uint224& hash);
+    bool MayContain(const uint224& hash,bool fStat = true);
+    void AddFalsePositive() { nFalsePositive++; }
+    void GetStat(CTxIndexFilterStat& stat);
+protected:
+    void GetSlot(const uint224& hash,std::size_t* pSlot) const;
+protected:
+    walleve::CWalleveRWAccess rwAccess;
+    std::vector<uint8> vCounter;
+    std::size_t nSlot;
+    std::size_t nCapacity;
+    std::size_t nCount;
+    bool fEnabled;
+    std::atomic<uint64> nQuery;
+    std::atomic<uint64> nReject;
+    std::atomic<uint64> nFalsePositive;
+};
+
 class CTxIndexDB
 {
     typedef CCTSDB<uint224,CTxIndex,CCTSChunkSnappy<uint224,CTxIndex> > CForkTxDB;
@@ -28,18 +71,16 @@ public:
     bool Retrieve(const uint256& hashFork,const uint256& txid,CTxIndex& txIndex);
     bool Retrieve(const uint256& txid,CTxIndex& txIndex,uint256& hashFork);
 
+    bool Flush(std::size_t& nCount,std::size_t& nFork,bool fSync);
+    bool BuildFilter();
+    void GetFilterStat(CTxIndexFilterStat& stat) { filter.GetStat(stat); }
+
     void Clear();
-protected:
-    void FlushProc();
 protected:
     boost::filesystem::path pathTxIndex;
     walleve::CWalleveRWAccess rwAccess;
     std::map<uint256,std::shared_ptr<CForkTxDB> > mapTxDB;
-
-    boost::mutex mtxFlush;
-    boost::condition_variable condFlush;
-    boost::thread* pThreadFlush;
-    bool fStopFlush;
+    CTxIndexFilter filter;
 };
 
 } // namespace storage
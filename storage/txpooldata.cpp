@@ -3,26 +3,43 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
     
 #include "txpooldata.h"
+#include "crypto.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace boost::filesystem;
 using namespace walleve;
 using namespace multiverse::storage;
-    
+
+// magic + version + generation + payload hash + payload size
+#define SNAPSHOT_HEADER_SIZE            (4 + 4 + 4 + 32 + 8)
+// magic + version + generation
+#define JOURNAL_HEADER_SIZE             (4 + 4 + 4)
+// payload size + payload checksum
+#define RECORD_HEADER_SIZE              (4 + 4)
+#define MAX_RECORD_SIZE                 (16 * 1024 * 1024)
+
 //////////////////////////////
 // CTxPoolData
 
 CTxPoolData::CTxPoolData()
+: fpJournal(NULL),nNextGeneration(1),nRecord(0),nSnapshotTx(0),nSnapshotGeneration(0),fBroken(false)
 {   
 }   
     
 CTxPoolData::~CTxPoolData()
 {   
+    Deinitialize();
 }
 
 bool CTxPoolData::Initialize(const path& pathData)
 {
-    path pathTxPool = pathData / "txpool";
+    pathTxPool = pathData / "txpool";
 
     if (!exists(pathTxPool))
     {
@@ -34,9 +51,13 @@ bool CTxPoolData::Initialize(const path& pathData)
         return false;
     }
 
-    pathTxPoolFile = pathTxPool / "txpool.dat";
+    pathSnapshotFile = pathTxPool / "snapshot.dat";
+    pathPrevSnapshotFile = pathTxPool / "snapshot.prev";
+    pathLegacyFile = pathTxPool / "txpool.dat";
 
-    if (exists(pathTxPoolFile) && !is_regular_file(pathTxPoolFile))
+    if ((exists(pathSnapshotFile) && !is_regular_file(pathSnapshotFile))
+        || (exists(pathPrevSnapshotFile) && !is_regular_file(pathPrevSnapshotFile))
+        || (exists(pathLegacyFile) && !is_regular_file(pathLegacyFile)))
     {
         return false;
     }
@@ -44,55 +65,447 @@ bool CTxPoolData::Initialize(const path& pathData)
     return true;
 }
 
+void CTxPoolData::Deinitialize()
+{
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+    CloseJournal();
+    nRecord = 0;
+    fBroken = false;
+}
+
 bool CTxPoolData::Remove()
 {
-    if (is_regular_file(pathTxPoolFile))
+    Deinitialize();
+
+    vector<uint32> vGeneration;
+    ListJournal(vGeneration);
+    try
+    {
+        for (const uint32 nGeneration : vGeneration)
+        {
+            remove(GetJournalPath(nGeneration));
+        }
+        if (is_regular_file(pathSnapshotFile))
+        {
+            remove(pathSnapshotFile);
+        }
+        if (is_regular_file(pathPrevSnapshotFile))
+        {
+            remove(pathPrevSnapshotFile);
+        }
+        if (is_regular_file(pathLegacyFile))
+        {
+            remove(pathLegacyFile);
+        }
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+    return true;
+}
+
+bool CTxPoolData::Load(vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
+{
+    vTx.clear();
+
+    vector<pair<uint256,pair<uint256,CAssembledTx> > > vReplay;
+    if (!LoadLegacy(vReplay))
+    {
+        return false;
+    }
+
+    uint32 nLoadGeneration = 0;
+    if (!LoadSnapshot(pathSnapshotFile,nLoadGeneration,vReplay))
+    {
+        StdError(__PRETTY_FUNCTION__, "Invalid txpool snapshot, ignored");
+        nLoadGeneration = 0;
+    }
+    // the previous snapshot and the journals after it are kept until the next compaction
+    if (nLoadGeneration == 0 && !LoadSnapshot(pathPrevSnapshotFile,nLoadGeneration,vReplay))
+    {
+        // without any snapshot the pool is rebuilt from whatever journals are left
+        StdError(__PRETTY_FUNCTION__, "Invalid previous txpool snapshot, ignored");
+        nLoadGeneration = 0;
+    }
+
+    map<uint256,size_t> mapIndex;
+    for (size_t i = 0;i < vReplay.size();i++)
+    {
+        mapIndex[vReplay[i].second.first] = i;
+    }
+
+    vector<uint32> vGeneration;
+    ListJournal(vGeneration);
+    uint32 nLastGeneration = nLoadGeneration;
+    for (const uint32 nGeneration : vGeneration)
+    {
+        if (nGeneration >= nLoadGeneration)
+        {
+            if (!LoadJournal(nGeneration,vReplay,mapIndex))
+            {
+                StdError(__PRETTY_FUNCTION__, "Truncated txpool journal, replayed up to the last complete record");
+            }
+        }
+        nLastGeneration = max(nLastGeneration,nGeneration);
+    }
+
+    // keep the recorded order, so parents stay ahead of the txs spending them
+    vTx.reserve(mapIndex.size());
+    for (size_t i = 0;i < vReplay.size();i++)
+    {
+        map<uint256,size_t>::iterator it = mapIndex.find(vReplay[i].second.first);
+        if (it != mapIndex.end() && (*it).second == i)
+        {
+            vTx.push_back(vReplay[i]);
+        }
+    }
+
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+    nNextGeneration = nLastGeneration + 1;
+    nSnapshotGeneration = nLoadGeneration;
+    return true;
+}
+
+bool CTxPoolData::Rotate(uint32& nGeneration)
+{
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+
+    CloseJournal();
+
+    nGeneration = nNextGeneration++;
+    path pathJournal = GetJournalPath(nGeneration);
+    fpJournal = fopen(pathJournal.c_str(),"wb");
+    if (fpJournal == NULL)
     {
-        return remove(pathTxPoolFile);
+        fBroken = true;
+        return false;
+    }
+
+    CWalleveBufStream ss;
+    ss << (uint32)JOURNAL_MAGIC << (uint32)DATA_VERSION << nGeneration;
+    if (fwrite(ss.GetData(),1,ss.GetSize(),fpJournal) != ss.GetSize() || fflush(fpJournal) != 0)
+    {
+        CloseJournal();
+        fBroken = true;
+        return false;
     }
+    nRecord = 0;
+    fBroken = false;
     return true;
 }
 
-bool CTxPoolData::Save(const vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
+bool CTxPoolData::SaveSnapshot(uint32 nGeneration,const vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
 {
-    FILE * fp = fopen(pathTxPoolFile.c_str(),"w");
+    CWalleveBufStream ssPayload;
+    CWalleveBufStream ssHeader;
+    try
+    {
+        ssPayload << vTx;
+        uint256 hash = crypto::CryptoHash(ssPayload.GetData(),ssPayload.GetSize());
+        ssHeader << (uint32)SNAPSHOT_MAGIC << (uint32)DATA_VERSION << nGeneration << hash << (uint64)ssPayload.GetSize();
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+
+    path pathTemp = pathSnapshotFile;
+    pathTemp += ".tmp";
+    FILE * fp = fopen(pathTemp.c_str(),"wb");
     if (fp == NULL)
     {
         return false;
     }
+    bool fRet = (fwrite(ssHeader.GetData(),1,ssHeader.GetSize(),fp) == ssHeader.GetSize()
+                 && fwrite(ssPayload.GetData(),1,ssPayload.GetSize(),fp) == ssPayload.GetSize()
+                 && fflush(fp) == 0);
+#ifdef __linux__
+    fRet = (fRet && fsync(fileno(fp)) == 0);
+#endif
     fclose(fp);
 
-    if (!is_regular_file(pathTxPoolFile))
+    uint32 nPrevGeneration = 0;
     {
+        boost::unique_lock<boost::mutex> lock(mtxJournal);
+        nPrevGeneration = nSnapshotGeneration;
+    }
+
+    vector<uint32> vGeneration;
+    ListJournal(vGeneration);
+    try
+    {
+        if (!fRet)
+        {
+            remove(pathTemp);
+            return false;
+        }
+        if (is_regular_file(pathSnapshotFile))
+        {
+            rename(pathSnapshotFile,pathPrevSnapshotFile);
+        }
+        rename(pathTemp,pathSnapshotFile);
+
+        // the previous snapshot stays as fallback, only the journals before it are superseded
+        for (const uint32 n : vGeneration)
+        {
+            if (n < nPrevGeneration)
+            {
+                remove(GetJournalPath(n));
+            }
+        }
+        if (is_regular_file(pathLegacyFile))
+        {
+            remove(pathLegacyFile);
+        }
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
         return false;
     }
 
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+    nSnapshotTx = vTx.size();
+    nSnapshotGeneration = nGeneration;
+    return true;
+}
+
+void CTxPoolData::AddNew(const uint256& hashFork,const uint256& txid,const CAssembledTx& tx)
+{
+    CWalleveBufStream ss;
+    ss << (uint8)JOURNAL_ADDNEW << hashFork << txid << tx;
+    Append(ss);
+}
+
+void CTxPoolData::Remove(const uint256& hashFork,const uint256& txid)
+{
+    CWalleveBufStream ss;
+    ss << (uint8)JOURNAL_REMOVE << hashFork << txid;
+    Append(ss);
+}
+
+void CTxPoolData::Flush()
+{
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+    if (fpJournal != NULL && fflush(fpJournal) != 0)
+    {
+        StdError(__PRETTY_FUNCTION__, "Failed to flush txpool journal");
+        CloseJournal();
+        fBroken = true;
+    }
+}
+
+bool CTxPoolData::IsCompactNeeded()
+{
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+    return (fBroken || nRecord > max((size_t)MIN_COMPACT_RECORD,nSnapshotTx));
+}
+
+path CTxPoolData::GetJournalPath(uint32 nGeneration) const
+{
+    return pathTxPool / ("journal." + to_string(nGeneration));
+}
+
+void CTxPoolData::ListJournal(vector<uint32>& vGeneration) const
+{
+    vGeneration.clear();
     try
     {
-        CWalleveFileStream fs(pathTxPoolFile.c_str());
-        fs << vTx;
+        for (directory_iterator it(pathTxPool);it != directory_iterator();++it)
+        {
+            string strName = (*it).path().filename().string();
+            if (strName.compare(0,8,"journal.") != 0 || strName.size() == 8 || !is_regular_file((*it).path()))
+            {
+                continue;
+            }
+            char* pEnd = NULL;
+            unsigned long n = strtoul(strName.c_str() + 8,&pEnd,10);
+            if (*pEnd == '\0' && n > 0 && n <= 0xFFFFFFFFUL)
+            {
+                vGeneration.push_back((uint32)n);
+            }
+        }
     }
     catch (std::exception& e)
     {
         StdError(__PRETTY_FUNCTION__, e.what());
+    }
+    sort(vGeneration.begin(),vGeneration.end());
+}
+
+bool CTxPoolData::LoadSnapshot(const path& pathFile,uint32& nGeneration,vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
+{
+    nGeneration = 0;
+    if (!is_regular_file(pathFile))
+    {
+        return true;
+    }
+
+    FILE * fp = fopen(pathFile.c_str(),"rb");
+    if (fp == NULL)
+    {
         return false;
     }
-    
+
+    vector<pair<uint256,pair<uint256,CAssembledTx> > > vSnapshot;
+    try
+    {
+        CWalleveBufStream ss;
+        char header[SNAPSHOT_HEADER_SIZE];
+        if (fread(header,1,SNAPSHOT_HEADER_SIZE,fp) != SNAPSHOT_HEADER_SIZE)
+        {
+            fclose(fp);
+            return false;
+        }
+        ss.Write(header,SNAPSHOT_HEADER_SIZE);
+
+        uint32 nMagic,nVersion,nSnapshotGeneration;
+        uint256 hash;
+        uint64 nSize;
+        ss >> nMagic >> nVersion >> nSnapshotGeneration >> hash >> nSize;
+        if (nMagic != SNAPSHOT_MAGIC || nVersion != DATA_VERSION
+            || nSize != file_size(pathFile) - SNAPSHOT_HEADER_SIZE)
+        {
+            fclose(fp);
+            return false;
+        }
+
+        vector<char> vPayload(nSize);
+        if (nSize == 0 || fread(&vPayload[0],1,nSize,fp) != nSize
+            || crypto::CryptoHash(&vPayload[0],nSize) != hash)
+        {
+            fclose(fp);
+            return false;
+        }
+        fclose(fp);
+        fp = NULL;
+
+        ss.Clear();
+        ss.Write(&vPayload[0],nSize);
+        vector<char>().swap(vPayload);
+        ss >> vSnapshot;
+        nGeneration = nSnapshotGeneration;
+    }
+    catch (std::exception& e)
+    {
+        if (fp != NULL)
+        {
+            fclose(fp);
+        }
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+
+    vTx.insert(vTx.end(),vSnapshot.begin(),vSnapshot.end());
     return true;
 }
 
-bool CTxPoolData::Load(vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
+bool CTxPoolData::LoadJournal(uint32 nGeneration,vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx,
+                              map<uint256,size_t>& mapIndex)
 {
-    vTx.clear();
+    path pathJournal = GetJournalPath(nGeneration);
+    vector<char> vData;
+    try
+    {
+        vData.resize(file_size(pathJournal));
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+
+    FILE * fp = fopen(pathJournal.c_str(),"rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    size_t nData = (vData.empty() ? 0 : fread(&vData[0],1,vData.size(),fp));
+    fclose(fp);
+    if (nData < JOURNAL_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    try
+    {
+        CWalleveBufStream ss;
+        ss.Write(&vData[0],JOURNAL_HEADER_SIZE);
+        uint32 nMagic,nVersion,nJournalGeneration;
+        ss >> nMagic >> nVersion >> nJournalGeneration;
+        if (nMagic != JOURNAL_MAGIC || nVersion != DATA_VERSION || nJournalGeneration != nGeneration)
+        {
+            return false;
+        }
+
+        size_t nOffset = JOURNAL_HEADER_SIZE;
+        while (nOffset < nData)
+        {
+            // a crash may leave a partial record at the tail, replay stops there
+            if (nData - nOffset < RECORD_HEADER_SIZE)
+            {
+                return false;
+            }
+            ss.Clear();
+            ss.Write(&vData[nOffset],RECORD_HEADER_SIZE);
+            uint32 nSize,nCheck;
+            ss >> nSize >> nCheck;
+            if (nSize == 0 || nSize > MAX_RECORD_SIZE || nData - nOffset - RECORD_HEADER_SIZE < nSize)
+            {
+                return false;
+            }
+            const char* pPayload = &vData[nOffset + RECORD_HEADER_SIZE];
+            if (crypto::CryptoHash(pPayload,nSize).Get32() != nCheck)
+            {
+                return false;
+            }
+            nOffset += RECORD_HEADER_SIZE + nSize;
+
+            ss.Clear();
+            ss.Write(pPayload,nSize);
+            uint8 nOperation;
+            uint256 hashFork,txid;
+            ss >> nOperation >> hashFork >> txid;
+            if (nOperation == JOURNAL_ADDNEW)
+            {
+                if (!mapIndex.count(txid))
+                {
+                    vTx.push_back(make_pair(hashFork,make_pair(txid,CAssembledTx())));
+                    ss >> vTx.back().second.second;
+                    mapIndex[txid] = vTx.size() - 1;
+                }
+            }
+            else if (nOperation == JOURNAL_REMOVE)
+            {
+                mapIndex.erase(txid);
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+    catch (std::exception& e)
+    {
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
+    }
+    return true;
+}
 
-    if (!is_regular_file(pathTxPoolFile))
+bool CTxPoolData::LoadLegacy(vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
+{
+    if (!is_regular_file(pathLegacyFile))
     {
         return true;
     }
 
     try
     {
-        CWalleveFileStream fs(pathTxPoolFile.c_str());
+        CWalleveFileStream fs(pathLegacyFile.c_str());
         fs >> vTx;
     }
     catch (std::exception& e)
@@ -100,9 +513,43 @@ bool CTxPoolData::Load(vector<pair<uint256,pair<uint256,CAssembledTx> > >& vTx)
         StdError(__PRETTY_FUNCTION__, e.what());
         return false;
     }
-    
-    remove(pathTxPoolFile);
-
     return true;
 }
 
+void CTxPoolData::Append(CWalleveBufStream& ss)
+{
+    uint32 nSize = ss.GetSize();
+    uint32 nCheck = crypto::CryptoHash(ss.GetData(),nSize).Get32();
+
+    boost::unique_lock<boost::mutex> lock(mtxJournal);
+    if (fpJournal == NULL)
+    {
+        return;
+    }
+
+    CWalleveBufStream ssRecord;
+    ssRecord << nSize << nCheck;
+    if (fwrite(ssRecord.GetData(),1,ssRecord.GetSize(),fpJournal) != ssRecord.GetSize()
+        || fwrite(ss.GetData(),1,nSize,fpJournal) != nSize)
+    {
+        // the next compaction rewrites the whole pool into a fresh journal generation
+        StdError(__PRETTY_FUNCTION__, "Failed to append txpool journal");
+        CloseJournal();
+        fBroken = true;
+        return;
+    }
+    nRecord++;
+}
+
+void CTxPoolData::CloseJournal()
+{
+    if (fpJournal != NULL)
+    {
+        fflush(fpJournal);
+#ifdef __linux__
+        fsync(fileno(fpJournal));
+#endif
+        fclose(fpJournal);
+        fpJournal = NULL;
+    }
+}
@@ -8,28 +8,64 @@
 #include "walleve/walleve.h"
 #include "transaction.h"
 
+#include <stdio.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace multiverse
 {
 namespace storage
 {
 
+// Persistent txpool: a snapshot of generation G plus the append-only journals
+// of generation >= G. Every add/remove is appended to the current journal,
+// compaction rotates to a new journal and writes a snapshot of the live pool.
+// The previous snapshot and the journals after it are kept until the next
+// compaction, so a corrupt snapshot falls back to them.
 class CTxPoolData
 {
+public:
+    enum { SNAPSHOT_MAGIC = 0x4D565450, JOURNAL_MAGIC = 0x4D56544A, DATA_VERSION = 1 };
+    enum { JOURNAL_ADDNEW = 1, JOURNAL_REMOVE = 2 };
+    enum { MIN_COMPACT_RECORD = 8192 };
 public:
     CTxPoolData();
     ~CTxPoolData();
     bool Initialize(const boost::filesystem::path& pathData);
+    void Deinitialize();
     bool Remove();
-    bool Save(const std::vector<std::pair<uint256,std::pair<uint256,CAssembledTx> > >& vTx);
     bool Load(std::vector<std::pair<uint256,std::pair<uint256,CAssembledTx> > >& vTx);
+    bool Rotate(uint32& nGeneration);
+    bool SaveSnapshot(uint32 nGeneration,const std::vector<std::pair<uint256,std::pair<uint256,CAssembledTx> > >& vTx);
+    void AddNew(const uint256& hashFork,const uint256& txid,const CAssembledTx& tx);
+    void Remove(const uint256& hashFork,const uint256& txid);
+    void Flush();
+    bool IsCompactNeeded();
+protected:
+    boost::filesystem::path GetJournalPath(uint32 nGeneration) const;
+    void ListJournal(std::vector<uint32>& vGeneration) const;
+    bool LoadSnapshot(const boost::filesystem::path& pathFile,uint32& nGeneration,
+                      std::vector<std::pair<uint256,std::pair<uint256,CAssembledTx> > >& vTx);
+    bool LoadJournal(uint32 nGeneration,std::vector<std::pair<uint256,std::pair<uint256,CAssembledTx> > >& vTx,
+                     std::map<uint256,std::size_t>& mapIndex);
+    bool LoadLegacy(std::vector<std::pair<uint256,std::pair<uint256,CAssembledTx> > >& vTx);
+    void Append(walleve::CWalleveBufStream& ss);
+    void CloseJournal();
 protected:
-    boost::filesystem::path pathTxPoolFile;
+    boost::filesystem::path pathTxPool;
+    boost::filesystem::path pathSnapshotFile;
+    boost::filesystem::path pathPrevSnapshotFile;
+    boost::filesystem::path pathLegacyFile;
+    boost::mutex mtxJournal;
+    FILE * fpJournal;
+    uint32 nNextGeneration;
+    std::size_t nRecord;
+    std::size_t nSnapshotTx;
+    uint32 nSnapshotGeneration;
+    bool fBroken;
 };
 
 } // namespace storage
 } // namespace multiverse
 
 #endif //MULTIVERSE_TXPOOLDATA_H
-
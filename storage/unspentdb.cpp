@@ -11,8 +11,6 @@ using namespace std;
 using namespace walleve;
 using namespace multiverse::storage;
 
-#define UNSPENT_FLUSH_INTERVAL                  (60)
-    
 //////////////////////////////
 // CForkUnspentDB
 
@@ -32,7 +30,7 @@ CForkUnspentDB::CForkUnspentDB(const boost::filesystem::path& pathDB)
 CForkUnspentDB::~CForkUnspentDB()
 {
     Close();
-    dblCache.Clear();
+    ClearCache();
 }
 
 bool CForkUnspentDB::RemoveAll()
@@ -41,24 +39,44 @@ bool CForkUnspentDB::RemoveAll()
     {
         return false;
     }
-    dblCache.Clear();
+    ClearCache();
     return true;
 }
 
 bool CForkUnspentDB::UpdateUnspent(const vector<CTxUnspent>& vAddNew,const vector<CTxOutPoint>& vRemove)
 {
-    walleve::CWalleveWriteLock wlock(rwUpper);
-
-    MapType& mapUpper = dblCache.GetUpperMap();
-
+    // the changes of a block are applied at once, all touched shards are held for the whole update
+    uint32 nShardMask = 0;
     for(const CTxUnspent& unspent : vAddNew)
     {
-        mapUpper[static_cast<const CTxOutPoint&>(unspent)] = unspent.output;
+        nShardMask |= (1U << GetShardIndex(unspent));
     }
-
     for(const CTxOutPoint& txout : vRemove)
     {
-        mapUpper[txout].SetNull();
+        nShardMask |= (1U << GetShardIndex(txout));
+    }
+
+    try
+    {
+        WriteLockShard(nShardMask);
+
+        for(const CTxUnspent& unspent : vAddNew)
+        {
+            GetShard(unspent).tblUpper.Set(static_cast<const CTxOutPoint&>(unspent),unspent.output);
+        }
+
+        for(const CTxOutPoint& txout : vRemove)
+        {
+            GetShard(txout).tblUpper.Set(txout,CTxOutput());
+        }
+
+        WriteUnlockShard(nShardMask);
+    }
+    catch (exception& e)
+    {
+        WriteUnlockShard(nShardMask);
+        StdError(__PRETTY_FUNCTION__, e.what());
+        return false;
     }
 
     return true;
@@ -72,37 +90,23 @@ bool CForkUnspentDB::WriteUnspent(const CTxOutPoint& txout,const CTxOutput& outp
 bool CForkUnspentDB::ReadUnspent(const CTxOutPoint& txout,CTxOutput& output)
 {
     {
-        walleve::CWalleveReadLock rlock(rwUpper);
+        CCacheShard& s = GetShard(txout);
+        walleve::CWalleveReadLock rlock(s.rwAccess);
 
-        MapType& mapUpper = dblCache.GetUpperMap();
-        typename MapType::iterator it = mapUpper.find(txout);
-        if (it != mapUpper.end())
+        const CTxOutput* pOutput = s.tblUpper.Find(txout);
+        if (pOutput == NULL)
         {
-            if (!(*it).second.IsNull())
-            {
-                output = (*it).second;
-                return true;
-            }
-            return false;
+            pOutput = s.tblLower.Find(txout);
         }
-    }
-
-    if (rwLower.ReadTryLock())
-    {
-        MapType& mapLower = dblCache.GetLowerMap();
-        typename MapType::iterator it = mapLower.find(txout);
-        if (it != mapLower.end())
+        if (pOutput != NULL)
         {
-            if (!(*it).second.IsNull())
+            if (!pOutput->IsNull())
             {
-                output = (*it).second;
-                rwLower.ReadUnlock();
+                output = *pOutput;
                 return true;
             }
-            rwLower.ReadUnlock();
             return false;
         }
-        rwLower.ReadUnlock();
     }
 
     return Read(txout,output);
@@ -117,18 +121,27 @@ bool CForkUnspentDB::Copy(CForkUnspentDB& dbUnspent)
 
     try
     {
-        walleve::CWalleveReadLock rulock(rwUpper);
-        walleve::CWalleveReadLock rdlock(rwLower);
+        LockAllShard();
 
         if (!WalkThrough(boost::bind(&CForkUnspentDB::CopyWalker,this,_1,_2,boost::ref(dbUnspent))))
         {
+            UnlockAllShard();
             return false;
         }
 
-        dbUnspent.SetCache(dblCache); 
+        for (int i = 0;i < CACHE_SHARD_COUNT;i++)
+        {
+            CCacheShard& s = dbUnspent.shard[i];
+            walleve::CWalleveWriteLock wlock(s.rwAccess);
+            s.tblUpper = shard[i].tblUpper;
+            s.tblLower = shard[i].tblLower;
+        }
+
+        UnlockAllShard();
     }
     catch (exception& e)
     {
+        UnlockAllShard();
         StdError(__PRETTY_FUNCTION__, e.what());
         return false;
     }
@@ -139,51 +152,113 @@ bool CForkUnspentDB::WalkThroughUnspent(CForkUnspentDBWalker& walker)
 {
     try
     {
-        walleve::CWalleveReadLock rulock(rwUpper);
-        walleve::CWalleveReadLock rdlock(rwLower);
-
-        MapType& mapUpper = dblCache.GetUpperMap();
-        MapType& mapLower = dblCache.GetLowerMap();
+        LockAllShard();
 
-        if (!WalkThrough(boost::bind(&CForkUnspentDB::LoadWalker,this,_1,_2,boost::ref(walker),
-                                     boost::ref(mapUpper),boost::ref(mapLower))))
+        if (!WalkThrough(boost::bind(&CForkUnspentDB::LoadWalker,this,_1,_2,boost::ref(walker))))
         {
+            UnlockAllShard();
             return false;
         }
 
-        for (MapType::iterator it = mapLower.begin();it != mapLower.end();++it)
+        for (int i = 0;i < CACHE_SHARD_COUNT;i++)
         {
-            const CTxOutPoint& txout = (*it).first;
-            const CTxOutput& output  = (*it).second;
-            if (!mapUpper.count(txout) && !output.IsNull())
+            const CUnspentCacheTable& tblUpper = shard[i].tblUpper;
+            const vector<CUnspentCacheTable::CSlot>& vLower = shard[i].tblLower.GetSlots();
+            for (size_t j = 0;j < vLower.size();j++)
             {
-                if (!walker.Walk(txout,output))
+                const CUnspentCacheTable::CSlot& slot = vLower[j];
+                if (slot.fUsed && !slot.output.IsNull() && tblUpper.Find(slot.txout) == NULL)
                 {
-                    return false;
+                    if (!walker.Walk(slot.txout,slot.output))
+                    {
+                        UnlockAllShard();
+                        return false;
+                    }
                 }
             }
-        }
-        for (MapType::iterator it = mapUpper.begin();it != mapUpper.end();++it)
-        {
-            const CTxOutPoint& txout = (*it).first;
-            const CTxOutput& output  = (*it).second;
-            if (!output.IsNull())
+            const vector<CUnspentCacheTable::CSlot>& vUpper = tblUpper.GetSlots();
+            for (size_t j = 0;j < vUpper.size();j++)
             {
-                if (!walker.Walk(txout,output))
+                const CUnspentCacheTable::CSlot& slot = vUpper[j];
+                if (slot.fUsed && !slot.output.IsNull())
                 {
-                    return false;
+                    if (!walker.Walk(slot.txout,slot.output))
+                    {
+                        UnlockAllShard();
+                        return false;
+                    }
                 }
             }
         }
+
+        UnlockAllShard();
     }
     catch (exception& e)
     {
+        UnlockAllShard();
         StdError(__PRETTY_FUNCTION__, e.what());
         return false;
     }
     return true;
 }
 
+void CForkUnspentDB::LockAllShard()
+{
+    // shards are always taken in index order, by the walkers here and by UpdateUnspent
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
+    {
+        shard[i].rwAccess.ReadLock();
+    }
+}
+
+void CForkUnspentDB::UnlockAllShard()
+{
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
+    {
+        shard[i].rwAccess.ReadUnlock();
+    }
+}
+
+void CForkUnspentDB::WriteLockShard(uint32 nShardMask)
+{
+    // same index order as LockAllShard
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
+    {
+        if (nShardMask & (1U << i))
+        {
+            shard[i].rwAccess.WriteLock();
+        }
+    }
+}
+
+void CForkUnspentDB::WriteUnlockShard(uint32 nShardMask)
+{
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
+    {
+        if (nShardMask & (1U << i))
+        {
+            shard[i].rwAccess.WriteUnlock();
+        }
+    }
+}
+
+void CForkUnspentDB::ClearCache()
+{
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
+    {
+        walleve::CWalleveWriteLock wlock(shard[i].rwAccess);
+        shard[i].tblUpper.Clear();
+        shard[i].tblLower.Clear();
+    }
+}
+
+const CTxOutput* CForkUnspentDB::FindCache(const CTxOutPoint& txout)
+{
+    CCacheShard& s = GetShard(txout);
+    const CTxOutput* pOutput = s.tblUpper.Find(txout);
+    return (pOutput != NULL ? pOutput : s.tblLower.Find(txout));
+}
+
 bool CForkUnspentDB::CopyWalker(CWalleveBufStream& ssKey, CWalleveBufStream& ssValue,
                                 CForkUnspentDB& dbUnspent)
 {
@@ -196,13 +271,14 @@ bool CForkUnspentDB::CopyWalker(CWalleveBufStream& ssKey, CWalleveBufStream& ssV
 }
 
 bool CForkUnspentDB::LoadWalker(CWalleveBufStream& ssKey, CWalleveBufStream& ssValue,
-                                CForkUnspentDBWalker& walker,const MapType& mapUpper,const MapType& mapLower)
+                                CForkUnspentDBWalker& walker)
 {
     CTxOutPoint txout;
     CTxOutput output;
     ssKey >> txout;
 
-    if (mapUpper.count(txout) || mapLower.count(txout))
+    // all shards are read locked by WalkThroughUnspent
+    if (FindCache(txout) != NULL)
     {
         return true;
     }
@@ -214,51 +290,74 @@ bool CForkUnspentDB::LoadWalker(CWalleveBufStream& ssKey, CWalleveBufStream& ssV
 
 bool CForkUnspentDB::Flush()
 {
-    walleve::CWalleveUpgradeLock ulock(rwLower);
+    std::size_t nCount = 0;
+    return Flush(nCount,true);
+}
+
+bool CForkUnspentDB::Flush(std::size_t& nCount,bool fSync)
+{
+    boost::unique_lock<boost::mutex> lock(mtxFlush);
 
+    // lower tables only change on flip below, so the gathered changes stay valid
     vector<pair<CTxOutPoint,CTxOutput> > vAddNew;
     vector<CTxOutPoint> vRemove;
 
-    MapType& mapLower = dblCache.GetLowerMap();
-    for (typename MapType::iterator it = mapLower.begin(); it != mapLower.end(); ++it)
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
     {
-        CTxOutput& output = (*it).second;
-        if (!output.IsNull())
-        {
-            vAddNew.push_back(*it);
-        }
-        else
+        walleve::CWalleveReadLock rlock(shard[i].rwAccess);
+
+        const vector<CUnspentCacheTable::CSlot>& vLower = shard[i].tblLower.GetSlots();
+        for (size_t j = 0;j < vLower.size();j++)
         {
-            vRemove.push_back((*it).first);
+            const CUnspentCacheTable::CSlot& slot = vLower[j];
+            if (!slot.fUsed)
+            {
+                continue;
+            }
+            if (!slot.output.IsNull())
+            {
+                vAddNew.push_back(make_pair(slot.txout,slot.output));
+            }
+            else
+            {
+                vRemove.push_back(slot.txout);
+            }
         }
     }
 
-    if (!TxnBegin())
+    // nothing changed in the last interval, skip the empty commit
+    if (!vAddNew.empty() || !vRemove.empty())
     {
-        return false;
-    }
+        if (!TxnBegin())
+        {
+            return false;
+        }
 
-    for (int i = 0;i < vAddNew.size();i++)
-    {
-        Write(vAddNew[i].first,vAddNew[i].second);
-    }
+        for (int i = 0;i < vAddNew.size();i++)
+        {
+            Write(vAddNew[i].first,vAddNew[i].second);
+        }
 
-    for (int i = 0;i < vRemove.size();i++)
-    {
-        Erase(vRemove[i]);
-    }
+        for (int i = 0;i < vRemove.size();i++)
+        {
+            Erase(vRemove[i]);
+        }
 
-    if (!TxnCommit())
-    {
-        return false;
+        if (!TxnCommit(fSync))
+        {
+            return false;
+        }
+        nCount = vAddNew.size() + vRemove.size();
     }
 
-    ulock.Upgrade();
-
+    // flip every shard at once, a walker never sees some shards flipped and others not
+    WriteLockShard(ALL_SHARD_MASK);
+    for (int i = 0;i < CACHE_SHARD_COUNT;i++)
     {
-        walleve::CWalleveWriteLock wlock(rwUpper);
-        dblCache.Flip();
+        shard[i].tblLower.Clear();
+        shard[i].tblLower.Swap(shard[i].tblUpper);
     }
+    WriteUnlockShard(ALL_SHARD_MASK);
 
     return true;
 }
@@ -268,8 +367,6 @@ bool CForkUnspentDB::Flush()
 
 CUnspentDB::CUnspentDB()
 {
-    pThreadFlush = NULL;
-    fStopFlush = true;
 }
 
 bool CUnspentDB::Initialize(const boost::filesystem::path& pathData)
@@ -286,31 +383,11 @@ bool CUnspentDB::Initialize(const boost::filesystem::path& pathData)
         return false;
     }
 
-    fStopFlush = false;
-    pThreadFlush = new boost::thread(boost::bind(&CUnspentDB::FlushProc,this));
-    if (pThreadFlush == NULL)
-    {
-        fStopFlush = true;
-        return false;
-    }
-
     return true;
 }
 
 void CUnspentDB::Deinitialize()
 {
-    if (pThreadFlush)
-    {
-        {
-            boost::unique_lock<boost::mutex> lock(mtxFlush);
-            fStopFlush = true;
-        }
-        condFlush.notify_all();
-        pThreadFlush->join();
-        delete pThreadFlush;
-        pThreadFlush = NULL;
-    }
-    
     {
         CWalleveWriteLock wlock(rwAccess);
 
@@ -427,40 +504,33 @@ bool CUnspentDB::WalkThrough(const uint256& hashFork,CForkUnspentDBWalker& walke
     return false;
 }
 
-void CUnspentDB::FlushProc()
+bool CUnspentDB::Flush(size_t& nCount,size_t& nFork,bool fSync)
 {
-    boost::system_time timeout = boost::get_system_time();
-
-    boost::unique_lock<boost::mutex> lock(mtxFlush);
-    while (!fStopFlush)
+    vector<std::shared_ptr<CForkUnspentDB> > vUnspentDB;
     {
-        timeout += boost::posix_time::seconds(UNSPENT_FLUSH_INTERVAL);
+        CWalleveReadLock rlock(rwAccess);
 
-        while (!fStopFlush)
+        vUnspentDB.reserve(mapUnspentDB.size());
+        for (map<uint256,std::shared_ptr<CForkUnspentDB> >::iterator it = mapUnspentDB.begin();
+             it != mapUnspentDB.end();++it)
         {
-            if (!condFlush.timed_wait(lock,timeout))
-            {
-                break;
-            }
+            vUnspentDB.push_back((*it).second);
         }
+    }
 
-        if (!fStopFlush)
+    bool fRet = true;
+    for (int i = 0;i < vUnspentDB.size();i++)
+    {
+        size_t n = 0;
+        if (!vUnspentDB[i]->Flush(n,fSync))
         {
-            vector<std::shared_ptr<CForkUnspentDB> > vUnspentDB;
-            vUnspentDB.reserve(mapUnspentDB.size());
-            {
-                CWalleveReadLock rlock(rwAccess);
-
-                for (map<uint256,std::shared_ptr<CForkUnspentDB> >::iterator it = mapUnspentDB.begin();
-                     it != mapUnspentDB.end();++it)
-                {
-                    vUnspentDB.push_back((*it).second);
-                }
-            }
-            for (int i = 0;i < vUnspentDB.size();i++)
-            {
-                vUnspentDB[i]->Flush();
-            }
+            fRet = false;
+        }
+        else if (n != 0)
+        {
+            nCount += n;
+            nFork++;
         }
     }
+    return fRet;
 }
@@ -8,8 +8,6 @@
 #include "transaction.h"
 #include "walleve/walleve.h"
 
-#include <boost/thread/thread.hpp>
-
 namespace multiverse
 {
 namespace storage
@@ -21,37 +19,111 @@ public:
     virtual bool Walk(const CTxOutPoint& txout,const CTxOutput& output) = 0;
 };
 
-class CForkUnspentDB : public walleve::CKVDB
+class CUnspentCacheTable
 {
-    typedef std::map<CTxOutPoint,CTxOutput> MapType;
-    class CDblMap
+public:
+    class CSlot
     {
     public:
-        CDblMap() : nIdxUpper(0) {}
-        MapType& GetUpperMap()
+        CSlot() : fUsed(false) {}
+    public:
+        CTxOutPoint txout;
+        CTxOutput output;
+        bool fUsed;
+    };
+public:
+    CUnspentCacheTable() : nSize(0) {}
+    static std::size_t GetHash(const CTxOutPoint& txout)
+    {
+        return (std::size_t)(txout.hash.Get64(0) ^ (txout.n * 0x9E3779B97F4A7C15ULL));
+    }
+    std::size_t GetSize() const { return nSize; }
+    const std::vector<CSlot>& GetSlots() const { return vSlot; }
+    const CTxOutput* Find(const CTxOutPoint& txout) const
+    {
+        if (nSize == 0)
         {
-            return mapCache[nIdxUpper];
+            return NULL;
         }
-        MapType& GetLowerMap()
+        std::size_t nMask = vSlot.size() - 1;
+        for (std::size_t i = GetHash(txout) & nMask;vSlot[i].fUsed;i = (i + 1) & nMask)
         {
-            return mapCache[nIdxUpper ^ 1];
+            if (vSlot[i].txout == txout)
+            {
+                return &vSlot[i].output;
+            }
         }
-        void Flip()
+        return NULL;
+    }
+    void Set(const CTxOutPoint& txout,const CTxOutput& output)
+    {
+        // keep load factor below 1/2 so probe chains stay short
+        if ((nSize + 1) * 2 > vSlot.size())
+        {
+            Rehash(vSlot.empty() ? 64 : vSlot.size() * 2);
+        }
+        std::size_t nMask = vSlot.size() - 1;
+        std::size_t i = GetHash(txout) & nMask;
+        while (vSlot[i].fUsed && vSlot[i].txout != txout)
+        {
+            i = (i + 1) & nMask;
+        }
+        if (!vSlot[i].fUsed)
+        {
+            vSlot[i].fUsed = true;
+            vSlot[i].txout = txout;
+            nSize++;
+        }
+        vSlot[i].output = output;
+    }
+    void Clear()
+    {
+        if (nSize != 0)
         {
-            MapType& mapLower = mapCache[nIdxUpper ^ 1];
-            mapLower.clear();
-            nIdxUpper = nIdxUpper ^ 1;
+            for (std::size_t i = 0;i < vSlot.size();i++)
+            {
+                vSlot[i].fUsed = false;
+            }
+            nSize = 0;
         }
-        void Clear()
+    }
+    void Swap(CUnspentCacheTable& tbl)
+    {
+        vSlot.swap(tbl.vSlot);
+        std::swap(nSize,tbl.nSize);
+    }
+protected:
+    void Rehash(std::size_t nCapacity)
+    {
+        std::vector<CSlot> vOld(nCapacity);
+        vOld.swap(vSlot);
+        nSize = 0;
+        for (std::size_t i = 0;i < vOld.size();i++)
         {
-            mapCache[0].clear();
-            mapCache[1].clear();
-            nIdxUpper = 0;
+            if (vOld[i].fUsed)
+            {
+                Set(vOld[i].txout,vOld[i].output);
+            }
         }
-    protected:
-        MapType mapCache[2];
-        int nIdxUpper;
+    }
+protected:
+    std::vector<CSlot> vSlot;
+    std::size_t nSize;
+};
+
+class CForkUnspentDB : public walleve::CKVDB
+{
+    // Pending changes are spread over shards by outpoint hash, each shard with its own lock.
+    // Upper table collects new changes, lower table holds the changes being flushed.
+    class CCacheShard
+    {
+    public:
+        walleve::CWalleveRWAccess rwAccess;
+        CUnspentCacheTable tblUpper;
+        CUnspentCacheTable tblLower;
     };
+    enum { CACHE_SHARD_COUNT = 32 };    // one bit each in the shard mask of UpdateUnspent
+    enum { ALL_SHARD_MASK = 0xFFFFFFFF };
 public:
     CForkUnspentDB(const boost::filesystem::path& pathDB);
     ~CForkUnspentDB();
@@ -60,18 +132,31 @@ public:
     bool WriteUnspent(const CTxOutPoint& txout,const CTxOutput& output);
     bool ReadUnspent(const CTxOutPoint& txout,CTxOutput& output);
     bool Copy(CForkUnspentDB& dbUnspent);
-    void SetCache(const CDblMap& dblCacheIn) { dblCache = dblCacheIn; }
     bool WalkThroughUnspent(CForkUnspentDBWalker& walker);
     bool Flush();
+    bool Flush(std::size_t& nCount,bool fSync);
 protected:
+    static int GetShardIndex(const CTxOutPoint& txout)
+    {
+        return (int)(txout.hash.Get64(1) % CACHE_SHARD_COUNT);
+    }
+    CCacheShard& GetShard(const CTxOutPoint& txout)
+    {
+        return shard[GetShardIndex(txout)];
+    }
+    void LockAllShard();
+    void UnlockAllShard();
+    void WriteLockShard(uint32 nShardMask);
+    void WriteUnlockShard(uint32 nShardMask);
+    void ClearCache();
     bool CopyWalker(walleve::CWalleveBufStream& ssKey, walleve::CWalleveBufStream& ssValue,
                     CForkUnspentDB& dbUnspent);
     bool LoadWalker(walleve::CWalleveBufStream& ssKey, walleve::CWalleveBufStream& ssValue,
-                    CForkUnspentDBWalker& walker,const MapType& mapUpper,const MapType& mapLower);
+                    CForkUnspentDBWalker& walker);
+    const CTxOutput* FindCache(const CTxOutPoint& txout);
 protected:
-    walleve::CWalleveRWAccess rwUpper;
-    walleve::CWalleveRWAccess rwLower;    
-    CDblMap dblCache;
+    boost::mutex mtxFlush;
+    CCacheShard shard[CACHE_SHARD_COUNT];
 };
 
 class CUnspentDB
@@ -89,17 +174,11 @@ public:
     bool Retrieve(const uint256& hashFork,const CTxOutPoint& txout,CTxOutput& output);
     bool Copy(const uint256& srcFork,const uint256& destFork);
     bool WalkThrough(const uint256& hashFork,CForkUnspentDBWalker& walker);
-protected:
-    void FlushProc();
+    bool Flush(std::size_t& nCount,std::size_t& nFork,bool fSync);
 protected:
     boost::filesystem::path pathUnspent;
     walleve::CWalleveRWAccess rwAccess;
     std::map<uint256,std::shared_ptr<CForkUnspentDB> > mapUnspentDB;
-
-    boost::mutex mtxFlush;
-    boost::condition_variable condFlush;
-    boost::thread* pThreadFlush;
-    bool fStopFlush;
 };
 
 } // namespace storage
@@ -0,0 +1,111 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "addresstxindexdb.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(addresstxindexdb_tests, BasicUtfSetup)
+
+using namespace multiverse::storage;
+
+static uint256 RandomHash()
+{
+    uint256 hash;
+    multiverse::crypto::CryptoGetRand256(hash);
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE( range )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("addrtx-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CAddressTxIndexDB db;
+    BOOST_CHECK( db.Initialize(pathTest) );
+    BOOST_CHECK( !db.IsComplete() );
+
+    uint256 hashFork = RandomHash(),hashOther = RandomHash();
+    multiverse::crypto::CPubKey pubkeyA(RandomHash()),pubkeyB(RandomHash());
+    CDestination destA(pubkeyA),destB(pubkeyB);
+
+    // heights cross byte boundaries to check the scan order
+    const int32 vHeight[] = {1,255,256,300,65536,70000};
+    std::vector<uint256> vTxid;
+    std::vector<std::pair<CDestination,CAddrTxIndex> > vAddrTxNew;
+    for (int i = 5;i >= 0;i--)
+    {
+        uint256 txid = RandomHash();
+        vTxid.insert(vTxid.begin(),txid);
+        CAddrTxIndex addrTx(vHeight[i],txid,1,i * 100,destB,i);
+        vAddrTxNew.push_back(std::make_pair(destA,addrTx));
+        vAddrTxNew.push_back(std::make_pair(destB,addrTx));
+    }
+    BOOST_CHECK( db.Update(hashFork,vAddrTxNew,std::vector<uint256>()) );
+
+    std::vector<std::pair<CDestination,CAddrTxIndex> > vOther;
+    vOther.push_back(std::make_pair(destA,CAddrTxIndex(2,RandomHash(),1,0)));
+    BOOST_CHECK( db.Update(hashOther,vOther,std::vector<uint256>()) );
+
+    std::vector<CAddrTxIndex> vAddrTx;
+    BOOST_CHECK( db.Retrieve(hashFork,destA,0,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 6 );
+    for (int i = 0;i < vAddrTx.size();i++)
+    {
+        BOOST_CHECK( vAddrTx[i].nBlockHeight == vHeight[i] && vAddrTx[i].txid == vTxid[i] );
+        BOOST_CHECK( vAddrTx[i].destIn == destB && vAddrTx[i].nValueIn == i && vAddrTx[i].nOffset == i * 100 );
+    }
+
+    vAddrTx.clear();
+    BOOST_CHECK( db.Retrieve(hashFork,destB,256,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 4 && vAddrTx[0].nBlockHeight == 256 );
+
+    // rollback removes the entries of every address the tx was indexed under
+    std::vector<uint256> vTxDel;
+    vTxDel.push_back(vTxid[5]);
+    vTxDel.push_back(vTxid[4]);
+    BOOST_CHECK( db.Update(hashFork,std::vector<std::pair<CDestination,CAddrTxIndex> >(),vTxDel) );
+    vAddrTx.clear();
+    BOOST_CHECK( db.Retrieve(hashFork,destA,0,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 4 );
+    vAddrTx.clear();
+    BOOST_CHECK( db.Retrieve(hashFork,destB,0,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 4 );
+
+    // re-added at another height, the old entry goes away in the same update
+    std::vector<std::pair<CDestination,CAddrTxIndex> > vMoved;
+    vMoved.push_back(std::make_pair(destA,CAddrTxIndex(400,vTxid[3],2,0)));
+    BOOST_CHECK( db.Update(hashFork,vMoved,std::vector<uint256>(1,vTxid[3])) );
+    vAddrTx.clear();
+    BOOST_CHECK( db.Retrieve(hashFork,destA,0,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 4 && vAddrTx[3].nBlockHeight == 400 && vAddrTx[3].txid == vTxid[3] );
+    vAddrTx.clear();
+    BOOST_CHECK( db.Retrieve(hashFork,destB,0,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 3 );
+
+    vAddrTx.clear();
+    BOOST_CHECK( db.Retrieve(hashOther,destA,0,vAddrTx) );
+    BOOST_CHECK( vAddrTx.size() == 1 && vAddrTx[0].nBlockHeight == 2 );
+
+    // the tip is stored with the entries of its block, an update without tip keeps it
+    uint256 hashTip = RandomHash(),hashTipRet;
+    BOOST_CHECK( !db.RetrieveTip(hashFork,hashTipRet) );
+    BOOST_CHECK( db.Update(hashFork,vOther,std::vector<uint256>(),hashTip) );
+    BOOST_CHECK( db.RetrieveTip(hashFork,hashTipRet) && hashTipRet == hashTip );
+    BOOST_CHECK( db.Update(hashFork,std::vector<std::pair<CDestination,CAddrTxIndex> >(),std::vector<uint256>()) );
+    BOOST_CHECK( db.RetrieveTip(hashFork,hashTipRet) && hashTipRet == hashTip );
+    BOOST_CHECK( !db.RetrieveTip(hashOther,hashTipRet) );
+
+    BOOST_CHECK( db.SetComplete() && db.IsComplete() );
+    db.Clear();
+    BOOST_CHECK( !db.IsComplete() && !db.RetrieveTip(hashFork,hashTipRet) );
+
+    db.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,400 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "blockbase.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(blockbase_tests, BasicUtfSetup)
+
+using namespace multiverse;
+using namespace multiverse::storage;
+
+static uint256 RandomHash()
+{
+    uint256 hash;
+    multiverse::crypto::CryptoGetRand256(hash);
+    return hash;
+}
+
+class CBlockBaseProbe : public CBlockBase
+{
+public:
+    void SetWorkerPool(boost::shared_ptr<CVerifyPool> spPool)
+    {
+        spWorkerPool = spPool;
+    }
+    bool IndexAddressTx(const uint256& hashFork,const std::vector<CBlockIndex*>& vIndex)
+    {
+        for (int i = 0;i < vIndex.size();i++)
+        {
+            CBlockEx block;
+            if (!Retrieve(vIndex[i],block))
+            {
+                return false;
+            }
+            std::vector<std::pair<uint256,CTxIndex> > vTxNew;
+            std::vector<std::pair<CDestination,CAddrTxIndex> > vAddrTxNew;
+            GetBlockTxIndex(vIndex[i],block,vTxNew,vAddrTxNew);
+            if (!dbBlock.AddAddressTx(hashFork,vAddrTxNew,vIndex[i]->GetBlockHash()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    static void GetSegment(CBlockIndex* pIndexLast,CBlockIndex* pIndexTop,CBlockIndex* pIndexBottom,bool fComplete,
+                           std::vector<std::pair<CBlockIndex*,CBlockIndex*> >& vSegment)
+    {
+        GetConsistencySegment(pIndexLast,pIndexTop,pIndexBottom,fComplete,vSegment);
+    }
+    static CBlockIndex* GetResume(CBlockIndex* pIndexDone,CBlockIndex* pIndexLast)
+    {
+        return GetAddressTxIndexResume(pIndexDone,pIndexLast);
+    }
+    static void MergeUnspent(const CConsistencyRange& range,std::map<CTxOutPoint,CTxUnspent>& mapUnspent,
+                                                            std::set<CTxOutPoint>& setSpent)
+    {
+        MergeRangeUnspent(range,mapUnspent,setSpent);
+    }
+    bool SaveCheckpoint(const CConsistencyCheckpoint& checkpoint)
+    {
+        return SaveConsistencyCheckpoint(checkpoint);
+    }
+    bool LoadCheckpoint(CConsistencyCheckpoint& checkpoint)
+    {
+        return LoadConsistencyCheckpoint(checkpoint);
+    }
+    bool FilterIndexed(const uint256& hashFork,int32 nHeightFrom,bool fReverse,CTxFilter& filter)
+    {
+        return FilterIndexedTx(hashFork,nHeightFrom,fReverse,filter);
+    }
+    bool ScanTx(const uint256& hashFork,const std::vector<CBlockIndex*>& vIndex,CTxFilter& filter)
+    {
+        return ScanForkTx(hashFork,vIndex,filter);
+    }
+    bool ScanTxSerial(const uint256& hashFork,const std::vector<CBlockIndex*>& vIndex,CTxFilter& filter)
+    {
+        for (int i = 0;i < vIndex.size();i++)
+        {
+            std::vector<CAssembledTx> vMatch;
+            if (!FilterBlockTx(vIndex[i],filter.setDest,vMatch))
+            {
+                return false;
+            }
+            for (int j = 0;j < vMatch.size();j++)
+            {
+                if (!filter.FoundTx(hashFork,vMatch[j]))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+class CTxFilterCollect : public CTxFilter
+{
+public:
+    CTxFilterCollect(const std::set<CDestination>& setDestIn) : CTxFilter(setDestIn) {}
+    bool FoundTx(const uint256& hashFork,const CAssembledTx& tx) override
+    {
+        vFound.push_back(std::make_pair(tx.GetHash(),tx.nBlockHeight));
+        return true;
+    }
+public:
+    std::vector<std::pair<uint256,int32> > vFound;
+};
+
+BOOST_AUTO_TEST_CASE( scan )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("blockbase-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CBlockBaseProbe base;
+    BOOST_CHECK( base.Initialize(pathTest,false) );
+    boost::shared_ptr<CVerifyPool> spPool(new CVerifyPool());
+    BOOST_CHECK( spPool->Start(3) );
+    base.SetWorkerPool(spPool);
+
+    std::vector<CDestination> vDest;
+    for (int i = 0;i < 4;i++)
+    {
+        vDest.push_back(CDestination(multiverse::crypto::CPubKey(RandomHash())));
+    }
+
+    // more blocks than one window, with matches spread unevenly over them
+    std::vector<CBlockIndex*> vIndex;
+    for (int nBlock = 0;nBlock < 600;nBlock++)
+    {
+        CBlockEx block;
+        block.nType = CBlock::BLOCK_SUBSIDIARY;
+        block.nTimeStamp = 1500000000 + nBlock;
+        block.hashPrev = RandomHash();
+        block.txMint.nType = CTransaction::TX_STAKE;
+        block.txMint.nTimeStamp = block.nTimeStamp;
+        block.txMint.sendTo = vDest[nBlock % 3];
+        for (int i = 0;i < nBlock % 7;i++)
+        {
+            CTransaction tx;
+            tx.nTimeStamp = block.nTimeStamp;
+            tx.vInput.push_back(CTxIn(CTxOutPoint(RandomHash(),0)));
+            tx.sendTo = vDest[(nBlock + i) % vDest.size()];
+            tx.nAmount = i + 1;
+            CTxContxt ctxt;
+            ctxt.destIn = vDest[(nBlock * 3 + i) % vDest.size()];
+            block.vtx.push_back(tx);
+            block.vTxContxt.push_back(ctxt);
+        }
+        block.hashMerkle = block.CalcMerkleTreeRoot();
+
+        CBlockIndex* pIndex = NULL;
+        BOOST_CHECK( base.AddNew(block.GetHash(),block,&pIndex) && pIndex != NULL );
+        vIndex.push_back(pIndex);
+    }
+
+    std::set<CDestination> setDest;
+    setDest.insert(vDest[0]);
+    setDest.insert(vDest[2]);
+    uint256 hashFork = RandomHash();
+
+    CTxFilterCollect filterSerial(setDest),filterPool(setDest);
+    BOOST_CHECK( base.ScanTxSerial(hashFork,vIndex,filterSerial) );
+    BOOST_CHECK( base.ScanTx(hashFork,vIndex,filterPool) );
+    BOOST_CHECK( !filterSerial.vFound.empty() );
+    BOOST_CHECK( filterPool.vFound == filterSerial.vFound );
+
+    // newest first, as FilterTx with depth walks the fork
+    std::vector<CBlockIndex*> vReverse(vIndex.rbegin(),vIndex.rbegin() + 300);
+    CTxFilterCollect filterSerialRev(setDest),filterPoolRev(setDest);
+    BOOST_CHECK( base.ScanTxSerial(hashFork,vReverse,filterSerialRev) );
+    BOOST_CHECK( base.ScanTx(hashFork,vReverse,filterPoolRev) );
+    BOOST_CHECK( filterPoolRev.vFound == filterSerialRev.vFound );
+
+    base.Deinitialize();
+    spPool->Stop();
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_CASE( indexed )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("blockbase-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CBlockBaseProbe base;
+    BOOST_CHECK( base.Initialize(pathTest,false) );
+
+    std::vector<CDestination> vDest;
+    for (int i = 0;i < 3;i++)
+    {
+        vDest.push_back(CDestination(multiverse::crypto::CPubKey(RandomHash())));
+    }
+
+    // a chain of blocks with several matching txs in each, so the order inside a block counts
+    std::vector<CBlockIndex*> vIndex;
+    uint256 hashPrev;
+    for (int nBlock = 0;nBlock < 40;nBlock++)
+    {
+        CBlockEx block;
+        block.nType = CBlock::BLOCK_SUBSIDIARY;
+        block.nTimeStamp = 1500000000 + nBlock;
+        block.hashPrev = hashPrev;
+        block.txMint.nType = CTransaction::TX_STAKE;
+        block.txMint.nTimeStamp = block.nTimeStamp;
+        block.txMint.sendTo = vDest[nBlock % 2];
+        for (int i = 0;i < 5;i++)
+        {
+            CTransaction tx;
+            tx.nTimeStamp = block.nTimeStamp;
+            tx.vInput.push_back(CTxIn(CTxOutPoint(RandomHash(),0)));
+            tx.sendTo = vDest[(nBlock + i) % vDest.size()];
+            tx.nAmount = i + 1;
+            CTxContxt ctxt;
+            ctxt.destIn = vDest[i % 2];
+            block.vtx.push_back(tx);
+            block.vTxContxt.push_back(ctxt);
+        }
+        block.hashMerkle = block.CalcMerkleTreeRoot();
+
+        CBlockIndex* pIndex = NULL;
+        hashPrev = block.GetHash();
+        BOOST_CHECK( base.AddNew(hashPrev,block,&pIndex) && pIndex != NULL );
+        vIndex.push_back(pIndex);
+    }
+    BOOST_CHECK( vIndex.back()->GetBlockHeight() == 39 );
+
+    uint256 hashFork = RandomHash();
+    BOOST_CHECK( base.IndexAddressTx(hashFork,vIndex) );
+
+    std::set<CDestination> setDest;
+    setDest.insert(vDest[0]);
+    setDest.insert(vDest[2]);
+
+    CTxFilterCollect filterScan(setDest),filterIndexed(setDest);
+    BOOST_CHECK( base.ScanTxSerial(hashFork,vIndex,filterScan) );
+    BOOST_CHECK( base.FilterIndexed(hashFork,0,false,filterIndexed) );
+    BOOST_CHECK( !filterScan.vFound.empty() );
+    BOOST_CHECK( filterIndexed.vFound == filterScan.vFound );
+
+    // newest block first as the depth walk does, with the txs of each block in block order
+    std::vector<CBlockIndex*> vReverse(vIndex.rbegin(),vIndex.rbegin() + 10);
+    CTxFilterCollect filterScanRev(setDest),filterIndexedRev(setDest);
+    BOOST_CHECK( base.ScanTxSerial(hashFork,vReverse,filterScanRev) );
+    BOOST_CHECK( base.FilterIndexed(hashFork,30,true,filterIndexedRev) );
+    BOOST_CHECK( filterIndexedRev.vFound == filterScanRev.vFound );
+
+    base.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_CASE( resume )
+{
+    std::vector<CBlockIndex> vIndex(10);
+    for (int i = 0;i < vIndex.size();i++)
+    {
+        vIndex[i].nHeight = i;
+        vIndex[i].pPrev = (i > 0 ? &vIndex[i - 1] : NULL);
+        vIndex[i].pNext = (i + 1 < vIndex.size() ? &vIndex[i + 1] : NULL);
+    }
+    CBlockIndex* pLast = &vIndex[9];
+
+    // nothing indexed yet, or indexed blocks still on the chain
+    BOOST_CHECK( CBlockBaseProbe::GetResume(NULL,pLast) == NULL );
+    BOOST_CHECK( CBlockBaseProbe::GetResume(&vIndex[4],pLast) == &vIndex[4] );
+    BOOST_CHECK( CBlockBaseProbe::GetResume(pLast,pLast) == pLast );
+
+    // a branch from height 5 replaced the indexed blocks above it
+    std::vector<CBlockIndex> vBranch(3);
+    for (int i = 0;i < vBranch.size();i++)
+    {
+        vBranch[i].nHeight = 6 + i;
+        vBranch[i].pPrev = (i > 0 ? &vBranch[i - 1] : &vIndex[5]);
+        vBranch[i].pNext = (i + 1 < vBranch.size() ? &vBranch[i + 1] : NULL);
+    }
+    vIndex[5].pNext = &vBranch[0];
+    for (int i = 6;i < vIndex.size();i++)
+    {
+        vIndex[i].pNext = NULL;
+    }
+    BOOST_CHECK( CBlockBaseProbe::GetResume(&vIndex[8],&vBranch[2]) == &vIndex[5] );
+    BOOST_CHECK( CBlockBaseProbe::GetResume(&vIndex[3],&vBranch[2]) == &vIndex[3] );
+}
+
+BOOST_AUTO_TEST_CASE( segment )
+{
+    std::vector<CBlockIndex> vIndex(10);
+    for (int i = 0;i < vIndex.size();i++)
+    {
+        vIndex[i].nHeight = i;
+        vIndex[i].pPrev = (i > 0 ? &vIndex[i - 1] : NULL);
+        vIndex[i].pNext = (i + 1 < vIndex.size() ? &vIndex[i + 1] : NULL);
+    }
+    CBlockIndex* pLast = &vIndex[9];
+    std::vector<std::pair<CBlockIndex*,CBlockIndex*> > vSegment;
+
+    // first run walks the whole chain down
+    CBlockBaseProbe::GetSegment(pLast,NULL,NULL,false,vSegment);
+    BOOST_CHECK( vSegment.size() == 1 && vSegment[0].first == pLast && vSegment[0].second == NULL );
+
+    // interrupted run resumes below the verified segment
+    CBlockBaseProbe::GetSegment(pLast,pLast,&vIndex[5],false,vSegment);
+    BOOST_CHECK( vSegment.size() == 1 && vSegment[0].first == &vIndex[4] && vSegment[0].second == NULL );
+
+    // new blocks are checked down to the old top, then the unchecked part below the bottom
+    CBlockBaseProbe::GetSegment(pLast,&vIndex[7],&vIndex[5],false,vSegment);
+    BOOST_CHECK( vSegment.size() == 2 );
+    BOOST_CHECK( vSegment[0].first == pLast && vSegment[0].second == &vIndex[7] );
+    BOOST_CHECK( vSegment[1].first == &vIndex[4] && vSegment[1].second == NULL );
+
+    // a complete segment only gets the new blocks, nothing when the tip did not move
+    CBlockBaseProbe::GetSegment(pLast,&vIndex[7],&vIndex[0],true,vSegment);
+    BOOST_CHECK( vSegment.size() == 1 && vSegment[0].first == pLast && vSegment[0].second == &vIndex[7] );
+    CBlockBaseProbe::GetSegment(pLast,pLast,&vIndex[0],true,vSegment);
+    BOOST_CHECK( vSegment.empty() );
+
+    // the bottom at the origin leaves nothing below, even if the flag was not saved yet
+    CBlockBaseProbe::GetSegment(pLast,pLast,&vIndex[0],false,vSegment);
+    BOOST_CHECK( vSegment.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( merge )
+{
+    std::vector<CTxOutPoint> vOut;
+    for (int i = 0;i < 6;i++)
+    {
+        vOut.push_back(CTxOutPoint(RandomHash(),i));
+    }
+    CTxOutput output(CDestination(multiverse::crypto::CPubKey(RandomHash())),100,1500000000,0);
+
+    // ranges come from the top: the upper one spends an output created by the lower one
+    CConsistencyRange rangeUpper,rangeLower;
+    rangeUpper.vSpent.push_back(vOut[0]);
+    rangeUpper.vSpent.push_back(vOut[1]);
+    rangeUpper.mapUnspent.insert(std::make_pair(vOut[2],CTxUnspent(vOut[2],output)));
+    rangeLower.mapUnspent.insert(std::make_pair(vOut[0],CTxUnspent(vOut[0],output)));
+    rangeLower.mapUnspent.insert(std::make_pair(vOut[3],CTxUnspent(vOut[3],output)));
+    rangeLower.vSpent.push_back(vOut[4]);
+
+    std::map<CTxOutPoint,CTxUnspent> mapUnspent;
+    std::set<CTxOutPoint> setSpent;
+    CBlockBaseProbe::MergeUnspent(rangeUpper,mapUnspent,setSpent);
+    BOOST_CHECK( mapUnspent.size() == 1 && mapUnspent.count(vOut[2]) );
+    BOOST_CHECK( setSpent.size() == 2 && setSpent.count(vOut[0]) && setSpent.count(vOut[1]) );
+
+    CBlockBaseProbe::MergeUnspent(rangeLower,mapUnspent,setSpent);
+    BOOST_CHECK( mapUnspent.size() == 2 && mapUnspent.count(vOut[2]) && mapUnspent.count(vOut[3]) );
+    BOOST_CHECK( setSpent.size() == 2 && setSpent.count(vOut[1]) && setSpent.count(vOut[4]) );
+
+    // a resumed run starts from the state saved in the checkpoint, below the new blocks
+    CConsistencyRange rangeNew;
+    rangeNew.vSpent.push_back(vOut[3]);
+    rangeNew.mapUnspent.insert(std::make_pair(vOut[5],CTxUnspent(vOut[5],output)));
+    std::map<CTxOutPoint,CTxUnspent> mapResumed;
+    std::set<CTxOutPoint> setResumed;
+    CBlockBaseProbe::MergeUnspent(rangeNew,mapResumed,setResumed);
+    CBlockBaseProbe::MergeUnspent(rangeUpper,mapResumed,setResumed);
+    CBlockBaseProbe::MergeUnspent(rangeLower,mapResumed,setResumed);
+    BOOST_CHECK( mapResumed.size() == 2 && mapResumed.count(vOut[2]) && mapResumed.count(vOut[5]) );
+    BOOST_CHECK( setResumed.size() == 2 && setResumed.count(vOut[1]) && setResumed.count(vOut[4]) );
+}
+
+BOOST_AUTO_TEST_CASE( checkpoint )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("blockbase-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CBlockBaseProbe base;
+    BOOST_CHECK( base.Initialize(pathTest,false) );
+    BOOST_CHECK( !base.IsConsistencyFailed() );
+
+    CConsistencyCheckpoint checkpoint,checkpointRet;
+    checkpoint.nCheckLevel = 3;
+    checkpoint.nCheckDepth = 100;
+    checkpoint.vFork.push_back(CConsistencyForkCheckpoint());
+    checkpoint.vFork[0].hashFork = RandomHash();
+    checkpoint.vFork[0].hashTop = RandomHash();
+    checkpoint.vFork[0].vSpent.push_back(CTxOutPoint(RandomHash(),1));
+    BOOST_CHECK( base.SaveCheckpoint(checkpoint) && base.LoadCheckpoint(checkpointRet) );
+    BOOST_CHECK( checkpointRet.nCheckLevel == 3 && checkpointRet.nCheckDepth == 100 && !checkpointRet.fFailed );
+    BOOST_CHECK( checkpointRet.vFork.size() == 1 && checkpointRet.vFork[0].hashTop == checkpoint.vFork[0].hashTop
+                 && checkpointRet.vFork[0].vSpent == checkpoint.vFork[0].vSpent );
+    BOOST_CHECK( !base.IsConsistencyFailed() );
+
+    // a failed run is reported until the container is cleared
+    checkpoint.fFailed = true;
+    BOOST_CHECK( base.SaveCheckpoint(checkpoint) && base.IsConsistencyFailed() );
+    base.Clear();
+    BOOST_CHECK( !base.IsConsistencyFailed() && !base.LoadCheckpoint(checkpointRet) );
+
+    base.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
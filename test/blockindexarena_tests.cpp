@@ -0,0 +1,60 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "blockindexarena.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(blockindexarena_tests, BasicUtfSetup)
+
+using namespace multiverse::storage;
+
+BOOST_AUTO_TEST_CASE( arena )
+{
+    CBlockIndexArena arena;
+    BOOST_CHECK( arena.IsEmpty() );
+
+    std::vector<uint256> vHash;
+    std::vector<CBlockIndex*> vIndex;
+    for (int i = 0;i < 50000;i++)
+    {
+        uint256 hash;
+        multiverse::crypto::CryptoGetRand256(hash);
+        CBlockIndex index;
+        index.nHeight = i;
+        bool fNew = false;
+        CBlockIndex* pIndex = arena.Insert(hash,index,fNew);
+        BOOST_CHECK( fNew && pIndex->GetBlockHash() == hash && pIndex->pOrigin == pIndex );
+        vHash.push_back(hash);
+        vIndex.push_back(pIndex);
+    }
+    BOOST_CHECK( arena.GetSize() == vHash.size() );
+
+    // pointers survive rehash and duplicate inserts return the existing entry
+    bool fNew = true;
+    BOOST_CHECK( arena.Insert(vHash[10],CBlockIndex(),fNew) == vIndex[10] && !fNew );
+    for (int i = 0;i < vHash.size();i++)
+    {
+        BOOST_CHECK( arena.Get(vHash[i]) == vIndex[i] && vIndex[i]->nHeight == i );
+    }
+
+    for (int i = 0;i < vHash.size();i += 2)
+    {
+        BOOST_CHECK( arena.Remove(vHash[i]) );
+    }
+    BOOST_CHECK( !arena.Remove(vHash[0]) );
+    BOOST_CHECK( arena.GetSize() == vHash.size() / 2 );
+    for (int i = 0;i < vHash.size();i++)
+    {
+        BOOST_CHECK( (arena.Get(vHash[i]) != NULL) == (i % 2 == 1) );
+        BOOST_CHECK( i % 2 == 0 || arena.Get(vHash[i])->nHeight == i );
+    }
+
+    arena.Clear();
+    BOOST_CHECK( arena.IsEmpty() && arena.Get(vHash[1]) == NULL );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
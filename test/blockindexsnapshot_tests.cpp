@@ -0,0 +1,62 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "blockindexsnapshot.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(blockindexsnapshot_tests, BasicUtfSetup)
+
+using namespace multiverse::storage;
+
+BOOST_AUTO_TEST_CASE( snapshot )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("snapshot-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    std::vector<CBlockIndexSnapshotFork> vFork(2);
+    std::vector<CBlockOutline> vOutline(1000);
+    for (int i = 0;i < vOutline.size();i++)
+    {
+        multiverse::crypto::CryptoGetRand256(vOutline[i].hashBlock);
+        vOutline[i].hashPrev = (i > 0 ? vOutline[i - 1].hashBlock : uint256());
+        vOutline[i].hashOrigin = vOutline[0].hashBlock;
+        vOutline[i].nHeight = i;
+        vOutline[i].nChainTrust = i * 10;
+    }
+    for (int i = 0;i < vFork.size();i++)
+    {
+        vFork[i].hashFork = vOutline[i * 500].hashBlock;
+        vFork[i].hashLastBlock = vOutline[i * 500 + 499].hashBlock;
+        vFork[i].vchProfile.assign(16,(unsigned char)i);
+    }
+
+    CBlockIndexSnapshot snapshot;
+    BOOST_CHECK( snapshot.Initialize(pathTest) );
+    uint256 hashSnapshot;
+    BOOST_CHECK( snapshot.Save(vFork,vOutline,hashSnapshot) );
+
+    std::vector<CBlockIndexSnapshotFork> vForkLoad;
+    std::vector<CBlockOutline> vOutlineLoad;
+    BOOST_CHECK( snapshot.Load(hashSnapshot,vForkLoad,vOutlineLoad) );
+    BOOST_CHECK( vForkLoad.size() == vFork.size() && vOutlineLoad.size() == vOutline.size() );
+    BOOST_CHECK( vForkLoad[1].hashLastBlock == vFork[1].hashLastBlock && vForkLoad[1].vchProfile == vFork[1].vchProfile );
+    for (int i = 0;i < vOutlineLoad.size();i++)
+    {
+        BOOST_CHECK( vOutlineLoad[i].hashBlock == vOutline[i].hashBlock && vOutlineLoad[i].hashPrev == vOutline[i].hashPrev
+                     && vOutlineLoad[i].nHeight == i && vOutlineLoad[i].nChainTrust == i * 10 );
+    }
+
+    // a snapshot recorded under another id is rejected
+    BOOST_CHECK( !snapshot.Load(uint256(1),vForkLoad,vOutlineLoad) && vOutlineLoad.empty() );
+    BOOST_CHECK( snapshot.Remove() );
+    BOOST_CHECK( !snapshot.Load(hashSnapshot,vForkLoad,vOutlineLoad) );
+
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,184 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+
+#include "test_fnfn.h"
+#include "compactblock.h"
+#include "siphash.h"
+
+BOOST_FIXTURE_TEST_SUITE(compactblock_tests, BasicUtfSetup)
+
+typedef std::map<uint256,CTransaction> TxPool;
+
+static bool GetPoolTx(const TxPool* pPool,const uint256& txid,CTransaction& tx)
+{
+    TxPool::const_iterator it = pPool->find(txid);
+    if (it == pPool->end())
+    {
+        return false;
+    }
+    tx = (*it).second;
+    return true;
+}
+
+static CBlock MakeBlock(int nTx)
+{
+    CBlock block;
+    block.nTimeStamp = 1000;
+    block.txMint.nTimeStamp = 1000;
+    for (int i = 0;i < nTx;i++)
+    {
+        CTransaction tx;
+        tx.nTimeStamp = 1000 - i;
+        tx.nAmount = i + 1;
+        tx.vchData.assign(64,(unsigned char)i);
+        block.vtx.push_back(tx);
+    }
+    block.hashMerkle = block.CalcMerkleTreeRoot();
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE( siphash_vector )
+{
+    // reference vectors, key 00..0f and message 00..n-1
+    const uint64 k0 = 0x0706050403020100ULL,k1 = 0x0F0E0D0C0B0A0908ULL;
+    unsigned char msg[32];
+    for (int i = 0;i < 32;i++)
+    {
+        msg[i] = i;
+    }
+    BOOST_CHECK( multiverse::crypto::siphash(k0,k1,msg,0) == 0x726fdb47dd0e0e31ULL );
+    BOOST_CHECK( multiverse::crypto::siphash(k0,k1,msg,1) == 0x74f839c593dc67fdULL );
+    BOOST_CHECK( multiverse::crypto::siphash(k0,k1,msg,8) == 0x93f5f5799a932462ULL );
+    BOOST_CHECK( multiverse::crypto::siphash(k0,k1,msg,32) == 0x7127512f72f27cceULL );
+
+    // the short id key changes with the block and the salt
+    uint64 nKey0,nKey1,nKey0b,nKey1b;
+    CCompactBlock::GetShortTxIdKey(uint256(uint64(1)),1,nKey0,nKey1);
+    CCompactBlock::GetShortTxIdKey(uint256(uint64(2)),1,nKey0b,nKey1b);
+    BOOST_CHECK( nKey0 != nKey0b && nKey1 != nKey1b );
+    CCompactBlock::GetShortTxIdKey(uint256(uint64(1)),2,nKey0b,nKey1b);
+    BOOST_CHECK( nKey0 != nKey0b && nKey1 != nKey1b );
+}
+
+BOOST_AUTO_TEST_CASE( reconstruct )
+{
+    CBlock block = MakeBlock(500);
+
+    CCompactBlock compact;
+    compact.Build(block,0x123456789ULL);
+    BOOST_CHECK( compact.GetHash() == block.GetHash() );
+    BOOST_CHECK( compact.GetTxCount() == block.vtx.size() && compact.vPrefilled.empty() );
+
+    walleve::CWalleveBufStream ssBlock,ssCompact;
+    ssBlock << block;
+    ssCompact << compact;
+    BOOST_TEST_MESSAGE( "block " << ssBlock.GetSize() << " bytes, compact " << ssCompact.GetSize() << " bytes" );
+    BOOST_CHECK( ssCompact.GetSize() * 10 < ssBlock.GetSize() );
+
+    CCompactBlock compactRecv;
+    ssCompact >> compactRecv;
+    BOOST_CHECK( compactRecv.GetHash() == block.GetHash() );
+
+    // the pool has every other tx of the block, and some that are not in it
+    TxPool pool;
+    std::vector<uint256> vTxPool;
+    for (int i = 0;i < block.vtx.size();i += 2)
+    {
+        pool[block.vtx[i].GetHash()] = block.vtx[i];
+    }
+    CBlock blockOther = MakeBlock(600);
+    for (int i = 500;i < 600;i++)
+    {
+        pool[blockOther.vtx[i].GetHash()] = blockOther.vtx[i];
+    }
+    for (TxPool::iterator it = pool.begin();it != pool.end();++it)
+    {
+        vTxPool.push_back((*it).first);
+    }
+
+    CPartialBlock partial;
+    BOOST_CHECK( partial.Init(compactRecv) );
+    BOOST_CHECK( partial.FillFromPool(vTxPool,boost::bind(GetPoolTx,&pool,_1,_2)) == 250 );
+    BOOST_CHECK( !partial.IsComplete() );
+
+    std::vector<uint32> vIndex;
+    partial.GetMissing(vIndex);
+    BOOST_CHECK( vIndex.size() == 250 && vIndex[0] == 1 && vIndex[249] == 499 );
+
+    std::vector<CTransaction> vtxMissing;
+    for (const uint32 nIndex : vIndex)
+    {
+        vtxMissing.push_back(block.vtx[nIndex]);
+    }
+
+    // a wrong tx only shows at the merkle root
+    CPartialBlock partialBad = partial;
+    std::vector<CTransaction> vtxBad = vtxMissing;
+    vtxBad[100].nAmount++;
+    BOOST_CHECK( partialBad.FillMissing(vtxBad) );
+    CBlock blockBad;
+    BOOST_CHECK( !partialBad.GetBlock(blockBad) );
+
+    vtxMissing.pop_back();
+    BOOST_CHECK( !partial.FillMissing(vtxMissing) );
+    vtxMissing.push_back(block.vtx[499]);
+    BOOST_CHECK( partial.FillMissing(vtxMissing) && partial.IsComplete() );
+
+    CBlock blockRecv;
+    BOOST_CHECK( partial.GetBlock(blockRecv) );
+    BOOST_CHECK( blockRecv.GetHash() == block.GetHash() && blockRecv.vtx.size() == block.vtx.size() );
+    for (int i = 0;i < block.vtx.size();i++)
+    {
+        BOOST_CHECK( blockRecv.vtx[i].GetHash() == block.vtx[i].GetHash() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( prefilled )
+{
+    CBlock block = MakeBlock(10);
+    CCompactBlock compact;
+    compact.Build(block,1);
+
+    // prefilled txs take their slots, short ids fill the rest in order
+    CCompactBlock compactPrefilled = compact;
+    compactPrefilled.vPrefilled.push_back(CCompactPrefilledTx(3,block.vtx[3]));
+    compactPrefilled.vchShortTxId.erase(compactPrefilled.vchShortTxId.begin() + 3 * CCompactBlock::SHORTTXID_SIZE,
+                                        compactPrefilled.vchShortTxId.begin() + 4 * CCompactBlock::SHORTTXID_SIZE);
+    TxPool pool;
+    std::vector<uint256> vTxPool;
+    for (const CTransaction& tx : block.vtx)
+    {
+        pool[tx.GetHash()] = tx;
+        vTxPool.push_back(tx.GetHash());
+    }
+    CPartialBlock partial;
+    BOOST_CHECK( partial.Init(compactPrefilled) );
+    BOOST_CHECK( partial.FillFromPool(vTxPool,boost::bind(GetPoolTx,&pool,_1,_2)) == 9 );
+    CBlock blockRecv;
+    BOOST_CHECK( partial.IsComplete() && partial.GetBlock(blockRecv) );
+
+    // malformed compact blocks are refused
+    CCompactBlock compactBad = compact;
+    compactBad.header.vtx.push_back(block.vtx[0]);
+    BOOST_CHECK( !partial.Init(compactBad) );
+
+    compactBad = compact;
+    compactBad.vchShortTxId.pop_back();
+    BOOST_CHECK( !partial.Init(compactBad) );
+
+    compactBad = compact;
+    compactBad.vPrefilled.push_back(CCompactPrefilledTx(10,block.vtx[0]));
+    compactBad.vchShortTxId.resize(9 * CCompactBlock::SHORTTXID_SIZE);
+    BOOST_CHECK( !partial.Init(compactBad) );
+
+    compactBad = compactPrefilled;
+    compactBad.vPrefilled.push_back(CCompactPrefilledTx(3,block.vtx[3]));
+    compactBad.vchShortTxId.resize(8 * CCompactBlock::SHORTTXID_SIZE);
+    BOOST_CHECK( !partial.Init(compactBad) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "crypto.h"
+#include "curve25519/curve25519.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -62,4 +63,36 @@ BOOST_AUTO_TEST_CASE(multisign)
               << " time per key count: " << verifyTime / keyCount << "us." << std::endl;
 }
 
+BOOST_AUTO_TEST_CASE(multiscalarmult)
+{
+    const int vCount[] = {1, 64, 1024, 8192};
+    for (int count : vCount)
+    {
+        std::vector<CEdwards25519> vPoint(count);
+        std::vector<CSC25519> vScalar(count);
+        for (int i = 0; i < count; i++)
+        {
+            uint256 r, s;
+            CryptoGetRand256(r);
+            CryptoGetRand256(s);
+            vPoint[i].Generate(CSC25519(r.begin()));
+            vScalar[i] = CSC25519(s.begin());
+        }
+
+        boost::posix_time::ptime t0 = boost::posix_time::microsec_clock::universal_time();
+        CEdwards25519 sum;
+        for (int i = 0; i < count; i++)
+        {
+            sum += vPoint[i].ScalarMult(vScalar[i]);
+        }
+        boost::posix_time::ptime t1 = boost::posix_time::microsec_clock::universal_time();
+        CEdwards25519 msm = CEdwards25519::MultiScalarMult(vPoint, vScalar);
+        boost::posix_time::ptime t2 = boost::posix_time::microsec_clock::universal_time();
+
+        BOOST_CHECK(msm == sum);
+        std::cout << "scalar mult count : " << count << "; single time : " << (t1 - t0).ticks() / count << "us."
+                  << " multi time : " << (t2 - t1).ticks() / count << "us." << std::endl;
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
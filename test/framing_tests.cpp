@@ -0,0 +1,110 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crc32c.h"
+#include "mvproto.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "test_fnfn.h"
+
+using namespace multiverse::crypto;
+using namespace multiverse::network;
+
+BOOST_FIXTURE_TEST_SUITE(framing_tests, BasicUtfSetup)
+
+BOOST_AUTO_TEST_CASE(crc32c_vector)
+{
+    const unsigned char check[] = "123456789";
+    BOOST_CHECK(crc32c(0, check, 9) == 0xE3069283);
+    BOOST_CHECK(crc32c(0, check, 0) == 0);
+
+    // rfc 3720 B.4
+    std::vector<unsigned char> vZero(32, 0x00), vOne(32, 0xFF), vInc(32);
+    for (int i = 0; i < 32; i++)
+    {
+        vInc[i] = i;
+    }
+    BOOST_CHECK(crc32c(0, vZero.data(), 32) == 0x8A9136AA);
+    BOOST_CHECK(crc32c(0, vOne.data(), 32) == 0x62A8AB43);
+    BOOST_CHECK(crc32c(0, vInc.data(), 32) == 0x46DD794E);
+}
+
+BOOST_AUTO_TEST_CASE(crc32c_incremental)
+{
+    std::vector<unsigned char> vData(MESSAGE_PAYLOAD_CHUNK_SIZE * 3 + 1234);
+    for (size_t i = 0; i < vData.size(); i++)
+    {
+        vData[i] = (unsigned char)(i * 131 + (i >> 7));
+    }
+    unsigned int nWhole = crc32c(0, vData.data(), vData.size());
+
+    // every split point, including unaligned ones, gives the same checksum
+    for (size_t nSplit : {size_t(0), size_t(1), size_t(7), size_t(13), size_t(MESSAGE_PAYLOAD_CHUNK_SIZE),
+                          size_t(MESSAGE_PAYLOAD_CHUNK_SIZE * 2 + 5), vData.size()})
+    {
+        unsigned int crc = crc32c(0, vData.data(), nSplit);
+        crc = crc32c(crc, vData.data() + nSplit, vData.size() - nSplit);
+        BOOST_CHECK(crc == nWhole);
+    }
+
+    unsigned int crc = 0;
+    for (size_t nPos = 0; nPos < vData.size(); nPos += MESSAGE_PAYLOAD_CHUNK_SIZE)
+    {
+        crc = crc32c(crc, vData.data() + nPos, std::min(vData.size() - nPos, (size_t)MESSAGE_PAYLOAD_CHUNK_SIZE));
+    }
+    BOOST_CHECK(crc == nWhole);
+
+    vData[vData.size() / 2] ^= 1;
+    BOOST_CHECK(crc32c(0, vData.data(), vData.size()) != nWhole);
+}
+
+static double FrameThroughput(walleve::CWalleveBufStream& ssPayload, bool fFast, int nCount)
+{
+    boost::posix_time::ptime t0 = boost::posix_time::microsec_clock::universal_time();
+    for (int i = 0; i < nCount; i++)
+    {
+        CMvPeerMessageHeader hdr;
+        hdr.nMagic = 0x4d565345;
+        hdr.nType = CMvPeerMessageHeader::GetMessageType(MVPROTO_CHN_DATA, MVPROTO_CMD_BLOCK);
+        hdr.nPayloadSize = ssPayload.GetSize();
+        hdr.nPayloadChecksum = CMvPeerMessageHeader::GetPayloadChecksum(ssPayload.GetData(), ssPayload.GetSize(), fFast);
+        hdr.nHeaderChecksum = hdr.GetHeaderChecksum();
+        BOOST_CHECK(hdr.Verify());
+
+        walleve::CWalleveBufStream ssSend;
+        ssSend << hdr;
+        ssSend.Write(ssPayload.GetData(), ssPayload.GetSize());
+
+        CMvPeerMessageHeader hdrRecv;
+        ssSend >> hdrRecv;
+        BOOST_CHECK(hdrRecv.Verify());
+        BOOST_CHECK(hdrRecv.nPayloadChecksum
+                    == CMvPeerMessageHeader::GetPayloadChecksum(ssSend.GetData(), ssSend.GetSize(), fFast));
+    }
+    boost::posix_time::ptime t1 = boost::posix_time::microsec_clock::universal_time();
+    double dSecond = (t1 - t0).total_microseconds() / 1000000.0;
+    return (double)ssPayload.GetSize() * nCount / (1024 * 1024) / (dSecond > 0 ? dSecond : 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(block_frame_throughput)
+{
+    // a full size block message, framed and verified on both ends
+    std::vector<unsigned char> vBlock(MESSAGE_PAYLOAD_MAX_SIZE);
+    for (size_t i = 0; i < vBlock.size(); i++)
+    {
+        vBlock[i] = (unsigned char)(i * 2654435761u >> 13);
+    }
+    walleve::CWalleveBufStream ssPayload;
+    ssPayload.Write((const char*)vBlock.data(), vBlock.size());
+
+    const int nCount = 16;
+    double dBlake2b = FrameThroughput(ssPayload, false, nCount);
+    double dCrc32c = FrameThroughput(ssPayload, true, nCount);
+    std::cout << "block frame " << vBlock.size() << " bytes x " << nCount
+              << " : blake2b " << dBlake2b << " MB/s; crc32c " << dCrc32c << " MB/s." << std::endl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "block.h"
+#include "merkle.h"
+#include "walleve/walleve.h"
+
+#include <algorithm>
+#include <set>
+
+BOOST_FIXTURE_TEST_SUITE(merkle_tests, BasicUtfSetup)
+
+BOOST_AUTO_TEST_CASE( merkle )
+{
+    CBlock block;
+    std::vector<uint256> vMerkleTree;
+    BOOST_CHECK( block.CalcMerkleTreeRoot() == block.BuildMerkleTree(vMerkleTree) );
+
+    // same root as the full tree for every shape of the last levels
+    for (int n = 1;n <= 300;n++)
+    {
+        CTransaction tx;
+        tx.nTimeStamp = n;
+        block.vtx.push_back(tx);
+        BOOST_CHECK( block.CalcMerkleTreeRoot() == block.BuildMerkleTree(vMerkleTree) );
+    }
+
+    // the root can be read between appends
+    CMerkleBuilder builder;
+    for (int i = 0;i < block.vtx.size();i++)
+    {
+        builder.Append(block.vtx[i].GetHash());
+        if (i == 99)
+        {
+            CBlock blockPart;
+            blockPart.vtx.assign(block.vtx.begin(),block.vtx.begin() + 100);
+            BOOST_CHECK( builder.GetRoot() == blockPart.BuildMerkleTree(vMerkleTree) );
+        }
+    }
+    BOOST_CHECK( builder.GetCount() == block.vtx.size() && builder.GetRoot() == block.CalcMerkleTreeRoot() );
+
+    builder.Clear();
+    BOOST_CHECK( builder.GetCount() == 0 && builder.GetRoot() == uint256(uint64(0)) );
+}
+
+BOOST_AUTO_TEST_CASE( seal )
+{
+    CBlock block;
+    block.nTimeStamp = 1000;
+    for (int n = 1;n <= 10;n++)
+    {
+        CTransaction tx;
+        tx.nTimeStamp = n;
+        tx.nAmount = n;
+        block.vtx.push_back(tx);
+    }
+    block.hashMerkle = block.CalcMerkleTreeRoot();
+    uint256 hash = block.GetHash();
+    uint256 txid = block.vtx[3].GetHash();
+
+    // sealed hashes are cached, a change unseals and the hash is computed again
+    block.Seal();
+    BOOST_CHECK( block.IsSealed() && block.vtx[3].IsSealed() && block.txMint.IsSealed() );
+    BOOST_CHECK( block.GetHash() == hash && block.vtx[3].GetHash() == txid );
+    block.nTimeStamp++;
+    block.vtx[3].nAmount++;
+    block.Unseal();
+    BOOST_CHECK( !block.IsSealed() && !block.vtx[3].IsSealed() && !block.txMint.IsSealed() );
+    BOOST_CHECK( block.GetHash() != hash && block.vtx[3].GetHash() != txid );
+    block.nTimeStamp--;
+    block.vtx[3].nAmount--;
+    BOOST_CHECK( block.GetHash() == hash && block.vtx[3].GetHash() == txid );
+
+    // a copy carries the seal of the same fields, its mutators unseal only the copy
+    block.Seal();
+    CTransaction txCopy = block.vtx[3];
+    BOOST_CHECK( txCopy.IsSealed() && txCopy.GetHash() == txid );
+    BOOST_CHECK( txCopy.SetLockUntil(100) && !txCopy.IsSealed() && txCopy.GetHash() != txid );
+    CTransaction txLocked = block.vtx[3];
+    txLocked.Unseal();
+    txLocked.nLockUntil = 100;
+    BOOST_CHECK( txCopy.GetHash() == txLocked.GetHash() );
+    BOOST_CHECK( block.vtx[3].IsSealed() && block.vtx[3].GetHash() == txid );
+    txCopy.SetNull();
+    BOOST_CHECK( !txCopy.IsSealed() && txCopy.GetHash() == CTransaction().GetHash() );
+
+    // deserializing into a sealed object drops the cached hashes
+    CBlock blockOther;
+    blockOther.nTimeStamp = 2000;
+    walleve::CWalleveBufStream ss;
+    ss << blockOther;
+    ss >> block;
+    BOOST_CHECK( !block.IsSealed() && !block.txMint.IsSealed() );
+    BOOST_CHECK( block.GetHash() == blockOther.GetHash() && block.GetHash() != hash );
+
+    CTransaction tx;
+    tx.nTimeStamp = 5;
+    tx.Seal();
+    CTransaction txOther;
+    txOther.nTimeStamp = 6;
+    ss << txOther;
+    ss >> tx;
+    BOOST_CHECK( !tx.IsSealed() && tx.GetHash() == txOther.GetHash() );
+}
+
+BOOST_AUTO_TEST_CASE( benchmark )
+{
+    // merkle root plus duplicate check of ValidateBlock, the full tree and set it replaced
+    const int vCount[] = {1000, 5000, 20000, 50000};
+    for (int nCount : vCount)
+    {
+        CBlock block;
+        for (int n = 0;n < nCount;n++)
+        {
+            CTransaction tx;
+            tx.nTimeStamp = 1500000000;
+            tx.nAmount = n;
+            block.vtx.push_back(tx);
+        }
+        block.Seal();
+
+        walleve::CTicks tTree;
+        std::vector<uint256> vMerkleTree;
+        uint256 hashTree = block.BuildMerkleTree(vMerkleTree);
+        std::set<uint256> setTx;
+        for (const CTransaction& tx : block.vtx)
+        {
+            setTx.insert(tx.GetHash());
+        }
+        int64 nTree = tTree.Elapse();
+
+        walleve::CTicks tBuilder;
+        std::vector<uint256> vTxid;
+        vTxid.reserve(block.vtx.size());
+        CMerkleBuilder builder;
+        for (const CTransaction& tx : block.vtx)
+        {
+            vTxid.push_back(tx.GetHash());
+            builder.Append(vTxid.back());
+        }
+        uint256 hashBuilder = builder.GetRoot();
+        std::sort(vTxid.begin(),vTxid.end());
+        bool fDuplicated = (std::adjacent_find(vTxid.begin(),vTxid.end()) != vTxid.end());
+        int64 nBuilder = tBuilder.Elapse();
+
+        BOOST_CHECK( hashBuilder == hashTree && !fDuplicated && setTx.size() == nCount );
+        std::cout << "merkle root and duplicate check : " << nCount << " txs; tree and set : " << nTree
+                  << "us. builder and sorted vector : " << nBuilder << "us." << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
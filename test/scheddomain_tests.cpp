@@ -0,0 +1,142 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "test_fnfn.h"
+#include "scheddomain.h"
+
+BOOST_FIXTURE_TEST_SUITE(scheddomain_tests, BasicUtfSetup)
+
+using namespace multiverse;
+
+struct CForkState
+{
+    CForkState() : nRunning(0), fOverlap(false), fDisorder(false), nDone(0) {}
+    std::atomic<int> nRunning;
+    bool fOverlap;
+    bool fDisorder;
+    std::vector<int> vLastSeq;
+    int nDone;
+};
+
+typedef CSchedDomain<CForkState> CForkDomain;
+
+static void RecvWork(int nPeer,int nSeq,int nSleepUs,CForkState& state)
+{
+    if (state.nRunning.fetch_add(1) != 0)
+    {
+        state.fOverlap = true;
+    }
+    if (state.vLastSeq[nPeer] >= nSeq)
+    {
+        state.fDisorder = true;
+    }
+    state.vLastSeq[nPeer] = nSeq;
+    if (nSleepUs > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(nSleepUs));
+    }
+    state.nDone++;
+    state.nRunning.fetch_sub(1);
+}
+
+// one event thread of the channel, relaying a virtual peer's inv/block/tx stream for every fork
+static void PeerThread(std::vector<CForkDomain>* pDomain,int nPeer,int nRound)
+{
+    for (int nSeq = 0;nSeq < nRound;nSeq++)
+    {
+        for (int i = 0;i < pDomain->size();i++)
+        {
+            int nFork = (i + nPeer * 7) % pDomain->size();
+            (*pDomain)[nFork].Post(boost::bind(RecvWork,nPeer,nSeq,(nSeq % 16 == 0 ? 50 : 0),_1));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_forks )
+{
+    const int nFork = 50;
+    const int nPeer = 8;
+    const int nRound = 400;
+
+    std::vector<CForkDomain> vDomain(nFork);
+    for (int i = 0;i < nFork;i++)
+    {
+        vDomain[i].GetState().vLastSeq.assign(nPeer,-1);
+    }
+
+    boost::thread_group group;
+    for (int i = 0;i < nPeer;i++)
+    {
+        group.create_thread(boost::bind(PeerThread,&vDomain,i,nRound));
+    }
+    group.join_all();
+
+    for (int i = 0;i < nFork;i++)
+    {
+        CForkState& state = vDomain[i].GetState();
+        BOOST_CHECK( vDomain[i].GetPending() == 0 );
+        BOOST_CHECK( state.nDone == nPeer * nRound );
+        BOOST_CHECK( !state.fOverlap );
+        BOOST_CHECK( !state.fDisorder );
+    }
+}
+
+static void SlowWork(boost::mutex* pMutex,std::atomic<bool>* pStarted,CForkState& state)
+{
+    // held until the other forks are done, like a large block under verification
+    *pStarted = true;
+    boost::unique_lock<boost::mutex> lock(*pMutex);
+    state.nDone++;
+}
+
+BOOST_AUTO_TEST_CASE( slow_fork )
+{
+    const int nFork = 50;
+    std::vector<CForkDomain> vDomain(nFork);
+    for (int i = 0;i < nFork;i++)
+    {
+        vDomain[i].GetState().vLastSeq.assign(2,-1);
+    }
+
+    boost::mutex mtxSlow;
+    std::atomic<bool> fStarted(false);
+    boost::unique_lock<boost::mutex> lockSlow(mtxSlow);
+    boost::thread thrSlow(boost::bind(&CForkDomain::Post,&vDomain[0],
+                                      CForkDomain::Work(boost::bind(SlowWork,&mtxSlow,&fStarted,_1))));
+    while (!fStarted)
+    {
+        std::this_thread::yield();
+    }
+
+    // fork 0 is busy: its new work is only queued, the other forks run on the posting thread
+    for (int nSeq = 0;nSeq < 100;nSeq++)
+    {
+        for (int i = 0;i < nFork;i++)
+        {
+            vDomain[i].Post(boost::bind(RecvWork,1,nSeq,0,_1));
+        }
+    }
+    BOOST_CHECK( vDomain[0].GetPending() == 100 );
+    BOOST_CHECK( vDomain[0].GetState().nDone == 0 );
+    for (int i = 1;i < nFork;i++)
+    {
+        BOOST_CHECK( vDomain[i].GetState().nDone == 100 );
+    }
+
+    lockSlow.unlock();
+    thrSlow.join();
+    BOOST_CHECK( vDomain[0].GetPending() == 0 );
+    BOOST_CHECK( vDomain[0].GetState().nDone == 101 );
+    BOOST_CHECK( !vDomain[0].GetState().fDisorder );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,272 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "schedule.h"
+
+BOOST_FIXTURE_TEST_SUITE(schedule_tests, BasicUtfSetup)
+
+using namespace multiverse;
+using namespace multiverse::network;
+
+static std::vector<uint256> MakeChain(int nCount)
+{
+    std::vector<uint256> vHash;
+    for (int i = 0;i < nCount;i++)
+    {
+        vHash.push_back(uint256(uint64(i + 1)));
+    }
+    return vHash;
+}
+
+static CBlock MakeBlock(const std::vector<uint256>& vHash,int n)
+{
+    CBlock block;
+    block.hashPrev = (n > 0 ? vHash[n - 1] : uint256(uint64(0)));
+    block.nTimeStamp = n;
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE( orphan )
+{
+    COrphan orphan;
+    for (int i = 1;i <= 100;i++)
+    {
+        orphan.AddNew(uint256(uint64(i - 1)),uint256(uint64(i)));
+    }
+    orphan.AddNew(uint256(uint64(7)),uint256(uint64(1000)));
+    BOOST_CHECK( orphan.GetSize() == 101 );
+
+    orphan.Remove(uint256(uint64(50)));
+    std::vector<uint256> vNext;
+    orphan.GetNext(uint256(uint64(49)),vNext);
+    BOOST_CHECK( vNext.empty() );
+    BOOST_CHECK( orphan.GetSize() == 100 );
+
+    std::vector<uint256> vBranch;
+    orphan.RemoveBranch(uint256(uint64(5)),vBranch);
+    BOOST_CHECK( vBranch.size() == 45 );
+    BOOST_CHECK( orphan.GetSize() == 55 );
+
+    // the reverse index must follow branch removal
+    orphan.Remove(uint256(uint64(1000)));
+    orphan.Remove(uint256(uint64(3)));
+    BOOST_CHECK( orphan.GetSize() == 54 );
+    vNext.clear();
+    orphan.GetNext(uint256(uint64(50)),vNext);
+    BOOST_CHECK( vNext.size() == 1 && vNext[0] == uint256(uint64(51)) );
+}
+
+BOOST_AUTO_TEST_CASE( striped_window )
+{
+    const int nBlock = 96;
+    std::vector<uint256> vHash = MakeChain(nBlock);
+    CSchedule sched;
+    for (uint64 nPeer = 1;nPeer <= 3;nPeer++)
+    {
+        for (const uint256& hash : vHash)
+        {
+            sched.AddNewInv(CInv(CInv::MSG_BLOCK,hash),nPeer);
+        }
+    }
+
+    // every peer gets its own range, and tops up its window while earlier blocks are in flight
+    std::map<uint256,uint64> mapAssigned;
+    for (int nRound = 0;nRound < 2;nRound++)
+    {
+        for (uint64 nPeer = 1;nPeer <= 3;nPeer++)
+        {
+            std::vector<CInv> vInv;
+            bool fMissingPrev,fEmpty;
+            BOOST_CHECK( sched.ScheduleBlockInv(nPeer,vInv,4,fMissingPrev,fEmpty) );
+            BOOST_CHECK( vInv.size() == 4 && !fMissingPrev && !fEmpty );
+            for (const CInv& inv : vInv)
+            {
+                BOOST_CHECK( mapAssigned.insert(std::make_pair(inv.nHash,nPeer)).second );
+            }
+        }
+    }
+    BOOST_CHECK( mapAssigned.size() == 24 );
+
+    // the initial window is full now
+    std::vector<CInv> vInv;
+    bool fMissingPrev,fEmpty;
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vInv,4,fMissingPrev,fEmpty) && vInv.empty() );
+
+    // out of order arrival is buffered until the gap is filled
+    std::set<uint64> setSchedPeer;
+    int n = 4;
+    BOOST_CHECK( sched.ReceiveBlock(mapAssigned[vHash[n]],vHash[n],MakeBlock(vHash,n),setSchedPeer) );
+    sched.AddOrphanBlockPrev(vHash[n],vHash[n - 1]);
+    BOOST_CHECK( sched.GetOrphanBlockCount() == 1 );
+    std::vector<uint256> vNext;
+    sched.GetNextBlock(vHash[n - 1],vNext);
+    BOOST_CHECK( vNext.size() == 1 && vNext[0] == vHash[n] );
+
+    // a delivered block opens the window again and grows it
+    uint64 nPeer = mapAssigned[vHash[n]];
+    vInv.clear();
+    BOOST_CHECK( sched.ScheduleBlockInv(nPeer,vInv,16,fMissingPrev,fEmpty) );
+    BOOST_CHECK( vInv.size() == 2 );
+
+    // unassigned or foreign blocks are still refused
+    BOOST_CHECK( !sched.ReceiveBlock(nPeer,vHash[90],MakeBlock(vHash,90),setSchedPeer) );
+    BOOST_CHECK( mapAssigned[vHash[0]] != 3 );
+    BOOST_CHECK( !sched.ReceiveBlock(3,vHash[0],MakeBlock(vHash,0),setSchedPeer) );
+}
+
+BOOST_AUTO_TEST_CASE( stalled_peer )
+{
+    std::vector<uint256> vHash = MakeChain(16);
+    CSchedule sched;
+    for (uint64 nPeer = 1;nPeer <= 2;nPeer++)
+    {
+        for (const uint256& hash : vHash)
+        {
+            sched.AddNewInv(CInv(CInv::MSG_BLOCK,hash),nPeer);
+        }
+    }
+
+    std::vector<CInv> vInv1;
+    bool fMissingPrev,fEmpty;
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vInv1,8,fMissingPrev,fEmpty) && vInv1.size() == 8 );
+
+    std::set<uint64> setSchedPeer;
+
+    // not stalled yet
+    std::set<uint64> setReassign;
+    sched.ReassignStalledBlock(walleve::GetTimeMillis(),20000,setReassign);
+    BOOST_CHECK( setReassign.empty() );
+
+    // peer 1 has delivered nothing for too long, its blocks go to peer 2
+    sched.ReassignStalledBlock(walleve::GetTimeMillis() + 30000,20000,setReassign);
+    BOOST_CHECK( setReassign.size() == 1 && setReassign.count(2) );
+
+    std::vector<CInv> vRetry;
+    BOOST_CHECK( sched.ScheduleBlockInv(2,vRetry,16,fMissingPrev,fEmpty) );
+    BOOST_CHECK( vRetry == vInv1 );
+
+    // peer 1 never gets its own stalled blocks back, and its window has shrunk
+    std::vector<CInv> vAgain;
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vAgain,16,fMissingPrev,fEmpty) );
+    BOOST_CHECK( vAgain.size() == CInvPeer::INIT_BLOCK_WINDOW / 2 );
+    for (const CInv& inv : vAgain)
+    {
+        BOOST_CHECK( std::find(vInv1.begin(),vInv1.end(),inv) == vInv1.end() );
+    }
+
+    // the re-requested peer answers first, the late mark is dropped with it,
+    // the stalled copy finds the block already received
+    uint64 nSender = 0;
+    BOOST_CHECK( sched.ReceiveBlock(2,vInv1[0].nHash,MakeBlock(vHash,0),setSchedPeer) );
+    BOOST_CHECK( !sched.ReceiveBlock(1,vInv1[0].nHash,MakeBlock(vHash,0),setSchedPeer) );
+    BOOST_CHECK( !sched.ReceiveLate(1,vInv1[0]) );
+    BOOST_CHECK( sched.GetBlock(vInv1[0].nHash,nSender) != NULL && nSender == 2 );
+
+    // the stalled peer answers first, the re-request is dropped instead
+    BOOST_CHECK( sched.ReceiveBlock(1,vInv1[1].nHash,MakeBlock(vHash,1),setSchedPeer) );
+    BOOST_CHECK( sched.GetBlock(vInv1[1].nHash,nSender) != NULL && nSender == 1 );
+    BOOST_CHECK( !sched.ReceiveBlock(2,vInv1[1].nHash,MakeBlock(vHash,1),setSchedPeer) );
+    BOOST_CHECK( !sched.ReceiveLate(2,vInv1[1]) );
+
+    // removed invs take their late marks along
+    BOOST_CHECK( sched.ReceiveLate(1,vInv1[2]) );
+    std::set<uint64> setKnownPeer;
+    sched.RemoveInv(vInv1[3],setKnownPeer);
+    BOOST_CHECK( setKnownPeer.size() == 2 && !sched.ReceiveLate(1,vInv1[3]) );
+}
+
+BOOST_AUTO_TEST_CASE( late_peer )
+{
+    std::vector<uint256> vHash = MakeChain(4);
+    CSchedule sched;
+    for (uint64 nPeer = 1;nPeer <= 2;nPeer++)
+    {
+        for (const uint256& hash : vHash)
+        {
+            sched.AddNewInv(CInv(CInv::MSG_BLOCK,hash),nPeer);
+        }
+    }
+
+    std::vector<CInv> vInv1,vInv2;
+    bool fMissingPrev,fEmpty;
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vInv1,4,fMissingPrev,fEmpty) && vInv1.size() == 4 );
+    std::set<uint64> setReassign;
+    sched.ReassignStalledBlock(walleve::GetTimeMillis() + 30000,20000,setReassign);
+    BOOST_CHECK( sched.ScheduleBlockInv(2,vInv2,4,fMissingPrev,fEmpty) && vInv2 == vInv1 );
+
+    // while another peer knows the blocks, the stalled peer is not asked again
+    std::vector<CInv> vAgain;
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vAgain,4,fMissingPrev,fEmpty) && vAgain.empty() );
+
+    // the other peer is gone, the stalled one is the last to ask
+    std::set<uint64> setSchedPeer;
+    sched.RemovePeer(2,setSchedPeer);
+    BOOST_CHECK( setSchedPeer.count(1) );
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vAgain,4,fMissingPrev,fEmpty) );
+    BOOST_CHECK( vAgain.size() == CInvPeer::INIT_BLOCK_WINDOW / 2 && vAgain[0] == vInv1[0] );
+    BOOST_CHECK( !sched.ReceiveLate(1,vAgain[0]) );
+    BOOST_CHECK( sched.ReceiveBlock(1,vAgain[0].nHash,MakeBlock(vHash,0),setSchedPeer) );
+}
+
+BOOST_AUTO_TEST_CASE( compact_block )
+{
+    std::vector<uint256> vHash = MakeChain(16);
+    CSchedule sched;
+    for (const uint256& hash : vHash)
+    {
+        sched.AddNewInv(CInv(CInv::MSG_BLOCK,hash),1);
+    }
+    std::vector<CInv> vInv;
+    bool fMissingPrev,fEmpty;
+    BOOST_CHECK( sched.ScheduleBlockInv(1,vInv,4,fMissingPrev,fEmpty) && vInv.size() == 4 );
+
+    // the requested peer answers, a pushing peer cannot take a block already in flight
+    BOOST_CHECK( sched.AssignCompactBlock(1,vInv[0].nHash,false) );
+    BOOST_CHECK( !sched.AssignCompactBlock(2,vInv[0].nHash,true) );
+    uint256 hashNew(uint64(100));
+    BOOST_CHECK( !sched.AssignCompactBlock(2,hashNew,false) );
+    BOOST_CHECK( sched.AssignCompactBlock(2,hashNew,true) );
+    BOOST_CHECK( !sched.AssignCompactBlock(3,hashNew,true) );
+
+    // a peer holds a few partial blocks at most
+    for (int i = 0;i < CSchedule::MAX_PEER_PARTIAL_BLOCK_COUNT + 1;i++)
+    {
+        CBlock block = MakeBlock(vHash,i);
+        CCompactBlock compact;
+        compact.Build(block,i);
+        CPartialBlock partial;
+        BOOST_CHECK( partial.Init(compact) );
+        BOOST_CHECK( sched.AddPartialBlock(3,partial) == (i < CSchedule::MAX_PEER_PARTIAL_BLOCK_COUNT) );
+    }
+    BOOST_CHECK( sched.GetPartialBlock(3,MakeBlock(vHash,0).GetHash()) != NULL );
+    BOOST_CHECK( sched.GetPartialBlock(1,MakeBlock(vHash,0).GetHash()) == NULL );
+
+    // they go with the peer
+    std::set<uint64> setSchedPeer;
+    sched.RemovePeer(3,setSchedPeer);
+    BOOST_CHECK( sched.GetPartialBlock(3,MakeBlock(vHash,0).GetHash()) == NULL );
+}
+
+BOOST_AUTO_TEST_CASE( inv_continue )
+{
+    CSchedule sched;
+    std::vector<uint256> vHash = MakeChain(1000);
+    for (int i = 0;i < 900;i++)
+    {
+        sched.AddNewInv(CInv(CInv::MSG_BLOCK,vHash[i]),1);
+    }
+
+    uint256 hash;
+    BOOST_CHECK( !sched.GetBlockInvContinue(1,128,hash) );
+    sched.SetBlockInvContinue(1,vHash[899]);
+    // no room for another batch
+    BOOST_CHECK( !sched.GetBlockInvContinue(1,128,hash) );
+    BOOST_CHECK( sched.GetBlockInvContinue(1,100,hash) && hash == vHash[899] );
+    BOOST_CHECK( !sched.GetBlockInvContinue(1,100,hash) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,64 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "template/templatecache.h"
+#include "template/delegate.h"
+#include "key.h"
+
+BOOST_FIXTURE_TEST_SUITE(templatecache_tests, BasicUtfSetup)
+
+using namespace multiverse;
+
+static CTemplatePtr MakeDelegateTemplate()
+{
+    crypto::CKey keyDelegate, keyOwner;
+    keyDelegate.Renew();
+    keyOwner.Renew();
+    return CTemplate::CreateTemplatePtr(new CTemplateDelegate(keyDelegate.GetPubKey(), CDestination(keyOwner.GetPubKey())));
+}
+
+BOOST_AUTO_TEST_CASE( templatecache )
+{
+    CTemplateCache cache(2);
+    CTemplateCacheStat stat;
+
+    CTemplatePtr ptr = MakeDelegateTemplate();
+    BOOST_CHECK( ptr != NULL );
+    std::vector<uint8> vchSig = ptr->GetTemplateData();
+    vchSig.resize(vchSig.size() + 64, 0x5a);
+
+    // parsed on first use, then served from the cache
+    CTemplatePtr ptrMiss = cache.GetTemplate(ptr->GetTemplateId(), vchSig);
+    BOOST_CHECK( ptrMiss != NULL && ptrMiss->GetTemplateId() == ptr->GetTemplateId() );
+    CTemplatePtr ptrHit = cache.GetTemplate(ptr->GetTemplateId(), vchSig);
+    BOOST_CHECK( ptrHit == ptrMiss );
+    cache.GetStat(stat);
+    BOOST_CHECK( stat.nCount == 1 && stat.nHit == 1 && stat.nMiss == 1 );
+
+    // a signature not led by the cached data is parsed again
+    std::vector<uint8> vchBad(vchSig);
+    vchBad[vchBad.size() - 65] ^= 0x01;
+    CTemplatePtr ptrBad = cache.GetTemplate(ptr->GetTemplateId(), vchBad);
+    BOOST_CHECK( !ptrBad || ptrBad->GetTemplateId() != ptr->GetTemplateId() );
+    cache.GetStat(stat);
+    BOOST_CHECK( stat.nHit == 1 && stat.nMiss == 2 );
+
+    // bounded
+    for (int i = 0; i < 4; i++)
+    {
+        CTemplatePtr ptrNew = MakeDelegateTemplate();
+        BOOST_CHECK( cache.GetTemplate(ptrNew->GetTemplateId(), ptrNew->GetTemplateData()) != NULL );
+    }
+    cache.GetStat(stat);
+    BOOST_CHECK( stat.nCount <= 2 && stat.nCapacity == 2 );
+
+    cache.Clear();
+    cache.GetStat(stat);
+    BOOST_CHECK( stat.nCount == 0 && stat.nHit == 0 && stat.nMiss == 0 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
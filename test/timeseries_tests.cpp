@@ -0,0 +1,269 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "timeseries.h"
+#include "block.h"
+#include "walleve/walleve.h"
+#include "crypto.h"
+#include "uint256.h"
+
+BOOST_FIXTURE_TEST_SUITE(timeseries_tests, BasicUtfSetup)
+
+using namespace multiverse::storage;
+
+static void MakeBlock(CBlockEx& block,int nTx,uint32 nTime)
+{
+    block.SetNull();
+    block.nType = CBlock::BLOCK_PRIMARY;
+    block.nTimeStamp = nTime;
+    multiverse::crypto::CryptoGetRand256(block.hashPrev);
+    block.txMint.nType = CTransaction::TX_STAKE;
+    block.txMint.nTimeStamp = nTime;
+    block.txMint.nAmount = 15000000;
+    for (int i = 0;i < nTx;i++)
+    {
+        CTransaction tx;
+        tx.nTimeStamp = nTime;
+        uint256 txidPrev;
+        multiverse::crypto::CryptoGetRand256(txidPrev);
+        tx.vInput.push_back(CTxIn(CTxOutPoint(txidPrev,0)));
+        tx.nAmount = i + 1;
+        tx.nTxFee = 100;
+        tx.vchSig.resize(64,(uint8)i);
+        block.vtx.push_back(tx);
+        block.vTxContxt.push_back(CTxContxt());
+    }
+    block.hashMerkle = block.CalcMerkleTreeRoot();
+}
+
+// per-write open/seek/close, as CTimeSeriesCached did before the file pool
+class CTimeSeriesOpenClose : public CTimeSeriesBase
+{
+public:
+    bool Write(const CBlockEx& block,CDiskPos& pos)
+    {
+        std::string pathFile;
+        if (!GetLastFilePath(pos.nFile,pathFile))
+        {
+            return false;
+        }
+        walleve::CWalleveFileStream fs(pathFile.c_str());
+        fs.SeekToEnd();
+        uint32 nMagic = 0x5E33A1EF;
+        uint32 nSize = fs.GetSerializeSize(block);
+        fs << nMagic << nSize;
+        pos.nOffset = fs.GetCurPos();
+        fs << block;
+        return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE( append )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("ts-%%%%-%%%%");
+
+    const int nBlockCount = 5000;
+    std::vector<CBlockEx> vBlock(16);
+    for (int i = 0;i < vBlock.size();i++)
+    {
+        MakeBlock(vBlock[i],i * 4,1500000000 + i);
+    }
+
+    {
+        CTimeSeriesOpenClose ts;
+        BOOST_CHECK( ts.Initialize(pathTest / "before","block") );
+        walleve::CTicks t;
+        for (int i = 0;i < nBlockCount;i++)
+        {
+            CDiskPos pos;
+            BOOST_CHECK( ts.Write(vBlock[i % vBlock.size()],pos) );
+        }
+        int64 nElapse = t.Elapse();
+        std::cout << "Open/close write : " << nBlockCount << " blocks, "
+                  << (nBlockCount * 1000000.0 / nElapse) << " blocks/sec\n";
+        ts.Deinitialize();
+    }
+
+    {
+        CTimeSeriesCached ts;
+        BOOST_CHECK( ts.Initialize(pathTest / "after","block") );
+        std::vector<CDiskPos> vPos(nBlockCount);
+        walleve::CTicks t;
+        for (int i = 0;i < nBlockCount;i++)
+        {
+            // pooled descriptor with one flush per block, as CBlockBase::AddNew commits its index
+            BOOST_CHECK( ts.Write(vBlock[i % vBlock.size()],vPos[i],false) && ts.Flush() );
+        }
+        int64 nElapse = t.Elapse();
+        std::cout << "Pooled append write : " << nBlockCount << " blocks, "
+                  << (nBlockCount * 1000000.0 / nElapse) << " blocks/sec\n";
+
+        for (int i = 0;i < nBlockCount;i += 97)
+        {
+            CBlockEx block;
+            BOOST_CHECK( ts.Read(block,vPos[i],false) );
+            BOOST_CHECK( block.GetHash() == vBlock[i % vBlock.size()].GetHash() );
+        }
+        ts.Deinitialize();
+    }
+
+    {
+        // unflushed records must be readable and survive reopen
+        CTimeSeriesCached ts;
+        BOOST_CHECK( ts.Initialize(pathTest / "reopen","block") );
+        CDiskPos pos0,pos1;
+        BOOST_CHECK( ts.Write(vBlock[3],pos0,false) );
+        BOOST_CHECK( ts.Write(vBlock[5],pos1,false) );
+        CBlockEx block;
+        BOOST_CHECK( ts.Read(block,pos1,false) && block.GetHash() == vBlock[5].GetHash() );
+        ts.Deinitialize();
+
+        BOOST_CHECK( ts.Initialize(pathTest / "reopen","block") );
+        BOOST_CHECK( ts.Read(block,pos0,false) && block.GetHash() == vBlock[3].GetHash() );
+        CDiskPos pos2;
+        BOOST_CHECK( ts.Write(vBlock[7],pos2,false) );
+        BOOST_CHECK( pos1 < pos2 );
+        BOOST_CHECK( ts.Read(block,pos2,false) && block.GetHash() == vBlock[7].GetHash() );
+        BOOST_CHECK( ts.ReadDirect(block,pos1.nFile,pos1.nOffset) && block.GetHash() == vBlock[5].GetHash() );
+
+        // a flushed record is on disk while the writer still runs, as the block index expects
+        CDiskPos pos3;
+        BOOST_CHECK( ts.Write(vBlock[9],pos3,false) && ts.Flush() );
+        CTimeSeriesCached tsReader;
+        BOOST_CHECK( tsReader.Initialize(pathTest / "reopen","block") );
+        BOOST_CHECK( tsReader.ReadDirect(block,pos3.nFile,pos3.nOffset) && block.GetHash() == vBlock[9].GetHash() );
+        tsReader.Deinitialize();
+        ts.Deinitialize();
+    }
+
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_CASE( rawread )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("ts-%%%%-%%%%");
+
+    std::vector<CBlockEx> vBlock(8);
+    for (int i = 0;i < vBlock.size();i++)
+    {
+        MakeBlock(vBlock[i],i * 3,1500000000 + i);
+        vBlock[i].vchProof.resize(i * 5,(uint8)i);
+        vBlock[i].vchSig.resize(64,(uint8)i);
+    }
+
+    CTimeSeriesCached ts;
+    BOOST_CHECK( ts.Initialize(pathTest,"block") );
+    std::vector<CDiskPos> vPos(vBlock.size());
+    for (int i = 0;i < vBlock.size();i++)
+    {
+        BOOST_CHECK( ts.Write(vBlock[i],vPos[i],false) );
+    }
+
+    for (int nPass = 0;nPass < 2;nPass++)
+    {
+        // first pass reads from the append buffer, second from the mapped file
+        for (int i = 0;i < vBlock.size();i++)
+        {
+            std::vector<unsigned char> vchRaw;
+            BOOST_CHECK( ts.ReadRaw(vPos[i],vchRaw) );
+
+            walleve::CWalleveBufStream ss;
+            ss << static_cast<const CBlock&>(vBlock[i]);
+            size_t nSize = 0;
+            BOOST_CHECK( CBlock::GetRawSize(&vchRaw[0],vchRaw.size(),nSize) );
+            BOOST_CHECK( nSize == ss.GetSize() && nSize < vchRaw.size() );
+            BOOST_CHECK( std::equal(vchRaw.begin(),vchRaw.begin() + nSize,(const unsigned char*)ss.GetData()) );
+            BOOST_CHECK( !CBlock::GetRawSize(&vchRaw[0],nSize - 1,nSize) );
+        }
+        BOOST_CHECK( ts.Flush() );
+    }
+
+    CDiskPos posBad = vPos[1];
+    posBad.nOffset += 1;
+    std::vector<unsigned char> vchRaw;
+    BOOST_CHECK( !ts.ReadRaw(posBad,vchRaw) );
+
+    ts.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+class CTimeSeriesMapProbe : public CTimeSeriesCached
+{
+public:
+    boost::shared_ptr<CTimeSeriesMappedFile> GetMapped(const CDiskPos& pos)
+    {
+        boost::unique_lock<boost::mutex> lock(mtxCache);
+        return GetMappedFile(pos.nFile,pos.nOffset);
+    }
+    std::size_t GetMappedCount()
+    {
+        boost::unique_lock<boost::mutex> lock(mtxCache);
+        return mapMappedFile.size();
+    }
+};
+
+BOOST_AUTO_TEST_CASE( mapped )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("ts-%%%%-%%%%");
+
+    std::vector<CBlockEx> vBlock(8);
+    for (int i = 0;i < vBlock.size();i++)
+    {
+        MakeBlock(vBlock[i],i * 3,1500000000 + i);
+    }
+
+    CTimeSeriesMapProbe ts;
+    BOOST_CHECK( ts.Initialize(pathTest,"block") );
+    ts.SetMappedFile(0x10000,2);
+
+    std::vector<CDiskPos> vPos;
+    CDiskPos pos;
+    BOOST_CHECK( ts.Write(vBlock[0],pos,false) && ts.Flush() );
+    vPos.push_back(pos);
+    boost::shared_ptr<CTimeSeriesMappedFile> spFirst = ts.GetMapped(pos);
+    BOOST_CHECK( spFirst != NULL && spFirst->GetCapacity() == 0x10000 );
+
+    // appends within the chunk extend the same mapping
+    BOOST_CHECK( ts.Write(vBlock[1],pos,false) && ts.Flush() );
+    vPos.push_back(pos);
+    BOOST_CHECK( ts.GetMapped(pos) == spFirst );
+    BOOST_CHECK( spFirst->GetSize() > pos.nOffset );
+
+    // appends past the chunk remap, the previous mapping stays valid for its holders
+    while (pos.nOffset < 0x10000)
+    {
+        BOOST_CHECK( ts.Write(vBlock[vPos.size() % vBlock.size()],pos,false) && ts.Flush() );
+        vPos.push_back(pos);
+    }
+    boost::shared_ptr<CTimeSeriesMappedFile> spGrown = ts.GetMapped(pos);
+    BOOST_CHECK( spGrown != NULL && spGrown != spFirst && spGrown->GetCapacity() == 0x20000 );
+    CBlockEx block;
+    BOOST_CHECK( spFirst->Read(block,vPos[1].nOffset) && block.GetHash() == vBlock[1].GetHash() );
+    for (int i = 0;i < vPos.size();i++)
+    {
+        BOOST_CHECK( ts.Read(block,vPos[i],false) && block.GetHash() == vBlock[i % vBlock.size()].GetHash() );
+    }
+
+    // at most nMaxMappedFile files stay mapped, the least recently used one is dropped
+    for (uint32 nFile = 2;nFile <= 3;nFile++)
+    {
+        std::string strFile = std::string("block_00000") + char('0' + nFile) + ".dat";
+        boost::filesystem::copy_file(pathTest / "block_000001.dat",pathTest / strFile);
+        BOOST_CHECK( ts.ReadDirect(block,nFile,vPos[2].nOffset) && block.GetHash() == vBlock[2].GetHash() );
+        BOOST_CHECK( ts.GetMappedCount() == 2 );
+    }
+    BOOST_CHECK( ts.ReadDirect(block,1,vPos[3].nOffset) && block.GetHash() == vBlock[3].GetHash() );
+    BOOST_CHECK( ts.GetMappedCount() == 2 );
+
+    ts.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "txindexdb.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(txindexdb_tests, BasicUtfSetup)
+
+using namespace multiverse::storage;
+
+static uint256 RandomTxId(uint32 nTime)
+{
+    uint256 txid;
+    multiverse::crypto::CryptoGetRand256(txid);
+    // tx time lives in the highest word of txid
+    ((uint32*)txid.begin())[7] = nTime;
+    return txid;
+}
+
+BOOST_AUTO_TEST_CASE( filter )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("txindex-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    uint256 hashFork;
+    multiverse::crypto::CryptoGetRand256(hashFork);
+    std::vector<std::pair<uint256,CTxIndex> > vTxNew;
+    for (int i = 0;i < 1000;i++)
+    {
+        vTxNew.push_back(std::make_pair(RandomTxId(1500000000 + i / 10),CTxIndex(i,1,i * 100)));
+    }
+
+    {
+        CTxIndexDB db;
+        BOOST_CHECK( db.Initialize(pathTest) );
+        BOOST_CHECK( db.LoadFork(hashFork) );
+        BOOST_CHECK( db.BuildFilter() );
+        BOOST_CHECK( db.Update(hashFork,vTxNew,std::vector<uint256>()) );
+
+        CTxIndex txIndex;
+        uint256 fork;
+        BOOST_CHECK( db.Retrieve(vTxNew[10].first,txIndex,fork) && fork == hashFork && txIndex.nBlockHeight == 10 );
+
+        // rollback removes the tx from the filter too
+        BOOST_CHECK( db.Update(hashFork,std::vector<std::pair<uint256,CTxIndex> >(),
+                               std::vector<uint256>(1,vTxNew[999].first)) );
+        BOOST_CHECK( !db.Retrieve(vTxNew[999].first,txIndex,fork) );
+        vTxNew.pop_back();
+
+        for (int i = 0;i < 1000;i++)
+        {
+            BOOST_CHECK( !db.Retrieve(RandomTxId(1500000000),txIndex,fork) );
+        }
+
+        CTxIndexFilterStat stat;
+        db.GetFilterStat(stat);
+        BOOST_CHECK( stat.fEnabled && stat.nCount == 999 && stat.nMemory > 0 );
+        BOOST_CHECK( stat.nReject + stat.nFalsePositive >= 1000 && stat.nFalsePositive < 50 );
+
+        // lookups in a single fork are rejected by the filter too, but leave the stats alone
+        uint256 hashOther;
+        multiverse::crypto::CryptoGetRand256(hashOther);
+        BOOST_CHECK( db.LoadFork(hashOther) );
+        for (int i = 0;i < 1000;i++)
+        {
+            BOOST_CHECK( !db.Retrieve(hashOther,RandomTxId(1500000000),txIndex) );
+        }
+        CTxIndexFilterStat statFork;
+        db.GetFilterStat(statFork);
+        BOOST_CHECK( statFork.nQuery == stat.nQuery && statFork.nReject == stat.nReject );
+        BOOST_CHECK( statFork.nFalsePositive == stat.nFalsePositive );
+
+        for (int i = 0;i < 100;i++)
+        {
+            BOOST_CHECK( !db.Retrieve(hashOther,vTxNew[i].first,txIndex) );
+        }
+        BOOST_CHECK( db.Retrieve(hashFork,vTxNew[0].first,txIndex) && txIndex.nBlockHeight == 0 );
+        db.GetFilterStat(stat);
+        BOOST_CHECK( stat.nFalsePositive == statFork.nFalsePositive );
+
+        db.Deinitialize();
+    }
+
+    {
+        // filter is rebuilt from the stored chunks on load
+        CTxIndexDB db;
+        BOOST_CHECK( db.Initialize(pathTest) );
+        BOOST_CHECK( db.LoadFork(hashFork) );
+        BOOST_CHECK( db.BuildFilter() );
+
+        CTxIndexFilterStat stat;
+        db.GetFilterStat(stat);
+        BOOST_CHECK( stat.fEnabled && stat.nCount == vTxNew.size() );
+
+        for (int i = 0;i < vTxNew.size();i++)
+        {
+            CTxIndex txIndex;
+            uint256 fork;
+            BOOST_CHECK( db.Retrieve(vTxNew[i].first,txIndex,fork) && txIndex.nOffset == i * 100 );
+        }
+
+        db.Deinitialize();
+    }
+
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "txpooldata.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(txpooldata_tests, BasicUtfSetup)
+
+using namespace std;
+using namespace multiverse;
+using namespace multiverse::storage;
+
+typedef vector<pair<uint256,pair<uint256,CAssembledTx> > > TxPoolVector;
+
+static CAssembledTx MakeTx(int n)
+{
+    CTransaction tx;
+    tx.nLockUntil = n;
+    tx.nAmount = n * 100;
+    tx.vchData.assign(n % 7 + 1,(unsigned char)n);
+    return CAssembledTx(tx,n);
+}
+
+BOOST_AUTO_TEST_CASE( journal )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("txpooldata-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    uint256 hashFork(1);
+    vector<uint256> vTxid(6);
+    for (int i = 0;i < vTxid.size();i++)
+    {
+        multiverse::crypto::CryptoGetRand256(vTxid[i]);
+    }
+
+    TxPoolVector vTx;
+    uint32 nGeneration;
+    {
+        CTxPoolData data;
+        BOOST_CHECK( data.Initialize(pathTest) );
+        BOOST_CHECK( data.Load(vTx) && vTx.empty() );
+        BOOST_CHECK( data.Rotate(nGeneration) && nGeneration == 1 );
+        for (int i = 0;i < 4;i++)
+        {
+            data.AddNew(hashFork,vTxid[i],MakeTx(i));
+        }
+        data.Remove(hashFork,vTxid[1]);
+        data.Flush();
+    }
+
+    // a torn record at the tail is ignored
+    FILE * fp = fopen((pathTest / "txpool" / "journal.1").c_str(),"ab");
+    BOOST_CHECK( fp != NULL );
+    fwrite("\x20\x00\x00\x00\x01\x02",1,6,fp);
+    fclose(fp);
+
+    {
+        CTxPoolData data;
+        BOOST_CHECK( data.Initialize(pathTest) );
+        BOOST_CHECK( data.Load(vTx) && vTx.size() == 3 );
+        BOOST_CHECK( vTx[0].second.first == vTxid[0] && vTx[1].second.first == vTxid[2] && vTx[2].second.first == vTxid[3] );
+        BOOST_CHECK( vTx[1].first == hashFork && vTx[1].second.second.nAmount == 200 && vTx[1].second.second.nBlockHeight == 2 );
+
+        // compaction: new journal generation plus a snapshot, journals are kept for the next one
+        BOOST_CHECK( data.Rotate(nGeneration) && nGeneration == 2 );
+        BOOST_CHECK( data.SaveSnapshot(nGeneration,vTx) );
+        BOOST_CHECK( boost::filesystem::exists(pathTest / "txpool" / "journal.1") );
+        BOOST_CHECK( !data.IsCompactNeeded() );
+
+        data.Remove(hashFork,vTxid[0]);
+        data.AddNew(hashFork,vTxid[4],MakeTx(4));
+        data.AddNew(hashFork,vTxid[5],MakeTx(5));
+        data.Flush();
+    }
+
+    {
+        CTxPoolData data;
+        BOOST_CHECK( data.Initialize(pathTest) );
+        BOOST_CHECK( data.Load(vTx) && vTx.size() == 4 );
+        BOOST_CHECK( vTx[0].second.first == vTxid[2] && vTx[3].second.first == vTxid[5] );
+        BOOST_CHECK( vTx[3].second.second.vchData == MakeTx(5).vchData );
+
+        // the second compaction drops the journals before the first snapshot, which is kept
+        BOOST_CHECK( data.Rotate(nGeneration) && nGeneration == 3 );
+        BOOST_CHECK( data.SaveSnapshot(nGeneration,vTx) );
+        BOOST_CHECK( !boost::filesystem::exists(pathTest / "txpool" / "journal.1") );
+        BOOST_CHECK( boost::filesystem::exists(pathTest / "txpool" / "journal.2") );
+        BOOST_CHECK( boost::filesystem::exists(pathTest / "txpool" / "snapshot.prev") );
+        data.Remove(hashFork,vTxid[2]);
+        data.Flush();
+    }
+
+    // a corrupt snapshot is recovered from the previous one and the journals after it
+    fp = fopen((pathTest / "txpool" / "snapshot.dat").c_str(),"r+b");
+    BOOST_CHECK( fp != NULL );
+    fseek(fp,-4,SEEK_END);
+    fwrite("\xff\xff\xff\xff",1,4,fp);
+    fclose(fp);
+
+    {
+        CTxPoolData data;
+        BOOST_CHECK( data.Initialize(pathTest) );
+        BOOST_CHECK( data.Load(vTx) && vTx.size() == 3 );
+        BOOST_CHECK( vTx[0].second.first == vTxid[3] && vTx[1].second.first == vTxid[4] && vTx[2].second.first == vTxid[5] );
+        BOOST_CHECK( data.Rotate(nGeneration) && nGeneration == 4 );
+        BOOST_CHECK( data.Remove() );
+        BOOST_CHECK( !boost::filesystem::exists(pathTest / "txpool" / "snapshot.prev") );
+        BOOST_CHECK( data.Load(vTx) && vTx.empty() );
+    }
+
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
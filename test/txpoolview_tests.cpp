@@ -0,0 +1,303 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_fnfn.h"
+#include "txpoolview.h"
+#include "key.h"
+#include "walleve/util.h"
+
+BOOST_FIXTURE_TEST_SUITE(txpoolview_tests, BasicUtfSetup)
+
+using namespace multiverse;
+
+// the view only holds pointers, the txs live here like in CForkTxPool
+class CTestPool
+{
+public:
+    CTestPool() : nSequenceNumber(0) {}
+    uint256 Add(const CTransaction& tx,int64 nValueIn)
+    {
+        uint256 txid = tx.GetHash();
+        std::map<uint256,CPooledTx>::iterator it;
+        it = mapTx.insert(std::make_pair(txid,CPooledTx(tx,-1,++nSequenceNumber,tx.sendTo,nValueIn))).first;
+        view.AddNew(txid,(*it).second);
+        return txid;
+    }
+public:
+    CTxPoolView view;
+    std::map<uint256,CPooledTx> mapTx;
+    std::size_t nSequenceNumber;
+};
+
+static CTransaction MakeTx(const std::vector<CTxOutPoint>& vPrevout,int64 nAmount,int64 nTxFee,uint32 nTime = 1000)
+{
+    CTransaction tx;
+    tx.nTimeStamp = nTime;
+    for (const CTxOutPoint& prevout : vPrevout)
+    {
+        tx.vInput.push_back(CTxIn(prevout));
+    }
+    tx.sendTo = CDestination(crypto::CPubKey(uint256(uint64(7))));
+    tx.nAmount = nAmount;
+    tx.nTxFee = nTxFee;
+    tx.vchSig.resize(64,1);
+    return tx;
+}
+
+static CTransaction MakeTx(const CTxOutPoint& prevout,int64 nAmount,int64 nTxFee,uint32 nTime = 1000)
+{
+    return MakeTx(std::vector<CTxOutPoint>(1,prevout),nAmount,nTxFee,nTime);
+}
+
+static CTxOutPoint External(int n)
+{
+    return CTxOutPoint(uint256(uint64(1000000 + n)),0);
+}
+
+BOOST_AUTO_TEST_CASE( memory_accounting )
+{
+    CTestPool pool;
+    BOOST_CHECK( pool.view.GetMemoryUsage() == 0 );
+
+    uint256 txid1 = pool.Add(MakeTx(External(1),1000,100),2000);
+    std::size_t nUsage1 = pool.view.GetMemoryUsage();
+    BOOST_CHECK( nUsage1 > 0 && nUsage1 == pool.mapTx[txid1].nMemoryUsage );
+
+    // data buffers are counted
+    CTransaction txData = MakeTx(External(2),1000,100);
+    txData.vchData.resize(4096);
+    uint256 txid2 = pool.Add(txData,2000);
+    BOOST_CHECK( pool.mapTx[txid2].nMemoryUsage >= nUsage1 + 4096 );
+
+    uint256 txid3 = pool.Add(MakeTx(CTxOutPoint(txid1,0),500,100),1000);
+    BOOST_CHECK( pool.view.GetMemoryUsage() == nUsage1 + pool.mapTx[txid2].nMemoryUsage
+                                               + pool.mapTx[txid3].nMemoryUsage );
+
+    // the total goes back to zero, with no spent records left behind
+    pool.view.Remove(txid3);
+    pool.view.Remove(txid2);
+    pool.view.Remove(txid1);
+    BOOST_CHECK( pool.view.GetMemoryUsage() == 0 );
+    BOOST_CHECK( pool.view.Count() == 0 && pool.view.mapSpent.empty() && pool.view.mapTxScore.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( evict )
+{
+    CTestPool pool;
+    uint256 txidLow = pool.Add(MakeTx(External(1),1000,100),2000);
+    uint256 txidMid = pool.Add(MakeTx(External(2),1000,200),2000);
+    uint256 txidHigh = pool.Add(MakeTx(External(3),1000,300),2000);
+    uint256 txidChild = pool.Add(MakeTx(CTxOutPoint(txidLow,0),500,150),1000);
+    std::size_t nUsageLow = pool.mapTx[txidLow].nMemoryUsage + pool.mapTx[txidChild].nMemoryUsage;
+    std::size_t nUsage = pool.view.GetMemoryUsage();
+
+    CTxPoolScore score(0,0);
+    BOOST_CHECK( pool.view.GetLowestScore(score) && score.nSequenceNumber == pool.mapTx[txidLow].nSequenceNumber );
+
+    // the lowest package goes first, with the txs spending it
+    std::vector<uint256> vEvicted;
+    pool.view.Evict(vEvicted);
+    BOOST_CHECK( vEvicted.size() == 2 && vEvicted[0] == txidLow && vEvicted[1] == txidChild );
+    BOOST_CHECK( !pool.view.Exists(txidLow) && !pool.view.Exists(txidChild) );
+    BOOST_CHECK( pool.view.GetMemoryUsage() == nUsage - nUsageLow );
+    BOOST_CHECK( !pool.view.mapSpent.count(CTxOutPoint(txidLow,0)) && !pool.view.mapSpent.count(CTxOutPoint(txidLow,1)) );
+    BOOST_CHECK( !pool.view.IsSpent(External(1)) );
+
+    vEvicted.clear();
+    pool.view.Evict(vEvicted);
+    BOOST_CHECK( vEvicted.size() == 1 && vEvicted[0] == txidMid && pool.view.Exists(txidHigh) );
+
+    vEvicted.clear();
+    pool.view.Evict(vEvicted);
+    pool.view.Evict(vEvicted);
+    BOOST_CHECK( vEvicted.size() == 1 && pool.view.Count() == 0 && pool.view.GetMemoryUsage() == 0 );
+}
+
+static std::vector<uint256> GetTxId(const std::vector<CTransaction>& vtx)
+{
+    std::vector<uint256> vTxId;
+    for (const CTransaction& tx : vtx)
+    {
+        vTxId.push_back(tx.GetHash());
+    }
+    return vTxId;
+}
+
+BOOST_AUTO_TEST_CASE( arrange_package )
+{
+    CTestPool pool;
+    uint256 txidA = pool.Add(MakeTx(External(1),1000,1000),3000);
+    uint256 txidB = pool.Add(MakeTx(External(2),1000,500),3000);
+    // a low fee parent is pulled ahead by its high fee child
+    uint256 txidParent = pool.Add(MakeTx(External(3),1000,100),3000);
+    uint256 txidChild = pool.Add(MakeTx(CTxOutPoint(txidParent,0),500,5000),1000);
+    // a low fee child stays behind once its high fee parent is arranged
+    uint256 txidHigh = pool.Add(MakeTx(External(4),1000,3000),5000);
+    uint256 txidLow = pool.Add(MakeTx(CTxOutPoint(txidHigh,1),500,10),1000);
+    // a tx from the future is left out, with what spends it
+    uint256 txidLate = pool.Add(MakeTx(External(5),1000,8000,3000),10000);
+    pool.Add(MakeTx(CTxOutPoint(txidLate,0),500,8000),1000);
+
+    BOOST_CHECK( pool.mapTx[txidParent].nSpentOutput == 1 && pool.mapTx[txidHigh].nSpentOutput == 2 );
+    BOOST_CHECK( pool.mapTx[txidChild].nPackageTx == 2 && pool.mapTx[txidChild].nPackageFee == 5100 );
+
+    std::vector<CTransaction> vtx;
+    int64 nTotalTxFee = 0;
+    pool.view.ArrangeBlockTx(vtx,nTotalTxFee,2000,1000000);
+    std::vector<uint256> vExpected = {txidHigh,txidParent,txidChild,txidA,txidB,txidLow};
+    BOOST_CHECK( GetTxId(vtx) == vExpected );
+    BOOST_CHECK( nTotalTxFee == 1000 + 500 + 100 + 5000 + 3000 + 10 );
+
+    // the size limit cuts the list, the child still brings its parent
+    std::size_t nTxSize = pool.mapTx[txidA].nSerializeSize;
+    vtx.clear();
+    pool.view.ArrangeBlockTx(vtx,nTotalTxFee,2000,nTxSize * 3);
+    vExpected = {txidHigh,txidParent,txidChild};
+    BOOST_CHECK( GetTxId(vtx) == vExpected );
+
+    // spent bits follow the spending tx
+    pool.view.Remove(txidChild);
+    BOOST_CHECK( pool.mapTx[txidParent].nSpentOutput == 0 );
+    std::vector<uint256> vInvolved;
+    pool.view.InvalidateSpent(CTxOutPoint(txidHigh,1),vInvolved);
+    BOOST_CHECK( vInvolved.size() == 1 && vInvolved[0] == txidLow && pool.mapTx[txidHigh].nSpentOutput == 0 );
+}
+
+BOOST_AUTO_TEST_CASE( package_limit )
+{
+    // a chain longer than the package limit
+    CTestPool pool;
+    const int nChain = CTxPoolView::MAX_PACKAGE_TX + 5;
+    std::vector<uint256> vChain;
+    CTxOutPoint prevout = External(1);
+    for (int i = 0;i < nChain;i++)
+    {
+        vChain.push_back(pool.Add(MakeTx(prevout,1000,100 + i),2000));
+        prevout = CTxOutPoint(vChain.back(),0);
+    }
+    BOOST_CHECK( pool.view.mapTxScore.size() == CTxPoolView::MAX_PACKAGE_TX );
+    BOOST_CHECK( pool.mapTx[vChain[CTxPoolView::MAX_PACKAGE_TX - 1]].nPackageTx == CTxPoolView::MAX_PACKAGE_TX );
+    BOOST_CHECK( pool.mapTx[vChain[CTxPoolView::MAX_PACKAGE_TX]].nPackageTx == 0 );
+
+    // block assembly still reaches the unindexed txs, in chain order
+    std::vector<CTransaction> vtx;
+    int64 nTotalTxFee = 0;
+    pool.view.ArrangeBlockTx(vtx,nTotalTxFee,2000,1000000);
+    BOOST_CHECK( GetTxId(vtx) == vChain );
+
+    // with the root gone, the next tx comes into the index
+    pool.view.Remove(vChain[0]);
+    BOOST_CHECK( pool.view.mapTxScore.size() == CTxPoolView::MAX_PACKAGE_TX );
+    BOOST_CHECK( pool.mapTx[vChain[CTxPoolView::MAX_PACKAGE_TX]].nPackageTx == CTxPoolView::MAX_PACKAGE_TX );
+    BOOST_CHECK( pool.mapTx[vChain[1]].nPackageTx == 1 && pool.mapTx[vChain[1]].nPackageFee == 101 );
+}
+
+BOOST_AUTO_TEST_CASE( arrange_failed )
+{
+    // packages too large for the block are skipped, up to MAX_ARRANGE_FAILED of them
+    for (int nLarge = CTxPoolView::MAX_ARRANGE_FAILED - 1;nLarge <= CTxPoolView::MAX_ARRANGE_FAILED;nLarge++)
+    {
+        CTestPool pool;
+        for (int i = 0;i < nLarge;i++)
+        {
+            CTransaction tx = MakeTx(External(i),1000,1000000);
+            tx.vchData.resize(2048);
+            pool.Add(tx,2000000);
+        }
+        uint256 txidSmall = pool.Add(MakeTx(External(nLarge),1000,100),2000);
+
+        std::vector<CTransaction> vtx;
+        int64 nTotalTxFee = 0;
+        pool.view.ArrangeBlockTx(vtx,nTotalTxFee,2000,1024);
+        if (nLarge < CTxPoolView::MAX_ARRANGE_FAILED)
+        {
+            BOOST_CHECK( vtx.size() == 1 && vtx[0].GetHash() == txidSmall && nTotalTxFee == 100 );
+        }
+        else
+        {
+            BOOST_CHECK( vtx.empty() && nTotalTxFee == 0 );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( arrange_benchmark )
+{
+    // 100k txs, 30% of them spend the change of a recent pooled tx
+    const int nTx = 100000;
+    CTestPool pool;
+    std::vector<uint256> vTxId;
+    uint64 nRand = 1;
+    for (int i = 0;i < nTx;i++)
+    {
+        nRand = nRand * 6364136223846793005ULL + 1442695040888963407ULL;
+        int64 nTxFee = 100 + (nRand >> 33) % 10000;
+        CTxOutPoint prevout = External(i);
+        if (i > 0 && (nRand >> 20) % 10 < 3)
+        {
+            CTxOutPoint out(vTxId[i - 1 - (nRand >> 40) % std::min(i,50)],1);
+            if (!pool.view.IsSpent(out))
+            {
+                prevout = out;
+            }
+        }
+        vTxId.push_back(pool.Add(MakeTx(prevout,1000,nTxFee),1000 + nTxFee + 500));
+    }
+
+    for (std::size_t nMaxSize : {2000000,200000,20000})
+    {
+        std::vector<CTransaction> vtx;
+        int64 nTotalTxFee = 0;
+        int64 nElapse = 0;
+        for (int n = 0;n < 5;n++)
+        {
+            vtx.clear();
+            walleve::CTicks t;
+            pool.view.ArrangeBlockTx(vtx,nTotalTxFee,2000,nMaxSize);
+            int64 nRound = t.Elapse();
+            nElapse = (n == 0 ? nRound : std::min(nElapse,nRound));
+        }
+
+        // the previous block assembly, in arrival order with no fee ranking
+        int64 nSeqTxFee = 0;
+        std::vector<CTransaction> vtxSeq;
+        walleve::CTicks t;
+        std::map<std::size_t,std::pair<uint256,CPooledTx*> > mapCandidate;
+        for (const auto& tx : pool.view.mapTx)
+        {
+            mapCandidate.insert(std::make_pair(tx.second->nSequenceNumber,tx));
+        }
+        std::size_t nSeqSize = 0;
+        for (const auto& candidate : mapCandidate)
+        {
+            if (nSeqSize + candidate.second.second->nSerializeSize > nMaxSize)
+            {
+                break;
+            }
+            vtxSeq.push_back(*static_cast<CTransaction*>(candidate.second.second));
+            nSeqSize += candidate.second.second->nSerializeSize;
+            nSeqTxFee += candidate.second.second->nTxFee;
+        }
+        int64 nSeqElapse = t.Elapse();
+
+        std::cout << "ArrangeBlockTx : " << nTx << " pooled, " << nMaxSize << " bytes, " << vtx.size() << " txs in "
+                  << nElapse / 1000.0 << " ms, fee " << nTotalTxFee << " (arrival order " << nSeqElapse / 1000.0
+                  << " ms, fee " << nSeqTxFee << ")\n";
+
+        // parents come first
+        std::set<uint256> setArranged;
+        for (const CTransaction& tx : vtx)
+        {
+            for (const CTxIn& txin : tx.vInput)
+            {
+                BOOST_CHECK( !pool.view.Exists(txin.prevout.hash) || setArranged.count(txin.prevout.hash) );
+            }
+            setArranged.insert(tx.GetHash());
+        }
+        BOOST_CHECK( nTotalTxFee > nSeqTxFee );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
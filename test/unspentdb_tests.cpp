@@ -0,0 +1,231 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+
+#include "test_fnfn.h"
+#include "unspentdb.h"
+#include "crypto.h"
+
+BOOST_FIXTURE_TEST_SUITE(unspentdb_tests, BasicUtfSetup)
+
+using namespace multiverse::storage;
+
+static uint256 RandomHash()
+{
+    uint256 hash;
+    multiverse::crypto::CryptoGetRand256(hash);
+    return hash;
+}
+
+class CCountWalker : public CForkUnspentDBWalker
+{
+public:
+    CCountWalker() : nCount(0),nAmount(0) {}
+    bool Walk(const CTxOutPoint& txout,const CTxOutput& output) override
+    {
+        nCount++;
+        nAmount += output.nAmount;
+        return true;
+    }
+public:
+    int nCount;
+    int64 nAmount;
+};
+
+BOOST_AUTO_TEST_CASE( cache )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("unspent-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CUnspentDB db;
+    BOOST_CHECK( db.Initialize(pathTest) );
+    uint256 hashFork = RandomHash();
+    BOOST_CHECK( db.AddNewFork(hashFork) );
+
+    multiverse::crypto::CPubKey pubkey(RandomHash());
+    CDestination dest(pubkey);
+
+    std::vector<CTxUnspent> vAddNew;
+    for (int i = 0;i < 1000;i++)
+    {
+        vAddNew.push_back(CTxUnspent(CTxOutPoint(RandomHash(),i & 1),CTxOutput(dest,i + 1,0,0)));
+    }
+    BOOST_CHECK( db.Update(hashFork,vAddNew,std::vector<CTxOutPoint>()) );
+
+    // first flush moves changes to lower tables, second writes them to db
+    std::size_t nCount = 0,nFork = 0;
+    BOOST_CHECK( db.Flush(nCount,nFork,true) && nCount == 0 );
+    std::vector<CTxOutPoint> vRemove;
+    vRemove.push_back(vAddNew[0]);
+    vRemove.push_back(vAddNew[1]);
+    BOOST_CHECK( db.Update(hashFork,std::vector<CTxUnspent>(),vRemove) );
+    BOOST_CHECK( db.Flush(nCount,nFork,true) && nCount == 1000 && nFork == 1 );
+
+    for (int i = 0;i < vAddNew.size();i++)
+    {
+        CTxOutput output;
+        BOOST_CHECK( db.Retrieve(hashFork,vAddNew[i],output) == (i > 1) );
+        BOOST_CHECK( i <= 1 || output.nAmount == i + 1 );
+    }
+
+    CCountWalker walker;
+    BOOST_CHECK( db.WalkThrough(hashFork,walker) );
+    BOOST_CHECK( walker.nCount == 998 && walker.nAmount == 1000 * 1001 / 2 - 3 );
+
+    nCount = 0;
+    BOOST_CHECK( db.Flush(nCount,nFork,true) && nCount == 2 );
+    CTxOutput output;
+    BOOST_CHECK( !db.Retrieve(hashFork,vAddNew[0],output) );
+    BOOST_CHECK( db.Retrieve(hashFork,vAddNew[999],output) && output.nAmount == 1000 );
+
+    db.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+static void SwapProc(CUnspentDB* pDB,const uint256& hashFork,const std::vector<CTxUnspent>* pvUnspent,int nRound,
+                     boost::atomic<bool>* pfDone)
+{
+    // every update moves the whole set to new outpoints
+    std::vector<CTxUnspent> vPrev = *pvUnspent;
+    for (int n = 0;n < nRound;n++)
+    {
+        std::vector<CTxUnspent> vNext;
+        std::vector<CTxOutPoint> vRemove;
+        for (const CTxUnspent& unspent : vPrev)
+        {
+            vNext.push_back(CTxUnspent(CTxOutPoint(RandomHash(),0),unspent.output));
+            vRemove.push_back(unspent);
+        }
+        pDB->Update(hashFork,vNext,vRemove);
+        vPrev.swap(vNext);
+    }
+    *pfDone = true;
+}
+
+BOOST_AUTO_TEST_CASE( atomic_update )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("unspent-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CUnspentDB db;
+    BOOST_CHECK( db.Initialize(pathTest) );
+    uint256 hashFork = RandomHash();
+    BOOST_CHECK( db.AddNewFork(hashFork) );
+
+    multiverse::crypto::CPubKey pubkey(RandomHash());
+    CDestination dest(pubkey);
+    std::vector<CTxUnspent> vUnspent;
+    for (int i = 0;i < 256;i++)
+    {
+        vUnspent.push_back(CTxUnspent(CTxOutPoint(RandomHash(),0),CTxOutput(dest,i + 1,0,0)));
+    }
+    BOOST_CHECK( db.Update(hashFork,vUnspent,std::vector<CTxOutPoint>()) );
+
+    // a walker never sees an update half applied across the shards
+    boost::atomic<bool> fDone(false);
+    boost::thread thrSwap(boost::bind(&SwapProc,&db,hashFork,&vUnspent,2000,&fDone));
+    int nPartial = 0;
+    while (!fDone)
+    {
+        CCountWalker walker;
+        BOOST_CHECK( db.WalkThrough(hashFork,walker) );
+        if (walker.nCount != vUnspent.size() || walker.nAmount != 256 * 257 / 2)
+        {
+            nPartial++;
+        }
+    }
+    thrSwap.join();
+    BOOST_CHECK( nPartial == 0 );
+
+    db.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+static void ReadProc(CUnspentDB* pDB,const uint256& hashFork,const std::vector<CTxUnspent>* pvUnspent,
+                     int nStart,int nRead,boost::atomic<int>* pnMiss)
+{
+    for (int i = 0;i < nRead;i++)
+    {
+        const CTxUnspent& unspent = (*pvUnspent)[(nStart + i * 7919) % pvUnspent->size()];
+        CTxOutput output;
+        if (!pDB->Retrieve(hashFork,unspent,output) || output.nAmount != unspent.output.nAmount)
+        {
+            (*pnMiss)++;
+        }
+    }
+}
+
+static void FlushProc(CUnspentDB* pDB,const uint256& hashFork,const std::vector<CTxUnspent>* pvUnspent,
+                      boost::atomic<bool>* pfStop)
+{
+    std::size_t nOffset = 0;
+    while (!*pfStop)
+    {
+        // rewrite existing outputs so every flush has work and readers never miss
+        std::vector<CTxUnspent> vUpdate(pvUnspent->begin() + nOffset,pvUnspent->begin() + nOffset + 10000);
+        pDB->Update(hashFork,vUpdate,std::vector<CTxOutPoint>());
+        std::size_t nCount = 0,nFork = 0;
+        pDB->Flush(nCount,nFork,false);
+        nOffset = (nOffset + 10000) % (pvUnspent->size() - 10000);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( bench )
+{
+    boost::filesystem::path pathTest = boost::filesystem::temp_directory_path()
+                                       / boost::filesystem::unique_path("unspent-%%%%-%%%%");
+    boost::filesystem::create_directories(pathTest);
+
+    CUnspentDB db;
+    BOOST_CHECK( db.Initialize(pathTest) );
+    uint256 hashFork = RandomHash();
+    BOOST_CHECK( db.AddNewFork(hashFork) );
+
+    multiverse::crypto::CPubKey pubkey(RandomHash());
+    CDestination dest(pubkey);
+
+    std::vector<CTxUnspent> vUnspent;
+    for (int i = 0;i < 200000;i++)
+    {
+        vUnspent.push_back(CTxUnspent(CTxOutPoint(RandomHash(),0),CTxOutput(dest,i + 1,0,0)));
+    }
+    BOOST_CHECK( db.Update(hashFork,vUnspent,std::vector<CTxOutPoint>()) );
+    std::size_t nCount = 0,nFork = 0;
+    BOOST_CHECK( db.Flush(nCount,nFork,false) );
+    BOOST_CHECK( db.Flush(nCount,nFork,false) );
+
+    const int nRead = 100000;
+    for (int nThread = 1;nThread <= 16;nThread *= 2)
+    {
+        boost::atomic<bool> fStop(false);
+        boost::atomic<int> nMiss(0);
+        boost::thread thrFlush(boost::bind(&FlushProc,&db,hashFork,&vUnspent,&fStop));
+
+        walleve::CTicks t;
+        boost::thread_group grp;
+        for (int i = 0;i < nThread;i++)
+        {
+            grp.create_thread(boost::bind(&ReadProc,&db,hashFork,&vUnspent,i * nRead,nRead,&nMiss));
+        }
+        grp.join_all();
+        int64 nElapse = t.Elapse();
+
+        fStop = true;
+        thrFlush.join();
+
+        BOOST_CHECK( nMiss == 0 );
+        std::cout << "GetTxUnspent : " << nThread << " threads, "
+                  << (nElapse > 0 ? (int64)nThread * nRead * 1000000 / nElapse : 0) << " reads/s\n";
+    }
+
+    db.Deinitialize();
+    boost::filesystem::remove_all(pathTest);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
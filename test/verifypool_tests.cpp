@@ -0,0 +1,109 @@
+// Copyright (c) 2017-2019 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "test_fnfn.h"
+#include "verifypool.h"
+
+BOOST_FIXTURE_TEST_SUITE(verifypool_tests, BasicUtfSetup)
+
+using namespace multiverse;
+
+BOOST_AUTO_TEST_CASE( run )
+{
+    CVerifyPool pool;
+    BOOST_CHECK( pool.Start(3) );
+
+    std::vector<int> vResult(1000,0);
+    BOOST_CHECK( pool.Run(vResult.size(),[&](std::size_t n) { vResult[n] = n + 1; }) );
+    bool fAll = true;
+    for (std::size_t i = 0;i < vResult.size();i++)
+    {
+        fAll = fAll && (vResult[i] == i + 1);
+    }
+    BOOST_CHECK( fAll );
+
+    pool.Stop();
+}
+
+BOOST_AUTO_TEST_CASE( exception )
+{
+    CVerifyPool pool;
+    BOOST_CHECK( pool.Start(3) );
+
+    // throwing jobs are counted as done on workers and on the calling thread
+    std::atomic<std::size_t> nRun(0);
+    BOOST_CHECK( !pool.Run(200,[&](std::size_t n) {
+        nRun++;
+        if (n % 7 == 0)
+        {
+            throw std::runtime_error("verify failed");
+        }
+    }) );
+    BOOST_CHECK( nRun == 200 );
+
+    // a later run does not see the failure of the earlier one
+    nRun = 0;
+    BOOST_CHECK( pool.Run(200,[&](std::size_t n) { nRun++; }) );
+    BOOST_CHECK( nRun == 200 );
+
+    // the inline path reports the failure as well
+    BOOST_CHECK( !pool.Run(1,[](std::size_t n) { throw std::bad_alloc(); }) );
+
+    pool.Stop();
+    BOOST_CHECK( !pool.Run(2,[](std::size_t n) { if (n == 1) throw 1; }) );
+}
+
+BOOST_AUTO_TEST_CASE( concurrent )
+{
+    CVerifyPool pool;
+    BOOST_CHECK( pool.Start(3) );
+
+    // job sets of several callers run at the same time and each returns with its own jobs done
+    const int nCaller = 4;
+    std::vector<std::vector<int> > vResult(nCaller,std::vector<int>(5000,0));
+    std::vector<int> vRet(nCaller,0);
+    boost::thread_group grpCaller;
+    for (int i = 0;i < nCaller;i++)
+    {
+        grpCaller.create_thread([&,i]() {
+            for (int nRound = 0;nRound < 20;nRound++)
+            {
+                vRet[i] += pool.Run(vResult[i].size(),[&,i](std::size_t n) { vResult[i][n]++; });
+            }
+        });
+    }
+    grpCaller.join_all();
+
+    bool fAll = true;
+    for (int i = 0;i < nCaller;i++)
+    {
+        fAll = fAll && (vRet[i] == 20);
+        for (std::size_t n = 0;n < vResult[i].size();n++)
+        {
+            fAll = fAll && (vResult[i][n] == 20);
+        }
+    }
+    BOOST_CHECK( fAll );
+    pool.Stop();
+}
+
+BOOST_AUTO_TEST_CASE( instance )
+{
+    boost::shared_ptr<CVerifyPool> spPool = CVerifyPool::GetInstance();
+    BOOST_CHECK( spPool != NULL && CVerifyPool::GetInstance() == spPool );
+
+    // the process wide pool stops with its last holder and starts again on next use
+    spPool.reset();
+    spPool = CVerifyPool::GetInstance();
+    std::atomic<std::size_t> nRun(0);
+    BOOST_CHECK( spPool != NULL && spPool->Run(100,[&](std::size_t n) { nRun++; }) && nRun == 100 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
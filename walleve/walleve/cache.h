@@ -39,6 +39,11 @@ class CWalleveCache
     typedef typename CKeyValueContainer::template nth_index<1>::type CKeyValueList;
 public:
     CWalleveCache(std::size_t nMaxCountIn = 0) : nMaxCount(nMaxCountIn) {}
+    std::size_t GetCount() const
+    {
+        CWalleveReadLock rlock(rwAccess);
+        return cntrCache.size();
+    }
     bool Exists(const K& key) const
     {
         CWalleveReadLock rlock(rwAccess);
@@ -21,7 +21,7 @@ public:
     virtual bool Open() = 0;
     virtual void Close() = 0;
     virtual bool TxnBegin() = 0;
-    virtual bool TxnCommit() = 0;
+    virtual bool TxnCommit(bool fSync) = 0;
     virtual void TxnAbort() = 0;
     virtual bool Get(CWalleveBufStream& ssKey,CWalleveBufStream& ssValue) = 0;
     virtual bool Put(CWalleveBufStream& ssKey,CWalleveBufStream& ssValue, bool fOverwrite) = 0;
@@ -94,12 +94,12 @@ public:
         return false;
     }
 
-    bool TxnCommit()
+    bool TxnCommit(bool fSync = true)
     {
         boost::recursive_mutex::scoped_lock lock(mtx);
         if (dbEngine != NULL)
         {
-            return dbEngine->TxnCommit();
+            return dbEngine->TxnCommit(fSync);
         }
         return false;
     }
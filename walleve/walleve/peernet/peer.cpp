@@ -79,6 +79,13 @@ void CPeer::Read(size_t nLength,CompltFunc fnComplt)
                   boost::bind(&CPeer::HandleRead,this,_1,fnComplt));
 }
 
+void CPeer::ReadMore(size_t nLength,CompltFunc fnComplt)
+{
+    // append to the bytes already in ssRecv
+    pClient->Read(ssRecv,nLength,
+                  boost::bind(&CPeer::HandleRead,this,_1,fnComplt));
+}
+
 void CPeer::Write()
 {
     if (indexWrite == indexStream)
@@ -41,6 +41,7 @@ protected:
     CWalleveBufStream& WriteStream();
 
     void Read(std::size_t nLength,CompltFunc fnComplt);
+    void ReadMore(std::size_t nLength,CompltFunc fnComplt);
     void Write();
 
     void HandleRead(std::size_t nTransferred,CompltFunc fnComplt);
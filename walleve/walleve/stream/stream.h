@@ -341,16 +341,19 @@ public:
 
     void Seek(std::size_t pos)
     {
+        ios.clear();
         seekpos((std::streampos)pos);
     }
 
     void SeekToBegin()
     {
+        ios.clear();
         seekoff(0,std::ios_base::beg);
     }
 
     void SeekToEnd()
     {
+        ios.clear();
         seekoff(0,std::ios_base::end);
     }
 
@@ -360,6 +363,48 @@ public:
     }
 };
 
+// Read only stream over external memory, such as a mapped file
+class CWalleveMemoryStream : public std::streambuf, public CWalleveStream
+{
+public:
+    CWalleveMemoryStream(const char* pData,std::size_t nSize) : CWalleveStream(this)
+    {
+        char* p = const_cast<char*>(pData);
+        setg(p,p,p + nSize);
+    }
+
+    bool IsEOF() const
+    {
+        return ios.eof();
+    }
+
+    bool IsFailed() const
+    {
+        return ios.fail();
+    }
+
+    std::size_t GetSize()
+    {
+        return (std::size_t)(egptr() - gptr());
+    }
+
+    std::size_t GetCurPos() const
+    {
+        return (std::size_t)(gptr() - eback());
+    }
+
+    bool Seek(std::size_t nPos)
+    {
+        ios.clear();
+        if (nPos > (std::size_t)(egptr() - eback()))
+        {
+            return false;
+        }
+        setg(eback(),eback() + nPos,egptr());
+        return true;
+    }
+};
+
 // R/W compact size
 //  size <  253        -- 1 byte
 //  size <= USHRT_MAX  -- 3 bytes  (253 + 2 bytes)